@@ -0,0 +1,101 @@
+/**
+  ******************************************************************************
+  * @file           : FreeRTOSConfig.h
+  * @brief          : FreeRTOS configuration for the RTOS firmware (make rtos)
+  *
+  * Kernel under the CMSIS-RTOS2 wrapper (CMSIS_RTOS_V2/cmsis_os2.c) used by
+  * rtos_app.c. SysTick stays HAL's timebase: SysTick_Handler() in
+  * stm32f4xx_it.c calls HAL_IncTick() and then the port tick through
+  * RTOS_App_Tick(), hence USE_CUSTOM_SYSTICK_HANDLER_IMPLEMENTATION. SVC and
+  * PendSV are the port's; the generated handlers are renamed away in
+  * stm32f4xx_it.c. Only read by the kernel sources, never by the firmware.
+  ******************************************************************************
+  */
+
+#ifndef FREERTOS_CONFIG_H
+#define FREERTOS_CONFIG_H
+
+#if defined(__ICCARM__) || defined(__CC_ARM) || defined(__GNUC__)
+#include <stdint.h>
+extern uint32_t SystemCoreClock;
+#endif
+
+#define configENABLE_FPU                         1
+#define configENABLE_MPU                         0
+
+#define configUSE_PREEMPTION                     1
+#define configSUPPORT_STATIC_ALLOCATION          0
+#define configSUPPORT_DYNAMIC_ALLOCATION         1
+#define configUSE_IDLE_HOOK                      0
+#define configUSE_TICK_HOOK                      0
+#define configCPU_CLOCK_HZ                       (SystemCoreClock)
+#define configTICK_RATE_HZ                       ((TickType_t)1000)
+#define configMAX_PRIORITIES                     (56)
+#define configMINIMAL_STACK_SIZE                 ((uint16_t)128)
+#define configTOTAL_HEAP_SIZE                    ((size_t)12288)
+#define configMAX_TASK_NAME_LEN                  (16)
+#define configUSE_TRACE_FACILITY                 1
+#define configUSE_16_BIT_TICKS                   0
+#define configUSE_MUTEXES                        1
+#define configQUEUE_REGISTRY_SIZE                8
+#define configUSE_RECURSIVE_MUTEXES              1
+#define configUSE_COUNTING_SEMAPHORES            1
+#define configUSE_PORT_OPTIMISED_TASK_SELECTION  0
+#define configUSE_NEWLIB_REENTRANT               1   /* printf from several tasks */
+#define configCHECK_FOR_STACK_OVERFLOW           0   /* Stack use: RTOS_App_Dump() */
+#define configRECORD_STACK_HIGH_ADDRESS          1
+
+/* Co-routine definitions */
+#define configUSE_CO_ROUTINES                    0
+#define configMAX_CO_ROUTINE_PRIORITIES          (2)
+
+/* Software timer definitions: the timer task runs event flag sets from ISRs */
+#define configUSE_TIMERS                         1
+#define configTIMER_TASK_PRIORITY                (2)
+#define configTIMER_QUEUE_LENGTH                 10
+#define configTIMER_TASK_STACK_DEPTH             256
+
+/* CMSIS-RTOS V2 flags */
+#define configUSE_OS2_THREAD_SUSPEND_RESUME      1
+#define configUSE_OS2_THREAD_ENUMERATE           1
+#define configUSE_OS2_EVENTFLAGS_FROM_ISR        1
+#define configUSE_OS2_THREAD_FLAGS               1
+#define configUSE_OS2_TIMER                      1
+#define configUSE_OS2_MUTEX                      1
+
+/* Optional functions */
+#define INCLUDE_vTaskPrioritySet                 1
+#define INCLUDE_uxTaskPriorityGet                1
+#define INCLUDE_vTaskDelete                      1
+#define INCLUDE_vTaskCleanUpResources            0
+#define INCLUDE_vTaskSuspend                     1
+#define INCLUDE_vTaskDelayUntil                  1
+#define INCLUDE_vTaskDelay                       1
+#define INCLUDE_xTaskGetSchedulerState           1
+#define INCLUDE_xTimerPendFunctionCall           1
+#define INCLUDE_xQueueGetMutexHolder             1
+#define INCLUDE_uxTaskGetStackHighWaterMark      1
+#define INCLUDE_xTaskGetCurrentTaskHandle        1
+#define INCLUDE_eTaskGetState                    1
+
+/* Cortex-M interrupt priorities (4 bits, NVIC_PRIORITYGROUP_4) */
+#ifdef __NVIC_PRIO_BITS
+#define configPRIO_BITS                          __NVIC_PRIO_BITS
+#else
+#define configPRIO_BITS                          4
+#endif
+#define configLIBRARY_LOWEST_INTERRUPT_PRIORITY        15
+#define configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY   5    /* RTOS_IRQ_PRIO */
+#define configKERNEL_INTERRUPT_PRIORITY     (configLIBRARY_LOWEST_INTERRUPT_PRIORITY << (8 - configPRIO_BITS))
+#define configMAX_SYSCALL_INTERRUPT_PRIORITY (configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY << (8 - configPRIO_BITS))
+
+#define configASSERT(x) if ((x) == 0) { taskDISABLE_INTERRUPTS(); for (;;); }
+
+/* Port handlers mapped to the CMSIS vector names */
+#define vPortSVCHandler                          SVC_Handler
+#define xPortPendSVHandler                       PendSV_Handler
+
+/* SysTick_Handler() is stm32f4xx_it.c's, it calls xPortSysTickHandler() */
+#define USE_CUSTOM_SYSTICK_HANDLER_IMPLEMENTATION 1
+
+#endif /* FREERTOS_CONFIG_H */
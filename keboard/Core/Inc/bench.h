@@ -0,0 +1,43 @@
+/**
+  ******************************************************************************
+  * @file           : bench.h
+  * @brief          : Cycle benchmark suite for the scan, debounce and report paths
+  *
+  * Built into the benchmark firmware (make bench, BENCH_ENABLE=1) and into
+  * the host simulation (sim/, build/keyboard_bench). Every case is timed
+  * BENCH_ITERATIONS times, one call per sample, and printed as one line:
+  *   BENCH <case> n=<samples> min=<> med=<> avg=<> max=<> unit=<cycles|ns>
+  * framed by BENCH_BEGIN / BENCH_END. On the target the unit is DWT core
+  * cycles with interrupts masked per sample; on the host it is nanoseconds.
+  * The cost of an empty measurement is subtracted. bench_compare.py diffs
+  * a run against a saved baseline.
+  ******************************************************************************
+  */
+
+#ifndef __BENCH_H
+#define __BENCH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "stm32f4xx_hal.h"
+
+/* Benchmark configuration */
+#ifndef BENCH_ENABLE
+#define BENCH_ENABLE        0
+#endif
+#define BENCH_ITERATIONS    200U
+
+/* Function Prototypes */
+#if BENCH_ENABLE
+void Bench_Run(void);
+#else
+#define Bench_Run()         ((void)0)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __BENCH_H */
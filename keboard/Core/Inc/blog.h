@@ -0,0 +1,81 @@
+/**
+  ******************************************************************************
+  * @file           : blog.h
+  * @brief          : Deferred-formatting binary log
+  *
+  * BLOG("fmt", args...) does not format on the target. The format string is
+  * placed in the .blog_fmt section, which the linker script keeps in the ELF
+  * as a non-loaded (INFO) section, and its offset in that section is the
+  * message id. Only the id, a timestamp and the raw arguments are sent,
+  * through the same ring buffer as printf (uart_log.c).
+  *
+  * Record (all integers LEB128 varints unless noted):
+  *   tag      1 byte   BLOG_TAG | number of arguments
+  *   id       2 bytes  little endian, offset of the format string
+  *   delta    varint   ms since the previous record
+  *   args     varint   one per argument, as uint32_t
+  * Tag bytes are never valid ASCII, so text from printf() and binary records
+  * can share the stream. blog_decode.py rebuilds the text from the ELF.
+  *
+  * Arguments must be integers, chars or pointers to strings in flash
+  * (string literals, const tables). %s of a RAM buffer and %f are not
+  * supported. Define BLOG_TEXT=1 to format with printf() on the target.
+  ******************************************************************************
+  */
+
+#ifndef __BLOG_H
+#define __BLOG_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "stm32f4xx_hal.h"
+#include <stdint.h>
+
+#ifndef BLOG_TEXT
+#define BLOG_TEXT        0
+#endif
+
+#define BLOG_TAG         0xB0   /* 0xB0..0xB6: tag | argument count */
+#define BLOG_MAX_ARGS    6
+
+/* Argument counting and casting (up to BLOG_MAX_ARGS) */
+#define BLOG_NARG(...)   BLOG_NARG_(0, ##__VA_ARGS__, 6, 5, 4, 3, 2, 1, 0)
+#define BLOG_NARG_(_0, _1, _2, _3, _4, _5, _6, N, ...)  N
+#define BLOG_CAT(a, b)   BLOG_CAT_(a, b)
+#define BLOG_CAT_(a, b)  a##b
+#define BLOG_U32(a)      ((uint32_t)(uintptr_t)(a))
+#define BLOG_ARGS_0()                    0
+#define BLOG_ARGS_1(a)                   BLOG_U32(a)
+#define BLOG_ARGS_2(a, b)                BLOG_U32(a), BLOG_U32(b)
+#define BLOG_ARGS_3(a, b, c)             BLOG_ARGS_2(a, b), BLOG_U32(c)
+#define BLOG_ARGS_4(a, b, c, d)          BLOG_ARGS_3(a, b, c), BLOG_U32(d)
+#define BLOG_ARGS_5(a, b, c, d, e)       BLOG_ARGS_4(a, b, c, d), BLOG_U32(e)
+#define BLOG_ARGS_6(a, b, c, d, e, f)    BLOG_ARGS_5(a, b, c, d, e), BLOG_U32(f)
+#define BLOG_ARGS(...)   BLOG_CAT(BLOG_ARGS_, BLOG_NARG(__VA_ARGS__))(__VA_ARGS__)
+
+#if BLOG_TEXT
+
+#include <stdio.h>
+#define BLOG(fmt, ...)   printf(fmt, ##__VA_ARGS__)
+
+#else
+
+#define BLOG(fmt, ...)                                                              \
+    do {                                                                            \
+        static const char blog_fmt_[] __attribute__((section(".blog_fmt"), used)) = fmt; \
+        const uint32_t blog_args_[BLOG_NARG(__VA_ARGS__) + 1] = { BLOG_ARGS(__VA_ARGS__) }; \
+        BLog_Write((uint32_t)(uintptr_t)blog_fmt_, blog_args_, BLOG_NARG(__VA_ARGS__)); \
+    } while (0)
+
+#endif /* BLOG_TEXT */
+
+/* Function Prototypes */
+void BLog_Write(uint32_t id, const uint32_t *args, uint8_t nargs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __BLOG_H */
@@ -0,0 +1,75 @@
+/**
+  ******************************************************************************
+  * @file           : clock_profile.h
+  * @brief          : Runtime core clock profiles
+  *
+  * The PLL runs at 336 MHz VCO for the whole uptime (SYSCLK 168 MHz, USB
+  * 48 MHz from PLLQ); a profile only changes the AHB prescaler and the APB
+  * prescalers with it, so USB never sees a clock change:
+  *   ACTIVE    HCLK 168 MHz, PCLK1 42 MHz, PCLK2 84 MHz, 5 wait states
+  *   BALANCED  HCLK  84 MHz, PCLK1 42 MHz, PCLK2 84 MHz, 2 wait states
+  *   IDLE      HCLK  42 MHz, PCLK1 42 MHz, PCLK2 42 MHz, 1 wait state
+  * PCLK1 is the same in all of them, so the USART2 baud rate (log, bridge)
+  * needs no reprogramming. After a switch SysTick, the matrix settle delay,
+  * pending latency timestamps and the SWO prescaler follow the new clock.
+  * Policy: any activity (key held, leader sequence, Unicode playback,
+  * queued reports) selects ACTIVE at once; CLOCK_IDLE_BALANCED_MS of
+  * quiet selects BALANCED, CLOCK_IDLE_LOW_MS selects IDLE. Until the host
+  * has configured the device the clock stays at ACTIVE, so enumeration
+  * always runs at the boot clock. Clock_Profile_Restore() brings the PLL
+  * back after STOP mode (usb_suspend.h).
+  ******************************************************************************
+  */
+
+#ifndef __CLOCK_PROFILE_H
+#define __CLOCK_PROFILE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "stm32f4xx_hal.h"
+
+/* Clock profile configuration */
+#ifndef CLOCK_PROFILE_ENABLE
+#define CLOCK_PROFILE_ENABLE    1
+#endif
+#define CLOCK_IDLE_BALANCED_MS  1000U   /* Quiet time before BALANCED */
+#define CLOCK_IDLE_LOW_MS       10000U  /* Quiet time before IDLE */
+
+/* Profiles */
+#define CLOCK_PROFILE_ACTIVE    0
+#define CLOCK_PROFILE_BALANCED  1
+#define CLOCK_PROFILE_IDLE      2
+#define CLOCK_PROFILES          3
+#define CLOCK_PROFILE_AUTO      0xFF    /* Clock_Profile_Pin(): back to the policy */
+
+/* Counters since boot */
+typedef struct {
+    uint32_t switches;                  // Profile changes
+    uint32_t ms[CLOCK_PROFILES];        // Time spent in each profile
+} Clock_Profile_Stats_t;
+
+/* Function Prototypes */
+#if CLOCK_PROFILE_ENABLE
+void Clock_Profile_Init(void);
+void Clock_Profile_Task(uint8_t busy);
+void Clock_Profile_Set(uint8_t profile);
+void Clock_Profile_Restore(void);
+void Clock_Profile_Pin(uint8_t profile);
+uint8_t Clock_Profile_Get(void);
+const Clock_Profile_Stats_t *Clock_Profile_Get_Stats(void);
+#else
+#define Clock_Profile_Init()            ((void)0)
+#define Clock_Profile_Task(busy)        ((void)(busy))
+#define Clock_Profile_Set(profile)      ((void)0)
+#define Clock_Profile_Restore()         SystemClock_Config()
+#define Clock_Profile_Pin(profile)      ((void)0)
+#define Clock_Profile_Get()             (CLOCK_PROFILE_ACTIVE)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __CLOCK_PROFILE_H */
@@ -0,0 +1,77 @@
+/**
+  ******************************************************************************
+  * @file           : config_proto.h
+  * @brief          : Framed binary configuration protocol on the CDC port
+  *
+  * Frame (little endian):
+  *   0xA5 | len u16 | id u16 | cmd u8 | payload | crc u16
+  * len counts id + cmd + payload (3..CONFIG_PROTO_PAYLOAD_MAX + 3), the
+  * CRC-16/CCITT-FALSE covers len up to the end of the payload.
+  * Every request is answered with a frame carrying the same id, cmd | 0x80
+  * and the status byte as the first payload byte, followed by the data.
+  * Requests are handled in order, so a host may send many frames without
+  * waiting (pipelining) and match the answers by id. When the answers are
+  * not read, the device stops reading requests and the CDC OUT endpoint
+  * NAKs until there is room again.
+  * The host tool is config_tool.py.
+  ******************************************************************************
+  */
+
+#ifndef __CONFIG_PROTO_H
+#define __CONFIG_PROTO_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "stm32f4xx_hal.h"
+
+/* Frame layout */
+#define CONFIG_PROTO_SOF            0xA5U
+#define CONFIG_PROTO_VERSION        1U
+#define CONFIG_PROTO_FRAME_MAX      128U
+#define CONFIG_PROTO_OVERHEAD       8U      /* SOF, len, id, cmd, crc */
+#define CONFIG_PROTO_PAYLOAD_MAX    (CONFIG_PROTO_FRAME_MAX - CONFIG_PROTO_OVERHEAD)
+#define CONFIG_PROTO_RESPONSE       0x80U   /* Set in the cmd of answers */
+
+/* Commands: request payload -> answer data (after the status byte) */
+#define CONFIG_CMD_PING             0x00U   /* any -> same bytes */
+#define CONFIG_CMD_INFO             0x01U   /* - -> version, payload max, keys, macros, macro size, latency stages */
+#define CONFIG_CMD_KEYMAP_GET       0x10U   /* first, count -> count HID codes */
+#define CONFIG_CMD_KEYMAP_SET       0x11U   /* first, HID codes -> - (one flash write) */
+#define CONFIG_CMD_DEBOUNCE_GET     0x20U   /* - -> ms u16, algorithm */
+#define CONFIG_CMD_DEBOUNCE_SET     0x21U   /* ms u16 [, algorithm] -> - */
+#define CONFIG_CMD_MACRO_GET        0x30U   /* n -> stored bytes (none if unset) */
+#define CONFIG_CMD_MACRO_SET        0x31U   /* n, 1..FLASH_KV_VALUE_SIZE bytes -> - */
+#define CONFIG_CMD_STATS_GET        0x40U   /* - -> uptime ms, USB frame, Config_Proto_Stats_t, u32 each */
+#define CONFIG_CMD_STATS_RESET      0x41U   /* - -> - (also the latency histograms) */
+#define CONFIG_CMD_LATENCY_GET      0x42U   /* stage -> count, min, p50, p90, p99, max u32 in us */
+
+/* Status byte */
+#define CONFIG_STATUS_OK            0x00U
+#define CONFIG_STATUS_UNKNOWN_CMD   0x01U
+#define CONFIG_STATUS_BAD_LENGTH    0x02U
+#define CONFIG_STATUS_RANGE         0x03U
+#define CONFIG_STATUS_FLASH         0x04U
+#define CONFIG_STATUS_CRC           0x05U
+#define CONFIG_STATUS_UNSUPPORTED   0x06U
+
+/* Counters since boot or the last CONFIG_CMD_STATS_RESET */
+typedef struct {
+    uint32_t rx_frames;         // Requests handled
+    uint32_t tx_frames;         // Answers queued
+    uint32_t crc_errors;        // Frames dropped for a bad CRC
+    uint32_t framing_errors;    // Bytes skipped while looking for a frame
+    uint32_t busy;              // Polls that waited for room in the TX ring
+} Config_Proto_Stats_t;
+
+/* Function Prototypes */
+void Config_Proto_Task(void);
+uint16_t Config_Proto_Crc16(uint16_t crc, const uint8_t *data, uint16_t len);
+const Config_Proto_Stats_t *Config_Proto_Get_Stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __CONFIG_PROTO_H */
@@ -0,0 +1,63 @@
+/**
+  ******************************************************************************
+  * @file           : flash_kv.h
+  * @brief          : Log-structured key/value store in flash (EEPROM emulation)
+  *
+  * Storage: flash sectors 2 and 3 (16 KB each), reserved in STM32F407XX_FLASH.ld.
+  * One sector is active and receives appended records; when it fills up the
+  * live values are copied into the other sector and the old one is erased
+  * later while the keyboard is idle.
+  *
+  * Record layout (FLASH_KV_RECORD_SIZE bytes, slot 0 holds the sector header):
+  *   word 0 : id | len << 8 | live << 16 | crc8 << 24   (written last = commit)
+  *   word 1+: value bytes
+  * "live" is the number of distinct ids stored when the record was written,
+  * which lets boot stop the backward scan as soon as every id is found.
+  ******************************************************************************
+  */
+
+#ifndef __FLASH_KV_H
+#define __FLASH_KV_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "stm32f4xx_hal.h"
+
+/* Flash layout */
+#define FLASH_KV_SECTOR_A         FLASH_SECTOR_2
+#define FLASH_KV_SECTOR_B         FLASH_SECTOR_3
+#define FLASH_KV_SECTOR_A_ADDR    0x08008000U
+#define FLASH_KV_SECTOR_B_ADDR    0x0800C000U
+#define FLASH_KV_SECTOR_SIZE      0x4000U
+#define FLASH_KV_RECORD_SIZE      32U
+#define FLASH_KV_VALUE_SIZE       (FLASH_KV_RECORD_SIZE - 4U)
+#define FLASH_KV_SLOTS            (FLASH_KV_SECTOR_SIZE / FLASH_KV_RECORD_SIZE)
+#define FLASH_KV_MAGIC            0x4B564631U   /* "KVF1" */
+
+/* Number of ids held in the RAM cache */
+#define FLASH_KV_MAX_KEYS         32U
+
+/* Quiet time after the last write before a retired sector is erased (ms) */
+#define FLASH_KV_ERASE_DELAY      2000U
+
+/* Key ids */
+#define KV_ID_KEYMAP              0x00U   /* matrix_to_usb_hid[], TOTAL_KEYS bytes */
+#define KV_ID_DEBOUNCE            0x01U   /* debounce time in ms (uint16_t), algorithm (uint8_t) */
+#define KV_ID_REPEAT              0x02U   /* KeyRepeat_Config_t[TOTAL_KEYS] */
+#define KV_ID_UNICODE_MODE        0x03U   /* host input method, uint8_t */
+#define KV_ID_MACRO_BASE          0x10U   /* macro n at KV_ID_MACRO_BASE + n */
+#define KV_MAX_MACROS             8U
+
+/* Function Prototypes */
+void FlashKV_Init(void);
+uint8_t FlashKV_Get(uint8_t id, void *buf, uint8_t max_len);
+HAL_StatusTypeDef FlashKV_Set(uint8_t id, const void *data, uint8_t len);
+void FlashKV_Task(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __FLASH_KV_H */
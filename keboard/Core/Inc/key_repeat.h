@@ -0,0 +1,49 @@
+/**
+  ******************************************************************************
+  * @file           : key_repeat.h
+  * @brief          : Device-side auto-repeat and turbo engine header
+  *
+  * Keys in REPEAT or TURBO mode are never left held in the HID report.
+  * Each press or repeat is sent as a tap (press report + release report),
+  * so the host OS typematic delay/rate never applies. Taps are scheduled
+  * in USB frames (SOF), so the rate is not limited by the main loop or
+  * by the matrix scan period.
+  ******************************************************************************
+  */
+
+#ifndef __KEY_REPEAT_H
+#define __KEY_REPEAT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "stm32f4xx_hal.h"
+
+/* Repeat modes */
+#define KEY_REPEAT_OFF       0   /* Normal key, host handles repeat */
+#define KEY_REPEAT_AUTO      1   /* Tap, wait delay, then tap at rate */
+#define KEY_REPEAT_TURBO     2   /* Tap at rate from the first press */
+
+/* A tap needs two reports, so one frame per report caps the rate */
+#define KEY_REPEAT_MIN_PERIOD   2     /* frames */
+
+/* Per-key configuration (persisted as KV_ID_REPEAT) */
+typedef struct {
+    uint8_t mode;       // KEY_REPEAT_OFF / AUTO / TURBO
+    uint8_t delay;      // AUTO: initial delay in units of 10 ms
+    uint8_t rate;       // Taps per second
+} KeyRepeat_Config_t;
+
+/* Function Prototypes */
+void KeyRepeat_Init(void);
+uint8_t KeyRepeat_Process_Key(uint8_t matrix_key, uint8_t usb_key, uint8_t pressed);
+void KeyRepeat_Task(void);
+HAL_StatusTypeDef KeyRepeat_Set_Config(uint8_t matrix_key, uint8_t mode, uint8_t delay, uint8_t rate);
+void KeyRepeat_Get_Config(uint8_t matrix_key, KeyRepeat_Config_t *config);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __KEY_REPEAT_H */
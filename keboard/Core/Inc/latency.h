@@ -0,0 +1,101 @@
+/**
+  ******************************************************************************
+  * @file           : latency.h
+  * @brief          : End-to-end key latency instrumentation
+  *
+  * Every matrix key transition is timestamped (DWT cycle counter) at five
+  * points on its way to the host:
+  *   edge      first raw sample that differs from the debounced state
+  *   debounce  debounce decision (Matrix_Key_Callback is called)
+  *   build     report queued by USB_Keyboard_SendReport()
+  *   send      report handed to USBD_HID_SendReport()
+  *   in        IN transfer complete (USBD_HID_DataIn)
+  * The per-stage deltas and the edge->in total go into running histograms
+  * in RAM (log-linear buckets, 8 per octave: 12.5 % resolution). Transitions
+  * that never produce a report (leader, mouse and repeat keys) and reports
+  * not caused by a matrix transition are not counted.
+  * Latency_Dump() prints count/min/percentiles/max per stage; a key mapped
+  * to KEY_LAT_DUMP requests a dump from the main loop.
+  ******************************************************************************
+  */
+
+#ifndef __LATENCY_H
+#define __LATENCY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "stm32f4xx_hal.h"
+
+/* Latency configuration */
+#ifndef LATENCY_ENABLE
+#define LATENCY_ENABLE          1
+#endif
+#define LATENCY_BUCKETS         184U    /* Up to 2^24 us */
+#define LATENCY_EDGE_TIMEOUT    100U    /* ms before an undecided edge is replaced */
+
+/* Stages */
+#define LATENCY_STAGE_DEBOUNCE  0       /* edge -> debounce */
+#define LATENCY_STAGE_BUILD     1       /* debounce -> build */
+#define LATENCY_STAGE_QUEUE     2       /* build -> send */
+#define LATENCY_STAGE_IN        3       /* send -> IN complete */
+#define LATENCY_STAGE_TOTAL     4       /* edge -> IN complete */
+#define LATENCY_STAGES          5
+
+/* Running histogram of one stage, values in microseconds */
+typedef struct {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+    uint16_t bucket[LATENCY_BUCKETS];
+} Latency_Hist_t;
+
+/* Edge and debounce stamps of a transition handed to another task
+ * (rtos_app.c): taken by the scan, restored before the key is handled */
+typedef struct {
+    uint32_t t[2];
+    uint8_t valid;
+} Latency_Key_Stamp_t;
+
+/* Function Prototypes */
+#if LATENCY_ENABLE
+void Latency_Init(void);
+void Latency_Edge(uint8_t matrix_key);
+void Latency_Debounced(uint8_t matrix_key);
+void Latency_Debounced_Stamp(uint8_t matrix_key, Latency_Key_Stamp_t *stamp);
+void Latency_Key_Done(void);
+void Latency_Key_Restore(const Latency_Key_Stamp_t *stamp);
+void Latency_Report_Built(uint8_t slot);
+void Latency_Report_Sent(uint8_t slot);
+void Latency_Report_Done(void);
+void Latency_Task(void);
+void Latency_Request_Dump(void);
+void Latency_Dump(void);
+void Latency_Reset(void);
+uint32_t Latency_Percentile(uint8_t stage, uint8_t percent);
+const Latency_Hist_t *Latency_Get_Hist(uint8_t stage);
+void Latency_Clock_Changed(uint32_t old_hz);
+#else
+#define Latency_Init()                  ((void)0)
+#define Latency_Edge(matrix_key)        ((void)0)
+#define Latency_Debounced(matrix_key)   ((void)0)
+#define Latency_Debounced_Stamp(matrix_key, stamp) ((void)(stamp))
+#define Latency_Key_Done()              ((void)0)
+#define Latency_Key_Restore(stamp)      ((void)(stamp))
+#define Latency_Report_Built(slot)      ((void)0)
+#define Latency_Report_Sent(slot)       ((void)0)
+#define Latency_Report_Done()           ((void)0)
+#define Latency_Task()                  ((void)0)
+#define Latency_Request_Dump()          ((void)0)
+#define Latency_Dump()                  ((void)0)
+#define Latency_Reset()                 ((void)0)
+#define Latency_Clock_Changed(old_hz)   ((void)0)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __LATENCY_H */
@@ -0,0 +1,62 @@
+/**
+  ******************************************************************************
+  * @file           : leader_key.h
+  * @brief          : Leader-key sequence engine header
+  *
+  * Pressing KEY_LEADER followed by up to LEADER_MAX_SEQUENCE keys triggers an
+  * action. Sequences live in a double-array trie in flash (leader_trie.c,
+  * generated by leader_trie_gen.py from leader_sequences.txt), so every
+  * keystroke costs exactly one trie step no matter how many sequences exist.
+  ******************************************************************************
+  */
+
+#ifndef __LEADER_KEY_H
+#define __LEADER_KEY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "stm32f4xx_hal.h"
+
+/* Key that starts a sequence (see usb_keyboard.h) */
+#define LEADER_KEY            KEY_LEADER
+
+/* Maximum number of keys after the leader (must match leader_trie_gen.py) */
+#define LEADER_MAX_SEQUENCE   8
+
+/* Idle time after which a pending sequence is resolved, in milliseconds */
+#define LEADER_TIMEOUT        1000
+
+/* Marks an empty slot in the trie check array */
+#define LEADER_TRIE_EMPTY     0xFFFF
+
+/* Action encoding: high byte = modifier bits, low byte = HID keycode */
+#define LEADER_ACTION(mod, key)   ((uint16_t)(((mod) << 8) | (key)))
+#define LEADER_ACTION_NONE        0x0000
+
+/* Double-array trie slot
+ * Child of state s on keycode c is t = base[s] + c, valid if check[t] == s.
+ * base == 0 means the state has no children. */
+typedef struct {
+    uint16_t base;
+    uint16_t check;
+    uint16_t action;
+} Leader_TrieNode_t;
+
+/* Generated tables (leader_trie.c) */
+extern const Leader_TrieNode_t leader_trie[];
+extern const uint16_t leader_trie_size;
+
+/* Function Prototypes */
+void Leader_Init(void);
+uint8_t Leader_Process_Key(uint8_t key_code, uint8_t pressed);
+void Leader_Task(void);
+uint8_t Leader_Is_Active(void);
+void Leader_Action_Callback(uint16_t action);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __LEADER_KEY_H */
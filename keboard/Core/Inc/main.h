@@ -54,6 +54,10 @@ extern "C" {
 void Error_Handler(void);
 
 /* USER CODE BEGIN EFP */
+void SystemClock_Config(void);
+void App_Key_Handle(uint8_t key_code, uint8_t pressed);
+uint8_t App_Busy(void);
+void App_Banner_Task(void);
 
 /* USER CODE END EFP */
 
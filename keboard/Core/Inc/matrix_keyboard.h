@@ -35,13 +35,47 @@ extern "C" {
 #define COL_PIN_1        GPIO_PIN_7   // Column 1
 #define COL_PIN_2        GPIO_PIN_8   // Column 2
 
-/* Debounce delay in milliseconds */
+/* Default debounce delay in milliseconds (overridden by FlashKV setting) */
 #define DEBOUNCE_TIME    20
 
+/* Accepted debounce times: 0 (no debouncing) to DEBOUNCE_TIME_MAX ms */
+#define DEBOUNCE_TIME_MAX    100U
+
+/* Debounce algorithms (Matrix_Keyboard_Set_Debounce_Algo) */
+#define DEBOUNCE_DEFER        0   /* Report once the input has differed for the whole debounce time */
+#define DEBOUNCE_EAGER        1   /* Report the first edge, then ignore the input for the debounce time */
+#define DEBOUNCE_INTEGRATOR   2   /* Up/down counter in ms, report when it saturates */
+#ifndef DEBOUNCE_ALGO
+#define DEBOUNCE_ALGO         DEBOUNCE_DEFER
+#endif
+
+/* Busy-wait after driving a row, lets the column lines settle. The loop
+ * count follows the core clock (Matrix_Keyboard_Clock_Update) */
+#ifndef MATRIX_SETTLE_US
+#define MATRIX_SETTLE_US      8
+#endif
+#define MATRIX_SETTLE_LOOP_CYCLES   6   /* Core cycles per delay loop pass */
+
+/* Power-up sampling (Matrix_Keyboard_Boot_Sync), one sample per ms */
+#define MATRIX_BOOT_STABLE    3   /* Equal samples in a row to accept the held keys */
+#define MATRIX_BOOT_SAMPLES   10  /* Give up after this many samples */
+
+/* STOP wake-up sampling (Matrix_Keyboard_Wake_Latch), back to back */
+#define MATRIX_WAKE_SAMPLES   8   /* A key closed in any of them is latched */
+
 /* Function Prototypes */
 void Matrix_Keyboard_Init(void);
 void Matrix_Keyboard_Scan(void);
+uint8_t Matrix_Keyboard_Boot_Sync(void);
+uint16_t Matrix_Keyboard_Wake_Latch(void);
 uint8_t Matrix_Get_Key_Status(uint8_t row, uint8_t col);
+uint8_t Matrix_Keyboard_Any_Pressed(void);
+HAL_StatusTypeDef Matrix_Keyboard_Set_Debounce(uint16_t ms);
+uint16_t Matrix_Keyboard_Get_Debounce(void);
+HAL_StatusTypeDef Matrix_Keyboard_Set_Debounce_Algo(uint8_t algo);
+uint8_t Matrix_Keyboard_Get_Debounce_Algo(void);
+void Matrix_Keyboard_Clock_Update(void);
+uint8_t Matrix_Keyboard_Debounce_Key(uint8_t row, uint8_t col, uint8_t raw, uint32_t now, uint32_t elapsed);
 void Matrix_Key_Callback(uint8_t key_code, uint8_t pressed);
 
 #ifdef __cplusplus
@@ -0,0 +1,50 @@
+/**
+  ******************************************************************************
+  * @file           : mouse_keys.h
+  * @brief          : Mouse emulation from matrix keys header
+  *
+  * Keys mapped to KEY_MS_* move the pointer, scroll and click. Movement is
+  * computed once per USB frame from the set of held direction keys, with
+  * one shared speed state (no per-key timers). Speed is a Q15 fraction of
+  * MOUSE_MAX_SPEED and follows one of three acceleration profiles:
+  *   CONSTANT     speed = 1.0 while any direction is held
+  *   LINEAR       speed += MOUSE_LINEAR_STEP per frame
+  *   EXPONENTIAL  speed += speed * MOUSE_EXP_GROWTH per frame
+  ******************************************************************************
+  */
+
+#ifndef __MOUSE_KEYS_H
+#define __MOUSE_KEYS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "stm32f4xx_hal.h"
+
+/* Acceleration profiles */
+#define MOUSE_PROFILE_CONSTANT      0
+#define MOUSE_PROFILE_LINEAR        1
+#define MOUSE_PROFILE_EXPONENTIAL   2
+
+/* Mouse keys configuration */
+#define MOUSE_KEYS_PROFILE      MOUSE_PROFILE_LINEAR   /* Profile after reset */
+#define MOUSE_MAX_SPEED         4        /* Pixels per frame at speed 1.0 */
+#define MOUSE_START_SPEED       0x0200   /* Q15, speed of the first frame (1/64) */
+#define MOUSE_LINEAR_STEP       0x0041   /* Q15 per frame, 1.0 after ~500 ms */
+#define MOUSE_EXP_GROWTH        0x00E4   /* Q15 per frame, doubles every ~100 ms */
+#define MOUSE_WHEEL_SPEED       0x0290   /* Q15 wheel steps per frame (~20/s) */
+#define MOUSE_MAX_CATCHUP       8        /* Frames computed per call at most */
+
+/* Function Prototypes */
+void Mouse_Keys_Init(void);
+uint8_t Mouse_Keys_Process_Key(uint8_t key_code, uint8_t pressed);
+void Mouse_Keys_Task(void);
+void Mouse_Keys_Set_Profile(uint8_t new_profile);
+uint8_t Mouse_Keys_Get_Profile(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __MOUSE_KEYS_H */
@@ -0,0 +1,56 @@
+/**
+  ******************************************************************************
+  * @file           : ram_sections.h
+  * @brief          : Placement of hot code and data outside flash
+  *
+  * CCM_BSS / CCM_DATA put a variable in the 64 KB core-coupled RAM: zero
+  * wait states and off the bus matrix, so scan state accesses never wait
+  * behind USB or DMA traffic. Only the core can reach CCM: no DMA buffers,
+  * no buffers handed to the USB stack, and no code (the core cannot fetch
+  * instructions from it).
+  * RAM_FUNC puts a function in SRAM (.ramfunc), away from the flash wait
+  * states (5 at 168 MHz) and the ART cache misses after a long idle. Calls
+  * between flash and SRAM go through linker veneers.
+  * NOINIT puts a buffer in .noinit, which the startup code does not clear:
+  * for buffers always written before they are read (DMA and frame
+  * buffers, rings indexed by separate counters), so boot does not spend
+  * time zeroing them. Their content after reset is undefined.
+  * The startup code copies .ramfunc and .ccmram and clears .ccmbss
+  * (STM32F407XX_FLASH.ld, startup_stm32f407xx.s). Host builds (SIM_BUILD)
+  * and RAM_PLACEMENT_ENABLE=0 leave everything at its default place.
+  ******************************************************************************
+  */
+
+#ifndef __RAM_SECTIONS_H
+#define __RAM_SECTIONS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Placement configuration */
+#ifndef RAM_PLACEMENT_ENABLE
+#ifdef SIM_BUILD
+#define RAM_PLACEMENT_ENABLE    0
+#else
+#define RAM_PLACEMENT_ENABLE    1
+#endif
+#endif
+
+#if RAM_PLACEMENT_ENABLE
+#define CCM_BSS                 __attribute__((section(".ccmbss")))
+#define CCM_DATA                __attribute__((section(".ccmram")))
+#define RAM_FUNC                __attribute__((section(".RamFunc"), noinline))
+#define NOINIT                  __attribute__((section(".noinit")))
+#else
+#define CCM_BSS
+#define CCM_DATA
+#define RAM_FUNC
+#define NOINIT
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __RAM_SECTIONS_H */
@@ -0,0 +1,94 @@
+/**
+  ******************************************************************************
+  * @file           : rtos_app.h
+  * @brief          : CMSIS-RTOS2 task layout (RTOS firmware, make rtos)
+  *
+  * The super loop in main() is replaced by four tasks, highest first:
+  *   scan    every RTOS_SCAN_PERIOD_MS (osDelayUntil): Matrix_Keyboard_Scan().
+  *           Debounced transitions only go into the key queue.
+  *   report  woken by the key queue, IN complete (event flags) or 1 ms:
+  *           key handling, leader/repeat/mouse/Unicode, USB_Keyboard_Task().
+  *   cdc     woken by CDC OUT packets or RTOS_CDC_POLL_MS: configuration
+  *           protocol, or USART2 in the bridge firmware.
+  *   log     every RTOS_LOG_PERIOD_MS: latency folding and dumps, FlashKV
+  *           erase, clock profile, USB suspend, banner, boot time.
+  * The scan task takes no lock, so a long macro or config upload on the
+  * CDC port (or a histogram dump) cannot delay scanning. It owns the
+  * matrix, debounce and latency edge state; what it shares is the key
+  * queue (transitions with their latency stamps), the debounce settings,
+  * handed over as pending values it applies at the start of a pass
+  * (Matrix_Keyboard_Set_Debounce*), and the debounced key states, which
+  * the others only read (Matrix_Keyboard_Any_Pressed). The report, cdc
+  * and log tasks share the HID and settings state under one mutex.
+  * Per task: work passes, DWT cycles spent (time preempted by higher
+  * priority tasks and interrupts included), longest pass and lowest free
+  * stack (osThreadGetStackSpace). A KEY_LAT_DUMP key prints them too.
+  *
+  * Only the CMSIS-RTOS2 API is used, except RTOS_App_Tick(): the SysTick
+  * interrupt stays HAL's 1 kHz tick (clock profiles keep reprogramming it)
+  * and forwards to the kernel, so the kernel is the STM32Cube FreeRTOS
+  * with its CMSIS_RTOS_V2 wrapper (FreeRTOSConfig.h). The OTG interrupt
+  * is moved to RTOS_IRQ_PRIO so its callbacks may set event flags.
+  ******************************************************************************
+  */
+
+#ifndef __RTOS_APP_H
+#define __RTOS_APP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "stm32f4xx_hal.h"
+
+/* RTOS configuration */
+#ifndef RTOS_ENABLE
+#define RTOS_ENABLE             0
+#endif
+#define RTOS_SCAN_PERIOD_MS     10U     /* Same rate as the super loop */
+#define RTOS_CDC_POLL_MS        1U      /* USART2 RX DMA and CDC TX room are polled */
+#define RTOS_LOG_PERIOD_MS      5U      /* Also paces remote wakeup signalling */
+#define RTOS_KEY_QUEUE_LEN      32U     /* Debounced transitions scan -> report */
+#define RTOS_IRQ_PRIO           5U      /* configMAX_SYSCALL_INTERRUPT_PRIORITY */
+
+/* Tasks */
+#define RTOS_TASK_SCAN          0
+#define RTOS_TASK_REPORT        1
+#define RTOS_TASK_CDC           2
+#define RTOS_TASK_LOG           3
+#define RTOS_TASKS              4
+
+/* Counters of one task since boot */
+typedef struct {
+    uint32_t runs;              // Work passes
+    uint32_t cycles;            // Core cycles in work passes (wraps)
+    uint32_t max_cycles;        // Longest work pass
+    uint32_t stack_size;        // Bytes
+    uint32_t stack_free_min;    // Lowest free stack seen, bytes
+} RTOS_Task_Stats_t;
+
+/* Function Prototypes */
+#if RTOS_ENABLE
+void RTOS_App_Start(void);
+uint8_t RTOS_App_Post_Key(uint8_t key_code, uint8_t pressed);
+void RTOS_App_In_Complete(void);
+void RTOS_App_Cdc_Rx(void);
+void RTOS_App_Tick(void);
+void RTOS_App_Request_Dump(void);
+void RTOS_App_Dump(void);
+const RTOS_Task_Stats_t *RTOS_App_Get_Stats(uint8_t task);
+uint32_t RTOS_App_Get_Key_Drops(void);
+#else
+#define RTOS_App_Start()                    ((void)0)
+#define RTOS_App_Post_Key(key_code, pressed) (0U)
+#define RTOS_App_In_Complete()              ((void)0)
+#define RTOS_App_Cdc_Rx()                   ((void)0)
+#define RTOS_App_Tick()                     ((void)0)
+#define RTOS_App_Request_Dump()             ((void)0)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __RTOS_APP_H */
@@ -0,0 +1,69 @@
+/**
+  ******************************************************************************
+  * @file           : trace.h
+  * @brief          : ITM/SWO event trace header
+  *
+  * Events are written to ITM stimulus ports and leave the chip on the SWO
+  * pin (PB3), so tracing costs neither USART2 nor USB bandwidth:
+  *   port 0  TRACE_PORT_LOG     log bytes (printf text and BLOG records)
+  *   port 1  TRACE_PORT_KEY     key events, 4 bytes:
+  *                              matrix key | pressed << 8 | HID code << 16
+  *   port 2  TRACE_PORT_REPORT  report handed to the endpoint, 8 + 4 bytes:
+  *                              report ID followed by the report
+  *   port 3  TRACE_PORT_USB     USB device state (USBD_STATE_*), 1 byte
+  *   port 4  TRACE_PORT_CLOCK   new core clock in Hz after a clock profile
+  *                              switch, 4 bytes
+  * ITM local timestamps are enabled and count core cycles, so the decoder
+  * needs port 4 to convert them. swo_decode.py decodes captured streams.
+  * A write never waits for the ITM FIFO: if it is full the packet is
+  * dropped and counted (Trace_Get_Dropped()).
+  ******************************************************************************
+  */
+
+#ifndef __TRACE_H
+#define __TRACE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "stm32f4xx_hal.h"
+
+/* Stimulus ports */
+#define TRACE_PORT_LOG       0
+#define TRACE_PORT_KEY       1
+#define TRACE_PORT_REPORT    2
+#define TRACE_PORT_USB       3
+#define TRACE_PORT_CLOCK     4
+
+/* Trace configuration */
+#ifndef TRACE_ENABLE
+#define TRACE_ENABLE         1
+#endif
+#define TRACE_SWO_SETUP      1          /* 0: leave TPIU/SWO setup to the debugger */
+#define TRACE_SWO_BAUD       2000000U   /* SWO bit rate when TRACE_SWO_SETUP = 1 */
+
+/* Function Prototypes */
+#if TRACE_ENABLE
+void Trace_Init(void);
+void Trace_Write(uint8_t port, const void *data, uint16_t len);
+void Trace_Key(uint8_t matrix_key, uint8_t pressed, uint8_t usb_key);
+void Trace_Report(uint8_t report_id, const void *report, uint8_t len);
+void Trace_Usb_State(uint8_t state);
+void Trace_Clock_Changed(void);
+uint32_t Trace_Get_Dropped(void);
+#else
+#define Trace_Init()                          ((void)0)
+#define Trace_Write(port, data, len)          ((void)0)
+#define Trace_Key(matrix_key, pressed, key)   ((void)0)
+#define Trace_Report(id, report, len)         ((void)0)
+#define Trace_Usb_State(state)                ((void)0)
+#define Trace_Clock_Changed()                 ((void)0)
+#define Trace_Get_Dropped()                   (0U)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __TRACE_H */
@@ -0,0 +1,66 @@
+/**
+  ******************************************************************************
+  * @file           : uart_bridge.h
+  * @brief          : USB CDC <-> USART2 bridge (bridge firmware, make bridge)
+  *
+  * With UART_BRIDGE_ENABLE=1 the CDC port is a USB serial adapter for the
+  * USART2 pins (PA2 TX, PA3 RX) instead of the configuration protocol:
+  *  - host -> UART: each received CDC packet is sent by USART2 TX DMA
+  *    straight from its RX slot; the OUT endpoint NAKs while the UART is
+  *    behind, so this direction cannot overrun.
+  *  - UART -> host: USART2 RX DMA runs circularly into a RAM buffer and
+  *    is drained into the CDC TX ring on half/full transfer and on line
+  *    idle, so a short reply is forwarded as soon as the line goes quiet.
+  *  - SET_LINE_CODING is applied live: baud rate, parity, data and stop
+  *    bits. Settings USART2 cannot do are refused and counted; the UART
+  *    keeps its previous settings.
+  * The log (printf) moves to ITM/SWO in this build, see uart_log.h.
+  ******************************************************************************
+  */
+
+#ifndef __UART_BRIDGE_H
+#define __UART_BRIDGE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "stm32f4xx_hal.h"
+
+/* Bridge configuration */
+#ifndef UART_BRIDGE_ENABLE
+#define UART_BRIDGE_ENABLE      0
+#endif
+
+/* USART2 RX DMA buffer (power of two). The top rate is PCLK1 / 8 with
+ * 8x oversampling, 5.25 Mbaud at PCLK1 = 42 MHz, i.e. 525 bytes/ms. The
+ * buffer and the CDC TX ring (APP_TX_DATA_SIZE, 1024 bytes) together
+ * hold 9.8 ms of that, which covers a host that skips IN polls for a few
+ * frames. */
+#define UART_BRIDGE_RX_SIZE     4096U
+
+/* Counters since boot */
+typedef struct {
+    uint32_t to_uart;           // Bytes sent on USART2 TX
+    uint32_t to_usb;            // Bytes queued to the CDC IN endpoint
+    uint32_t rx_dropped;        // Received bytes overwritten before the host took them
+    uint32_t line_errors;       // Parity, framing, noise and overrun errors
+    uint32_t codings;           // Line codings applied
+    uint32_t codings_refused;   // Line codings USART2 cannot do
+} UART_Bridge_Stats_t;
+
+/* Function Prototypes */
+#if UART_BRIDGE_ENABLE
+void UART_Bridge_Init(void);
+void UART_Bridge_Task(void);
+const UART_Bridge_Stats_t *UART_Bridge_Get_Stats(void);
+#else
+#define UART_Bridge_Init()      ((void)0)
+#define UART_Bridge_Task()      ((void)0)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __UART_BRIDGE_H */
@@ -0,0 +1,51 @@
+/**
+  ******************************************************************************
+  * @file           : uart_log.h
+  * @brief          : Non-blocking UART log backend (ring buffer + USART2 TX DMA)
+  *
+  * printf(), _write() and __io_putchar() copy into a RAM ring buffer and
+  * return immediately; DMA1 Stream6 drains it to USART2 in the background.
+  * A message that does not fit is dropped whole and counted, the writer
+  * never waits for the UART. After a drop the next message that fits is
+  * preceded by UART_LOG_DROP_MARKER so the gap is visible in the output.
+  ******************************************************************************
+  */
+
+#ifndef __UART_LOG_H
+#define __UART_LOG_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "stm32f4xx_hal.h"
+#include "uart_bridge.h"
+
+/* Ring buffer size in bytes (power of two) */
+#define UART_LOG_BUFFER_SIZE   2048U
+
+/* Log backends (UART_LOG_BACKEND may combine both) */
+#define UART_LOG_TO_UART       0x01
+#define UART_LOG_TO_ITM        0x02   /* ITM stimulus port 0, see trace.h */
+#ifndef UART_LOG_BACKEND
+#if UART_BRIDGE_ENABLE
+#define UART_LOG_BACKEND       UART_LOG_TO_ITM    /* USART2 carries the CDC bridge */
+#else
+#define UART_LOG_BACKEND       UART_LOG_TO_UART
+#endif
+#endif
+
+/* Written in place of dropped messages */
+#define UART_LOG_DROP_MARKER   "\r\n[LOG] overflow, messages dropped\r\n"
+
+/* Function Prototypes */
+uint16_t UART_Log_Write(const void *data, uint16_t len);
+uint32_t UART_Log_Get_Dropped(void);
+uint16_t UART_Log_Pending(void);
+void UART_Log_Flush_Fault(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __UART_LOG_H */
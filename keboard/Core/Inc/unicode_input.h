@@ -0,0 +1,49 @@
+/**
+  ******************************************************************************
+  * @file           : unicode_input.h
+  * @brief          : Unicode input engine header
+  *
+  * Types arbitrary code points by playing the host input method's hex
+  * entry sequence through the keyboard report queue:
+  *   LINUX       Ctrl+Shift+U, hex digits, Space        (IBus / GTK)
+  *   WINDOWS     hold Alt, keypad +, hex digits, release Alt
+  *               (needs HKCU\Control Panel\Input Method\EnableHexNumpad = "1")
+  *   WINCOMPOSE  Compose (Right Alt), U, hex digits, Enter
+  * Each step of a sequence is one report, fed as fast as the queue takes
+  * them, so one code point costs 2 + 2 * digits + 2 reports (frames).
+  ******************************************************************************
+  */
+
+#ifndef __UNICODE_INPUT_H
+#define __UNICODE_INPUT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "stm32f4xx_hal.h"
+
+/* Host input methods */
+#define UNICODE_MODE_LINUX        0
+#define UNICODE_MODE_WINDOWS      1
+#define UNICODE_MODE_WINCOMPOSE   2
+
+/* Unicode input configuration */
+#define UNICODE_DEFAULT_MODE      UNICODE_MODE_LINUX
+#define UNICODE_QUEUE_LEN         64    /* Code points waiting to be typed */
+#define UNICODE_MAX_CODEPOINT     0x10FFFFU
+
+/* Function Prototypes */
+void Unicode_Init(void);
+HAL_StatusTypeDef Unicode_Send_Codepoint(uint32_t codepoint);
+uint16_t Unicode_Send_String(const char *utf8);
+void Unicode_Task(void);
+uint8_t Unicode_Is_Busy(void);
+HAL_StatusTypeDef Unicode_Set_Mode(uint8_t mode);
+uint8_t Unicode_Get_Mode(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __UNICODE_INPUT_H */
@@ -26,6 +26,23 @@ typedef struct {
     uint8_t keycode[6];         // Up to 6 simultaneous key presses
 } USB_KeyboardReport_t;
 
+/* HID Mouse Report Structure (sent with HID_REPORT_ID_MOUSE) */
+typedef struct {
+    uint8_t buttons;            // Button 1-3 in bits 0-2
+    int8_t x;                   // Relative movement, -127..127
+    int8_t y;
+    int8_t wheel;
+} USB_MouseReport_t;
+
+/* Report IDs (report protocol only; boot protocol sends the bare keyboard report) */
+#define HID_REPORT_ID_KEYBOARD   0x01
+#define HID_REPORT_ID_MOUSE      0x02
+
+/* Mouse Buttons */
+#define MOUSE_BTN_LEFT   0x01
+#define MOUSE_BTN_RIGHT  0x02
+#define MOUSE_BTN_MIDDLE 0x04
+
 /* Modifier Keys */
 #define KBD_MOD_LCTRL    0x01
 #define KBD_MOD_LSHIFT   0x02
@@ -118,6 +135,38 @@ typedef struct {
 #define KEY_LEFT         0x50
 #define KEY_RIGHT        0x4F
 
+#define KEY_KP_PLUS      0x57
+#define KEY_KP_1         0x59
+#define KEY_KP_2         0x5A
+#define KEY_KP_3         0x5B
+#define KEY_KP_4         0x5C
+#define KEY_KP_5         0x5D
+#define KEY_KP_6         0x5E
+#define KEY_KP_7         0x5F
+#define KEY_KP_8         0x60
+#define KEY_KP_9         0x61
+#define KEY_KP_0         0x62
+
+/* Firmware-internal function keys (HID reserved range, never sent to host) */
+#define KEY_LEADER       0xF0
+#define KEY_MS_UP        0xF1
+#define KEY_MS_DOWN      0xF2
+#define KEY_MS_LEFT      0xF3
+#define KEY_MS_RIGHT     0xF4
+#define KEY_MS_BTN1      0xF5
+#define KEY_MS_BTN2      0xF6
+#define KEY_MS_BTN3      0xF7
+#define KEY_MS_WH_UP     0xF8
+#define KEY_MS_WH_DOWN   0xF9
+#define KEY_LAT_DUMP     0xFA    /* Print the latency histograms (latency.h) */
+
+/* Depth of the outgoing report queue (one entry per distinct report) */
+#define USB_KEYBOARD_QUEUE_LEN   16
+
+/* Reports queued before the first SET_CONFIGURATION (keys held at
+ * power-up) are kept this long after boot instead of being dropped */
+#define USB_KEYBOARD_BOOT_HOLD_MS   3000U
+
 /* Function Prototypes */
 void USB_Keyboard_Init(void);
 void USB_Keyboard_SendReport(void);
@@ -126,8 +175,19 @@ void USB_Keyboard_ReleaseKey(uint8_t key_code);
 void USB_Keyboard_ReleaseAll(void);
 void USB_Keyboard_SetModifier(uint8_t modifier);
 void USB_Keyboard_ClearModifier(void);
+uint8_t USB_Keyboard_GetModifier(void);
+uint8_t USB_Keyboard_IsKeyPressed(uint8_t key_code);
 void USB_Keyboard_HandleMatrixKey(uint8_t matrix_key, uint8_t pressed);
 uint8_t USB_Keyboard_GetReport(uint8_t *report);
+void USB_Keyboard_TapKey(uint8_t modifier, uint8_t key_code);
+HAL_StatusTypeDef USB_Keyboard_SetKeymap(uint8_t matrix_key, uint8_t usb_key);
+HAL_StatusTypeDef USB_Keyboard_SetKeymapRange(uint8_t first, const uint8_t *usb_keys, uint8_t count);
+uint8_t USB_Keyboard_GetKeymap(uint8_t matrix_key);
+void USB_Keyboard_Task(void);
+uint8_t USB_Keyboard_QueueSpace(void);
+uint32_t USB_Keyboard_GetFrame(void);
+uint8_t USB_Keyboard_IsConfigured(void);
+HAL_StatusTypeDef USB_Keyboard_SendMouseReport(uint8_t buttons, int8_t x, int8_t y, int8_t wheel);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,76 @@
+/**
+  ******************************************************************************
+  * @file           : usb_suspend.h
+  * @brief          : USB suspend: STOP mode and remote wakeup from the matrix
+  *
+  * When the host suspends a configured device and nothing is in progress,
+  * USB_Suspend_Task() drives all rows low, arms EXTI (falling edge) on the
+  * column pins and EXTI line 18 (OTG_FS wakeup), and enters STOP mode.
+  * Either event wakes the core on HSI; the PLL is restarted at 168 MHz
+  * (Clock_Profile_Restore) before any interrupt runs. Then:
+  *  - key press, host allows remote wakeup: resume signalling (RWUSIG) for
+  *    USB_SUSPEND_RWU_MS, then the host drives resume and reconfigures the
+  *    bus. The waking press is sampled right after the wake-up and
+  *    latched (Matrix_Keyboard_Wake_Latch), so a tap shorter than the
+  *    debounce time still counts; its report is held in the queue (not
+  *    dropped) until the device is configured again, so it is the first
+  *    report the host receives.
+  *  - host resume: the OTG core resumes as usual.
+  * A report queued while suspended without STOP (key held at suspend
+  * time, bridge firmware) also triggers remote wakeup. A device the host
+  * never configured, or one the host did not allow to wake it, only
+  * leaves STOP on host resume or reset.
+  ******************************************************************************
+  */
+
+#ifndef __USB_SUSPEND_H
+#define __USB_SUSPEND_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "stm32f4xx_hal.h"
+#include "uart_bridge.h"
+
+/* Suspend configuration */
+#ifndef USB_SUSPEND_ENABLE
+#define USB_SUSPEND_ENABLE      1
+#endif
+#ifndef USB_SUSPEND_STOP
+#if UART_BRIDGE_ENABLE
+#define USB_SUSPEND_STOP        0       /* USART2 DMA keeps bridging while suspended */
+#else
+#define USB_SUSPEND_STOP        1       /* 0: stay in RUN mode while suspended */
+#endif
+#endif
+#ifndef USB_SUSPEND_DBG_STOP
+#define USB_SUSPEND_DBG_STOP    0       /* 1: keep SWD/SWO alive in STOP (more current) */
+#endif
+#define USB_SUSPEND_IDLE_MS     3U      /* Bus idle is 3 ms at suspend, remote wakeup needs 5 */
+#define USB_SUSPEND_RWU_MS      5U      /* Resume signalling time (1..15 ms) */
+
+/* Counters since boot */
+typedef struct {
+    uint32_t suspends;          // Suspends of a configured device
+    uint32_t stops;             // STOP mode entries
+    uint32_t key_wakes;         // STOP left on a key press
+    uint32_t host_wakes;        // STOP left on host resume or reset
+    uint32_t remote_wakeups;    // Resume signalling sent
+} USB_Suspend_Stats_t;
+
+/* Function Prototypes */
+#if USB_SUSPEND_ENABLE
+void USB_Suspend_Init(void);
+void USB_Suspend_Task(uint8_t busy);
+const USB_Suspend_Stats_t *USB_Suspend_Get_Stats(void);
+#else
+#define USB_Suspend_Init()      ((void)0)
+#define USB_Suspend_Task(busy)  ((void)(busy))
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __USB_SUSPEND_H */
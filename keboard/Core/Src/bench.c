@@ -0,0 +1,274 @@
+/**
+  ******************************************************************************
+  * @file           : bench.c
+  * @brief          : Cycle benchmark suite implementation
+  *
+  * Cases:
+  *   scan/<algo>               Matrix_Keyboard_Scan() per debounce algorithm
+  *   debounce/<algo>/<N>keys   debounce kernel over an N-key matrix with every
+  *                             key bouncing (3x3 .. 12x12)
+  *   press/<held>              USB_Keyboard_PressKey() with <held> keys down
+  *   release/<held>            USB_Keyboard_ReleaseKey() of the oldest key
+  *   report/<held>             USB_Keyboard_SendReport() of a changed report
+  * The matrix itself is wired 3x3, so the larger sizes run the kernel over
+  * the 9 real key slots repeatedly. Reports use F13..F18. Bench_Run() is
+  * called before the device connects to the bus and the report queue is
+  * dropped afterwards, so none of them reaches a host (the boot hold in
+  * USB_Keyboard_Task() would otherwise deliver them after enumeration);
+  * the results only go to the log.
+  ******************************************************************************
+  */
+
+#include "bench.h"
+
+#if BENCH_ENABLE
+
+#include "matrix_keyboard.h"
+#include "usb_keyboard.h"
+#include "ram_sections.h"
+#include <stdio.h>
+
+#ifdef SIM_BUILD
+#include <time.h>
+#define BENCH_UNIT       "ns"
+#else
+#include "uart_log.h"
+#define BENCH_UNIT       "cycles"
+#endif
+
+#define BENCH_KEY_BASE   0x68U   /* KEY_F13 */
+
+static uint32_t bench_samples[BENCH_ITERATIONS] NOINIT;
+static uint32_t bench_overhead = 0;
+
+static const char *const bench_algo_names[] = {"defer", "eager", "integrator"};
+static const uint8_t bench_matrix_keys[] = {9, 36, 81, 144};
+
+/**
+  * @brief Start a sample
+  * @retval Timestamp
+  */
+static inline uint32_t Bench_Begin(void)
+{
+#ifdef SIM_BUILD
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000U + (uint64_t)ts.tv_nsec);
+#else
+    __disable_irq();
+    return DWT->CYCCNT;
+#endif
+}
+
+/**
+  * @brief End a sample
+  * @param start: Value returned by Bench_Begin()
+  * @retval Elapsed units
+  */
+static inline uint32_t Bench_End(uint32_t start)
+{
+#ifdef SIM_BUILD
+    return Bench_Begin() - start;
+#else
+    uint32_t delta = DWT->CYCCNT - start;
+    __enable_irq();
+    return delta;
+#endif
+}
+
+/**
+  * @brief Wait until a printed line has left the device
+  * The log ring holds less than a full report, so drain it line by line.
+  * @retval None
+  */
+static void Bench_Flush(void)
+{
+#ifdef SIM_BUILD
+    fflush(stdout);
+#else
+    while (UART_Log_Pending() > 0U) {
+    }
+#endif
+}
+
+/**
+  * @brief Sort the samples (insertion sort, the set is small)
+  */
+static void Bench_Sort(uint32_t n)
+{
+    for (uint32_t i = 1; i < n; i++) {
+        uint32_t v = bench_samples[i];
+        uint32_t j = i;
+        while (j > 0 && bench_samples[j - 1] > v) {
+            bench_samples[j] = bench_samples[j - 1];
+            j--;
+        }
+        bench_samples[j] = v;
+    }
+}
+
+/**
+  * @brief Print the statistics of the collected samples
+  * @param name: Case name
+  * @retval None
+  */
+static void Bench_Print(const char *name)
+{
+    uint64_t sum = 0;
+
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; i++) {
+        bench_samples[i] = (bench_samples[i] > bench_overhead) ? bench_samples[i] - bench_overhead : 0U;
+        sum += bench_samples[i];
+    }
+    Bench_Sort(BENCH_ITERATIONS);
+
+    printf("BENCH %s n=%u min=%lu med=%lu avg=%lu max=%lu unit=" BENCH_UNIT "\r\n", name,
+           (unsigned)BENCH_ITERATIONS, (unsigned long)bench_samples[0],
+           (unsigned long)bench_samples[BENCH_ITERATIONS / 2U],
+           (unsigned long)(sum / BENCH_ITERATIONS),
+           (unsigned long)bench_samples[BENCH_ITERATIONS - 1U]);
+    Bench_Flush();
+}
+
+/**
+  * @brief Cost of an empty measurement
+  * @retval None
+  */
+static void Bench_Calibrate(void)
+{
+    uint32_t min = UINT32_MAX;
+
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; i++) {
+        uint32_t t = Bench_Begin();
+        uint32_t d = Bench_End(t);
+        if (d < min) min = d;
+    }
+    bench_overhead = min;
+}
+
+static void Bench_Scan(void)
+{
+    char name[40];
+    uint8_t saved = Matrix_Keyboard_Get_Debounce_Algo();
+
+    for (uint8_t algo = DEBOUNCE_DEFER; algo <= DEBOUNCE_INTEGRATOR; algo++) {
+        Matrix_Keyboard_Set_Debounce_Algo(algo);
+        for (uint32_t i = 0; i < BENCH_ITERATIONS; i++) {
+            uint32_t t = Bench_Begin();
+            Matrix_Keyboard_Scan();
+            bench_samples[i] = Bench_End(t);
+        }
+        snprintf(name, sizeof(name), "scan/%s", bench_algo_names[algo]);
+        Bench_Print(name);
+    }
+    Matrix_Keyboard_Set_Debounce_Algo(saved);
+}
+
+static void Bench_Debounce(void)
+{
+    char name[40];
+    uint8_t saved = Matrix_Keyboard_Get_Debounce_Algo();
+    uint32_t now = HAL_GetTick();
+
+    for (uint8_t algo = DEBOUNCE_DEFER; algo <= DEBOUNCE_INTEGRATOR; algo++) {
+        for (uint8_t s = 0; s < sizeof(bench_matrix_keys); s++) {
+            uint8_t keys = bench_matrix_keys[s];
+
+            Matrix_Keyboard_Set_Debounce_Algo(algo);
+            for (uint32_t i = 0; i < BENCH_ITERATIONS; i++) {
+                /* Every key sees the opposite level each pass: worst-case bounce */
+                uint8_t raw = (uint8_t)(i & 1U);
+                uint32_t t = Bench_Begin();
+                for (uint8_t k = 0; k < keys; k++) {
+                    uint8_t slot = k % TOTAL_KEYS;
+                    Matrix_Keyboard_Debounce_Key(slot / KEYBOARD_COLS, slot % KEYBOARD_COLS, raw, now, 1U);
+                }
+                bench_samples[i] = Bench_End(t);
+            }
+            snprintf(name, sizeof(name), "debounce/%s/%ukeys", bench_algo_names[algo], (unsigned)keys);
+            Bench_Print(name);
+        }
+    }
+
+    /* The kernel changed key states behind the scan's back */
+    Matrix_Keyboard_Init();
+    Matrix_Keyboard_Set_Debounce_Algo(saved);
+}
+
+static void Bench_Report(void)
+{
+    char name[40];
+
+    for (uint8_t held = 0; held < 6U; held++) {
+        /* press: the new key is checked against every held key */
+        for (uint32_t i = 0; i < BENCH_ITERATIONS; i++) {
+            USB_Keyboard_ReleaseAll();
+            for (uint8_t k = 0; k < held; k++) {
+                USB_Keyboard_PressKey(BENCH_KEY_BASE + k);
+            }
+            uint32_t t = Bench_Begin();
+            USB_Keyboard_PressKey(BENCH_KEY_BASE + held);
+            bench_samples[i] = Bench_End(t);
+        }
+        snprintf(name, sizeof(name), "press/%u", (unsigned)held);
+        Bench_Print(name);
+
+        /* release: removing the oldest key shifts all others */
+        for (uint32_t i = 0; i < BENCH_ITERATIONS; i++) {
+            USB_Keyboard_ReleaseAll();
+            for (uint8_t k = 0; k <= held; k++) {
+                USB_Keyboard_PressKey(BENCH_KEY_BASE + k);
+            }
+            uint32_t t = Bench_Begin();
+            USB_Keyboard_ReleaseKey(BENCH_KEY_BASE);
+            bench_samples[i] = Bench_End(t);
+        }
+        snprintf(name, sizeof(name), "release/%u", (unsigned)held);
+        Bench_Print(name);
+
+        /* report: change detection, queueing and the endpoint hand-off */
+        for (uint32_t i = 0; i < BENCH_ITERATIONS; i++) {
+            USB_Keyboard_ReleaseAll();
+            for (uint8_t k = 0; k < held; k++) {
+                USB_Keyboard_PressKey(BENCH_KEY_BASE + k);
+            }
+            USB_Keyboard_SetModifier((uint8_t)(i & 1U));   /* Always a new report */
+            uint32_t t = Bench_Begin();
+            USB_Keyboard_SendReport();
+            bench_samples[i] = Bench_End(t);
+        }
+        snprintf(name, sizeof(name), "report/%u", (unsigned)held);
+        Bench_Print(name);
+    }
+
+    /* Drop the queued reports and the key state, reload the keymap */
+    USB_Keyboard_Init();
+}
+
+/**
+  * @brief Run the whole suite and print one line per case
+  * Leaves the keyboard modules in their initial state.
+  * @retval None
+  */
+void Bench_Run(void)
+{
+#ifdef SIM_BUILD
+    printf("BENCH_BEGIN platform=host unit=" BENCH_UNIT "\r\n");
+#else
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0U;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    printf("BENCH_BEGIN platform=stm32f407 hclk=%lu unit=" BENCH_UNIT "\r\n", (unsigned long)SystemCoreClock);
+#endif
+    Bench_Flush();
+
+    Bench_Calibrate();
+    Bench_Scan();
+    Bench_Debounce();
+    Bench_Report();
+
+    printf("BENCH_END\r\n");
+    Bench_Flush();
+}
+
+#endif /* BENCH_ENABLE */
@@ -0,0 +1,61 @@
+/**
+  ******************************************************************************
+  * @file           : blog.c
+  * @brief          : Deferred-formatting binary log implementation
+  ******************************************************************************
+  */
+
+#include "blog.h"
+#include "uart_log.h"
+
+/* Tick of the last record that made it into the log buffer */
+static uint32_t blog_last_tick = 0;
+
+/**
+  * @brief Append a value as an unsigned LEB128 varint
+  * @param out: Output buffer
+  * @param value: Value to encode
+  * @retval Number of bytes written (1-5)
+  */
+static uint8_t BLog_Varint(uint8_t *out, uint32_t value)
+{
+    uint8_t n = 0;
+
+    while (value >= 0x80U) {
+        out[n++] = (uint8_t)(value | 0x80U);
+        value >>= 7;
+    }
+    out[n++] = (uint8_t)value;
+    return n;
+}
+
+/**
+  * @brief Emit one binary log record (use the BLOG() macro)
+  * @param id: Offset of the format string in .blog_fmt
+  * @param args: Arguments as uint32_t
+  * @param nargs: Number of arguments (0-BLOG_MAX_ARGS)
+  * @retval None
+  */
+void BLog_Write(uint32_t id, const uint32_t *args, uint8_t nargs)
+{
+    uint8_t record[1 + 2 + 5 + 5 * BLOG_MAX_ARGS];
+    uint32_t now = HAL_GetTick();
+    uint8_t len = 0;
+
+    if (nargs > BLOG_MAX_ARGS) {
+        nargs = BLOG_MAX_ARGS;
+    }
+
+    record[len++] = (uint8_t)(BLOG_TAG | nargs);
+    record[len++] = (uint8_t)id;
+    record[len++] = (uint8_t)(id >> 8);
+    len += BLog_Varint(&record[len], now - blog_last_tick);
+    for (uint8_t i = 0; i < nargs; i++) {
+        len += BLog_Varint(&record[len], args[i]);
+    }
+
+    /* Dropped records must not eat their time delta */
+    if (UART_Log_Write(record, len) != 0) {
+        blog_last_tick = now;
+    }
+}
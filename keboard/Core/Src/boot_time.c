@@ -0,0 +1,96 @@
+/**
+  ******************************************************************************
+  * @file           : boot_time.c
+  * @brief          : Boot-to-first-report timing implementation
+  *
+  * The timestamps live in .noinit: boot_reached guards every read, so
+  * they need no zeroing. Boot_Time_Mark() may run in interrupt context
+  * (IN complete); a SysTick wrap not yet counted there costs at most 1 ms.
+  ******************************************************************************
+  */
+
+#include "boot_time.h"
+
+#if BOOT_TIME_ENABLE
+
+#include "ram_sections.h"
+#include <stdio.h>
+
+static uint32_t boot_us[BOOT_STAGES] NOINIT;
+static uint8_t boot_reached = 0;               /* bit n = stage n */
+static uint8_t boot_printed = 0;
+
+static const char *const boot_stage_names[BOOT_STAGES] = {
+    "clock", "keys", "usb", "configured", "report"
+};
+
+/**
+  * @brief Microseconds since HAL_Init
+  */
+static uint32_t Boot_Time_Now_Us(void)
+{
+    uint32_t ms;
+    uint32_t val;
+
+    do {
+        ms = HAL_GetTick();
+        val = SysTick->VAL;
+    } while (ms != HAL_GetTick());
+
+    return ms * 1000U + (SysTick->LOAD - val) / (SystemCoreClock / 1000000U);
+}
+
+/**
+  * @brief Record a milestone, only the first time it is reached
+  * @param stage: BOOT_STAGE_*
+  * @retval None
+  */
+void Boot_Time_Mark(uint8_t stage)
+{
+    if (stage >= BOOT_STAGES || (boot_reached & (1U << stage))) {
+        return;
+    }
+    boot_us[stage] = Boot_Time_Now_Us();
+    boot_reached |= (uint8_t)(1U << stage);
+}
+
+/**
+  * @brief Time of a milestone
+  * @param stage: BOOT_STAGE_*
+  * @retval Microseconds since HAL_Init, BOOT_TIME_NONE if not reached
+  */
+uint32_t Boot_Time_Get(uint8_t stage)
+{
+    if (stage >= BOOT_STAGES || !(boot_reached & (1U << stage))) {
+        return BOOT_TIME_NONE;
+    }
+    return boot_us[stage];
+}
+
+/**
+  * @brief Print the milestones once the first report is out, call from
+  * the main loop
+  * @retval None
+  */
+void Boot_Time_Task(void)
+{
+    if (boot_printed || !(boot_reached & (1U << BOOT_STAGE_REPORT))) {
+        return;
+    }
+    boot_printed = 1;
+
+    printf("[BOOT]");
+    for (uint8_t s = 0; s < BOOT_STAGES; s++) {
+        uint32_t us = Boot_Time_Get(s);
+
+        if (us == BOOT_TIME_NONE) {
+            printf(" %s -", boot_stage_names[s]);
+        } else {
+            printf(" %s %lu.%lu", boot_stage_names[s], (unsigned long)(us / 1000U),
+                   (unsigned long)((us % 1000U) / 100U));
+        }
+    }
+    printf(" (ms)\r\n");
+}
+
+#endif /* BOOT_TIME_ENABLE */
@@ -0,0 +1,226 @@
+/**
+  ******************************************************************************
+  * @file           : clock_profile.c
+  * @brief          : Runtime core clock profiles implementation
+  *
+  * A switch rewrites the RCC bus prescalers and the flash wait states with
+  * interrupts masked, then lets every SystemCoreClock user catch up before
+  * the interrupts run again. The PLL is never stopped: USB keeps its 48 MHz
+  * clock and the OTG turnaround time set at init (HCLK >= 32 MHz) holds
+  * for every profile.
+  ******************************************************************************
+  */
+
+#include "clock_profile.h"
+
+#if CLOCK_PROFILE_ENABLE
+
+#include "main.h"
+#include "matrix_keyboard.h"
+#include "latency.h"
+#include "trace.h"
+#include "usbd_def.h"
+
+/* USB device handle (usb_device.c) */
+extern USBD_HandleTypeDef hUsbDeviceFS;
+
+/* Bus prescalers and wait states of one profile (RCC_CFGR and FLASH_ACR values) */
+typedef struct {
+    uint32_t hpre;
+    uint32_t ppre1;
+    uint32_t ppre2;
+    uint32_t latency;
+} Clock_Profile_Def_t;
+
+/* SYSCLK 168 MHz; PCLK1 <= 42 MHz and PCLK2 <= 84 MHz in every profile */
+static const Clock_Profile_Def_t profile_defs[CLOCK_PROFILES] = {
+    { RCC_SYSCLK_DIV1, RCC_HCLK_DIV4, RCC_HCLK_DIV2, FLASH_LATENCY_5 },   /* 168 MHz */
+    { RCC_SYSCLK_DIV2, RCC_HCLK_DIV2, RCC_HCLK_DIV1, FLASH_LATENCY_2 },   /*  84 MHz */
+    { RCC_SYSCLK_DIV4, RCC_HCLK_DIV1, RCC_HCLK_DIV1, FLASH_LATENCY_1 },   /*  42 MHz */
+};
+
+static uint8_t profile = CLOCK_PROFILE_ACTIVE;
+static uint8_t pinned = CLOCK_PROFILE_AUTO;
+static uint32_t last_busy = 0;
+static uint32_t stats_tick = 0;
+static Clock_Profile_Stats_t clock_stats;
+
+/**
+  * @brief Set the flash wait states and wait until they are in effect
+  */
+static void Clock_Profile_Set_Latency(uint32_t latency)
+{
+    __HAL_FLASH_SET_LATENCY(latency);
+    while (__HAL_FLASH_GET_LATENCY() != latency);
+}
+
+/**
+  * @brief Bring everything derived from the core clock up to date
+  * @param old_hz: SystemCoreClock before the change
+  */
+static void Clock_Profile_Changed(uint32_t old_hz)
+{
+    SystemCoreClockUpdate();
+    (void)HAL_InitTick(uwTickPrio);
+    Matrix_Keyboard_Clock_Update();
+    Latency_Clock_Changed(old_hz);
+    Trace_Clock_Changed();
+}
+
+/**
+  * @brief Whether the host has configured the device (suspended included)
+  */
+static uint8_t Clock_Profile_Usb_Configured(void)
+{
+    uint8_t state = hUsbDeviceFS.dev_state;
+
+    return (state == USBD_STATE_CONFIGURED ||
+            (state == USBD_STATE_SUSPENDED && hUsbDeviceFS.dev_old_state == USBD_STATE_CONFIGURED));
+}
+
+/**
+  * @brief Start at the boot clock (SystemClock_Config is ACTIVE)
+  * @retval None
+  */
+void Clock_Profile_Init(void)
+{
+    profile = CLOCK_PROFILE_ACTIVE;
+    pinned = CLOCK_PROFILE_AUTO;
+    last_busy = HAL_GetTick();
+    stats_tick = last_busy;
+}
+
+/**
+  * @brief Switch to a profile now
+  * Raising HCLK goes through APB /16 first so PCLK1/PCLK2 never exceed
+  * their limits while the prescalers change one at a time.
+  * @param new_profile: CLOCK_PROFILE_*
+  * @retval None
+  */
+void Clock_Profile_Set(uint8_t new_profile)
+{
+    const Clock_Profile_Def_t *def;
+    uint32_t old_hz;
+    uint32_t primask;
+
+    if (new_profile >= CLOCK_PROFILES || new_profile == profile) {
+        return;
+    }
+    def = &profile_defs[new_profile];
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+
+    old_hz = SystemCoreClock;
+    if (def->latency > __HAL_FLASH_GET_LATENCY()) {
+        Clock_Profile_Set_Latency(def->latency);
+    }
+    if (new_profile < profile) {
+        MODIFY_REG(RCC->CFGR, RCC_CFGR_PPRE1 | RCC_CFGR_PPRE2,
+                   RCC_HCLK_DIV16 | (RCC_HCLK_DIV16 << 3));
+    }
+    MODIFY_REG(RCC->CFGR, RCC_CFGR_HPRE, def->hpre);
+    MODIFY_REG(RCC->CFGR, RCC_CFGR_PPRE1 | RCC_CFGR_PPRE2, def->ppre1 | (def->ppre2 << 3));
+    if (def->latency < __HAL_FLASH_GET_LATENCY()) {
+        Clock_Profile_Set_Latency(def->latency);
+    }
+
+    Clock_Profile_Changed(old_hz);
+
+    profile = new_profile;
+    clock_stats.switches++;
+
+    __set_PRIMASK(primask);
+}
+
+/**
+  * @brief Restart the PLL after STOP mode (the core wakes on HSI) and
+  * return to ACTIVE, the activity that woke the device needs it. Call
+  * with interrupts masked.
+  * @retval None
+  */
+void Clock_Profile_Restore(void)
+{
+    uint32_t old_hz = SystemCoreClock;
+
+    SystemClock_Config();
+    Clock_Profile_Changed(old_hz);
+
+    if (profile != CLOCK_PROFILE_ACTIVE) {
+        profile = CLOCK_PROFILE_ACTIVE;
+        clock_stats.switches++;
+    }
+    last_busy = HAL_GetTick();
+}
+
+/**
+  * @brief Hold a profile regardless of activity (benchmarks, measurements),
+  * applied by the next Clock_Profile_Task() once the device is configured
+  * @param new_profile: CLOCK_PROFILE_*, or CLOCK_PROFILE_AUTO to resume the policy
+  * @retval None
+  */
+void Clock_Profile_Pin(uint8_t new_profile)
+{
+    if (new_profile != CLOCK_PROFILE_AUTO && new_profile >= CLOCK_PROFILES) {
+        return;
+    }
+    pinned = new_profile;
+    last_busy = HAL_GetTick();
+}
+
+/**
+  * @brief Pick the profile for the current activity, call from the main loop
+  * @param busy: Nonzero while keys, sequences or reports are in progress
+  * @retval None
+  */
+void Clock_Profile_Task(uint8_t busy)
+{
+    uint32_t now = HAL_GetTick();
+    uint8_t configured = Clock_Profile_Usb_Configured();
+    uint32_t quiet;
+    uint8_t target;
+
+    clock_stats.ms[profile] += now - stats_tick;
+    stats_tick = now;
+
+    /* Idle time only counts once enumeration is over */
+    if (busy || !configured) {
+        last_busy = now;
+    }
+
+    if (!configured) {
+        target = CLOCK_PROFILE_ACTIVE;
+    } else if (pinned != CLOCK_PROFILE_AUTO) {
+        target = pinned;
+    } else {
+        quiet = now - last_busy;
+        if (quiet >= CLOCK_IDLE_LOW_MS) {
+            target = CLOCK_PROFILE_IDLE;
+        } else if (quiet >= CLOCK_IDLE_BALANCED_MS) {
+            target = CLOCK_PROFILE_BALANCED;
+        } else {
+            target = CLOCK_PROFILE_ACTIVE;
+        }
+    }
+    Clock_Profile_Set(target);
+}
+
+/**
+  * @brief Current profile
+  * @retval CLOCK_PROFILE_*
+  */
+uint8_t Clock_Profile_Get(void)
+{
+    return profile;
+}
+
+/**
+  * @brief Profile counters
+  * @retval Counters since boot
+  */
+const Clock_Profile_Stats_t *Clock_Profile_Get_Stats(void)
+{
+    return &clock_stats;
+}
+
+#endif /* CLOCK_PROFILE_ENABLE */
@@ -0,0 +1,420 @@
+/**
+  ******************************************************************************
+  * @file           : config_proto.c
+  * @brief          : Framed binary configuration protocol on the CDC port
+  *
+  * Requests are parsed straight out of the CDC RX queue (CDC_RxPeek_FS).
+  * A frame that lies within one received packet is checked and handled in
+  * place; only a frame that spans packets is assembled in rx_frame first.
+  * Answers are built in tx_frame and queued in the CDC TX ring. A request
+  * is only taken once the ring has room for the largest answer, so a host
+  * that does not read answers is throttled by NAKs on the OUT endpoint
+  * and nothing is dropped.
+  ******************************************************************************
+  */
+
+#include "config_proto.h"
+#include "usbd_cdc_if.h"
+#include "usb_keyboard.h"
+#include "matrix_keyboard.h"
+#include "flash_kv.h"
+#include "latency.h"
+#include "ram_sections.h"
+#include <string.h>
+
+/* Offsets in a frame */
+#define FRAME_LEN       1U
+#define FRAME_ID        3U
+#define FRAME_CMD       5U
+#define FRAME_PAYLOAD   6U
+#define FRAME_HEADER    3U      /* SOF and len: enough to know the frame size */
+#define FRAME_LEN_MIN   3U
+#define FRAME_LEN_MAX   (CONFIG_PROTO_PAYLOAD_MAX + 3U)
+
+/* Total frame size for a len field */
+#define FRAME_SIZE(len) ((uint16_t)((len) + 5U))
+
+/* Answer data after the status byte */
+#define DATA_MAX        (CONFIG_PROTO_PAYLOAD_MAX - 1U)
+
+/* Handler: request payload in, answer data out, returns the status */
+typedef uint8_t (*Config_Proto_Handler_t)(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len);
+
+typedef struct {
+    uint8_t cmd;
+    uint8_t min_len;                // Request payload bounds
+    uint8_t max_len;
+    Config_Proto_Handler_t handler;
+} Config_Proto_Cmd_t;
+
+static Config_Proto_Stats_t proto_stats;
+
+/* Frame spanning packets, rx_frame_len bytes so far (0: hunting for SOF) */
+static uint8_t rx_frame[CONFIG_PROTO_FRAME_MAX] NOINIT;
+static uint16_t rx_frame_len = 0;
+
+static uint8_t tx_frame[CONFIG_PROTO_FRAME_MAX] NOINIT;
+
+/* CRC-16/CCITT-FALSE (poly 0x1021), one nibble per table lookup */
+static const uint16_t crc16_nibble[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+/**
+  * @brief Update a CRC-16/CCITT-FALSE
+  * @param crc: 0xFFFF to start, or the CRC so far
+  * @param data: Bytes
+  * @param len: Number of bytes
+  * @retval Updated CRC
+  */
+uint16_t Config_Proto_Crc16(uint16_t crc, const uint8_t *data, uint16_t len)
+{
+    while (len--) {
+        uint8_t b = *data++;
+
+        crc = (uint16_t)((crc << 4) ^ crc16_nibble[(crc >> 12) ^ (b >> 4)]);
+        crc = (uint16_t)((crc << 4) ^ crc16_nibble[(crc >> 12) ^ (b & 0x0FU)]);
+    }
+    return crc;
+}
+
+static uint16_t Get16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint8_t *Put16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    return p + 2;
+}
+
+static uint8_t *Put32(uint8_t *p, uint32_t v)
+{
+    p = Put16(p, (uint16_t)v);
+    return Put16(p, (uint16_t)(v >> 16));
+}
+
+/* ---- Command handlers ---------------------------------------------------- */
+
+static uint8_t Cmd_Ping(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len)
+{
+    memcpy(data, req, len);
+    *data_len = len;
+    return CONFIG_STATUS_OK;
+}
+
+static uint8_t Cmd_Info(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len)
+{
+    (void)req;
+    (void)len;
+    data[0] = CONFIG_PROTO_VERSION;
+    data[1] = CONFIG_PROTO_PAYLOAD_MAX;
+    data[2] = TOTAL_KEYS;
+    data[3] = KV_MAX_MACROS;
+    data[4] = FLASH_KV_VALUE_SIZE;
+    data[5] = LATENCY_STAGES;
+    *data_len = 6;
+    return CONFIG_STATUS_OK;
+}
+
+static uint8_t Cmd_Keymap_Get(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len)
+{
+    uint8_t first = req[0];
+    uint8_t count = req[1];
+
+    (void)len;
+    if (first >= TOTAL_KEYS || count > TOTAL_KEYS - first) return CONFIG_STATUS_RANGE;
+
+    for (uint8_t i = 0; i < count; i++) {
+        data[i] = USB_Keyboard_GetKeymap(first + i);
+    }
+    *data_len = count;
+    return CONFIG_STATUS_OK;
+}
+
+static uint8_t Cmd_Keymap_Set(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len)
+{
+    uint8_t first = req[0];
+    uint8_t count = (uint8_t)(len - 1U);
+
+    (void)data;
+    (void)data_len;
+    if (first >= TOTAL_KEYS || count > TOTAL_KEYS - first) return CONFIG_STATUS_RANGE;
+
+    return (USB_Keyboard_SetKeymapRange(first, &req[1], count) == HAL_OK) ? CONFIG_STATUS_OK : CONFIG_STATUS_FLASH;
+}
+
+static uint8_t Cmd_Debounce_Get(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len)
+{
+    (void)req;
+    (void)len;
+    Put16(data, Matrix_Keyboard_Get_Debounce());
+    data[2] = Matrix_Keyboard_Get_Debounce_Algo();
+    *data_len = 3;
+    return CONFIG_STATUS_OK;
+}
+
+static uint8_t Cmd_Debounce_Set(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len)
+{
+    (void)data;
+    (void)data_len;
+    if (Get16(req) > DEBOUNCE_TIME_MAX) return CONFIG_STATUS_RANGE;
+    if (len > 2U && req[2] > DEBOUNCE_INTEGRATOR) return CONFIG_STATUS_RANGE;
+
+    /* Algorithm first: Set_Debounce() persists both in one record */
+    if (len > 2U) {
+        Matrix_Keyboard_Set_Debounce_Algo(req[2]);
+    }
+    if (Matrix_Keyboard_Set_Debounce(Get16(req)) != HAL_OK) return CONFIG_STATUS_FLASH;
+    return CONFIG_STATUS_OK;
+}
+
+static uint8_t Cmd_Macro_Get(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len)
+{
+    (void)len;
+    if (req[0] >= KV_MAX_MACROS) return CONFIG_STATUS_RANGE;
+
+    *data_len = FlashKV_Get(KV_ID_MACRO_BASE + req[0], data, FLASH_KV_VALUE_SIZE);
+    return CONFIG_STATUS_OK;
+}
+
+static uint8_t Cmd_Macro_Set(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len)
+{
+    (void)data;
+    (void)data_len;
+    if (req[0] >= KV_MAX_MACROS) return CONFIG_STATUS_RANGE;
+
+    return (FlashKV_Set(KV_ID_MACRO_BASE + req[0], &req[1], (uint8_t)(len - 1U)) == HAL_OK) ?
+           CONFIG_STATUS_OK : CONFIG_STATUS_FLASH;
+}
+
+static uint8_t Cmd_Stats_Get(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len)
+{
+    uint8_t *p = data;
+
+    (void)req;
+    (void)len;
+    p = Put32(p, HAL_GetTick());
+    p = Put32(p, USB_Keyboard_GetFrame());
+    p = Put32(p, proto_stats.rx_frames);
+    p = Put32(p, proto_stats.tx_frames);
+    p = Put32(p, proto_stats.crc_errors);
+    p = Put32(p, proto_stats.framing_errors);
+    p = Put32(p, proto_stats.busy);
+    *data_len = (uint16_t)(p - data);
+    return CONFIG_STATUS_OK;
+}
+
+static uint8_t Cmd_Stats_Reset(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len)
+{
+    (void)req;
+    (void)len;
+    (void)data;
+    (void)data_len;
+    memset(&proto_stats, 0, sizeof(proto_stats));
+    Latency_Reset();
+    return CONFIG_STATUS_OK;
+}
+
+static uint8_t Cmd_Latency_Get(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len)
+{
+#if LATENCY_ENABLE
+    const Latency_Hist_t *h;
+    uint8_t *p = data;
+
+    (void)len;
+    if (req[0] >= LATENCY_STAGES) return CONFIG_STATUS_RANGE;
+
+    h = Latency_Get_Hist(req[0]);
+    p = Put32(p, h->count);
+    p = Put32(p, h->count ? h->min : 0U);
+    p = Put32(p, Latency_Percentile(req[0], 50));
+    p = Put32(p, Latency_Percentile(req[0], 90));
+    p = Put32(p, Latency_Percentile(req[0], 99));
+    p = Put32(p, h->max);
+    *data_len = (uint16_t)(p - data);
+    return CONFIG_STATUS_OK;
+#else
+    (void)req;
+    (void)len;
+    (void)data;
+    (void)data_len;
+    return CONFIG_STATUS_UNSUPPORTED;
+#endif
+}
+
+static const Config_Proto_Cmd_t proto_cmds[] = {
+    { CONFIG_CMD_PING,         0, DATA_MAX,                 Cmd_Ping },
+    { CONFIG_CMD_INFO,         0, 0,                        Cmd_Info },
+    { CONFIG_CMD_KEYMAP_GET,   2, 2,                        Cmd_Keymap_Get },
+    { CONFIG_CMD_KEYMAP_SET,   2, 1 + TOTAL_KEYS,           Cmd_Keymap_Set },
+    { CONFIG_CMD_DEBOUNCE_GET, 0, 0,                        Cmd_Debounce_Get },
+    { CONFIG_CMD_DEBOUNCE_SET, 2, 3,                        Cmd_Debounce_Set },
+    { CONFIG_CMD_MACRO_GET,    1, 1,                        Cmd_Macro_Get },
+    { CONFIG_CMD_MACRO_SET,    2, 1 + FLASH_KV_VALUE_SIZE,  Cmd_Macro_Set },
+    { CONFIG_CMD_STATS_GET,    0, 0,                        Cmd_Stats_Get },
+    { CONFIG_CMD_STATS_RESET,  0, 0,                        Cmd_Stats_Reset },
+    { CONFIG_CMD_LATENCY_GET,  1, 1,                        Cmd_Latency_Get },
+};
+
+/* ---- Framing -------------------------------------------------------------- */
+
+/**
+  * @brief Queue an answer frame
+  * @param id: Request id
+  * @param cmd: Request command
+  * @param status: Status byte
+  * @param data_len: Answer data already in tx_frame after the status byte
+  * @retval None
+  */
+static void Config_Proto_Answer(uint16_t id, uint8_t cmd, uint8_t status, uint16_t data_len)
+{
+    uint16_t len = (uint16_t)(4U + data_len);    /* id, cmd, status, data */
+    uint16_t crc;
+
+    tx_frame[0] = CONFIG_PROTO_SOF;
+    Put16(&tx_frame[FRAME_LEN], len);
+    Put16(&tx_frame[FRAME_ID], id);
+    tx_frame[FRAME_CMD] = cmd | CONFIG_PROTO_RESPONSE;
+    tx_frame[FRAME_PAYLOAD] = status;
+    crc = Config_Proto_Crc16(0xFFFFU, &tx_frame[FRAME_LEN], (uint16_t)(len + 2U));
+    Put16(&tx_frame[FRAME_LEN + 2U + len], crc);
+
+    CDC_Write_FS(tx_frame, FRAME_SIZE(len));
+    proto_stats.tx_frames++;
+}
+
+/**
+  * @brief Check and handle one complete request frame
+  * @param frame: Frame, starting with the SOF (RX packet or rx_frame)
+  * @param len: Its len field, already range checked
+  * @retval None
+  */
+static void Config_Proto_Frame(const uint8_t *frame, uint16_t len)
+{
+    uint16_t id = Get16(&frame[FRAME_ID]);
+    uint8_t cmd = frame[FRAME_CMD];
+    uint16_t plen = (uint16_t)(len - 3U);
+    uint16_t data_len = 0;
+    uint8_t status = CONFIG_STATUS_UNKNOWN_CMD;
+
+    if (Config_Proto_Crc16(0xFFFFU, &frame[FRAME_LEN], (uint16_t)(len + 2U)) != Get16(&frame[FRAME_LEN + 2U + len])) {
+        proto_stats.crc_errors++;
+        Config_Proto_Answer(id, cmd, CONFIG_STATUS_CRC, 0);
+        return;
+    }
+    proto_stats.rx_frames++;
+
+    for (uint8_t i = 0; i < sizeof(proto_cmds) / sizeof(proto_cmds[0]); i++) {
+        if (proto_cmds[i].cmd != cmd) continue;
+
+        if (plen < proto_cmds[i].min_len || plen > proto_cmds[i].max_len) {
+            status = CONFIG_STATUS_BAD_LENGTH;
+        } else {
+            status = proto_cmds[i].handler(&frame[FRAME_PAYLOAD], plen, &tx_frame[FRAME_PAYLOAD + 1U], &data_len);
+        }
+        break;
+    }
+    Config_Proto_Answer(id, cmd, status, data_len);
+}
+
+/**
+  * @brief Drop the SOF of a bad partial frame and look for the next one
+  * in the bytes already assembled
+  * @retval None
+  */
+static void Config_Proto_Resync(void)
+{
+    uint16_t skip = 1;
+
+    while (skip < rx_frame_len && rx_frame[skip] != CONFIG_PROTO_SOF) {
+        skip++;
+    }
+    proto_stats.framing_errors += skip;
+    rx_frame_len -= skip;
+    memmove(rx_frame, &rx_frame[skip], rx_frame_len);
+}
+
+/**
+  * @brief Parse and handle received requests, call from the main loop
+  * Never blocks: stops when the RX queue is empty or the TX ring is short
+  * of room for an answer.
+  * @retval None
+  */
+void Config_Proto_Task(void)
+{
+    uint16_t avail;
+    const uint8_t *p;
+
+    while ((p = CDC_RxPeek_FS(&avail)) != NULL) {
+        uint16_t need;
+        uint16_t n;
+
+        if (CDC_TxFree_FS() < CONFIG_PROTO_FRAME_MAX) {
+            proto_stats.busy++;
+            return;
+        }
+
+        if (rx_frame_len == 0U) {
+            /* Hunt for the SOF */
+            n = 0;
+            while (n < avail && p[n] != CONFIG_PROTO_SOF) {
+                n++;
+            }
+            if (n > 0U) {
+                proto_stats.framing_errors += n;
+                CDC_RxConsume_FS(n);
+                continue;
+            }
+
+            /* Whole frame in this packet: handle it in place */
+            if (avail >= FRAME_HEADER) {
+                uint16_t len = Get16(&p[FRAME_LEN]);
+
+                if (len < FRAME_LEN_MIN || len > FRAME_LEN_MAX) {
+                    proto_stats.framing_errors++;
+                    CDC_RxConsume_FS(1);
+                    continue;
+                }
+                if (avail >= FRAME_SIZE(len)) {
+                    Config_Proto_Frame(p, len);
+                    CDC_RxConsume_FS(FRAME_SIZE(len));
+                    continue;
+                }
+            }
+        }
+
+        /* Frame continues in the next packet: assemble it */
+        need = (rx_frame_len < FRAME_HEADER) ? FRAME_HEADER : FRAME_SIZE(Get16(&rx_frame[FRAME_LEN]));
+        n = need - rx_frame_len;
+        if (n > avail) {
+            n = avail;
+        }
+        memcpy(&rx_frame[rx_frame_len], p, n);
+        rx_frame_len += n;
+        CDC_RxConsume_FS(n);
+
+        if (rx_frame_len == FRAME_HEADER) {
+            uint16_t len = Get16(&rx_frame[FRAME_LEN]);
+
+            if (len < FRAME_LEN_MIN || len > FRAME_LEN_MAX) {
+                Config_Proto_Resync();
+            }
+        } else if (rx_frame_len > FRAME_HEADER && rx_frame_len == need) {
+            Config_Proto_Frame(rx_frame, Get16(&rx_frame[FRAME_LEN]));
+            rx_frame_len = 0;
+        }
+    }
+}
+
+/**
+  * @brief Protocol counters
+  * @retval Counters since boot or the last CONFIG_CMD_STATS_RESET
+  */
+const Config_Proto_Stats_t *Config_Proto_Get_Stats(void)
+{
+    return &proto_stats;
+}
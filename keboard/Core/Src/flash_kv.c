@@ -0,0 +1,408 @@
+/**
+  ******************************************************************************
+  * @file           : flash_kv.c
+  * @brief          : Log-structured key/value store in flash (EEPROM emulation)
+  *
+  * Boot cost is at most one scan of the full sector:
+  *   1. The write pointer is found by binary search over record headers
+  *      (used slots always precede free ones).
+  *   2. Records are read newest to oldest; the scan stops as soon as every
+  *      id counted in the newest record's "live" field has been loaded.
+  *      That is early when all ids were written recently, but an id
+  *      written once near the start of a sector full of rewrites of
+  *      another id is only found after reading all FLASH_KV_SLOTS (512)
+  *      records.
+  *
+  * Writes go to the RAM cache first, so readers see new values immediately;
+  * the flash append costs a few word programs. A sector erase stalls the
+  * CPU for hundreds of milliseconds and is therefore deferred to
+  * FlashKV_Task(), which the main loop only calls while no key is held.
+  * That includes the erase before a compaction: when the active sector
+  * is full and the other one is not erased yet, FlashKV_Set() leaves the
+  * value in the cache and the task erases and compacts.
+  ******************************************************************************
+  */
+
+#include "flash_kv.h"
+#include <string.h>
+
+/* RAM cache of the current values */
+static uint8_t kv_value[FLASH_KV_MAX_KEYS][FLASH_KV_VALUE_SIZE];
+static uint8_t kv_len[FLASH_KV_MAX_KEYS];
+static uint32_t kv_present = 0;   /* bit n = id n stored */
+
+/* Log state */
+static uint8_t active_sector = 0;       /* 0 = A, 1 = B */
+static uint32_t generation = 0;
+static uint16_t write_slot = 1;
+static uint8_t other_erased = 0;
+static uint8_t retire_pending = 0;
+static uint8_t compact_pending = 0;
+static uint32_t last_write_tick = 0;
+
+static const uint32_t sector_addr[2] = {FLASH_KV_SECTOR_A_ADDR, FLASH_KV_SECTOR_B_ADDR};
+static const uint32_t sector_num[2] = {FLASH_KV_SECTOR_A, FLASH_KV_SECTOR_B};
+
+/**
+  * @brief Address of a slot in a sector
+  */
+static inline uint32_t FlashKV_SlotAddr(uint8_t sector, uint16_t slot)
+{
+    return sector_addr[sector] + (uint32_t)slot * FLASH_KV_RECORD_SIZE;
+}
+
+/**
+  * @brief Read a 32-bit word from flash
+  */
+static inline uint32_t FlashKV_Read(uint32_t addr)
+{
+    return *(__IO uint32_t *)addr;
+}
+
+/**
+  * @brief CRC-8 (poly 0x07) over header fields and value
+  */
+static uint8_t FlashKV_Crc8(uint8_t id, uint8_t len, uint8_t live, const uint8_t *data)
+{
+    uint8_t crc = 0;
+    uint8_t head[3] = {id, len, live};
+
+    for (uint8_t i = 0; i < 3u + len; i++) {
+        crc ^= (i < 3u) ? head[i] : data[i - 3u];
+        for (uint8_t b = 0; b < 8; b++) {
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+/**
+  * @brief Number of ids currently stored
+  */
+static uint8_t FlashKV_LiveCount(void)
+{
+    uint32_t v = kv_present;
+    uint8_t n = 0;
+
+    while (v) {
+        v &= v - 1;
+        n++;
+    }
+    return n;
+}
+
+/**
+  * @brief Check that every word of a slot is erased
+  */
+static uint8_t FlashKV_SlotBlank(uint8_t sector, uint16_t slot)
+{
+    uint32_t addr = FlashKV_SlotAddr(sector, slot);
+
+    for (uint32_t i = 0; i < FLASH_KV_RECORD_SIZE; i += 4) {
+        if (FlashKV_Read(addr + i) != 0xFFFFFFFFU) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+  * @brief Erase one of the two sectors (blocking, stalls flash fetches)
+  */
+static HAL_StatusTypeDef FlashKV_EraseSector(uint8_t sector)
+{
+    FLASH_EraseInitTypeDef erase = {0};
+    uint32_t sector_error = 0;
+    HAL_StatusTypeDef status;
+
+    erase.TypeErase = FLASH_TYPEERASE_SECTORS;
+    erase.Sector = sector_num[sector];
+    erase.NbSectors = 1;
+    erase.VoltageRange = FLASH_VOLTAGE_RANGE_3;
+
+    HAL_FLASH_Unlock();
+    status = HAL_FLASHEx_Erase(&erase, &sector_error);
+    HAL_FLASH_Lock();
+
+    return status;
+}
+
+/**
+  * @brief Program one record from the RAM cache; header word goes last
+  */
+static HAL_StatusTypeDef FlashKV_WriteRecord(uint8_t sector, uint16_t slot, uint8_t id)
+{
+    uint32_t words[FLASH_KV_RECORD_SIZE / 4];
+    uint32_t addr = FlashKV_SlotAddr(sector, slot);
+    uint8_t len = kv_len[id];
+    uint8_t live = FlashKV_LiveCount();
+    HAL_StatusTypeDef status = HAL_OK;
+
+    memset(words, 0xFF, sizeof(words));
+    memcpy(&words[1], kv_value[id], len);
+    words[0] = (uint32_t)id | ((uint32_t)len << 8) | ((uint32_t)live << 16) |
+               ((uint32_t)FlashKV_Crc8(id, len, live, kv_value[id]) << 24);
+
+    HAL_FLASH_Unlock();
+    for (uint32_t i = 1; i < FLASH_KV_RECORD_SIZE / 4 && status == HAL_OK; i++) {
+        if (words[i] != 0xFFFFFFFFU) {
+            status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, addr + i * 4, words[i]);
+        }
+    }
+    if (status == HAL_OK) {
+        status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, addr, words[0]);
+    }
+    HAL_FLASH_Lock();
+
+    return status;
+}
+
+/**
+  * @brief Write the sector header (generation first, magic last)
+  */
+static HAL_StatusTypeDef FlashKV_WriteHeader(uint8_t sector, uint32_t gen)
+{
+    uint32_t addr = sector_addr[sector];
+    HAL_StatusTypeDef status;
+
+    HAL_FLASH_Unlock();
+    status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, addr + 4, gen);
+    if (status == HAL_OK) {
+        status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, addr, FLASH_KV_MAGIC);
+    }
+    HAL_FLASH_Lock();
+
+    return status;
+}
+
+/**
+  * @brief Copy live values into the other sector, which must be erased,
+  * and make it active
+  */
+static HAL_StatusTypeDef FlashKV_Compact(void)
+{
+    uint8_t target = active_sector ^ 1u;
+    uint16_t slot = 1;
+    HAL_StatusTypeDef status = HAL_OK;
+
+    for (uint8_t id = 0; id < FLASH_KV_MAX_KEYS && status == HAL_OK; id++) {
+        if (kv_present & (1UL << id)) {
+            status = FlashKV_WriteRecord(target, slot++, id);
+        }
+    }
+    if (status == HAL_OK) {
+        status = FlashKV_WriteHeader(target, generation + 1);
+    }
+    if (status != HAL_OK) {
+        other_erased = 0;
+        return status;
+    }
+
+    active_sector = target;
+    generation++;
+    write_slot = slot;
+    other_erased = 0;
+    retire_pending = 1;
+
+    return HAL_OK;
+}
+
+/**
+  * @brief Locate the write pointer and load the newest value of every id
+  */
+static void FlashKV_Load(void)
+{
+    uint16_t lo = 1;
+    uint16_t hi = FLASH_KV_SLOTS;
+    uint8_t target = 0xFF;
+    uint8_t seen = 0;
+
+    /* Binary search for the first free header */
+    while (lo < hi) {
+        uint16_t mid = (uint16_t)((lo + hi) / 2);
+        if (FlashKV_Read(FlashKV_SlotAddr(active_sector, mid)) == 0xFFFFFFFFU) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+
+    /* Skip a record torn by reset (value written, header not) */
+    while (lo < FLASH_KV_SLOTS && !FlashKV_SlotBlank(active_sector, lo)) {
+        lo++;
+    }
+    write_slot = lo;
+
+    /* Newest to oldest until all live ids are found */
+    for (uint16_t slot = write_slot; slot > 1 && seen != target; slot--) {
+        uint32_t addr = FlashKV_SlotAddr(active_sector, slot - 1);
+        uint32_t header = FlashKV_Read(addr);
+        uint8_t id = (uint8_t)header;
+        uint8_t len = (uint8_t)(header >> 8);
+        uint8_t live = (uint8_t)(header >> 16);
+        uint8_t value[FLASH_KV_VALUE_SIZE];
+
+        if (header == 0xFFFFFFFFU || id >= FLASH_KV_MAX_KEYS || len == 0 || len > FLASH_KV_VALUE_SIZE) {
+            continue;
+        }
+        memcpy(value, (const void *)(addr + 4), len);
+        if ((uint8_t)(header >> 24) != FlashKV_Crc8(id, len, live, value)) {
+            continue;
+        }
+
+        if (target == 0xFF) {
+            target = live;
+        }
+        if (!(kv_present & (1UL << id))) {
+            memcpy(kv_value[id], value, len);
+            kv_len[id] = len;
+            kv_present |= 1UL << id;
+            seen++;
+        }
+    }
+}
+
+/**
+  * @brief Initialize the store and load all values into RAM
+  * Call once at boot, before modules that read their settings from it.
+  * @retval None
+  */
+void FlashKV_Init(void)
+{
+    uint8_t valid[2];
+    uint32_t gen[2];
+
+    memset(kv_len, 0, sizeof(kv_len));
+    kv_present = 0;
+    retire_pending = 0;
+    compact_pending = 0;
+
+    for (uint8_t s = 0; s < 2; s++) {
+        valid[s] = (FlashKV_Read(sector_addr[s]) == FLASH_KV_MAGIC);
+        gen[s] = FlashKV_Read(sector_addr[s] + 4);
+    }
+
+    if (!valid[0] && !valid[1]) {
+        /* First boot: format sector A */
+        FlashKV_EraseSector(0);
+        FlashKV_WriteHeader(0, 1);
+        active_sector = 0;
+        generation = 1;
+        write_slot = 1;
+        other_erased = 0;
+        retire_pending = 1;
+        return;
+    }
+
+    if (valid[0] && valid[1]) {
+        /* Interrupted before the old sector was erased: newest wins */
+        active_sector = (gen[1] > gen[0]) ? 1 : 0;
+    } else {
+        active_sector = valid[1] ? 1 : 0;
+    }
+    generation = gen[active_sector];
+
+    /* A compaction always starts at slot 1, so two words tell if it is clean */
+    uint8_t other = active_sector ^ 1u;
+    other_erased = (FlashKV_Read(sector_addr[other]) == 0xFFFFFFFFU) &&
+                   (FlashKV_Read(FlashKV_SlotAddr(other, 1)) == 0xFFFFFFFFU);
+    retire_pending = !other_erased;
+
+    FlashKV_Load();
+}
+
+/**
+  * @brief Read a value from the RAM cache
+  * @param id: Key id (< FLASH_KV_MAX_KEYS)
+  * @param buf: Destination buffer
+  * @param max_len: Size of buf
+  * @retval Number of bytes copied, 0 if the id is not stored
+  */
+uint8_t FlashKV_Get(uint8_t id, void *buf, uint8_t max_len)
+{
+    if (id >= FLASH_KV_MAX_KEYS || !(kv_present & (1UL << id))) {
+        return 0;
+    }
+
+    uint8_t len = (kv_len[id] < max_len) ? kv_len[id] : max_len;
+    memcpy(buf, kv_value[id], len);
+    return len;
+}
+
+/**
+  * @brief Store a value: RAM cache immediately, flash record appended
+  * Never erases: a full sector whose successor still needs erasing is
+  * compacted by FlashKV_Task().
+  * @param id: Key id (< FLASH_KV_MAX_KEYS)
+  * @param data: Value bytes
+  * @param len: Value length (1..FLASH_KV_VALUE_SIZE)
+  * @retval HAL status of the flash write (HAL_OK once queued for the task)
+  */
+HAL_StatusTypeDef FlashKV_Set(uint8_t id, const void *data, uint8_t len)
+{
+    if (id >= FLASH_KV_MAX_KEYS || len == 0 || len > FLASH_KV_VALUE_SIZE) {
+        return HAL_ERROR;
+    }
+
+    /* Unchanged values cost no flash wear */
+    if ((kv_present & (1UL << id)) && kv_len[id] == len && memcmp(kv_value[id], data, len) == 0) {
+        return HAL_OK;
+    }
+
+    memcpy(kv_value[id], data, len);
+    kv_len[id] = len;
+    kv_present |= 1UL << id;
+    last_write_tick = HAL_GetTick();
+
+    if (compact_pending) {
+        return HAL_OK;      /* The compaction writes the cache */
+    }
+    if (write_slot >= FLASH_KV_SLOTS) {
+        if (!other_erased) {
+            compact_pending = 1;
+            return HAL_OK;
+        }
+        return FlashKV_Compact();
+    }
+
+    HAL_StatusTypeDef status = FlashKV_WriteRecord(active_sector, write_slot, id);
+    /* Load() skips a torn slot but not a blank one: a failed write only
+     * moves on if it left something behind */
+    if (status == HAL_OK || !FlashKV_SlotBlank(active_sector, write_slot)) {
+        write_slot++;
+    }
+    return status;
+}
+
+/**
+  * @brief Erase the retired sector once writes have been quiet for a while,
+  * and run a compaction FlashKV_Set() could not
+  * Call from the main loop only while the keyboard is idle: the erase
+  * blocks execution from flash until it completes.
+  * @retval None
+  */
+void FlashKV_Task(void)
+{
+    if (compact_pending) {
+        if (!other_erased) {
+            if (FlashKV_EraseSector(active_sector ^ 1u) != HAL_OK) {
+                return;
+            }
+            other_erased = 1;
+            retire_pending = 0;
+        }
+        if (FlashKV_Compact() == HAL_OK) {
+            compact_pending = 0;
+        }
+        return;
+    }
+
+    if (!retire_pending || (HAL_GetTick() - last_write_tick) < FLASH_KV_ERASE_DELAY) {
+        return;
+    }
+
+    if (FlashKV_EraseSector(active_sector ^ 1u) == HAL_OK) {
+        other_erased = 1;
+        retire_pending = 0;
+    }
+}
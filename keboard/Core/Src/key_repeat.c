@@ -0,0 +1,192 @@
+/**
+  ******************************************************************************
+  * @file           : key_repeat.c
+  * @brief          : Device-side auto-repeat and turbo engine implementation
+  *
+  * Timing is kept in USB frames (USB_Keyboard_GetFrame(), 1 ms per SOF at
+  * full speed). With bInterval = 1 every queued report goes out in its own
+  * frame, so a tap (press + release) costs two frames and the highest
+  * useful rate is 500 taps/s. A repeat is only generated when both of its
+  * reports fit in the report queue; a late repeat is not made up later,
+  * so a busy host never builds up a backlog of taps. The first tap of a
+  * press is never dropped: without room it is sent by KeyRepeat_Task(),
+  * even if the key has been released by then.
+  ******************************************************************************
+  */
+
+#include "key_repeat.h"
+#include "usb_keyboard.h"
+#include "matrix_keyboard.h"
+#include "flash_kv.h"
+#include <string.h>
+
+/* Defaults for keys without a stored configuration */
+#define KEY_REPEAT_DEFAULT_DELAY   50    /* 500 ms */
+#define KEY_REPEAT_DEFAULT_RATE    30    /* taps/s */
+
+/* Per-key configuration (RAM copy of KV_ID_REPEAT) */
+static KeyRepeat_Config_t repeat_config[TOTAL_KEYS];
+
+/* Per-key runtime state */
+static uint8_t repeat_active[TOTAL_KEYS];
+static uint8_t repeat_code[TOTAL_KEYS];
+static uint32_t repeat_next[TOTAL_KEYS];
+static uint8_t repeat_first[TOTAL_KEYS];       /* First tap still to be sent */
+
+/**
+  * @brief Frames between two taps for a given rate
+  * @param rate: Taps per second
+  * @retval Period in frames
+  */
+static uint32_t KeyRepeat_Period(uint8_t rate)
+{
+    uint32_t period = (rate > 0) ? (1000U / rate) : 1000U;
+
+    return (period < KEY_REPEAT_MIN_PERIOD) ? KEY_REPEAT_MIN_PERIOD : period;
+}
+
+/**
+  * @brief Frames between the first tap and the next one
+  * @param cfg: Key configuration
+  * @retval Initial delay for KEY_REPEAT_AUTO, else the tap period
+  */
+static uint32_t KeyRepeat_First_Delay(const KeyRepeat_Config_t *cfg)
+{
+    if (cfg->mode == KEY_REPEAT_AUTO) {
+        return (uint32_t)cfg->delay * 10U;
+    }
+    return KeyRepeat_Period(cfg->rate);
+}
+
+/**
+  * @brief Initialize the repeat engine and load the per-key configuration
+  * @retval None
+  */
+void KeyRepeat_Init(void)
+{
+    memset(repeat_active, 0, sizeof(repeat_active));
+    memset(repeat_code, 0, sizeof(repeat_code));
+    memset(repeat_next, 0, sizeof(repeat_next));
+    memset(repeat_first, 0, sizeof(repeat_first));
+
+    if (FlashKV_Get(KV_ID_REPEAT, repeat_config, sizeof(repeat_config)) != sizeof(repeat_config)) {
+        for (uint8_t i = 0; i < TOTAL_KEYS; i++) {
+            repeat_config[i].mode = KEY_REPEAT_OFF;
+            repeat_config[i].delay = KEY_REPEAT_DEFAULT_DELAY;
+            repeat_config[i].rate = KEY_REPEAT_DEFAULT_RATE;
+        }
+    }
+}
+
+/**
+  * @brief Feed a key event to the repeat engine
+  * @param matrix_key: Matrix key code (0-8)
+  * @param usb_key: HID keyboard code the key is mapped to
+  * @param pressed: 1 = key pressed, 0 = key released
+  * @retval 1 if the event was consumed, 0 if it should be handled normally
+  */
+uint8_t KeyRepeat_Process_Key(uint8_t matrix_key, uint8_t usb_key, uint8_t pressed)
+{
+    KeyRepeat_Config_t *cfg;
+
+    if (matrix_key >= TOTAL_KEYS) return 0;
+
+    /* Only consume the release if we also consumed the press */
+    if (!pressed) {
+        if (!repeat_active[matrix_key]) {
+            return 0;
+        }
+        repeat_active[matrix_key] = 0;
+        return 1;
+    }
+
+    cfg = &repeat_config[matrix_key];
+    if (cfg->mode == KEY_REPEAT_OFF || usb_key == KEY_NONE) {
+        return 0;
+    }
+
+    repeat_active[matrix_key] = 1;
+    repeat_code[matrix_key] = usb_key;
+
+    /* First tap goes out immediately if both reports fit, else from the task */
+    if (USB_Keyboard_QueueSpace() < 2) {
+        repeat_first[matrix_key] = 1;
+        repeat_next[matrix_key] = USB_Keyboard_GetFrame();
+        return 1;
+    }
+    USB_Keyboard_TapKey(0, usb_key);
+    repeat_first[matrix_key] = 0;
+    repeat_next[matrix_key] = USB_Keyboard_GetFrame() + KeyRepeat_First_Delay(cfg);
+
+    return 1;
+}
+
+/**
+  * @brief Generate due repeats; call from the main loop
+  * @retval None
+  */
+void KeyRepeat_Task(void)
+{
+    uint32_t now = USB_Keyboard_GetFrame();
+
+    for (uint8_t i = 0; i < TOTAL_KEYS; i++) {
+        if (!repeat_active[i] && !repeat_first[i]) {
+            continue;
+        }
+        if ((int32_t)(now - repeat_next[i]) < 0) {
+            continue;  /* Not due yet */
+        }
+        if (USB_Keyboard_QueueSpace() < 2) {
+            return;    /* Retry once the host has taken some reports */
+        }
+
+        USB_Keyboard_TapKey(0, repeat_code[i]);
+
+        /* A deferred first tap: the repeats start from here */
+        if (repeat_first[i]) {
+            repeat_first[i] = 0;
+            repeat_next[i] = now + KeyRepeat_First_Delay(&repeat_config[i]);
+            continue;
+        }
+
+        /* Stay on the frame grid, but drop taps we are already late for */
+        repeat_next[i] += KeyRepeat_Period(repeat_config[i].rate);
+        if ((int32_t)(now - repeat_next[i]) >= 0) {
+            repeat_next[i] = now + KeyRepeat_Period(repeat_config[i].rate);
+        }
+    }
+}
+
+/**
+  * @brief Change the repeat configuration of a key and persist it
+  * @param matrix_key: Matrix key code (0-8)
+  * @param mode: KEY_REPEAT_OFF, KEY_REPEAT_AUTO or KEY_REPEAT_TURBO
+  * @param delay: Initial delay for KEY_REPEAT_AUTO in units of 10 ms
+  * @param rate: Taps per second (1-255)
+  * @retval HAL status of the flash write
+  */
+HAL_StatusTypeDef KeyRepeat_Set_Config(uint8_t matrix_key, uint8_t mode, uint8_t delay, uint8_t rate)
+{
+    if (matrix_key >= TOTAL_KEYS || mode > KEY_REPEAT_TURBO || rate == 0) {
+        return HAL_ERROR;
+    }
+
+    repeat_config[matrix_key].mode = mode;
+    repeat_config[matrix_key].delay = delay;
+    repeat_config[matrix_key].rate = rate;
+
+    return FlashKV_Set(KV_ID_REPEAT, repeat_config, sizeof(repeat_config));
+}
+
+/**
+  * @brief Get the repeat configuration of a key
+  * @param matrix_key: Matrix key code (0-8)
+  * @param config: Pointer to buffer to receive the configuration
+  * @retval None
+  */
+void KeyRepeat_Get_Config(uint8_t matrix_key, KeyRepeat_Config_t *config)
+{
+    if (matrix_key >= TOTAL_KEYS) return;
+
+    *config = repeat_config[matrix_key];
+}
@@ -0,0 +1,375 @@
+/**
+  ******************************************************************************
+  * @file           : latency.c
+  * @brief          : End-to-end key latency instrumentation implementation
+  *
+  * A transition carries its timestamps from the scan (edge, debounce) to the
+  * report queue slot it ended up in (build), then to the IN endpoint (send).
+  * The IN-complete interrupt only stores the last timestamp; histograms are
+  * updated from the main loop.
+  ******************************************************************************
+  */
+
+#include "latency.h"
+
+#if LATENCY_ENABLE
+
+#include "matrix_keyboard.h"
+#include "usb_keyboard.h"
+#include <stdio.h>
+#include <string.h>
+
+#ifdef SIM_BUILD
+#include "sim.h"
+#define LATENCY_NOW()            ((uint32_t)Sim_Time_Us())
+#define LATENCY_TICKS_PER_US     1U
+#else
+#define LATENCY_NOW()            (DWT->CYCCNT)
+#define LATENCY_TICKS_PER_US     (SystemCoreClock / 1000000U)
+#endif
+
+/* Timestamps of one transition: edge, debounce, build, send, in */
+typedef struct {
+    uint32_t t[LATENCY_STAGES];
+    uint8_t valid;
+} Latency_Sample_t;
+
+/* In-flight sample states */
+#define LATENCY_IDLE    0U
+#define LATENCY_SENT    1U
+#define LATENCY_DONE    2U
+
+static uint32_t edge_time[TOTAL_KEYS];
+static uint32_t edge_pending = 0;              /* bit n = matrix key n */
+
+static Latency_Sample_t current;               /* Between debounce and report build */
+static Latency_Sample_t queued[USB_KEYBOARD_QUEUE_LEN];
+static Latency_Sample_t in_flight;
+static volatile uint8_t in_flight_state = LATENCY_IDLE;
+
+static Latency_Hist_t hist[LATENCY_STAGES];
+static volatile uint8_t dump_requested = 0;
+
+static const char *const stage_names[LATENCY_STAGES] = {
+    "debounce", "build", "queue", "in", "total"
+};
+
+/**
+  * @brief Histogram bucket of a value (exact below 16 us, then 8 per octave)
+  */
+static uint8_t Latency_Bucket(uint32_t us)
+{
+    if (us < 16U) return (uint8_t)us;
+
+    uint32_t msb = 31U - (uint32_t)__builtin_clz(us);
+    if (msb > 24U) return LATENCY_BUCKETS - 1U;
+
+    uint32_t idx = 16U + (msb - 4U) * 8U + ((us >> (msb - 3U)) & 7U);
+    return (idx < LATENCY_BUCKETS) ? (uint8_t)idx : (uint8_t)(LATENCY_BUCKETS - 1U);
+}
+
+/**
+  * @brief Lowest value of a bucket
+  */
+static uint32_t Latency_Bucket_Floor(uint32_t idx)
+{
+    if (idx < 16U) return idx;
+
+    uint32_t msb = 4U + (idx - 16U) / 8U;
+    return (8U + (idx - 16U) % 8U) << (msb - 3U);
+}
+
+static void Latency_Hist_Add(Latency_Hist_t *h, uint32_t us)
+{
+    if (h->count == 0 || us < h->min) h->min = us;
+    if (us > h->max) h->max = us;
+    h->count++;
+    h->sum += us;
+
+    uint8_t b = Latency_Bucket(us);
+    if (h->bucket[b] < UINT16_MAX) h->bucket[b]++;
+}
+
+/**
+  * @brief Move a completed transition into the histograms
+  */
+static void Latency_Fold(void)
+{
+    if (in_flight_state != LATENCY_DONE) return;
+
+    uint32_t per_us = LATENCY_TICKS_PER_US;
+    const uint32_t *t = in_flight.t;
+
+    if (per_us == 0U) per_us = 1U;
+    for (uint8_t s = 0; s < LATENCY_STAGE_TOTAL; s++) {
+        Latency_Hist_Add(&hist[s], (t[s + 1] - t[s]) / per_us);
+    }
+    Latency_Hist_Add(&hist[LATENCY_STAGE_TOTAL], (t[LATENCY_STAGES - 1] - t[0]) / per_us);
+    in_flight_state = LATENCY_IDLE;
+}
+
+/**
+  * @brief Start the cycle counter and clear all statistics
+  * @retval None
+  */
+void Latency_Init(void)
+{
+#ifndef SIM_BUILD
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+    edge_pending = 0;
+    memset(&current, 0, sizeof(current));
+    memset(queued, 0, sizeof(queued));
+    in_flight_state = LATENCY_IDLE;
+    dump_requested = 0;
+    Latency_Reset();
+}
+
+/**
+  * @brief A raw sample differs from the debounced state
+  * Only the first edge of a bounce burst is kept; an edge that was never
+  * confirmed is replaced after LATENCY_EDGE_TIMEOUT.
+  * @param matrix_key: Matrix key code
+  * @retval None
+  */
+void Latency_Edge(uint8_t matrix_key)
+{
+    uint32_t now = LATENCY_NOW();
+
+    if (matrix_key >= TOTAL_KEYS) return;
+    if ((edge_pending & (1UL << matrix_key)) &&
+        (now - edge_time[matrix_key]) / LATENCY_TICKS_PER_US < LATENCY_EDGE_TIMEOUT * 1000U) {
+        return;
+    }
+    edge_time[matrix_key] = now;
+    edge_pending |= (1UL << matrix_key);
+}
+
+/**
+  * @brief The debouncer accepted a transition
+  * @param matrix_key: Matrix key code
+  * @retval None
+  */
+void Latency_Debounced(uint8_t matrix_key)
+{
+    Latency_Key_Stamp_t stamp;
+
+    Latency_Debounced_Stamp(matrix_key, &stamp);
+    Latency_Key_Restore(&stamp);
+}
+
+/**
+  * @brief The debouncer accepted a transition that another task handles
+  * Only touches the edge state, which belongs to the scan; the transition
+  * being handled is left alone.
+  * @param matrix_key: Matrix key code
+  * @param stamp: Receives the edge and debounce stamps
+  * @retval None
+  */
+void Latency_Debounced_Stamp(uint8_t matrix_key, Latency_Key_Stamp_t *stamp)
+{
+    uint32_t now = LATENCY_NOW();
+
+    stamp->t[0] = now;
+    stamp->t[1] = now;
+    stamp->valid = 0;
+    if (matrix_key >= TOTAL_KEYS) return;
+    if (edge_pending & (1UL << matrix_key)) {
+        stamp->t[0] = edge_time[matrix_key];
+    }
+    stamp->valid = 1;
+    edge_pending &= ~(1UL << matrix_key);
+}
+
+/**
+  * @brief Key event fully handled: drop it if it did not produce a report
+  * @retval None
+  */
+void Latency_Key_Done(void)
+{
+    current.valid = 0;
+}
+
+/**
+  * @brief Make saved stamps the transition being handled
+  * @param stamp: Stamps from Latency_Debounced_Stamp()
+  * @retval None
+  */
+void Latency_Key_Restore(const Latency_Key_Stamp_t *stamp)
+{
+    current.t[0] = stamp->t[0];
+    current.t[1] = stamp->t[1];
+    current.valid = stamp->valid;
+}
+
+/**
+  * @brief A report was queued in a slot
+  * Reports not caused by a matrix transition clear the slot, so a sample
+  * left behind by a dropped or overwritten report is never reused.
+  * @param slot: Report queue index
+  * @retval None
+  */
+void Latency_Report_Built(uint8_t slot)
+{
+    if (slot >= USB_KEYBOARD_QUEUE_LEN) return;
+
+    current.t[2] = LATENCY_NOW();
+    queued[slot] = current;
+    current.valid = 0;
+}
+
+/**
+  * @brief The report of a queue slot was handed to the IN endpoint
+  * @param slot: Report queue index
+  * @retval None
+  */
+void Latency_Report_Sent(uint8_t slot)
+{
+    Latency_Fold();
+    if (slot >= USB_KEYBOARD_QUEUE_LEN) return;
+
+    if (queued[slot].valid) {
+        in_flight = queued[slot];
+        in_flight.t[3] = LATENCY_NOW();
+        in_flight_state = LATENCY_SENT;
+    } else {
+        in_flight_state = LATENCY_IDLE;
+    }
+    queued[slot].valid = 0;
+}
+
+/**
+  * @brief IN transfer complete (USB interrupt context)
+  * @retval None
+  */
+void Latency_Report_Done(void)
+{
+    if (in_flight_state == LATENCY_SENT) {
+        in_flight.t[4] = LATENCY_NOW();
+        in_flight_state = LATENCY_DONE;
+    }
+}
+
+/**
+  * @brief Fold completed transitions and service dump requests
+  * Call from the main loop.
+  * @retval None
+  */
+void Latency_Task(void)
+{
+    Latency_Fold();
+    if (dump_requested) {
+        dump_requested = 0;
+        Latency_Dump();
+    }
+}
+
+/**
+  * @brief Ask the main loop to print the histograms (safe from any context)
+  * @retval None
+  */
+void Latency_Request_Dump(void)
+{
+    dump_requested = 1;
+}
+
+/**
+  * @brief Value below which a percentage of the samples fall
+  * @param stage: LATENCY_STAGE_*
+  * @param percent: 0-100
+  * @retval Microseconds (bucket floor, clamped to min/max), 0 if no samples
+  */
+uint32_t Latency_Percentile(uint8_t stage, uint8_t percent)
+{
+    const Latency_Hist_t *h;
+    uint64_t need, seen = 0;
+
+    if (stage >= LATENCY_STAGES || hist[stage].count == 0) return 0;
+    h = &hist[stage];
+    need = ((uint64_t)h->count * percent + 99U) / 100U;
+    if (need == 0) need = 1;
+
+    for (uint32_t b = 0; b < LATENCY_BUCKETS; b++) {
+        seen += h->bucket[b];
+        if (seen >= need) {
+            uint32_t v = Latency_Bucket_Floor(b);
+            if (v < h->min) v = h->min;
+            if (v > h->max) v = h->max;
+            return v;
+        }
+    }
+    return h->max;
+}
+
+/**
+  * @brief Print count, min, p50/p90/p99 and max of every stage
+  * @retval None
+  */
+void Latency_Dump(void)
+{
+    printf("[LAT] stage        count      min      p50      p90      p99      max  (us)\r\n");
+    for (uint8_t s = 0; s < LATENCY_STAGES; s++) {
+        const Latency_Hist_t *h = &hist[s];
+        printf("[LAT] %-8s %9lu %8lu %8lu %8lu %8lu %8lu\r\n", stage_names[s],
+               (unsigned long)h->count, (unsigned long)h->min,
+               (unsigned long)Latency_Percentile(s, 50), (unsigned long)Latency_Percentile(s, 90),
+               (unsigned long)Latency_Percentile(s, 99), (unsigned long)h->max);
+    }
+}
+
+/**
+  * @brief Clear the histograms
+  * @retval None
+  */
+void Latency_Reset(void)
+{
+    memset(hist, 0, sizeof(hist));
+}
+
+/**
+  * @brief Histogram of a stage
+  * @param stage: LATENCY_STAGE_*
+  * @retval Histogram, NULL if out of range
+  */
+const Latency_Hist_t *Latency_Get_Hist(uint8_t stage)
+{
+    return (stage < LATENCY_STAGES) ? &hist[stage] : NULL;
+}
+
+/**
+  * @brief Rescale a timestamp taken at another cycle counter rate
+  */
+static uint32_t Latency_Rescale(uint32_t t, uint32_t now, uint32_t old_per_us, uint32_t new_per_us)
+{
+    return now - (uint32_t)(((uint64_t)(now - t) * new_per_us) / old_per_us);
+}
+
+/**
+  * @brief The core clock changed: restate pending timestamps in the new
+  * cycle counter rate, so spans across the change stay in microseconds.
+  * Call with interrupts masked, right after SystemCoreClock was updated.
+  * @param old_hz: Previous SystemCoreClock
+  * @retval None
+  */
+void Latency_Clock_Changed(uint32_t old_hz)
+{
+    uint32_t old_per_us = old_hz / 1000000U;
+    uint32_t new_per_us = LATENCY_TICKS_PER_US;
+    uint32_t now = LATENCY_NOW();
+
+    if (old_per_us == 0U || old_per_us == new_per_us) return;
+
+    for (uint32_t i = 0; i < TOTAL_KEYS; i++) {
+        edge_time[i] = Latency_Rescale(edge_time[i], now, old_per_us, new_per_us);
+    }
+    for (uint32_t s = 0; s < LATENCY_STAGES; s++) {
+        current.t[s] = Latency_Rescale(current.t[s], now, old_per_us, new_per_us);
+        in_flight.t[s] = Latency_Rescale(in_flight.t[s], now, old_per_us, new_per_us);
+        for (uint32_t q = 0; q < USB_KEYBOARD_QUEUE_LEN; q++) {
+            queued[q].t[s] = Latency_Rescale(queued[q].t[s], now, old_per_us, new_per_us);
+        }
+    }
+}
+
+#endif /* LATENCY_ENABLE */
@@ -0,0 +1,133 @@
+/**
+  ******************************************************************************
+  * @file           : leader_key.c
+  * @brief          : Leader-key sequence engine implementation
+  *
+  * State machine:
+  *   IDLE   --KEY_LEADER pressed-->  ACTIVE (trie state = root)
+  *   ACTIVE --key pressed-->         one trie step
+  *            leaf reached       ->  fire action, IDLE
+  *            no such child      ->  cancel, IDLE
+  *   ACTIVE --LEADER_TIMEOUT idle--> fire action of current state (if any), IDLE
+  *
+  * Only key presses are consumed; releases always pass through so a key
+  * held before the leader is never left stuck in the report.
+  ******************************************************************************
+  */
+
+#include "leader_key.h"
+#include "usb_keyboard.h"
+
+/* Engine state */
+static uint8_t leader_active = 0;
+static uint16_t leader_state = 0;
+static uint8_t leader_depth = 0;
+static uint32_t leader_timer = 0;
+
+/**
+  * @brief Resolve the pending sequence and return to idle
+  * @param fire: 1 = run the action of the current state, 0 = cancel
+  * @retval None
+  */
+static void Leader_Finish(uint8_t fire)
+{
+    uint16_t action = leader_trie[leader_state].action;
+
+    leader_active = 0;
+    leader_state = 0;
+    leader_depth = 0;
+
+    if (fire && action != LEADER_ACTION_NONE) {
+        Leader_Action_Callback(action);
+    }
+}
+
+/**
+  * @brief Initialize the leader-key engine
+  * @retval None
+  */
+void Leader_Init(void)
+{
+    leader_active = 0;
+    leader_state = 0;
+    leader_depth = 0;
+    leader_timer = 0;
+}
+
+/**
+  * @brief Feed a key event to the leader engine
+  * @param key_code: HID keyboard code
+  * @param pressed: 1 = key pressed, 0 = key released
+  * @retval 1 if the event was consumed, 0 if it should be handled normally
+  */
+uint8_t Leader_Process_Key(uint8_t key_code, uint8_t pressed)
+{
+    if (!pressed) {
+        return (key_code == LEADER_KEY);
+    }
+
+    if (!leader_active) {
+        if (key_code != LEADER_KEY) {
+            return 0;
+        }
+        leader_active = 1;
+        leader_state = 0;
+        leader_depth = 0;
+        leader_timer = HAL_GetTick();
+        return 1;
+    }
+
+    /* One trie step: child = base[state] + key, owned by state if check matches */
+    uint16_t base = leader_trie[leader_state].base;
+    uint32_t next = (uint32_t)base + key_code;
+
+    if (base == 0 || next >= leader_trie_size || leader_trie[next].check != leader_state) {
+        Leader_Finish(0);
+        return 1;
+    }
+
+    leader_state = (uint16_t)next;
+    leader_depth++;
+    leader_timer = HAL_GetTick();
+
+    /* Leaf or maximum length: nothing longer can match, resolve now */
+    if (leader_trie[leader_state].base == 0 || leader_depth >= LEADER_MAX_SEQUENCE) {
+        Leader_Finish(1);
+    }
+
+    return 1;
+}
+
+/**
+  * @brief Handle sequence timeout
+  * Call periodically from the main loop.
+  * @retval None
+  */
+void Leader_Task(void)
+{
+    if (leader_active && (HAL_GetTick() - leader_timer) >= LEADER_TIMEOUT) {
+        /* A sequence that is also a prefix of longer ones fires on timeout */
+        Leader_Finish(1);
+    }
+}
+
+/**
+  * @brief Check whether a sequence is being collected
+  * @retval 1 = leader pressed and sequence pending, 0 = idle
+  */
+uint8_t Leader_Is_Active(void)
+{
+    return leader_active;
+}
+
+/**
+  * @brief Action callback for a completed sequence
+  * Default implementation taps the encoded key with its modifiers.
+  * This is a weak function, user can override it in application code.
+  * @param action: LEADER_ACTION(modifier, keycode)
+  * @retval None
+  */
+__weak void Leader_Action_Callback(uint16_t action)
+{
+    USB_Keyboard_TapKey((uint8_t)(action >> 8), (uint8_t)(action & 0xFF));
+}
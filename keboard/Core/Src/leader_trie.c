@@ -0,0 +1,60 @@
+/**
+  ******************************************************************************
+  * @file           : leader_trie.c
+  * @brief          : Leader-key sequence trie (generated)
+  *
+  * Generated by leader_trie_gen.py from leader_sequences.txt.
+  * Do not edit by hand.
+  * Sequences: 8, trie slots: 43
+  ******************************************************************************
+  */
+
+#include "leader_key.h"
+
+const uint16_t leader_trie_size = 43;
+
+const Leader_TrieNode_t leader_trie[] = {
+    {0x0001, 0xFFFF, 0x0000},  /* 0 */
+    {0x0000, 0xFFFF, 0x0000},  /* 1 */
+    {0x0000, 0xFFFF, 0x0000},  /* 2 */
+    {0x0000, 0xFFFF, 0x0000},  /* 3 */
+    {0x0000, 0xFFFF, 0x0000},  /* 4 */
+    {0x0000, 0xFFFF, 0x0000},  /* 5 */
+    {0x0000, 0xFFFF, 0x0000},  /* 6 */
+    {0x0000, 0xFFFF, 0x0000},  /* 7 */
+    {0x0000, 0xFFFF, 0x0000},  /* 8 */
+    {0x0000, 0xFFFF, 0x0000},  /* 9 */
+    {0x0000, 0xFFFF, 0x0000},  /* 10 */
+    {0x0000, 0xFFFF, 0x0000},  /* 11 */
+    {0x0000, 0xFFFF, 0x0000},  /* 12 */
+    {0x0000, 0xFFFF, 0x0000},  /* 13 */
+    {0x0000, 0xFFFF, 0x0000},  /* 14 */
+    {0x0000, 0xFFFF, 0x0000},  /* 15 */
+    {0x0000, 0xFFFF, 0x0000},  /* 16 */
+    {0x0000, 0xFFFF, 0x0000},  /* 17 */
+    {0x0000, 0xFFFF, 0x0000},  /* 18 */
+    {0x0000, 0xFFFF, 0x0000},  /* 19 */
+    {0x0000, 0xFFFF, 0x0000},  /* 20 */
+    {0x0000, 0xFFFF, 0x0000},  /* 21 */
+    {0x0000, 0xFFFF, 0x0000},  /* 22 */
+    {0x0000, 0xFFFF, 0x0000},  /* 23 */
+    {0x0000, 0xFFFF, 0x0000},  /* 24 */
+    {0x0000, 0xFFFF, 0x0000},  /* 25 */
+    {0x0000, 0xFFFF, 0x0000},  /* 26 */
+    {0x0000, 0xFFFF, 0x0000},  /* 27 */
+    {0x0000, 0xFFFF, 0x0000},  /* 28 */
+    {0x0000, 0xFFFF, 0x0000},  /* 29 */
+    {0x0000, 0xFFFF, 0x0000},  /* 30 */
+    {0x0006, 0x0000, 0x0000},  /* 31 */
+    {0x0009, 0x0000, 0x0000},  /* 32 */
+    {0x0002, 0x0000, 0x0116},  /* 33 */
+    {0x0000, 0x0021, 0x0316},  /* 34 */
+    {0x0007, 0x0000, 0x0000},  /* 35 */
+    {0x0000, 0x001F, 0x0106},  /* 36 */
+    {0x0000, 0x001F, 0x0119},  /* 37 */
+    {0x0000, 0x001F, 0x011B},  /* 38 */
+    {0x0000, 0x0020, 0x011D},  /* 39 */
+    {0x0000, 0x0020, 0x011C},  /* 40 */
+    {0x0008, 0x0023, 0x0000},  /* 41 */
+    {0x0000, 0x0029, 0x054C},  /* 42 */
+};
@@ -24,6 +24,22 @@
 /* USER CODE BEGIN Includes */
 #include "matrix_keyboard.h"
 #include "usb_keyboard.h"
+#include "leader_key.h"
+#include "key_repeat.h"
+#include "mouse_keys.h"
+#include "unicode_input.h"
+#include "uart_log.h"
+#include "blog.h"
+#include "trace.h"
+#include "bench.h"
+#include "latency.h"
+#include "flash_kv.h"
+#include "config_proto.h"
+#include "uart_bridge.h"
+#include "clock_profile.h"
+#include "usb_suspend.h"
+#include "boot_time.h"
+#include "rtos_app.h"
 #include "usbd_hid.h"
 #include <stdio.h>
 /* USER CODE END Includes */
@@ -35,6 +51,8 @@
 
 /* Private define ------------------------------------------------------------*/
 /* USER CODE BEGIN PD */
+/* Banner printed at the first report, or after this long without a host */
+#define BOOT_BANNER_DELAY_MS  500U
 
 /* USER CODE END PD */
 
@@ -45,14 +63,18 @@
 
 /* Private variables ---------------------------------------------------------*/
 UART_HandleTypeDef huart2;
+DMA_HandleTypeDef hdma_usart2_rx;
+DMA_HandleTypeDef hdma_usart2_tx;
 
 /* USER CODE BEGIN PV */
 uint32_t scan_timer = 0;
+static uint8_t banner_printed = 0;
 /* USER CODE END PV */
 
 /* Private function prototypes -----------------------------------------------*/
 void SystemClock_Config(void);
 static void MX_GPIO_Init(void);
+static void MX_DMA_Init(void);
 static void MX_USART2_UART_Init(void);
 /* USER CODE BEGIN PFP */
 
@@ -62,7 +84,7 @@ static void MX_USART2_UART_Init(void);
 /* USER CODE BEGIN 0 */
 
 /**
- * @brief Printf 重定向到 UART
+ * @brief Printf 重定向到 UART (经 uart_log 环形缓冲区 + DMA 发送, 不阻塞)
  */
 #ifdef __GNUC__
 #define PUTCHAR_PROTOTYPE int __io_putchar(int ch)
@@ -71,10 +93,50 @@ static void MX_USART2_UART_Init(void);
 #endif
 
 PUTCHAR_PROTOTYPE {
-  HAL_UART_Transmit(&huart2, (uint8_t *)&ch, 1, HAL_MAX_DELAY);
+  uint8_t c = (uint8_t)ch;
+  UART_Log_Write(&c, 1);
   return ch;
 }
 
+/**
+ * @brief 启动信息, 枚举完成后才打印 (不占用启动路径)
+ */
+static void Print_Banner(void)
+{
+  printf("\r\n===============================================\r\n");
+  printf("   USB Keyboard - STM32F407 @ 168 MHz\r\n");
+  printf("   Matrix: 3x3 (9 keys)\r\n");
+#if UART_BRIDGE_ENABLE
+  printf("   USB: HID Keyboard + CDC (USART2 bridge)\r\n");
+  printf("   Log: ITM/SWO\r\n");
+#else
+  printf("   USB: HID Keyboard + CDC (config port)\r\n");
+  printf("   UART2: 115200 baud\r\n");
+#endif
+  printf("===============================================\r\n\r\n");
+}
+
+/**
+ * @brief 启动信息: 第一个报告之后, 或无主机时延迟打印
+ */
+void App_Banner_Task(void)
+{
+  if (!banner_printed && (Boot_Time_Get(BOOT_STAGE_REPORT) != BOOT_TIME_NONE ||
+                          HAL_GetTick() >= BOOT_BANNER_DELAY_MS)) {
+    banner_printed = 1;
+    Print_Banner();
+  }
+}
+
+/**
+ * @brief 按键, 序列或报告尚未处理完 (时钟档位与 USB 挂起据此判断)
+ */
+uint8_t App_Busy(void)
+{
+  return Matrix_Keyboard_Any_Pressed() || Leader_Is_Active() || Unicode_Is_Busy() ||
+         USB_Keyboard_QueueSpace() < USB_KEYBOARD_QUEUE_LEN;
+}
+
 /* USER CODE END 0 */
 
 /**
@@ -85,7 +147,7 @@ int main(void)
 {
 
   /* USER CODE BEGIN 1 */
-
+  uint8_t busy;
   /* USER CODE END 1 */
 
   /* MCU Configuration--------------------------------------------------------*/
@@ -101,29 +163,64 @@ int main(void)
   SystemClock_Config();
 
   /* USER CODE BEGIN SysInit */
+  Trace_Init();
+  Boot_Time_Mark(BOOT_STAGE_CLOCK);
 
   /* USER CODE END SysInit */
 
   /* Initialize all configured peripherals */
   MX_GPIO_Init();
+  MX_DMA_Init();
   MX_USART2_UART_Init();
-  MX_USB_DEVICE_Init();
   /* USER CODE BEGIN 2 */
 
+  /* Load persisted settings (keymap, debounce, macros) into RAM */
+  FlashKV_Init();
+
   /* Initialize matrix keyboard */
   Matrix_Keyboard_Init();
 
   /* Initialize USB keyboard */
   USB_Keyboard_Init();
 
-  /* Print welcome message */
-  printf("\r\n===============================================\r\n");
-  printf("   USB Keyboard - STM32F407\r\n");
-  printf("   Matrix: 3x3 (9 keys)\r\n");
-  printf("   USB: HID Keyboard\r\n");
-  printf("   UART2: 115200 baud\r\n");
-  printf("===============================================\r\n");
-  printf("Waiting for USB connection...\r\n\r\n");
+  /* Initialize leader-key sequences */
+  Leader_Init();
+
+  /* Initialize per-key auto-repeat / turbo */
+  KeyRepeat_Init();
+
+  /* Initialize mouse keys */
+  Mouse_Keys_Init();
+
+  /* Initialize Unicode input */
+  Unicode_Init();
+
+  /* Start key latency histograms */
+  Latency_Init();
+
+  /* Benchmark firmware (make bench): run the cycle suite once, before the
+   * device is on the bus so none of its reports reaches the host */
+  Bench_Run();
+
+  /* Keys held at power-up are in the state before the host sees the device */
+  Matrix_Keyboard_Boot_Sync();
+  Boot_Time_Mark(BOOT_STAGE_KEYS);
+
+  /* Connect to the bus (generated call disabled in keboard.ioc) */
+  MX_USB_DEVICE_Init();
+  Boot_Time_Mark(BOOT_STAGE_USB);
+
+  /* Bridge firmware (make bridge): CDC port <-> USART2 */
+  UART_Bridge_Init();
+
+  /* Runtime clock profiles, starting at the 168 MHz boot clock */
+  Clock_Profile_Init();
+
+  /* STOP mode and remote wakeup while the bus is suspended */
+  USB_Suspend_Init();
+
+  /* RTOS firmware (make rtos): the tasks take over, never returns */
+  RTOS_App_Start();
 
   /* USER CODE END 2 */
 
@@ -138,6 +235,47 @@ int main(void)
       scan_timer = HAL_GetTick();
       Matrix_Keyboard_Scan();
     }
+
+    /* Resolve timed-out leader sequences */
+    Leader_Task();
+
+    /* Generate due repeat/turbo taps */
+    KeyRepeat_Task();
+
+    /* One mouse-keys step per elapsed USB frame */
+    Mouse_Keys_Task();
+
+    /* Play queued Unicode input sequences */
+    Unicode_Task();
+
+    /* Push queued reports to the host */
+    USB_Keyboard_Task();
+
+    /* Fold finished latency samples, print on request */
+    Latency_Task();
+
+    /* CDC port: configuration requests, or USART2 in the bridge firmware */
+#if UART_BRIDGE_ENABLE
+    UART_Bridge_Task();
+#else
+    Config_Proto_Task();
+#endif
+
+    /* Sector erase stalls flash fetches: only while no key is held */
+    if (!Matrix_Keyboard_Any_Pressed()) {
+      FlashKV_Task();
+    }
+
+    /* Full clock while anything is in progress, scaled down when idle */
+    busy = App_Busy();
+    Clock_Profile_Task(busy);
+
+    /* Suspended bus: STOP mode, remote wakeup on a key press */
+    USB_Suspend_Task(busy);
+
+    /* Start-up output once the host has the first report */
+    App_Banner_Task();
+    Boot_Time_Task();
   }
   /* USER CODE END 3 */
 }
@@ -164,9 +302,9 @@ void SystemClock_Config(void)
   RCC_OscInitStruct.PLL.PLLState = RCC_PLL_ON;
   RCC_OscInitStruct.PLL.PLLSource = RCC_PLLSOURCE_HSE;
   RCC_OscInitStruct.PLL.PLLM = 4;
-  RCC_OscInitStruct.PLL.PLLN = 72;
+  RCC_OscInitStruct.PLL.PLLN = 168;
   RCC_OscInitStruct.PLL.PLLP = RCC_PLLP_DIV2;
-  RCC_OscInitStruct.PLL.PLLQ = 3;
+  RCC_OscInitStruct.PLL.PLLQ = 7;
   if (HAL_RCC_OscConfig(&RCC_OscInitStruct) != HAL_OK)
   {
     Error_Handler();
@@ -178,10 +316,10 @@ void SystemClock_Config(void)
                               |RCC_CLOCKTYPE_PCLK1|RCC_CLOCKTYPE_PCLK2;
   RCC_ClkInitStruct.SYSCLKSource = RCC_SYSCLKSOURCE_PLLCLK;
   RCC_ClkInitStruct.AHBCLKDivider = RCC_SYSCLK_DIV1;
-  RCC_ClkInitStruct.APB1CLKDivider = RCC_HCLK_DIV2;
-  RCC_ClkInitStruct.APB2CLKDivider = RCC_HCLK_DIV1;
+  RCC_ClkInitStruct.APB1CLKDivider = RCC_HCLK_DIV4;
+  RCC_ClkInitStruct.APB2CLKDivider = RCC_HCLK_DIV2;
 
-  if (HAL_RCC_ClockConfig(&RCC_ClkInitStruct, FLASH_LATENCY_2) != HAL_OK)
+  if (HAL_RCC_ClockConfig(&RCC_ClkInitStruct, FLASH_LATENCY_5) != HAL_OK)
   {
     Error_Handler();
   }
@@ -220,6 +358,25 @@ static void MX_USART2_UART_Init(void)
 
 }
 
+/**
+  * Enable DMA controller clock
+  */
+static void MX_DMA_Init(void)
+{
+
+  /* DMA controller clock enable */
+  __HAL_RCC_DMA1_CLK_ENABLE();
+
+  /* DMA interrupt init */
+  /* DMA1_Stream5_IRQn interrupt configuration */
+  HAL_NVIC_SetPriority(DMA1_Stream5_IRQn, 5, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Stream5_IRQn);
+  /* DMA1_Stream6_IRQn interrupt configuration */
+  HAL_NVIC_SetPriority(DMA1_Stream6_IRQn, 5, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Stream6_IRQn);
+
+}
+
 /**
   * @brief GPIO Initialization Function
   * @param None
@@ -263,17 +420,33 @@ static void MX_GPIO_Init(void)
 
 /**
  * @brief Matrix keyboard key callback function
+ * In the RTOS firmware the scan task only queues the transition; the
+ * report task handles it with App_Key_Handle().
  * @param key_code: Key code (0-8)
  * @param pressed: 1 = key pressed, 0 = key released
  * @retval None
  */
 void Matrix_Key_Callback(uint8_t key_code, uint8_t pressed) {
-  const char *key_names[] = {"1", "2", "3", "4", "5", "6", "7", "8", "9"};
+  if (RTOS_App_Post_Key(key_code, pressed)) {
+    return;
+  }
+  App_Key_Handle(key_code, pressed);
+}
+
+/**
+ * @brief Handle a debounced key transition: log it and update the report
+ * @param key_code: Key code (0-8)
+ * @param pressed: 1 = key pressed, 0 = key released
+ * @retval None
+ */
+void App_Key_Handle(uint8_t key_code, uint8_t pressed) {
+  static const char *const key_names[] = {"1", "2", "3", "4", "5", "6", "7", "8", "9"};
 
+  /* Binary log: decode with blog_decode.py */
   if (pressed) {
-    printf("[USB] Key %s pressed\r\n", key_names[key_code]);
+    BLOG("[USB] Key %s pressed\r\n", key_names[key_code]);
   } else {
-    printf("[USB] Key %s released\r\n", key_names[key_code]);
+    BLOG("[USB] Key %s released\r\n", key_names[key_code]);
   }
 
   /* Send to USB HID */
@@ -291,6 +464,7 @@ void Error_Handler(void)
   /* USER CODE BEGIN Error_Handler_Debug */
   /* User can add his own implementation to report the HAL error return state */
   __disable_irq();
+  UART_Log_Flush_Fault();
   while (1) {
   }
   /* USER CODE END Error_Handler_Debug */
@@ -13,11 +13,30 @@
   */
 
 #include "matrix_keyboard.h"
+#include "flash_kv.h"
+#include "latency.h"
+#include "rtos_app.h"
+#include "ram_sections.h"
+#include <string.h>
 
-/* Global variables for keyboard state */
-static uint8_t key_state[KEYBOARD_ROWS][KEYBOARD_COLS] = {0};
-static uint8_t key_state_last[KEYBOARD_ROWS][KEYBOARD_COLS] = {0};
-static uint32_t debounce_timer[KEYBOARD_ROWS][KEYBOARD_COLS] = {0};
+/* Global variables for keyboard state, in CCM: touched on every scan */
+static uint8_t key_state[KEYBOARD_ROWS][KEYBOARD_COLS] CCM_BSS;
+static uint8_t key_state_last[KEYBOARD_ROWS][KEYBOARD_COLS] CCM_BSS;
+static uint32_t debounce_timer[KEYBOARD_ROWS][KEYBOARD_COLS] CCM_BSS;
+static uint8_t debounce_locked[KEYBOARD_ROWS][KEYBOARD_COLS] CCM_BSS;
+static uint16_t debounce_time CCM_DATA = DEBOUNCE_TIME;
+static uint8_t debounce_algo CCM_DATA = DEBOUNCE_ALGO;
+static uint32_t last_scan_time CCM_BSS;
+static uint32_t settle_loops CCM_BSS;
+
+/* Settings changed by another task (RTOS build), applied by the next scan */
+static volatile uint16_t debounce_time_next;
+static volatile uint8_t debounce_algo_next;
+static volatile uint8_t debounce_time_changed = 0;
+static volatile uint8_t debounce_algo_changed = 0;
+
+/* Keys that woke the MCU from STOP (bit n = key n), committed by the scan */
+static volatile uint16_t wake_latch = 0;
 
 /* Row and Column pin definitions */
 static const uint16_t row_pins[KEYBOARD_ROWS] = {ROW_PIN_0, ROW_PIN_1, ROW_PIN_2};
@@ -62,20 +81,170 @@ void Matrix_Keyboard_Init(void)
             key_state[i][j] = 0;
             key_state_last[i][j] = 0;
             debounce_timer[i][j] = 0;
+            debounce_locked[i][j] = 0;
+        }
+    }
+    last_scan_time = HAL_GetTick();
+    Matrix_Keyboard_Clock_Update();
+    debounce_time_changed = 0;
+    debounce_algo_changed = 0;
+    wake_latch = 0;
+    
+    /* Persisted debounce setting overrides DEBOUNCE_TIME and DEBOUNCE_ALGO;
+     * records written before the algorithm was stored only hold the time */
+    uint8_t rec[sizeof(debounce_time) + 1];
+    uint8_t len = FlashKV_Get(KV_ID_DEBOUNCE, rec, sizeof(rec));
+
+    debounce_time = DEBOUNCE_TIME;
+    debounce_algo = DEBOUNCE_ALGO;
+    if (len >= sizeof(debounce_time)) {
+        uint16_t ms;
+
+        memcpy(&ms, rec, sizeof(ms));
+        if (ms <= DEBOUNCE_TIME_MAX) debounce_time = ms;
+    }
+    if (len == sizeof(rec) && rec[sizeof(debounce_time)] <= DEBOUNCE_INTEGRATOR) {
+        debounce_algo = rec[sizeof(debounce_time)];
+    }
+}
+
+/**
+  * @brief Take over debounce settings changed since the previous scan
+  * @retval None
+  */
+static void Matrix_Keyboard_Apply_Settings(void)
+{
+    if (debounce_time_changed) {
+        debounce_time_changed = 0;
+        debounce_time = debounce_time_next;
+    }
+    if (debounce_algo_changed) {
+        debounce_algo_changed = 0;
+        debounce_algo = debounce_algo_next;
+
+        /* Per-key state restarts from the current key states */
+        for (uint8_t i = 0; i < KEYBOARD_ROWS; i++) {
+            for (uint8_t j = 0; j < KEYBOARD_COLS; j++) {
+                debounce_locked[i][j] = 0;
+                debounce_timer[i][j] = (debounce_algo == DEBOUNCE_INTEGRATOR && key_state[i][j]) ? debounce_time : 0;
+            }
+        }
+    }
+}
+
+/**
+  * @brief Commit the keys latched at wake-up as debounced presses
+  * Their release is debounced as usual from this state on.
+  * @param now: Current tick
+  */
+static void Matrix_Keyboard_Apply_Wake_Latch(uint32_t now)
+{
+    uint16_t keys = wake_latch;
+
+    wake_latch = 0;
+    for (uint8_t row = 0; row < KEYBOARD_ROWS; row++) {
+        for (uint8_t col = 0; col < KEYBOARD_COLS; col++) {
+            uint8_t key_code = key_map[row][col];
+
+            if (!(keys & (1U << key_code)) || key_state[row][col]) {
+                continue;
+            }
+            key_state_last[row][col] = 0;
+            key_state[row][col] = 1;
+            debounce_locked[row][col] = (debounce_algo == DEBOUNCE_EAGER);
+            debounce_timer[row][col] = (debounce_algo == DEBOUNCE_INTEGRATOR) ? debounce_time :
+                                       (debounce_algo == DEBOUNCE_EAGER) ? now : 0;
+#if RTOS_ENABLE
+            Matrix_Key_Callback(key_code, 1);
+#else
+            Latency_Debounced(key_code);
+            Matrix_Key_Callback(key_code, 1);
+            Latency_Key_Done();
+#endif
         }
     }
 }
 
+/**
+  * @brief Run the active debounce algorithm on one key
+  * Called by Matrix_Keyboard_Scan() for every sampled key; exported for
+  * the benchmark suite, which feeds it synthetic samples.
+  * @param row: Row index
+  * @param col: Column index
+  * @param raw: Sampled contact state (1 = closed)
+  * @param now: Current tick
+  * @param elapsed: Ticks since the previous scan (integrator only)
+  * @retval 1 if the debounced state changed
+  */
+RAM_FUNC uint8_t Matrix_Keyboard_Debounce_Key(uint8_t row, uint8_t col, uint8_t raw, uint32_t now, uint32_t elapsed)
+{
+    uint32_t *timer = &debounce_timer[row][col];
+    uint8_t state = key_state[row][col];
+
+    switch (debounce_algo) {
+    case DEBOUNCE_EAGER:
+        /* Lockout after an edge: the contact is still bouncing */
+        if (debounce_locked[row][col]) {
+            if ((now - *timer) < debounce_time) return 0;
+            debounce_locked[row][col] = 0;
+        }
+        if (raw == state) return 0;
+        debounce_locked[row][col] = 1;
+        *timer = now;
+        break;
+
+    case DEBOUNCE_INTEGRATOR:
+        /* Counter moves toward the sampled level, saturating at 0 and debounce_time */
+        if (raw) {
+            *timer = (*timer + elapsed < debounce_time) ? *timer + elapsed : debounce_time;
+        } else {
+            *timer = (*timer > elapsed) ? *timer - elapsed : 0;
+        }
+        if (raw == state) return 0;
+        if (raw ? (*timer < debounce_time) : (*timer != 0)) return 0;
+        break;
+
+    default:
+        if (raw == state) {
+            /* State stable, reset debounce timer */
+            *timer = 0;
+            return 0;
+        }
+        /* State changed, start debounce timer */
+        if (*timer == 0) {
+            *timer = now;
+        }
+        /* Check if debounce time has passed */
+        if ((now - *timer) < debounce_time) return 0;
+        *timer = 0;
+        break;
+    }
+
+    key_state_last[row][col] = state;
+    key_state[row][col] = raw;
+    return 1;
+}
+
 /**
   * @brief Scan the matrix keyboard
   * This function should be called periodically (e.g., every 5-10ms)
   * @retval None
   */
-void Matrix_Keyboard_Scan(void)
+RAM_FUNC void Matrix_Keyboard_Scan(void)
 {
     uint8_t col;
     GPIO_PinState pin_state;
     uint32_t current_time = HAL_GetTick();
+    uint32_t elapsed = current_time - last_scan_time;
+    
+    last_scan_time = current_time;
+    
+    if (debounce_time_changed || debounce_algo_changed) {
+        Matrix_Keyboard_Apply_Settings();
+    }
+    if (wake_latch) {
+        Matrix_Keyboard_Apply_Wake_Latch(current_time);
+    }
     
     /* Scan each row */
     for (uint8_t row = 0; row < KEYBOARD_ROWS; row++) {
@@ -89,7 +258,7 @@ void Matrix_Keyboard_Scan(void)
         }
         
         /* Small delay for signal stabilization */
-        for (volatile uint32_t i = 0; i < 100; i++);
+        for (volatile uint32_t i = 0; i < settle_loops; i++);
         
         /* Read each column */
         for (col = 0; col < KEYBOARD_COLS; col++) {
@@ -97,30 +266,22 @@ void Matrix_Keyboard_Scan(void)
             
             /* With pull-up: GPIO_PIN_RESET (0) = pressed, GPIO_PIN_SET (1) = not pressed */
             uint8_t current_state = (pin_state == GPIO_PIN_RESET) ? 1 : 0;
+            uint8_t key_code = key_map[row][col];
             
-            /* Debounce logic */
             if (current_state != key_state[row][col]) {
-                /* State changed, start debounce timer */
-                if (debounce_timer[row][col] == 0) {
-                    debounce_timer[row][col] = current_time;
-                }
-                
-                /* Check if debounce time has passed */
-                if ((current_time - debounce_timer[row][col]) >= DEBOUNCE_TIME) {
-                    /* State is stable, update key state */
-                    key_state_last[row][col] = key_state[row][col];
-                    key_state[row][col] = current_state;
-                    debounce_timer[row][col] = 0;
-                    
-                    /* Call callback if state changed */
-                    if (key_state[row][col] != key_state_last[row][col]) {
-                        uint8_t key_code = key_map[row][col];
-                        Matrix_Key_Callback(key_code, key_state[row][col]);
-                    }
-                }
-            } else {
-                /* State stable, reset debounce timer */
-                debounce_timer[row][col] = 0;
+                Latency_Edge(key_code);
+            }
+            
+            /* Debounce logic, call callback if state changed */
+            if (Matrix_Keyboard_Debounce_Key(row, col, current_state, current_time, elapsed)) {
+#if RTOS_ENABLE
+                /* RTOS_App_Post_Key() stamps it into the key queue message */
+                Matrix_Key_Callback(key_code, key_state[row][col]);
+#else
+                Latency_Debounced(key_code);
+                Matrix_Key_Callback(key_code, key_state[row][col]);
+                Latency_Key_Done();
+#endif
             }
         }
     }
@@ -131,6 +292,97 @@ void Matrix_Keyboard_Scan(void)
     }
 }
 
+/**
+  * @brief Sample the whole matrix once, no debouncing
+  * @retval Bit n set = key n closed
+  */
+static uint16_t Matrix_Keyboard_Read_Raw(void)
+{
+    uint16_t raw = 0;
+
+    for (uint8_t row = 0; row < KEYBOARD_ROWS; row++) {
+        HAL_GPIO_WritePin(ROW_PORT, row_pins[row], GPIO_PIN_RESET);
+        for (volatile uint32_t i = 0; i < settle_loops; i++);
+
+        for (uint8_t col = 0; col < KEYBOARD_COLS; col++) {
+            if (HAL_GPIO_ReadPin(COL_PORT, col_pins[col]) == GPIO_PIN_RESET) {
+                raw |= (uint16_t)(1U << key_map[row][col]);
+            }
+        }
+        HAL_GPIO_WritePin(ROW_PORT, row_pins[row], GPIO_PIN_SET);
+    }
+    return raw;
+}
+
+/**
+  * @brief Take over the keys held at power-up, call once after
+  * Matrix_Keyboard_Init() and before USB enumeration
+  * Samples the matrix once per millisecond until MATRIX_BOOT_STABLE
+  * samples in a row agree (at most MATRIX_BOOT_SAMPLES), then commits the
+  * held keys as debounced presses through Matrix_Key_Callback(). The
+  * first report after enumeration then carries them, instead of waiting
+  * for a scan and a full debounce period. Needs SysTick running.
+  * @retval Number of keys held
+  */
+uint8_t Matrix_Keyboard_Boot_Sync(void)
+{
+    uint16_t raw = Matrix_Keyboard_Read_Raw();
+    uint8_t stable = 1;
+    uint8_t held = 0;
+
+    for (uint8_t n = 1; n < MATRIX_BOOT_SAMPLES && stable < MATRIX_BOOT_STABLE; n++) {
+        uint32_t tick = HAL_GetTick();
+        uint16_t sample;
+
+        while (HAL_GetTick() == tick);
+        sample = Matrix_Keyboard_Read_Raw();
+        stable = (sample == raw) ? (uint8_t)(stable + 1U) : 1U;
+        raw = sample;
+    }
+    if (stable < MATRIX_BOOT_STABLE) {
+        return 0;   /* Still bouncing: the regular scan debounces it */
+    }
+
+    for (uint8_t row = 0; row < KEYBOARD_ROWS; row++) {
+        for (uint8_t col = 0; col < KEYBOARD_COLS; col++) {
+            uint8_t key_code = key_map[row][col];
+
+            if (!(raw & (1U << key_code))) {
+                continue;
+            }
+            key_state_last[row][col] = 0;
+            key_state[row][col] = 1;
+            debounce_locked[row][col] = 0;
+            debounce_timer[row][col] = (debounce_algo == DEBOUNCE_INTEGRATOR) ? debounce_time : 0;
+            Matrix_Key_Callback(key_code, 1);
+            held++;
+        }
+    }
+    last_scan_time = HAL_GetTick();
+    return held;
+}
+
+/**
+  * @brief Latch the keys that woke the MCU from STOP mode
+  * Call right after the wake-up, interrupts may still be masked. Samples
+  * the matrix MATRIX_WAKE_SAMPLES times; every key seen closed is
+  * committed as a debounced press at the start of the next scan (like a
+  * debounce setting change), so a tap shorter than the debounce time
+  * still produces a keystroke. Keys already pressed are left alone.
+  * @retval Keys seen closed (bit n = key n)
+  */
+uint16_t Matrix_Keyboard_Wake_Latch(void)
+{
+    uint16_t raw = 0;
+
+    /* The contact may still be bouncing: any closure counts */
+    for (uint8_t n = 0; n < MATRIX_WAKE_SAMPLES; n++) {
+        raw |= Matrix_Keyboard_Read_Raw();
+    }
+    wake_latch |= raw;
+    return raw;
+}
+
 /**
   * @brief Get the status of a specific key
   * @param row: Row index (0-2)
@@ -145,6 +397,99 @@ uint8_t Matrix_Get_Key_Status(uint8_t row, uint8_t col)
     return 0;
 }
 
+/**
+  * @brief Check whether any key is currently pressed
+  * @retval 1 = at least one key pressed, 0 = all released
+  */
+uint8_t Matrix_Keyboard_Any_Pressed(void)
+{
+    for (uint8_t i = 0; i < KEYBOARD_ROWS; i++) {
+        for (uint8_t j = 0; j < KEYBOARD_COLS; j++) {
+            if (key_state[i][j]) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+  * @brief Change the debounce time and persist it with the algorithm
+  * Takes effect on the next scan, no reflash needed. In the RTOS build
+  * the scan task picks it up at the start of its next pass, so a change
+  * from another task never lands in the middle of a scan. The record also
+  * holds the algorithm selected so far, so select it first.
+  * @param ms: Debounce time in milliseconds (up to DEBOUNCE_TIME_MAX)
+  * @retval HAL status of the flash write, HAL_ERROR if out of range
+  */
+HAL_StatusTypeDef Matrix_Keyboard_Set_Debounce(uint16_t ms)
+{
+    if (ms > DEBOUNCE_TIME_MAX) return HAL_ERROR;
+
+    debounce_time_next = ms;
+    debounce_time_changed = 1;
+#if !RTOS_ENABLE
+    Matrix_Keyboard_Apply_Settings();
+#endif
+
+    uint8_t rec[sizeof(ms) + 1];
+
+    memcpy(rec, &ms, sizeof(ms));
+    rec[sizeof(ms)] = Matrix_Keyboard_Get_Debounce_Algo();
+    return FlashKV_Set(KV_ID_DEBOUNCE, rec, sizeof(rec));
+}
+
+/**
+  * @brief Get the debounce time, including a change not yet applied
+  * @retval Debounce time in milliseconds
+  */
+uint16_t Matrix_Keyboard_Get_Debounce(void)
+{
+    return debounce_time_changed ? debounce_time_next : debounce_time;
+}
+
+/**
+  * @brief Select the debounce algorithm
+  * Per-key debounce state is restarted from the current key states; in
+  * the RTOS build by the scan task, at the start of its next pass. Only
+  * persisted by the next Matrix_Keyboard_Set_Debounce().
+  * @param algo: DEBOUNCE_DEFER, DEBOUNCE_EAGER or DEBOUNCE_INTEGRATOR
+  * @retval HAL_ERROR for an unknown algorithm, else HAL_OK
+  */
+HAL_StatusTypeDef Matrix_Keyboard_Set_Debounce_Algo(uint8_t algo)
+{
+    if (algo > DEBOUNCE_INTEGRATOR) return HAL_ERROR;
+
+    debounce_algo_next = algo;
+    debounce_algo_changed = 1;
+#if !RTOS_ENABLE
+    Matrix_Keyboard_Apply_Settings();
+#endif
+    return HAL_OK;
+}
+
+/**
+  * @brief Get the debounce algorithm, including a change not yet applied
+  * @retval DEBOUNCE_DEFER, DEBOUNCE_EAGER or DEBOUNCE_INTEGRATOR
+  */
+uint8_t Matrix_Keyboard_Get_Debounce_Algo(void)
+{
+    return debounce_algo_changed ? debounce_algo_next : debounce_algo;
+}
+
+/**
+  * @brief Recompute the row settle delay, call after SystemCoreClock changes
+  * @retval None
+  */
+void Matrix_Keyboard_Clock_Update(void)
+{
+#if MATRIX_SETTLE_US > 0
+    settle_loops = MATRIX_SETTLE_US * (SystemCoreClock / 1000000U) / MATRIX_SETTLE_LOOP_CYCLES;
+#else
+    settle_loops = 0;
+#endif
+}
+
 /**
   * @brief Callback function for key press/release events
   * This function should be overridden by user application
@@ -0,0 +1,275 @@
+/**
+  ******************************************************************************
+  * @file           : mouse_keys.c
+  * @brief          : Mouse emulation from matrix keys implementation
+  *
+  * All arithmetic is fixed point: speed and direction are Q15, the
+  * per-axis sub-pixel accumulators hold Q15 pixels in a q31_t. The held
+  * direction keys form a Q15 unit vector that is scaled by the current
+  * speed with arm_scale_q15() (CMSIS-DSP), then by MOUSE_MAX_SPEED.
+  * Mouse_Keys_Task() runs one step per elapsed USB frame.
+  ******************************************************************************
+  */
+
+#include "mouse_keys.h"
+#include "usb_keyboard.h"
+#include "arm_math.h"
+
+#define Q15_ONE          0x7FFF
+#define Q15_INV_SQRT2    0x5A82   /* Diagonal moves keep the same speed */
+
+#define MS_BIT(code)     (1U << ((code) - KEY_MS_UP))
+#define MS_HELD(code)    ((held_keys & MS_BIT(code)) ? 1 : 0)
+
+/* Key state */
+static uint16_t held_keys = 0;
+static uint8_t buttons = 0;
+static uint8_t buttons_sent = 0;
+
+/* Motion state, shared by all direction keys */
+static uint8_t profile = MOUSE_KEYS_PROFILE;
+static uint8_t moving = 0;
+static q15_t speed = MOUSE_START_SPEED;
+static q31_t axis_acc[2] = {0};
+static q31_t wheel_acc = 0;
+
+/* Motion computed but not yet accepted by the USB layer */
+static int16_t carry_x = 0;
+static int16_t carry_y = 0;
+static int16_t carry_wheel = 0;
+
+static uint32_t last_frame = 0;
+
+/**
+  * @brief Take whole units out of a Q15 accumulator
+  * @param acc: Accumulator, keeps the fractional remainder
+  * @retval Whole units, rounded toward zero
+  */
+static int16_t Mouse_Keys_Take(q31_t *acc)
+{
+    int16_t whole = (int16_t)(*acc / (1 << 15));
+
+    *acc -= (q31_t)whole << 15;
+    return whole;
+}
+
+/**
+  * @brief Add motion to a carry, bounded so a stalled host cannot overflow it
+  * @param carry: Carry to update
+  * @param delta: Motion to add
+  * @retval None
+  */
+static void Mouse_Keys_Carry(int16_t *carry, int16_t delta)
+{
+    int32_t sum = (int32_t)*carry + delta;
+
+    if (sum > 1024) sum = 1024;
+    if (sum < -1024) sum = -1024;
+    *carry = (int16_t)sum;
+}
+
+/**
+  * @brief Advance the acceleration curve by one frame
+  * @retval None
+  */
+static void Mouse_Keys_Accelerate(void)
+{
+    switch (profile) {
+        case MOUSE_PROFILE_LINEAR:
+            speed = clip_q31_to_q15((q31_t)speed + MOUSE_LINEAR_STEP);
+            break;
+        case MOUSE_PROFILE_EXPONENTIAL:
+            speed = clip_q31_to_q15((q31_t)speed + (((q31_t)speed * MOUSE_EXP_GROWTH) >> 15));
+            break;
+        default:
+            speed = Q15_ONE;
+            break;
+    }
+}
+
+/**
+  * @brief Compute one USB frame of movement
+  * @retval None
+  */
+static void Mouse_Keys_Step(void)
+{
+    int8_t x_dir = MS_HELD(KEY_MS_RIGHT) - MS_HELD(KEY_MS_LEFT);
+    int8_t y_dir = MS_HELD(KEY_MS_DOWN) - MS_HELD(KEY_MS_UP);
+    int8_t w_dir = MS_HELD(KEY_MS_WH_UP) - MS_HELD(KEY_MS_WH_DOWN);
+    q15_t dir[2];
+    q15_t vel[2];
+    q15_t scale;
+
+    if (x_dir == 0 && y_dir == 0) {
+        moving = 0;
+        speed = (profile == MOUSE_PROFILE_CONSTANT) ? Q15_ONE : MOUSE_START_SPEED;
+        axis_acc[0] = 0;
+        axis_acc[1] = 0;
+    } else {
+        dir[0] = (q15_t)(x_dir * Q15_ONE);
+        dir[1] = (q15_t)(y_dir * Q15_ONE);
+
+        /* Preload so the first frame of a move always yields one pixel */
+        if (!moving) {
+            moving = 1;
+            axis_acc[0] = (q31_t)dir[0];
+            axis_acc[1] = (q31_t)dir[1];
+        }
+
+        scale = speed;
+        if (x_dir != 0 && y_dir != 0) {
+            scale = (q15_t)(((q31_t)speed * Q15_INV_SQRT2) >> 15);
+        }
+        arm_scale_q15(dir, scale, 0, vel, 2);
+
+        axis_acc[0] += (q31_t)vel[0] * MOUSE_MAX_SPEED;
+        axis_acc[1] += (q31_t)vel[1] * MOUSE_MAX_SPEED;
+        Mouse_Keys_Carry(&carry_x, Mouse_Keys_Take(&axis_acc[0]));
+        Mouse_Keys_Carry(&carry_y, Mouse_Keys_Take(&axis_acc[1]));
+
+        Mouse_Keys_Accelerate();
+    }
+
+    if (w_dir == 0) {
+        wheel_acc = 0;
+    } else {
+        wheel_acc += (q31_t)w_dir * MOUSE_WHEEL_SPEED;
+        Mouse_Keys_Carry(&carry_wheel, Mouse_Keys_Take(&wheel_acc));
+    }
+}
+
+/**
+  * @brief Clip a carry to the range of one report field
+  * @param carry: Pending motion
+  * @retval Value for the report
+  */
+static int8_t Mouse_Keys_Clip(int16_t carry)
+{
+    if (carry > 127) return 127;
+    if (carry < -127) return -127;
+    return (int8_t)carry;
+}
+
+/**
+  * @brief Initialize mouse keys
+  * @retval None
+  */
+void Mouse_Keys_Init(void)
+{
+    held_keys = 0;
+    buttons = 0;
+    buttons_sent = 0;
+    moving = 0;
+    speed = (profile == MOUSE_PROFILE_CONSTANT) ? Q15_ONE : MOUSE_START_SPEED;
+    axis_acc[0] = 0;
+    axis_acc[1] = 0;
+    wheel_acc = 0;
+    carry_x = 0;
+    carry_y = 0;
+    carry_wheel = 0;
+    last_frame = USB_Keyboard_GetFrame();
+}
+
+/**
+  * @brief Feed a key event to mouse keys
+  * @param key_code: HID keyboard code (KEY_MS_* are handled here)
+  * @param pressed: 1 = key pressed, 0 = key released
+  * @retval 1 if the event was consumed, 0 if it should be handled normally
+  */
+uint8_t Mouse_Keys_Process_Key(uint8_t key_code, uint8_t pressed)
+{
+    uint8_t button = 0;
+
+    if (key_code < KEY_MS_UP || key_code > KEY_MS_WH_DOWN) {
+        return 0;
+    }
+
+    if (pressed) {
+        held_keys |= MS_BIT(key_code);
+    } else {
+        held_keys &= ~MS_BIT(key_code);
+    }
+
+    switch (key_code) {
+        case KEY_MS_BTN1: button = MOUSE_BTN_LEFT;   break;
+        case KEY_MS_BTN2: button = MOUSE_BTN_RIGHT;  break;
+        case KEY_MS_BTN3: button = MOUSE_BTN_MIDDLE; break;
+        case KEY_MS_WH_UP:
+        case KEY_MS_WH_DOWN:
+            /* First wheel step goes out on the next frame */
+            if (pressed) {
+                wheel_acc = (key_code == KEY_MS_WH_UP) ? ((1 << 15) - MOUSE_WHEEL_SPEED)
+                                                       : -((1 << 15) - MOUSE_WHEEL_SPEED);
+            }
+            break;
+        default:
+            break;
+    }
+
+    if (button) {
+        buttons = pressed ? (buttons | button) : (buttons & ~button);
+    }
+
+    return 1;
+}
+
+/**
+  * @brief Run the elapsed USB frames and send the resulting report
+  * Call from the main loop.
+  * @retval None
+  */
+void Mouse_Keys_Task(void)
+{
+    uint32_t now = USB_Keyboard_GetFrame();
+    uint32_t frames = now - last_frame;
+    int8_t x, y, wheel;
+
+    if (frames == 0) {
+        return;
+    }
+    last_frame = now;
+
+    if (frames > MOUSE_MAX_CATCHUP) {
+        frames = MOUSE_MAX_CATCHUP;
+    }
+    while (frames--) {
+        Mouse_Keys_Step();
+    }
+
+    if (carry_x == 0 && carry_y == 0 && carry_wheel == 0 && buttons == buttons_sent) {
+        return;
+    }
+
+    x = Mouse_Keys_Clip(carry_x);
+    y = Mouse_Keys_Clip(carry_y);
+    wheel = Mouse_Keys_Clip(carry_wheel);
+
+    /* Busy: keep everything in the carry and retry on the next frame */
+    if (USB_Keyboard_SendMouseReport(buttons, x, y, wheel) == HAL_OK) {
+        carry_x -= x;
+        carry_y -= y;
+        carry_wheel -= wheel;
+        buttons_sent = buttons;
+    }
+}
+
+/**
+  * @brief Select the acceleration profile
+  * @param new_profile: MOUSE_PROFILE_CONSTANT, _LINEAR or _EXPONENTIAL
+  * @retval None
+  */
+void Mouse_Keys_Set_Profile(uint8_t new_profile)
+{
+    if (new_profile > MOUSE_PROFILE_EXPONENTIAL) return;
+
+    profile = new_profile;
+}
+
+/**
+  * @brief Get the acceleration profile
+  * @retval Current profile
+  */
+uint8_t Mouse_Keys_Get_Profile(void)
+{
+    return profile;
+}
@@ -0,0 +1,384 @@
+/**
+  ******************************************************************************
+  * @file           : rtos_app.c
+  * @brief          : CMSIS-RTOS2 task layout implementation
+  *
+  * Everything the super loop in main() does is split over the tasks by
+  * who has to wait for whom: the scan task owns the matrix and never
+  * blocks on anything but its period; the report task owns the HID state
+  * (report queue, leader, repeat, mouse, Unicode) and holds hid_mutex
+  * while it works; the cdc and log tasks take the same mutex for anything
+  * that reads or changes that state or the settings. Key transitions
+  * cross from scan to report in key_queue together with their latency
+  * stamps, so the latency histograms keep measuring edge to IN complete;
+  * the scan fills the stamps straight into the message and never touches
+  * the transition the report task is handling.
+  ******************************************************************************
+  */
+
+#include "rtos_app.h"
+
+#if RTOS_ENABLE
+
+#include "cmsis_os2.h"
+#include "main.h"
+#include "matrix_keyboard.h"
+#include "usb_keyboard.h"
+#include "leader_key.h"
+#include "key_repeat.h"
+#include "mouse_keys.h"
+#include "unicode_input.h"
+#include "latency.h"
+#include "flash_kv.h"
+#include "config_proto.h"
+#include "uart_bridge.h"
+#include "clock_profile.h"
+#include "usb_suspend.h"
+#include "boot_time.h"
+#include <stdio.h>
+
+/* app_events bits */
+#define RTOS_EVT_KEY        0x01U   /* Transition queued for the report task */
+#define RTOS_EVT_IN_DONE    0x02U   /* IN transfer complete, endpoint free */
+#define RTOS_EVT_CDC_RX     0x04U   /* CDC OUT packet received */
+
+/* Debounced transition, scan task -> report task */
+typedef struct {
+    uint8_t key_code;
+    uint8_t pressed;
+    Latency_Key_Stamp_t stamp;
+} RTOS_Key_Msg_t;
+
+/* FreeRTOS port tick (USE_CUSTOM_SYSTICK_HANDLER_IMPLEMENTATION) */
+extern void xPortSysTickHandler(void);
+
+static void RTOS_Scan_Task(void *argument);
+static void RTOS_Report_Task(void *argument);
+static void RTOS_Cdc_Task(void *argument);
+static void RTOS_Log_Task(void *argument);
+
+static const osThreadFunc_t task_funcs[RTOS_TASKS] = {
+    RTOS_Scan_Task, RTOS_Report_Task, RTOS_Cdc_Task, RTOS_Log_Task
+};
+
+static const osThreadAttr_t task_attrs[RTOS_TASKS] = {
+    { .name = "scan",   .stack_size = 512U,  .priority = osPriorityRealtime },
+    { .name = "report", .stack_size = 1024U, .priority = osPriorityHigh },
+    { .name = "cdc",    .stack_size = 1024U, .priority = osPriorityNormal },
+    { .name = "log",    .stack_size = 1536U, .priority = osPriorityLow },
+};
+
+static const osMutexAttr_t hid_mutex_attr = {
+    .name = "hid", .attr_bits = osMutexPrioInherit
+};
+
+static osThreadId_t task_ids[RTOS_TASKS];
+static osMessageQueueId_t key_queue = NULL;
+static osEventFlagsId_t app_events = NULL;
+static osMutexId_t hid_mutex = NULL;
+
+static RTOS_Task_Stats_t task_stats[RTOS_TASKS];
+static uint32_t dump_cycles[RTOS_TASKS];       /* task_stats[].cycles at the last dump */
+static uint32_t dump_start = 0;                 /* DWT->CYCCNT at the last dump */
+static uint32_t key_drops = 0;
+static volatile uint8_t dump_requested = 0;
+
+/**
+  * @brief Whether the scheduler runs (thread or interrupt context)
+  */
+static uint8_t RTOS_Running(void)
+{
+    osKernelState_t state = osKernelGetState();
+
+    return (state == osKernelRunning || state == osKernelLocked);
+}
+
+/**
+  * @brief Account one work pass of a task
+  * @param task: RTOS_TASK_*
+  * @param start: DWT->CYCCNT at the start of the pass
+  */
+static void RTOS_Pass_End(uint8_t task, uint32_t start)
+{
+    RTOS_Task_Stats_t *s = &task_stats[task];
+    uint32_t cycles = DWT->CYCCNT - start;
+
+    s->runs++;
+    s->cycles += cycles;
+    if (cycles > s->max_cycles) {
+        s->max_cycles = cycles;
+    }
+}
+
+/**
+  * @brief Wait for the next period; after STOP mode, restart from now
+  * @param next: Tick of the previous period, advanced by period
+  * @param period: Ticks
+  */
+static void RTOS_Delay_Period(uint32_t *next, uint32_t period)
+{
+    *next += period;
+    if (osDelayUntil(*next) != osOK) {
+        *next = osKernelGetTickCount();
+    }
+}
+
+/**
+  * @brief Matrix scan, highest priority, takes no lock
+  */
+static void RTOS_Scan_Task(void *argument)
+{
+    uint32_t next = osKernelGetTickCount();
+
+    (void)argument;
+    for (;;) {
+        RTOS_Delay_Period(&next, RTOS_SCAN_PERIOD_MS);
+
+        uint32_t start = DWT->CYCCNT;
+        Matrix_Keyboard_Scan();
+        RTOS_Pass_End(RTOS_TASK_SCAN, start);
+    }
+}
+
+/**
+  * @brief Key handling and report generation
+  * The 1 ms timeout paces leader timeouts, repeat, mouse keys and Unicode
+  * playback like the super loop did.
+  */
+static void RTOS_Report_Task(void *argument)
+{
+    RTOS_Key_Msg_t msg;
+
+    (void)argument;
+    for (;;) {
+        (void)osEventFlagsWait(app_events, RTOS_EVT_KEY | RTOS_EVT_IN_DONE, osFlagsWaitAny, 1U);
+
+        uint32_t start = DWT->CYCCNT;
+        (void)osMutexAcquire(hid_mutex, osWaitForever);
+        while (osMessageQueueGet(key_queue, &msg, NULL, 0U) == osOK) {
+            Latency_Key_Restore(&msg.stamp);
+            App_Key_Handle(msg.key_code, msg.pressed);
+            Latency_Key_Done();
+        }
+        Leader_Task();
+        KeyRepeat_Task();
+        Mouse_Keys_Task();
+        Unicode_Task();
+        USB_Keyboard_Task();
+        (void)osMutexRelease(hid_mutex);
+        RTOS_Pass_End(RTOS_TASK_REPORT, start);
+    }
+}
+
+/**
+  * @brief CDC port: configuration requests, or USART2 in the bridge firmware
+  */
+static void RTOS_Cdc_Task(void *argument)
+{
+    (void)argument;
+    for (;;) {
+        (void)osEventFlagsWait(app_events, RTOS_EVT_CDC_RX, osFlagsWaitAny, RTOS_CDC_POLL_MS);
+
+        uint32_t start = DWT->CYCCNT;
+#if UART_BRIDGE_ENABLE
+        UART_Bridge_Task();
+#else
+        (void)osMutexAcquire(hid_mutex, osWaitForever);
+        Config_Proto_Task();
+        (void)osMutexRelease(hid_mutex);
+#endif
+        RTOS_Pass_End(RTOS_TASK_CDC, start);
+    }
+}
+
+/**
+  * @brief Log output and housekeeping, lowest priority
+  */
+static void RTOS_Log_Task(void *argument)
+{
+    uint32_t next = osKernelGetTickCount();
+    uint8_t busy;
+
+    (void)argument;
+    for (;;) {
+        RTOS_Delay_Period(&next, RTOS_LOG_PERIOD_MS);
+
+        uint32_t start = DWT->CYCCNT;
+        (void)osMutexAcquire(hid_mutex, osWaitForever);
+        Latency_Task();
+        /* Sector erase stalls flash fetches: only while no key is held */
+        if (!Matrix_Keyboard_Any_Pressed()) {
+            FlashKV_Task();
+        }
+        busy = App_Busy();
+        Clock_Profile_Task(busy);
+        USB_Suspend_Task(busy);
+        (void)osMutexRelease(hid_mutex);
+
+        App_Banner_Task();
+        Boot_Time_Task();
+        if (dump_requested) {
+            dump_requested = 0;
+            RTOS_App_Dump();
+        }
+        RTOS_Pass_End(RTOS_TASK_LOG, start);
+    }
+}
+
+/**
+  * @brief Create the tasks and start the kernel, call at the end of
+  * initialization instead of entering the super loop
+  * @retval None (does not return)
+  */
+void RTOS_App_Start(void)
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    /* The OTG callbacks set event flags */
+    HAL_NVIC_SetPriority(OTG_FS_IRQn, RTOS_IRQ_PRIO, 0);
+
+    if (osKernelInitialize() != osOK) {
+        Error_Handler();
+    }
+    key_queue = osMessageQueueNew(RTOS_KEY_QUEUE_LEN, sizeof(RTOS_Key_Msg_t), NULL);
+    app_events = osEventFlagsNew(NULL);
+    hid_mutex = osMutexNew(&hid_mutex_attr);
+    if (key_queue == NULL || app_events == NULL || hid_mutex == NULL) {
+        Error_Handler();
+    }
+
+    for (uint8_t i = 0; i < RTOS_TASKS; i++) {
+        task_ids[i] = osThreadNew(task_funcs[i], NULL, &task_attrs[i]);
+        if (task_ids[i] == NULL) {
+            Error_Handler();
+        }
+        task_stats[i].stack_size = task_attrs[i].stack_size;
+        task_stats[i].stack_free_min = task_attrs[i].stack_size;
+    }
+    dump_start = DWT->CYCCNT;
+
+    (void)osKernelStart();
+    Error_Handler();
+}
+
+/**
+  * @brief Hand a debounced transition to the report task (scan task)
+  * @param key_code: Matrix key code
+  * @param pressed: 1 = pressed, 0 = released
+  * @retval 1 if queued (or dropped), 0 before the kernel runs: handle it now
+  */
+uint8_t RTOS_App_Post_Key(uint8_t key_code, uint8_t pressed)
+{
+    RTOS_Key_Msg_t msg;
+
+    if (!RTOS_Running()) {
+        return 0;   /* Matrix_Keyboard_Boot_Sync() */
+    }
+
+    msg.key_code = key_code;
+    msg.pressed = pressed;
+    Latency_Debounced_Stamp(key_code, &msg.stamp);
+    if (osMessageQueuePut(key_queue, &msg, 0U, 0U) != osOK) {
+        key_drops++;
+        return 1;
+    }
+    (void)osEventFlagsSet(app_events, RTOS_EVT_KEY);
+    return 1;
+}
+
+/**
+  * @brief IN transfer complete (USB interrupt context)
+  * @retval None
+  */
+void RTOS_App_In_Complete(void)
+{
+    if (RTOS_Running()) {
+        (void)osEventFlagsSet(app_events, RTOS_EVT_IN_DONE);
+    }
+}
+
+/**
+  * @brief CDC OUT packet received (USB interrupt context)
+  * @retval None
+  */
+void RTOS_App_Cdc_Rx(void)
+{
+    if (RTOS_Running()) {
+        (void)osEventFlagsSet(app_events, RTOS_EVT_CDC_RX);
+    }
+}
+
+/**
+  * @brief Kernel tick, called from SysTick_Handler() after HAL_IncTick()
+  * @retval None
+  */
+void RTOS_App_Tick(void)
+{
+    if (RTOS_Running()) {
+        xPortSysTickHandler();
+    }
+}
+
+/**
+  * @brief Ask the log task to print the task statistics (any context)
+  * @retval None
+  */
+void RTOS_App_Request_Dump(void)
+{
+    dump_requested = 1;
+}
+
+/**
+  * @brief Print load since the previous dump, longest pass and stack use
+  * per task (thread context)
+  * @retval None
+  */
+void RTOS_App_Dump(void)
+{
+    uint32_t now = DWT->CYCCNT;
+    uint32_t window = now - dump_start;
+    uint32_t per_us = SystemCoreClock / 1000000U;
+
+    if (window == 0U) window = 1U;
+    printf("[RTOS] task        runs  load%%   max_us  stack used/size\r\n");
+    for (uint8_t i = 0; i < RTOS_TASKS; i++) {
+        const RTOS_Task_Stats_t *s = RTOS_App_Get_Stats(i);
+        uint32_t busy = s->cycles - dump_cycles[i];
+
+        printf("[RTOS] %-8s %9lu %6lu %8lu %6lu/%lu\r\n", task_attrs[i].name,
+               (unsigned long)s->runs, (unsigned long)((uint64_t)busy * 100U / window),
+               (unsigned long)(s->max_cycles / per_us),
+               (unsigned long)(s->stack_size - s->stack_free_min), (unsigned long)s->stack_size);
+        dump_cycles[i] = s->cycles;
+    }
+    printf("[RTOS] key queue drops %lu\r\n", (unsigned long)key_drops);
+    dump_start = now;
+}
+
+/**
+  * @brief Counters of a task, stack low-water mark refreshed (thread context)
+  * @param task: RTOS_TASK_*
+  * @retval Counters since boot, NULL for an unknown task
+  */
+const RTOS_Task_Stats_t *RTOS_App_Get_Stats(uint8_t task)
+{
+    if (task >= RTOS_TASKS) {
+        return NULL;
+    }
+    if (task_ids[task] != NULL) {
+        task_stats[task].stack_free_min = osThreadGetStackSpace(task_ids[task]);
+    }
+    return &task_stats[task];
+}
+
+/**
+  * @brief Transitions lost because the key queue was full
+  * @retval Count since boot
+  */
+uint32_t RTOS_App_Get_Key_Drops(void)
+{
+    return key_drops;
+}
+
+#endif /* RTOS_ENABLE */
@@ -0,0 +1,186 @@
+/**
+  ******************************************************************************
+  * @file           : trace.c
+  * @brief          : ITM/SWO event trace implementation
+  *
+  * A stimulus port reads as non-zero when its FIFO can take a write. The
+  * first packet of an event is only written if the port is ready right
+  * away; the continuation words of a multi-word event may wait up to
+  * TRACE_SPIN polls so an event is not cut in half.
+  ******************************************************************************
+  */
+
+#include "trace.h"
+
+#if TRACE_ENABLE
+
+#define TRACE_SPIN    64U
+
+/* Packets dropped because the ITM FIFO was full */
+static volatile uint32_t trace_dropped = 0;
+
+/**
+  * @brief Check that tracing is on and the stimulus port can take a write
+  * @param port: Stimulus port
+  * @param spin: Number of extra polls allowed
+  * @retval 1 if a write can be issued, 0 otherwise
+  */
+static uint8_t Trace_Ready(uint8_t port, uint32_t spin)
+{
+    if ((ITM->TCR & ITM_TCR_ITMENA_Msk) == 0U || (ITM->TER & (1UL << port)) == 0U) {
+        return 0;   /* Disabled: not a drop */
+    }
+
+    while (ITM->PORT[port].u32 == 0U) {
+        if (spin-- == 0U) {
+            trace_dropped++;
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+  * @brief Enable the ITM, local timestamps and (optionally) SWO output
+  * Call after SystemClock_Config(): the SWO prescaler depends on HCLK.
+  * @retval None
+  */
+void Trace_Init(void)
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+
+#if TRACE_SWO_SETUP
+    /* Asynchronous trace on PB3, NRZ (UART) encoding, formatter bypassed */
+    DBGMCU->CR = (DBGMCU->CR & ~DBGMCU_CR_TRACE_MODE) | DBGMCU_CR_TRACE_IOEN;
+    TPI->SPPR = 2U;
+    TPI->ACPR = (SystemCoreClock / TRACE_SWO_BAUD) - 1U;
+    TPI->FFCR = 0x100U;
+#endif
+
+    ITM->LAR = 0xC5ACCE55U;
+    ITM->TCR = (1UL << ITM_TCR_TraceBusID_Pos) | ITM_TCR_TSENA_Msk |
+               ITM_TCR_SYNCENA_Msk | ITM_TCR_ITMENA_Msk;
+    ITM->TPR = 0U;
+    ITM->TER = (1UL << TRACE_PORT_LOG) | (1UL << TRACE_PORT_KEY) |
+               (1UL << TRACE_PORT_REPORT) | (1UL << TRACE_PORT_USB) |
+               (1UL << TRACE_PORT_CLOCK);
+
+    /* Boot clock, for timestamps without --cpu-hz */
+    Trace_Clock_Changed();
+}
+
+/**
+  * @brief Write a byte stream to a stimulus port (4 bytes per packet)
+  * @param port: Stimulus port
+  * @param data: Bytes to send
+  * @param len: Number of bytes
+  * @retval None
+  */
+void Trace_Write(uint8_t port, const void *data, uint16_t len)
+{
+    const uint8_t *p = (const uint8_t *)data;
+    uint32_t spin = 0;
+
+    while (len >= 4U) {
+        if (!Trace_Ready(port, spin)) return;
+        ITM->PORT[port].u32 = (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+                              ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+        p += 4;
+        len -= 4U;
+        spin = TRACE_SPIN;
+    }
+    while (len > 0U) {
+        if (!Trace_Ready(port, spin)) return;
+        ITM->PORT[port].u8 = *p++;
+        len--;
+        spin = TRACE_SPIN;
+    }
+}
+
+/**
+  * @brief Trace a matrix key event (one 32-bit packet)
+  * @param matrix_key: Matrix key code
+  * @param pressed: 1 = pressed, 0 = released
+  * @param usb_key: HID code the key is mapped to
+  * @retval None
+  */
+void Trace_Key(uint8_t matrix_key, uint8_t pressed, uint8_t usb_key)
+{
+    if (!Trace_Ready(TRACE_PORT_KEY, 0)) return;
+    ITM->PORT[TRACE_PORT_KEY].u32 = (uint32_t)matrix_key | ((uint32_t)pressed << 8) |
+                                    ((uint32_t)usb_key << 16);
+}
+
+/**
+  * @brief Trace a report handed to the IN endpoint (two 32-bit packets)
+  * The first byte of the first packet is the report ID (1 or 2); the
+  * continuation packet never starts with 1 or 2, which lets the decoder
+  * resynchronise after a drop.
+  * @param report_id: HID_REPORT_ID_KEYBOARD or HID_REPORT_ID_MOUSE
+  * @param report: Report without ID (8 or 4 bytes)
+  * @param len: Report length
+  * @retval None
+  */
+void Trace_Report(uint8_t report_id, const void *report, uint8_t len)
+{
+    uint8_t buf[8] = {0};
+    const uint8_t *r = (const uint8_t *)report;
+
+    if (len > sizeof(buf)) len = sizeof(buf);
+    for (uint8_t i = 0; i < len; i++) {
+        buf[i] = r[i];
+    }
+
+    if (!Trace_Ready(TRACE_PORT_REPORT, 0)) return;
+    if (len <= 4U) {
+        /* Mouse: id, buttons, x, y | 0, wheel */
+        ITM->PORT[TRACE_PORT_REPORT].u32 = (uint32_t)report_id | ((uint32_t)buf[0] << 8) |
+                                           ((uint32_t)buf[1] << 16) | ((uint32_t)buf[2] << 24);
+        if (!Trace_Ready(TRACE_PORT_REPORT, TRACE_SPIN)) return;
+        ITM->PORT[TRACE_PORT_REPORT].u32 = (uint32_t)buf[3] << 8;
+    } else {
+        /* Keyboard: id, modifier, key0, key1 | key2..key5 (reserved byte skipped) */
+        ITM->PORT[TRACE_PORT_REPORT].u32 = (uint32_t)report_id | ((uint32_t)buf[0] << 8) |
+                                           ((uint32_t)buf[2] << 16) | ((uint32_t)buf[3] << 24);
+        if (!Trace_Ready(TRACE_PORT_REPORT, TRACE_SPIN)) return;
+        ITM->PORT[TRACE_PORT_REPORT].u32 = (uint32_t)buf[4] | ((uint32_t)buf[5] << 8) |
+                                           ((uint32_t)buf[6] << 16) | ((uint32_t)buf[7] << 24);
+    }
+}
+
+/**
+  * @brief Trace a USB device state change (one 8-bit packet)
+  * @param state: USBD_STATE_* value
+  * @retval None
+  */
+void Trace_Usb_State(uint8_t state)
+{
+    if (!Trace_Ready(TRACE_PORT_USB, 0)) return;
+    ITM->PORT[TRACE_PORT_USB].u8 = state;
+}
+
+/**
+  * @brief Follow a core clock change (clock_profile.c, interrupts masked)
+  * Reprograms the SWO prescaler for the new HCLK and traces the new clock,
+  * which lets the decoder convert the cycle timestamps that follow.
+  * @retval None
+  */
+void Trace_Clock_Changed(void)
+{
+#if TRACE_SWO_SETUP
+    TPI->ACPR = (SystemCoreClock / TRACE_SWO_BAUD) - 1U;
+#endif
+    if (!Trace_Ready(TRACE_PORT_CLOCK, TRACE_SPIN)) return;
+    ITM->PORT[TRACE_PORT_CLOCK].u32 = SystemCoreClock;
+}
+
+/**
+  * @brief Number of trace packets dropped because the ITM FIFO was full
+  * @retval Dropped packet count since reset
+  */
+uint32_t Trace_Get_Dropped(void)
+{
+    return trace_dropped;
+}
+
+#endif /* TRACE_ENABLE */
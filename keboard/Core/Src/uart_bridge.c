@@ -0,0 +1,364 @@
+/**
+  ******************************************************************************
+  * @file           : uart_bridge.c
+  * @brief          : USB CDC <-> USART2 bridge implementation
+  *
+  * UART -> host: rx_in counts the bytes the RX DMA has written (its buffer
+  * index is rx_in masked), rx_out the bytes queued to the CDC TX ring. Both
+  * run freely; the difference is the data waiting for room in the ring.
+  * More than UART_BRIDGE_RX_SIZE waiting means the DMA lapped the reader:
+  * the overwritten bytes are skipped and counted. The DMA count is
+  * rx_lap (advanced on every transfer complete) plus the position from
+  * NDTR, plus one lap while a transfer complete is pending: NDTR alone
+  * cannot tell a full lap from none. The half/full transfer events come
+  * every UART_BRIDGE_RX_SIZE / 2 bytes (3.9 ms at 5.25 Mbaud); only a
+  * DMA interrupt held off for more than a whole lap (7.8 ms) could still
+  * lose count of one.
+  * Host -> UART: tx_len is the CDC packet owned by the running TX DMA
+  * transfer, consumed from HAL_UART_TxCpltCallback(), which starts the
+  * next one. The bridge is the only CDC reader and writer in this build.
+  * Everything runs from the USART2/DMA interrupts (same priority) or from
+  * UART_Bridge_Task() with interrupts masked.
+  ******************************************************************************
+  */
+
+#include "uart_bridge.h"
+
+#if UART_BRIDGE_ENABLE
+
+#include "main.h"
+#include "uart_log.h"
+#include "ram_sections.h"
+#include "usbd_cdc_if.h"
+#include <string.h>
+
+#if (UART_LOG_BACKEND & UART_LOG_TO_UART)
+#error "USART2 carries the bridge: the log must use UART_LOG_TO_ITM"
+#endif
+#if (UART_BRIDGE_RX_SIZE & (UART_BRIDGE_RX_SIZE - 1U)) != 0U
+#error "UART_BRIDGE_RX_SIZE must be a power of two"
+#endif
+
+#define UART_BRIDGE_RX_MASK     (UART_BRIDGE_RX_SIZE - 1U)
+
+/* UART handle (main.c) */
+extern UART_HandleTypeDef huart2;
+
+static UART_Bridge_Stats_t bridge_stats;
+
+/* UART -> host */
+static uint8_t rx_dma[UART_BRIDGE_RX_SIZE] NOINIT;
+static uint32_t rx_in = 0;
+static uint32_t rx_out = 0;
+static uint32_t rx_lap = 0;             /* DMA count at the start of the running lap */
+
+/* Host -> UART */
+static volatile uint16_t tx_len = 0;
+static uint8_t tx_hold = 0;             /* New line coding waits for the running transfer */
+
+/* CDC_GetLineCoding_FS() sequence last applied */
+static uint32_t coding_seq = 0;
+
+/**
+  * @brief Queue received bytes to the CDC TX ring, as many as fit
+  * @param count: Bytes written by the RX DMA since it was started
+  * @retval None
+  */
+static void UART_Bridge_Rx_Drain(uint32_t count)
+{
+    rx_in = count;
+
+    if (rx_in - rx_out > UART_BRIDGE_RX_SIZE) {
+        bridge_stats.rx_dropped += rx_in - rx_out - UART_BRIDGE_RX_SIZE;
+        rx_out = rx_in - UART_BRIDGE_RX_SIZE;
+    }
+
+    while (rx_out != rx_in) {
+        uint16_t space;
+        uint8_t *dst = CDC_TxReserve_FS(&space);
+        uint32_t start = rx_out & UART_BRIDGE_RX_MASK;
+        uint32_t n = rx_in - rx_out;
+
+        if (n > UART_BRIDGE_RX_SIZE - start) {
+            n = UART_BRIDGE_RX_SIZE - start;   /* Up to the wrap, rest in the next pass */
+        }
+        if (n > space) {
+            n = space;
+        }
+        if (n == 0U) {
+            break;   /* Ring full: retried from the next event or task pass */
+        }
+        memcpy(dst, &rx_dma[start], n);
+        CDC_TxCommit_FS((uint16_t)n);
+        rx_out += n;
+        bridge_stats.to_usb += n;
+    }
+}
+
+/**
+  * @brief Bytes written by the RX DMA since it was started
+  * Call from the USART2/DMA interrupts or with interrupts masked.
+  * @retval Byte count
+  */
+static uint32_t UART_Bridge_Rx_Count(void)
+{
+    DMA_HandleTypeDef *hdma = huart2.hdmarx;
+    uint32_t tc_flag = __HAL_DMA_GET_TC_FLAG_INDEX(hdma);
+    uint8_t lapped = (__HAL_DMA_GET_FLAG(hdma, tc_flag) != 0U);
+    uint32_t ndtr = __HAL_DMA_GET_COUNTER(hdma);
+
+    /* A lap that ends between the two reads: NDTR must be the reloaded one */
+    if (!lapped && __HAL_DMA_GET_FLAG(hdma, tc_flag) != 0U) {
+        lapped = 1;
+        ndtr = __HAL_DMA_GET_COUNTER(hdma);
+    }
+    return rx_lap + (lapped ? UART_BRIDGE_RX_SIZE : 0U) + UART_BRIDGE_RX_SIZE - ndtr;
+}
+
+/**
+  * @brief Stop RX DMA, queueing what it received first
+  * The next start writes from the start of the buffer again, so bytes
+  * that still do not fit in the CDC TX ring are dropped.
+  * @retval None
+  */
+static void UART_Bridge_Rx_Stop(void)
+{
+    UART_Bridge_Rx_Drain(UART_Bridge_Rx_Count());
+    HAL_UART_AbortReceive(&huart2);
+
+    bridge_stats.rx_dropped += rx_in - rx_out;
+    rx_in = 0;
+    rx_out = 0;
+    rx_lap = 0;
+}
+
+/**
+  * @brief (Re)start circular RX DMA with idle line detection
+  * @retval None
+  */
+static void UART_Bridge_Rx_Restart(void)
+{
+    UART_Bridge_Rx_Stop();
+    (void)HAL_UARTEx_ReceiveToIdle_DMA(&huart2, rx_dma, UART_BRIDGE_RX_SIZE);
+}
+
+/**
+  * @brief Send the oldest CDC packet if the UART TX is idle
+  * Must run with interrupts masked or from the UART interrupt.
+  * @retval None
+  */
+static void UART_Bridge_Tx_Kick(void)
+{
+    uint16_t len;
+    uint8_t *p;
+
+    if (tx_len != 0U || tx_hold) {
+        return;
+    }
+    p = CDC_RxPeek_FS(&len);
+    if (p == NULL || len == 0U) {
+        return;
+    }
+
+    tx_len = len;
+    if (HAL_UART_Transmit_DMA(&huart2, p, len) != HAL_OK) {
+        tx_len = 0;   /* UART busy: retried from the task */
+    }
+}
+
+/**
+  * @brief Translate a CDC line coding to USART2 settings
+  * @param coding: Line coding from the host
+  * @param init: Receives the UART settings
+  * @retval HAL_OK, or HAL_ERROR if USART2 cannot do it
+  */
+static HAL_StatusTypeDef UART_Bridge_Coding(const USBD_HID_CDC_LineCodingTypeDef *coding, UART_InitTypeDef *init)
+{
+    uint32_t pclk = HAL_RCC_GetPCLK1Freq();
+
+    *init = huart2.Init;
+
+    /* 16x oversampling up to PCLK1 / 16, 8x above; the divider has 12 integer bits */
+    if (coding->bitrate > pclk / 8U || coding->bitrate <= pclk / (16U * 4096U)) {
+        return HAL_ERROR;
+    }
+    init->BaudRate = coding->bitrate;
+    init->OverSampling = (coding->bitrate > pclk / 16U) ? UART_OVERSAMPLING_8 : UART_OVERSAMPLING_16;
+
+    /* bCharFormat: 0 = 1 stop bit, 2 = 2 stop bits (1.5 is smartcard only) */
+    switch (coding->format) {
+    case 0: init->StopBits = UART_STOPBITS_1; break;
+    case 2: init->StopBits = UART_STOPBITS_2; break;
+    default: return HAL_ERROR;
+    }
+
+    /* bParityType: none, odd, even (no mark/space) */
+    switch (coding->paritytype) {
+    case 0: init->Parity = UART_PARITY_NONE; break;
+    case 1: init->Parity = UART_PARITY_ODD; break;
+    case 2: init->Parity = UART_PARITY_EVEN; break;
+    default: return HAL_ERROR;
+    }
+
+    /* The USART word includes the parity bit: 8 or 9 bits */
+    if (coding->datatype == 8U) {
+        init->WordLength = (init->Parity == UART_PARITY_NONE) ? UART_WORDLENGTH_8B : UART_WORDLENGTH_9B;
+    } else if (coding->datatype == 7U && init->Parity != UART_PARITY_NONE) {
+        init->WordLength = UART_WORDLENGTH_8B;
+    } else {
+        return HAL_ERROR;
+    }
+    return HAL_OK;
+}
+
+/**
+  * @brief Reconfigure USART2 for a new line coding, UART TX idle
+  * @param coding: Line coding from the host
+  * @retval None
+  */
+static void UART_Bridge_Apply(const USBD_HID_CDC_LineCodingTypeDef *coding)
+{
+    UART_InitTypeDef init;
+
+    if (UART_Bridge_Coding(coding, &init) != HAL_OK) {
+        bridge_stats.codings_refused++;
+        return;
+    }
+    /* Hosts send the same coding again on every open */
+    if (memcmp(&init, &huart2.Init, sizeof(init)) == 0) {
+        return;
+    }
+
+    UART_Bridge_Rx_Stop();
+    huart2.Init = init;
+    if (HAL_UART_Init(&huart2) != HAL_OK) {
+        Error_Handler();
+    }
+    (void)HAL_UARTEx_ReceiveToIdle_DMA(&huart2, rx_dma, UART_BRIDGE_RX_SIZE);
+    bridge_stats.codings++;
+}
+
+/**
+  * @brief Start the bridge, call once after USB and USART2 init
+  * @retval None
+  */
+void UART_Bridge_Init(void)
+{
+    USBD_HID_CDC_LineCodingTypeDef coding;
+    uint32_t primask;
+
+    coding_seq = CDC_GetLineCoding_FS(&coding);
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+    UART_Bridge_Rx_Restart();
+    __set_PRIMASK(primask);
+}
+
+/**
+  * @brief Apply line coding changes and move data the interrupts could
+  * not, call from the main loop
+  * @retval None
+  */
+void UART_Bridge_Task(void)
+{
+    USBD_HID_CDC_LineCodingTypeDef coding;
+    uint32_t seq = CDC_GetLineCoding_FS(&coding);
+    uint32_t primask;
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+
+    /* Packets queued before the change go out with the old settings */
+    if (seq != coding_seq) {
+        tx_hold = 1;
+        if (tx_len == 0U) {
+            UART_Bridge_Apply(&coding);
+            coding_seq = seq;
+            tx_hold = 0;
+        }
+    }
+
+    if (huart2.RxState == HAL_UART_STATE_READY) {
+        UART_Bridge_Rx_Restart();   /* A failed restart is retried here */
+    } else {
+        UART_Bridge_Rx_Drain(UART_Bridge_Rx_Count());
+    }
+    UART_Bridge_Tx_Kick();
+
+    __set_PRIMASK(primask);
+}
+
+/**
+  * @brief Bridge counters
+  * @retval Counters since boot
+  */
+const UART_Bridge_Stats_t *UART_Bridge_Get_Stats(void)
+{
+    return &bridge_stats;
+}
+
+/**
+  * @brief RX DMA half/full transfer or line idle: forward what arrived
+  * Size is not used: on line idle it is taken from NDTR and cannot tell
+  * whether a lap just ended.
+  * @param huart: UART handle
+  * @param Size: RX DMA write position in the buffer
+  * @retval None
+  */
+void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t Size)
+{
+    (void)Size;
+    if (huart->Instance != USART2) {
+        return;
+    }
+    /* The DMA handler cleared the flag, NDTR is reloaded */
+    if (HAL_UARTEx_GetRxEventType(huart) == HAL_UART_RXEVENT_TC) {
+        rx_lap += UART_BRIDGE_RX_SIZE;
+    }
+    UART_Bridge_Rx_Drain(UART_Bridge_Rx_Count());
+}
+
+/**
+  * @brief UART TX complete: release the CDC packet and send the next
+  * @param huart: UART handle
+  * @retval None
+  */
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+{
+    if (huart->Instance != USART2) {
+        return;
+    }
+
+    bridge_stats.to_uart += tx_len;
+    CDC_RxConsume_FS(tx_len);
+    tx_len = 0;
+    UART_Bridge_Tx_Kick();
+}
+
+/**
+  * @brief UART error: count line errors and restart what the HAL stopped
+  * Any error during DMA reception stops the RX DMA; a DMA transfer error
+  * also ends the TX transfer, whose packet is then sent again.
+  * @param huart: UART handle
+  * @retval None
+  */
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
+{
+    if (huart->Instance != USART2) {
+        return;
+    }
+
+    if (huart->ErrorCode & (HAL_UART_ERROR_PE | HAL_UART_ERROR_NE | HAL_UART_ERROR_FE | HAL_UART_ERROR_ORE)) {
+        bridge_stats.line_errors++;
+    }
+    if (huart->RxState == HAL_UART_STATE_READY) {
+        UART_Bridge_Rx_Restart();
+    }
+    if (tx_len != 0U && huart->gState == HAL_UART_STATE_READY) {
+        tx_len = 0;
+        UART_Bridge_Tx_Kick();
+    }
+}
+
+#endif /* UART_BRIDGE_ENABLE */
@@ -0,0 +1,265 @@
+/**
+  ******************************************************************************
+  * @file           : uart_log.c
+  * @brief          : Non-blocking UART log backend implementation
+  *
+  * Single producer: UART_Log_Write() is called from thread context only
+  * (main loop and the callbacks it runs). It owns log_head and copies
+  * without masking interrupts. The DMA side owns log_tail and advances
+  * it from HAL_UART_TxCpltCallback(). Interrupts are only masked for the
+  * few instructions that decide whether a new DMA transfer must start.
+  * Each transfer covers the contiguous part of the ring up to the wrap.
+  * In the RTOS firmware several tasks write: each message (a printf line
+  * through _write(), a BLOG record) is copied with the scheduler locked,
+  * so messages never interleave and interrupts stay enabled.
+  ******************************************************************************
+  */
+
+#include "uart_log.h"
+#include "trace.h"
+#include "ram_sections.h"
+#include "rtos_app.h"
+#include <string.h>
+
+#if RTOS_ENABLE
+#include "cmsis_os2.h"
+#endif
+
+#define UART_LOG_MASK   (UART_LOG_BUFFER_SIZE - 1U)
+
+/* UART handle (main.c) */
+extern UART_HandleTypeDef huart2;
+
+/* Ring buffer, indices run freely and are masked on access */
+static uint8_t log_buf[UART_LOG_BUFFER_SIZE] NOINIT;
+static volatile uint32_t log_head = 0;
+static volatile uint32_t log_tail = 0;
+static volatile uint16_t log_tx_len = 0;   /* Bytes owned by the running DMA transfer */
+
+/* Overflow accounting */
+static volatile uint32_t log_dropped = 0;
+static uint8_t log_drop_pending = 0;
+
+/**
+  * @brief Start a DMA transfer if the UART is idle and data is waiting
+  * Must run with interrupts masked or from the UART interrupt.
+  * @retval None
+  */
+static void UART_Log_Kick(void)
+{
+    uint32_t start, len;
+
+    if (log_tx_len != 0 || log_head == log_tail) {
+        return;
+    }
+
+    start = log_tail & UART_LOG_MASK;
+    len = log_head - log_tail;
+    if (len > UART_LOG_BUFFER_SIZE - start) {
+        len = UART_LOG_BUFFER_SIZE - start;   /* Up to the wrap, rest in the next transfer */
+    }
+
+    log_tx_len = (uint16_t)len;
+    if (HAL_UART_Transmit_DMA(&huart2, &log_buf[start], (uint16_t)len) != HAL_OK) {
+        log_tx_len = 0;   /* UART not ready yet: retried on the next write */
+    }
+}
+
+/**
+  * @brief Copy bytes into the ring buffer at the head
+  * @param src: Data to copy
+  * @param len: Number of bytes (must fit)
+  * @retval None
+  */
+static void UART_Log_Copy(const uint8_t *src, uint32_t len)
+{
+    uint32_t pos = log_head & UART_LOG_MASK;
+    uint32_t first = UART_LOG_BUFFER_SIZE - pos;
+
+    if (first > len) {
+        first = len;
+    }
+    memcpy(&log_buf[pos], src, first);
+    memcpy(&log_buf[0], src + first, len - first);
+
+    log_head += len;
+}
+
+/**
+  * @brief Queue a message, single producer
+  * @param data: Message bytes
+  * @param len: Message length
+  * @retval Bytes queued: len, or 0 if the message was dropped
+  */
+static uint16_t UART_Log_Put(const void *data, uint16_t len)
+{
+    uint32_t primask;
+    uint32_t space = UART_LOG_BUFFER_SIZE - (log_head - log_tail);
+
+    if (len == 0) {
+        return 0;
+    }
+
+#if (UART_LOG_BACKEND & UART_LOG_TO_ITM)
+    Trace_Write(TRACE_PORT_LOG, data, len);
+#endif
+#if !(UART_LOG_BACKEND & UART_LOG_TO_UART)
+    (void)space;
+    (void)primask;
+    return len;
+#endif
+
+    /* Mark the gap left by earlier drops before any newer message */
+    if (log_drop_pending) {
+        if (space < len + sizeof(UART_LOG_DROP_MARKER) - 1U) {
+            log_dropped++;
+            return 0;
+        }
+        UART_Log_Copy((const uint8_t *)UART_LOG_DROP_MARKER, sizeof(UART_LOG_DROP_MARKER) - 1U);
+        log_drop_pending = 0;
+    } else if (space < len) {
+        log_dropped++;
+        log_drop_pending = 1;
+        return 0;
+    }
+
+    UART_Log_Copy((const uint8_t *)data, len);
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+    UART_Log_Kick();
+    __set_PRIMASK(primask);
+
+    return len;
+}
+
+/**
+  * @brief Queue a log message for transmission, never blocks
+  * @param data: Message bytes
+  * @param len: Message length
+  * @retval Bytes queued: len, or 0 if the message was dropped
+  */
+uint16_t UART_Log_Write(const void *data, uint16_t len)
+{
+#if RTOS_ENABLE
+    int32_t lock = osKernelLock();   /* Fails before the kernel runs: one producer then */
+    uint16_t n = UART_Log_Put(data, len);
+
+    if (lock >= 0) {
+        (void)osKernelRestoreLock(lock);
+    }
+    return n;
+#else
+    return UART_Log_Put(data, len);
+#endif
+}
+
+/**
+  * @brief Number of messages dropped because the ring buffer was full
+  * @retval Dropped message count since reset
+  */
+uint32_t UART_Log_Get_Dropped(void)
+{
+    return log_dropped;
+}
+
+/**
+  * @brief Number of bytes not yet handed to the UART
+  * @retval Pending bytes, including the running DMA transfer
+  */
+uint16_t UART_Log_Pending(void)
+{
+    return (uint16_t)(log_head - log_tail);
+}
+
+/**
+  * @brief Drain the ring buffer by polling, for fault and error handlers
+  * Stops the DMA, keeps what it already sent and pushes the rest through
+  * the data register. Does not use HAL state, which may be corrupt.
+  * @retval None
+  */
+void UART_Log_Flush_Fault(void)
+{
+    USART_TypeDef *uart = huart2.Instance;
+    DMA_Stream_TypeDef *stream = (huart2.hdmatx != NULL) ? huart2.hdmatx->Instance : NULL;
+
+    __disable_irq();
+
+    if (uart == NULL || (uart->CR1 & USART_CR1_UE) == 0U) {
+        return;   /* UART never initialized */
+    }
+
+    if (log_tx_len != 0 && stream != NULL) {
+        stream->CR &= ~DMA_SxCR_EN;
+        while (stream->CR & DMA_SxCR_EN) {
+        }
+        log_tail += log_tx_len - stream->NDTR;
+    }
+    log_tx_len = 0;
+    uart->CR3 &= ~USART_CR3_DMAT;
+
+    while (log_tail != log_head) {
+        while ((uart->SR & USART_SR_TXE) == 0U) {
+        }
+        uart->DR = log_buf[log_tail & UART_LOG_MASK];
+        log_tail++;
+    }
+    while ((uart->SR & USART_SR_TC) == 0U) {
+    }
+}
+
+#if (UART_LOG_BACKEND & UART_LOG_TO_UART)
+/**
+  * @brief UART TX complete: release the sent bytes and start the next chunk
+  * @param huart: UART handle
+  * @retval None
+  */
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+{
+    if (huart->Instance != USART2) {
+        return;
+    }
+
+    log_tail += log_tx_len;
+    log_tx_len = 0;
+    UART_Log_Kick();
+}
+
+/**
+  * @brief UART error (e.g. DMA transfer error): resend the aborted chunk
+  * @param huart: UART handle
+  * @retval None
+  */
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
+{
+    if (huart->Instance != USART2 || huart->gState != HAL_UART_STATE_READY) {
+        return;
+    }
+
+    log_tx_len = 0;
+    UART_Log_Kick();
+}
+#endif /* UART_LOG_BACKEND & UART_LOG_TO_UART */
+
+/**
+  * @brief newlib write hook: stdout/stderr go to the log ring buffer
+  * @param file: File descriptor (ignored)
+  * @param ptr: Data
+  * @param len: Length
+  * @retval len (a dropped message is not an I/O error for printf)
+  */
+int _write(int file, char *ptr, int len)
+{
+    int remaining = len;
+
+    (void)file;
+
+    while (remaining > 0) {
+        uint16_t chunk = (remaining > 0xFFFF) ? 0xFFFF : (uint16_t)remaining;
+
+        UART_Log_Write(ptr, chunk);
+        ptr += chunk;
+        remaining -= chunk;
+    }
+    return len;
+}
@@ -0,0 +1,309 @@
+/**
+  ******************************************************************************
+  * @file           : unicode_input.c
+  * @brief          : Unicode input engine implementation
+  *
+  * Code points wait in a small FIFO. Unicode_Task() expands the oldest one
+  * into a list of report steps (modifier + at most one key) and feeds them
+  * to the keyboard report queue whenever it has room. Every step differs
+  * from the previous one, so none is collapsed by USB_Keyboard_SendReport()
+  * and each lands in its own USB frame.
+  * Keys and modifiers the user holds are left alone: the modifiers are
+  * lifted for the sequence and come back with an extra step at its end,
+  * and a step key the user already holds is lifted for one report (so the
+  * step is a new press) and never released by the sequence.
+  ******************************************************************************
+  */
+
+#include "unicode_input.h"
+#include "usb_keyboard.h"
+#include "flash_kv.h"
+#include "ram_sections.h"
+
+/* Longest expansion: WinCompose, 6 hex digits, modifier restore */
+#define UNICODE_MAX_STEPS   (4 + 2 * 6 + 2 + 1)
+
+/* One report of an input sequence */
+typedef struct {
+    uint8_t modifier;
+    uint8_t key;
+} Unicode_Step_t;
+
+/* Hex digit -> HID code, main row (Linux, WinCompose) */
+static const uint8_t hex_key_main[16] = {
+    KEY_0, KEY_1, KEY_2, KEY_3, KEY_4, KEY_5, KEY_6, KEY_7,
+    KEY_8, KEY_9, KEY_A, KEY_B, KEY_C, KEY_D, KEY_E, KEY_F,
+};
+
+/* Hex digit -> HID code, Windows hex numpad (digits must come from the keypad) */
+static const uint8_t hex_key_keypad[16] = {
+    KEY_KP_0, KEY_KP_1, KEY_KP_2, KEY_KP_3, KEY_KP_4, KEY_KP_5, KEY_KP_6, KEY_KP_7,
+    KEY_KP_8, KEY_KP_9, KEY_A,    KEY_B,    KEY_C,    KEY_D,    KEY_E,    KEY_F,
+};
+
+/* Smallest code point of each UTF-8 sequence length (shorter = overlong) */
+static const uint32_t utf8_min[5] = {0, 0, 0x80U, 0x800U, 0x10000U};
+
+/* Code point FIFO */
+static uint32_t cp_queue[UNICODE_QUEUE_LEN] NOINIT;
+static uint8_t cp_head = 0;
+static uint8_t cp_count = 0;
+
+/* Expansion of the code point being typed */
+static Unicode_Step_t steps[UNICODE_MAX_STEPS] NOINIT;
+static uint8_t step_count = 0;
+static uint8_t step_index = 0;
+static uint8_t step_key = KEY_NONE;
+static uint8_t step_key_user = 0;           /* step_key is held by the user too */
+
+static uint8_t unicode_mode = UNICODE_DEFAULT_MODE;
+
+/**
+  * @brief Append one step to the current expansion
+  * @param modifier: Modifier bits of the report
+  * @param key: HID keyboard code, KEY_NONE for an empty report
+  * @retval None
+  */
+static void Unicode_Add_Step(uint8_t modifier, uint8_t key)
+{
+    steps[step_count].modifier = modifier;
+    steps[step_count].key = key;
+    step_count++;
+}
+
+/**
+  * @brief Append the hex digits of a code point, without leading zeros
+  * @param codepoint: Code point to type
+  * @param table: Hex digit -> HID code table
+  * @param modifier: Modifier held while typing the digits
+  * @retval None
+  */
+static void Unicode_Add_Hex(uint32_t codepoint, const uint8_t *table, uint8_t modifier)
+{
+    int8_t shift = 20;
+
+    while (shift > 0 && ((codepoint >> shift) & 0xFU) == 0) {
+        shift -= 4;
+    }
+    for (; shift >= 0; shift -= 4) {
+        Unicode_Add_Step(modifier, table[(codepoint >> shift) & 0xFU]);
+        Unicode_Add_Step(modifier, KEY_NONE);
+    }
+}
+
+/**
+  * @brief Build the input sequence of a code point for the current mode
+  * @param codepoint: Code point to type
+  * @retval None
+  */
+static void Unicode_Expand(uint32_t codepoint)
+{
+    step_count = 0;
+    step_index = 0;
+
+    switch (unicode_mode) {
+        case UNICODE_MODE_WINDOWS:
+            Unicode_Add_Step(KBD_MOD_LALT, KEY_NONE);
+            Unicode_Add_Step(KBD_MOD_LALT, KEY_KP_PLUS);
+            Unicode_Add_Step(KBD_MOD_LALT, KEY_NONE);
+            Unicode_Add_Hex(codepoint, hex_key_keypad, KBD_MOD_LALT);
+            Unicode_Add_Step(0, KEY_NONE);
+            break;
+
+        case UNICODE_MODE_WINCOMPOSE:
+            Unicode_Add_Step(KBD_MOD_RALT, KEY_NONE);
+            Unicode_Add_Step(0, KEY_NONE);
+            Unicode_Add_Step(0, KEY_U);
+            Unicode_Add_Step(0, KEY_NONE);
+            Unicode_Add_Hex(codepoint, hex_key_main, 0);
+            Unicode_Add_Step(0, KEY_ENTER);
+            Unicode_Add_Step(0, KEY_NONE);
+            break;
+
+        default:
+            Unicode_Add_Step(KBD_MOD_LCTRL | KBD_MOD_LSHIFT, KEY_U);
+            Unicode_Add_Step(0, KEY_NONE);
+            Unicode_Add_Hex(codepoint, hex_key_main, 0);
+            Unicode_Add_Step(0, KEY_SPACE);
+            Unicode_Add_Step(0, KEY_NONE);
+            break;
+    }
+}
+
+/**
+  * @brief Initialize the Unicode engine and load the host input method
+  * @retval None
+  */
+void Unicode_Init(void)
+{
+    uint8_t mode;
+
+    cp_head = 0;
+    cp_count = 0;
+    step_count = 0;
+    step_index = 0;
+    step_key = KEY_NONE;
+    step_key_user = 0;
+
+    unicode_mode = UNICODE_DEFAULT_MODE;
+    if (FlashKV_Get(KV_ID_UNICODE_MODE, &mode, 1) == 1 && mode <= UNICODE_MODE_WINCOMPOSE) {
+        unicode_mode = mode;
+    }
+}
+
+/**
+  * @brief Queue one code point for typing
+  * @param codepoint: Unicode code point (surrogates are rejected)
+  * @retval HAL_OK, HAL_BUSY if the queue is full, HAL_ERROR if invalid
+  */
+HAL_StatusTypeDef Unicode_Send_Codepoint(uint32_t codepoint)
+{
+    if (codepoint == 0 || codepoint > UNICODE_MAX_CODEPOINT ||
+        (codepoint >= 0xD800U && codepoint <= 0xDFFFU)) {
+        return HAL_ERROR;
+    }
+    if (cp_count >= UNICODE_QUEUE_LEN) {
+        return HAL_BUSY;
+    }
+
+    cp_queue[(cp_head + cp_count) % UNICODE_QUEUE_LEN] = codepoint;
+    cp_count++;
+    return HAL_OK;
+}
+
+/**
+  * @brief Queue a UTF-8 string for typing
+  * Invalid, overlong and surrogate sequences are skipped. Stops early when the queue is full.
+  * @param utf8: NUL-terminated UTF-8 string
+  * @retval Number of bytes consumed (strlen(utf8) if everything was queued)
+  */
+uint16_t Unicode_Send_String(const char *utf8)
+{
+    const uint8_t *s = (const uint8_t *)utf8;
+    uint16_t pos = 0;
+
+    while (s[pos] != 0) {
+        uint32_t cp;
+        uint8_t len, i;
+
+        if (s[pos] < 0x80) {
+            cp = s[pos]; len = 1;
+        } else if ((s[pos] & 0xE0) == 0xC0) {
+            cp = s[pos] & 0x1FU; len = 2;
+        } else if ((s[pos] & 0xF0) == 0xE0) {
+            cp = s[pos] & 0x0FU; len = 3;
+        } else if ((s[pos] & 0xF8) == 0xF0) {
+            cp = s[pos] & 0x07U; len = 4;
+        } else {
+            pos++;      /* Stray continuation or invalid lead byte */
+            continue;
+        }
+
+        for (i = 1; i < len; i++) {
+            if ((s[pos + i] & 0xC0) != 0x80) {
+                break;
+            }
+            cp = (cp << 6) | (s[pos + i] & 0x3FU);
+        }
+        if (i < len) {
+            pos += i;   /* Truncated sequence */
+            continue;
+        }
+        if (cp < utf8_min[len] || (cp >= 0xD800U && cp <= 0xDFFFU)) {
+            pos += len; /* Overlong encoding or surrogate */
+            continue;
+        }
+
+        if (Unicode_Send_Codepoint(cp) == HAL_BUSY) {
+            break;
+        }
+        pos += len;
+    }
+
+    return pos;
+}
+
+/**
+  * @brief Feed pending input steps to the report queue; call from the main loop
+  * @retval None
+  */
+void Unicode_Task(void)
+{
+    /* Nothing is typed while the host is away, so no sequence is cut in half */
+    if (!USB_Keyboard_IsConfigured()) {
+        return;
+    }
+
+    while (USB_Keyboard_QueueSpace() > 0) {
+        uint8_t key;
+        uint8_t user_held;
+
+        if (step_index >= step_count) {
+            uint8_t user_modifier = USB_Keyboard_GetModifier();
+
+            if (cp_count == 0) {
+                return;
+            }
+            Unicode_Expand(cp_queue[cp_head]);
+            cp_head = (cp_head + 1) % UNICODE_QUEUE_LEN;
+            cp_count--;
+            if (user_modifier != 0) {
+                Unicode_Add_Step(user_modifier, KEY_NONE);
+            }
+        }
+
+        if (!step_key_user) {
+            USB_Keyboard_ReleaseKey(step_key);
+        }
+        step_key = KEY_NONE;
+        step_key_user = 0;
+
+        key = steps[step_index].key;
+        user_held = USB_Keyboard_IsKeyPressed(key);
+        if (user_held && USB_Keyboard_QueueSpace() < 2U) {
+            return;     /* Lift and press need two reports */
+        }
+
+        USB_Keyboard_SetModifier(steps[step_index].modifier);
+        if (user_held) {
+            USB_Keyboard_ReleaseKey(key);
+            USB_Keyboard_SendReport();
+        }
+        USB_Keyboard_PressKey(key);
+        USB_Keyboard_SendReport();
+        step_key = key;
+        step_key_user = user_held;
+        step_index++;
+    }
+}
+
+/**
+  * @brief Check whether code points are still being typed
+  * @retval 1 if busy, 0 if idle
+  */
+uint8_t Unicode_Is_Busy(void)
+{
+    return (cp_count > 0 || step_index < step_count);
+}
+
+/**
+  * @brief Select the host input method and persist it
+  * @param mode: UNICODE_MODE_LINUX, _WINDOWS or _WINCOMPOSE
+  * @retval HAL status of the flash write
+  */
+HAL_StatusTypeDef Unicode_Set_Mode(uint8_t mode)
+{
+    if (mode > UNICODE_MODE_WINCOMPOSE) return HAL_ERROR;
+
+    unicode_mode = mode;
+    return FlashKV_Set(KV_ID_UNICODE_MODE, &unicode_mode, 1);
+}
+
+/**
+  * @brief Get the host input method
+  * @retval Current mode
+  */
+uint8_t Unicode_Get_Mode(void)
+{
+    return unicode_mode;
+}
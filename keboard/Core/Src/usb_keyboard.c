@@ -6,6 +6,16 @@
   */
 
 #include "usb_keyboard.h"
+#include "matrix_keyboard.h"
+#include "leader_key.h"
+#include "key_repeat.h"
+#include "mouse_keys.h"
+#include "flash_kv.h"
+#include "trace.h"
+#include "latency.h"
+#include "boot_time.h"
+#include "rtos_app.h"
+#include "ram_sections.h"
 #include "usbd_hid.h"
 #include <string.h>
 
@@ -20,6 +30,58 @@ extern USBD_HandleTypeDef hUsbDeviceFS;
 static uint8_t pressed_keys[6] = {0};
 static uint8_t key_count = 0;
 
+/* Outgoing report queue, drained one report per IN transfer. In CCM: only
+ * the core touches it, reports are copied to tx_buf for the endpoint */
+static USB_KeyboardReport_t report_queue[USB_KEYBOARD_QUEUE_LEN] CCM_BSS;
+static uint8_t queue_head CCM_BSS;
+static uint8_t queue_count CCM_BSS;
+
+/* Report currently owned by the IN endpoint (must stay valid until sent):
+ * report ID followed by a keyboard or mouse report */
+static uint8_t tx_buf[1 + sizeof(USB_KeyboardReport_t)];
+
+/* Pending mouse report; motion is merged until the endpoint takes it */
+static USB_MouseReport_t mouse_report = {0};
+static uint8_t mouse_pending = 0;
+
+/* USB frame counter, incremented on every SOF (1 ms at full speed) */
+static volatile uint32_t usb_frame_count CCM_BSS;
+
+/* The host has configured the device since boot */
+static uint8_t usb_configured_once = 0;
+static const USB_KeyboardReport_t report_empty = {0};
+
+/**
+  * @brief Matrix keyboard to USB HID code mapping
+  * Map 3x3 matrix keys to USB HID keycodes
+  * Defaults below; a keymap stored with FlashKV (KV_ID_KEYMAP) overrides
+  * them at boot and USB_Keyboard_SetKeymap() changes them at runtime.
+  * 
+  * Matrix layout:
+  *   0 1 2  ->  Keys: 1 2 3
+  *   3 4 5  ->  Keys: 4 5 6
+  *   6 7 8  ->  Keys: 7 8 9
+  */
+static const uint8_t default_keymap[TOTAL_KEYS] = {
+    KEY_1,      /* Matrix key 0 -> USB 1 */
+    KEY_2,      /* Matrix key 1 -> USB 2 */
+    KEY_3,      /* Matrix key 2 -> USB 3 */
+    KEY_4,      /* Matrix key 3 -> USB 4 */
+    KEY_5,      /* Matrix key 4 -> USB 5 */
+    KEY_6,      /* Matrix key 5 -> USB 6 */
+    KEY_7,      /* Matrix key 6 -> USB 7 */
+    KEY_8,      /* Matrix key 7 -> USB 8 */
+    KEY_9,      /* Matrix key 8 -> USB 9 */
+};
+
+/* Active keymap (RAM copy) */
+static uint8_t matrix_to_usb_hid[TOTAL_KEYS];
+
+/* Matrix keys held down (bit n = matrix key n), and held keys whose code
+ * was released by a keymap change: their physical release is dropped */
+static uint32_t matrix_held = 0;
+static uint32_t matrix_remapped = 0;
+
 /**
   * @brief Initialize USB keyboard
   * @retval None
@@ -30,6 +92,18 @@ void USB_Keyboard_Init(void)
     memset(&keyboard_report_last, 0, sizeof(keyboard_report_last));
     memset(pressed_keys, 0, sizeof(pressed_keys));
     key_count = 0;
+    queue_head = 0;
+    queue_count = 0;
+    memset(&mouse_report, 0, sizeof(mouse_report));
+    mouse_pending = 0;
+    matrix_held = 0;
+    matrix_remapped = 0;
+
+    /* Load the persisted keymap, falling back to the built-in defaults */
+    memcpy(matrix_to_usb_hid, default_keymap, sizeof(matrix_to_usb_hid));
+    if (FlashKV_Get(KV_ID_KEYMAP, matrix_to_usb_hid, sizeof(matrix_to_usb_hid)) != TOTAL_KEYS) {
+        memcpy(matrix_to_usb_hid, default_keymap, sizeof(matrix_to_usb_hid));
+    }
 }
 
 /**
@@ -112,9 +186,37 @@ void USB_Keyboard_ClearModifier(void)
     keyboard_report.modifier = 0;
 }
 
+/**
+  * @brief Get the modifier keys of the current report
+  * @retval Modifier bits
+  */
+uint8_t USB_Keyboard_GetModifier(void)
+{
+    return keyboard_report.modifier;
+}
+
+/**
+  * @brief Check whether a key is in the current report
+  * @param key_code: HID keyboard code
+  * @retval 1 if pressed, 0 otherwise
+  */
+uint8_t USB_Keyboard_IsKeyPressed(uint8_t key_code)
+{
+    if (key_code == 0) return 0;
+
+    for (uint8_t i = 0; i < key_count; i++) {
+        if (pressed_keys[i] == key_code) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
 /**
   * @brief Send keyboard report to USB host
-  * Only sends if report changed from last time
+  * Only queues if report changed from last time. Every distinct report is
+  * delivered in its own IN transfer, so a press followed immediately by a
+  * release is never collapsed into nothing.
   * @retval None
   */
 void USB_Keyboard_SendReport(void)
@@ -123,34 +225,165 @@ void USB_Keyboard_SendReport(void)
     if (memcmp(&keyboard_report, &keyboard_report_last, sizeof(keyboard_report)) == 0) {
         return;  /* No change, don't send */
     }
-    
-    /* Send report */
-    USBD_HID_SendReport(&hUsbDeviceFS, (uint8_t*)&keyboard_report, sizeof(keyboard_report));
-    
+
+    if (queue_count < USB_KEYBOARD_QUEUE_LEN) {
+        uint8_t tail = (queue_head + queue_count) % USB_KEYBOARD_QUEUE_LEN;
+        memcpy(&report_queue[tail], &keyboard_report, sizeof(keyboard_report));
+        Latency_Report_Built(tail);
+        queue_count++;
+    } else {
+        /* Queue full: overwrite the newest entry so the final state still gets out */
+        uint8_t last = (queue_head + queue_count - 1) % USB_KEYBOARD_QUEUE_LEN;
+        memcpy(&report_queue[last], &keyboard_report, sizeof(keyboard_report));
+        Latency_Report_Built(last);
+    }
+
     /* Update last report */
     memcpy(&keyboard_report_last, &keyboard_report, sizeof(keyboard_report));
+
+    USB_Keyboard_Task();
 }
 
 /**
-  * @brief Matrix keyboard to USB HID code mapping
-  * Map 3x3 matrix keys to USB HID keycodes
-  * 
-  * Matrix layout:
-  *   0 1 2  ->  Keys: 1 2 3
-  *   3 4 5  ->  Keys: 4 5 6
-  *   6 7 8  ->  Keys: 7 8 9
+  * @brief Press and release a key as two consecutive reports
+  * @param modifier: Modifier bits held for the duration of the tap
+  * @param key_code: HID keyboard code
+  * @retval None
   */
-static const uint8_t matrix_to_usb_hid[9] = {
-    KEY_1,      /* Matrix key 0 -> USB 1 */
-    KEY_2,      /* Matrix key 1 -> USB 2 */
-    KEY_3,      /* Matrix key 2 -> USB 3 */
-    KEY_4,      /* Matrix key 3 -> USB 4 */
-    KEY_5,      /* Matrix key 4 -> USB 5 */
-    KEY_6,      /* Matrix key 5 -> USB 6 */
-    KEY_7,      /* Matrix key 6 -> USB 7 */
-    KEY_8,      /* Matrix key 7 -> USB 8 */
-    KEY_9,      /* Matrix key 8 -> USB 9 */
-};
+void USB_Keyboard_TapKey(uint8_t modifier, uint8_t key_code)
+{
+    uint8_t saved_modifier = keyboard_report.modifier;
+
+    keyboard_report.modifier = saved_modifier | modifier;
+    USB_Keyboard_PressKey(key_code);
+    USB_Keyboard_SendReport();
+
+    USB_Keyboard_ReleaseKey(key_code);
+    keyboard_report.modifier = saved_modifier;
+    USB_Keyboard_SendReport();
+}
+
+/**
+  * @brief Queue a mouse report
+  * Motion of a report that is still pending is added to it, so no movement
+  * is lost while the endpoint is busy with keyboard reports.
+  * @param buttons: Button bits (MOUSE_BTN_*)
+  * @param x: Relative X movement
+  * @param y: Relative Y movement
+  * @param wheel: Wheel movement
+  * @retval HAL_BUSY if a report with different buttons is still pending
+  */
+HAL_StatusTypeDef USB_Keyboard_SendMouseReport(uint8_t buttons, int8_t x, int8_t y, int8_t wheel)
+{
+    if (mouse_pending) {
+        /* Never merge across a button change, the click would be lost */
+        if (mouse_report.buttons != buttons) {
+            return HAL_BUSY;
+        }
+        if ((mouse_report.x + x) > 127 || (mouse_report.x + x) < -127 ||
+            (mouse_report.y + y) > 127 || (mouse_report.y + y) < -127 ||
+            (mouse_report.wheel + wheel) > 127 || (mouse_report.wheel + wheel) < -127) {
+            return HAL_BUSY;
+        }
+        mouse_report.x += x;
+        mouse_report.y += y;
+        mouse_report.wheel += wheel;
+    } else {
+        mouse_report.buttons = buttons;
+        mouse_report.x = x;
+        mouse_report.y = y;
+        mouse_report.wheel = wheel;
+        mouse_pending = 1;
+    }
+
+    USB_Keyboard_Task();
+    return HAL_OK;
+}
+
+/**
+  * @brief Hand the next queued report to the HID endpoint if it is free
+  * Keyboard reports go first, then the pending mouse report.
+  * Call from the main loop; also called after every queued report.
+  * @retval None
+  */
+void USB_Keyboard_Task(void)
+{
+    USBD_HID_HandleTypeDef *hhid = (USBD_HID_HandleTypeDef *)hUsbDeviceFS.pClassData;
+
+    /* First configuration: keys held at power-up go out at once. Their
+     * reports are normally still queued (held below); if the hold ran
+     * out, the current state is queued again. With nothing held the
+     * host's initial all-released state is already right. State changes
+     * are traced by the PCD callbacks (usbd_conf.c), which also mark
+     * BOOT_STAGE_CONFIGURED */
+    if (!usb_configured_once && hUsbDeviceFS.dev_state == USBD_STATE_CONFIGURED) {
+        usb_configured_once = 1;
+        if (queue_count == 0 && memcmp(&keyboard_report, &report_empty, sizeof(keyboard_report)) != 0) {
+            memcpy(&report_queue[queue_head], &keyboard_report, sizeof(keyboard_report));
+            Latency_Report_Built(queue_head);
+            queue_count = 1;
+        }
+        if (queue_count == 0) {
+            Boot_Time_Mark(BOOT_STAGE_REPORT);
+        }
+    }
+
+    if (queue_count == 0 && !mouse_pending) {
+        return;
+    }
+
+    /* Suspended, remote wakeup allowed: hold the reports, the first one
+     * wakes the host (usb_suspend.c) and goes out after the resume */
+    if (hUsbDeviceFS.dev_state == USBD_STATE_SUSPENDED &&
+        hUsbDeviceFS.dev_old_state == USBD_STATE_CONFIGURED &&
+        hUsbDeviceFS.dev_remote_wakeup != 0U) {
+        return;
+    }
+
+    /* Not configured yet after boot: keep the power-up state for the host */
+    if (!usb_configured_once && HAL_GetTick() < USB_KEYBOARD_BOOT_HOLD_MS) {
+        return;
+    }
+
+    /* Host is not listening: behave like the endpoint would and drop */
+    if (hhid == NULL || hUsbDeviceFS.dev_state != USBD_STATE_CONFIGURED) {
+        queue_head = 0;
+        queue_count = 0;
+        mouse_pending = 0;
+        return;
+    }
+
+    if (hhid->state != USBD_HID_IDLE) {
+        return;  /* Previous report still in flight */
+    }
+
+    if (queue_count > 0) {
+        tx_buf[0] = HID_REPORT_ID_KEYBOARD;
+        memcpy(&tx_buf[1], &report_queue[queue_head], sizeof(USB_KeyboardReport_t));
+        Latency_Report_Sent(queue_head);
+        queue_head = (queue_head + 1) % USB_KEYBOARD_QUEUE_LEN;
+        queue_count--;
+
+        Trace_Report(HID_REPORT_ID_KEYBOARD, &tx_buf[1], sizeof(USB_KeyboardReport_t));
+        if (hhid->Protocol == 0U) {
+            /* Boot protocol (BIOS): bare 8-byte report without ID */
+            USBD_HID_SendReport(&hUsbDeviceFS, &tx_buf[1], sizeof(USB_KeyboardReport_t));
+        } else {
+            USBD_HID_SendReport(&hUsbDeviceFS, tx_buf, sizeof(tx_buf));
+        }
+        return;
+    }
+
+    mouse_pending = 0;
+    if (hhid->Protocol == 0U) {
+        return;  /* Boot keyboards have no mouse */
+    }
+
+    tx_buf[0] = HID_REPORT_ID_MOUSE;
+    memcpy(&tx_buf[1], &mouse_report, sizeof(mouse_report));
+    Trace_Report(HID_REPORT_ID_MOUSE, &mouse_report, sizeof(mouse_report));
+    USBD_HID_SendReport(&hUsbDeviceFS, tx_buf, 1 + sizeof(mouse_report));
+}
 
 /**
   * @brief Convert matrix keyboard code to USB HID code
@@ -161,10 +394,48 @@ static const uint8_t matrix_to_usb_hid[9] = {
   */
 void USB_Keyboard_HandleMatrixKey(uint8_t matrix_key, uint8_t pressed)
 {
-    if (matrix_key >= 9) return;
+    if (matrix_key >= TOTAL_KEYS) return;
+    
+    /* A key released by a keymap change already left the report */
+    uint32_t bit = 1UL << matrix_key;
+    if (pressed) {
+        matrix_held |= bit;
+        matrix_remapped &= ~bit;
+    } else {
+        matrix_held &= ~bit;
+        if (matrix_remapped & bit) {
+            matrix_remapped &= ~bit;
+            return;
+        }
+    }
     
     uint8_t usb_key = matrix_to_usb_hid[matrix_key];
     
+    Trace_Key(matrix_key, pressed, usb_key);
+    
+    if (usb_key == KEY_LAT_DUMP) {
+        if (pressed) {
+            Latency_Request_Dump();
+            RTOS_App_Request_Dump();
+        }
+        return;
+    }
+    
+    /* Leader sequences swallow the keys they consume */
+    if (Leader_Process_Key(usb_key, pressed)) {
+        return;
+    }
+    
+    /* Mouse keys never reach the keyboard report */
+    if (Mouse_Keys_Process_Key(usb_key, pressed)) {
+        return;
+    }
+    
+    /* Repeat/turbo keys are generated as taps, never held in the report */
+    if (KeyRepeat_Process_Key(matrix_key, usb_key, pressed)) {
+        return;
+    }
+    
     if (pressed) {
         USB_Keyboard_PressKey(usb_key);
     } else {
@@ -175,6 +446,109 @@ void USB_Keyboard_HandleMatrixKey(uint8_t matrix_key, uint8_t pressed)
     USB_Keyboard_SendReport();
 }
 
+/**
+  * @brief Number of reports that can still be queued
+  * @retval Free entries in the report queue
+  */
+uint8_t USB_Keyboard_QueueSpace(void)
+{
+    return USB_KEYBOARD_QUEUE_LEN - queue_count;
+}
+
+/**
+  * @brief Current USB frame number
+  * Counts SOF packets, so it only advances while the device is configured.
+  * @retval Frames (1 ms each at full speed) since enumeration
+  */
+uint32_t USB_Keyboard_GetFrame(void)
+{
+    return usb_frame_count;
+}
+
+/**
+  * @brief Check whether the host has configured the device
+  * @retval 1 if reports can be delivered, 0 otherwise
+  */
+uint8_t USB_Keyboard_IsConfigured(void)
+{
+    return (hUsbDeviceFS.pClassData != NULL && hUsbDeviceFS.dev_state == USBD_STATE_CONFIGURED);
+}
+
+/**
+  * @brief SOF hook from the HID class (interrupt context)
+  * @param pdev: USB device handle
+  * @retval None
+  */
+RAM_FUNC void USBD_HID_SOFCallback(USBD_HandleTypeDef *pdev)
+{
+    (void)pdev;
+    usb_frame_count++;
+}
+
+/**
+  * @brief IN transfer complete hook from the HID class (interrupt context)
+  * @param pdev: USB device handle
+  * @retval None
+  */
+RAM_FUNC void USBD_HID_DataInCallback(USBD_HandleTypeDef *pdev)
+{
+    (void)pdev;
+    Latency_Report_Done();
+    Boot_Time_Mark(BOOT_STAGE_REPORT);
+    RTOS_App_In_Complete();
+}
+
+/**
+  * @brief Change the HID code of a matrix key and persist the keymap
+  * Takes effect on the next key event, no reflash needed.
+  * @param matrix_key: Matrix key code (0-8)
+  * @param usb_key: HID keyboard code (or KEY_LEADER)
+  * @retval HAL status of the flash write
+  */
+HAL_StatusTypeDef USB_Keyboard_SetKeymap(uint8_t matrix_key, uint8_t usb_key)
+{
+    return USB_Keyboard_SetKeymapRange(matrix_key, &usb_key, 1);
+}
+
+/**
+  * @brief Change the HID codes of consecutive matrix keys
+  * The keymap is persisted once for the whole range. Held keys whose code
+  * changes are released through the old code first; they produce the new
+  * code from their next press.
+  * @param first: First matrix key code
+  * @param usb_keys: HID keyboard codes for first, first + 1, ...
+  * @param count: Number of keys
+  * @retval HAL_ERROR if the range leaves the matrix, else the flash write status
+  */
+HAL_StatusTypeDef USB_Keyboard_SetKeymapRange(uint8_t first, const uint8_t *usb_keys, uint8_t count)
+{
+    if (first >= TOTAL_KEYS || count > TOTAL_KEYS - first) return HAL_ERROR;
+
+    for (uint8_t i = 0; i < count; i++) {
+        uint8_t k = first + i;
+
+        if ((matrix_held & (1UL << k)) && matrix_to_usb_hid[k] != usb_keys[i]) {
+            USB_Keyboard_HandleMatrixKey(k, 0);
+            matrix_remapped |= 1UL << k;
+        }
+    }
+
+    memcpy(&matrix_to_usb_hid[first], usb_keys, count);
+    return FlashKV_Set(KV_ID_KEYMAP, matrix_to_usb_hid, sizeof(matrix_to_usb_hid));
+}
+
+/**
+  * @brief Get the HID code of a matrix key
+  * @param matrix_key: Matrix key code (0-8)
+  * @retval HID keyboard code, KEY_NONE if out of range
+  */
+uint8_t USB_Keyboard_GetKeymap(uint8_t matrix_key)
+{
+    if (matrix_key >= TOTAL_KEYS) return KEY_NONE;
+
+    return matrix_to_usb_hid[matrix_key];
+}
+
 /**
   * @brief Get USB keyboard report content
   * @param report: Pointer to buffer to receive report
@@ -0,0 +1,241 @@
+/**
+  ******************************************************************************
+  * @file           : usb_suspend.c
+  * @brief          : USB suspend: STOP mode and remote wakeup implementation
+  *
+  * STOP mode is entered and left with interrupts masked: WFI still wakes
+  * on the pending EXTI or OTG interrupt, and the clocks are back at
+  * 168 MHz before any handler runs. The wake-up EXTI lines are disarmed
+  * again in the same window, so their handlers normally never run.
+  * The OTG interrupt path is not changed: HAL_PCD_SuspendCallback() still
+  * gates the PHY clock (low_power_enable stays DISABLE, its sleep-on-exit
+  * would enter STOP from the interrupt with nothing armed), and the
+  * resume interrupt restores the device state.
+  ******************************************************************************
+  */
+
+#include "usb_suspend.h"
+
+#if USB_SUSPEND_ENABLE
+
+#include "main.h"
+#include "matrix_keyboard.h"
+#include "usb_keyboard.h"
+#include "clock_profile.h"
+#include "uart_log.h"
+#include "usbd_def.h"
+
+#define USB_SUSPEND_COL_PINS    (COL_PIN_0 | COL_PIN_1 | COL_PIN_2)
+#define USB_SUSPEND_ROW_PINS    (ROW_PIN_0 | ROW_PIN_1 | ROW_PIN_2)
+
+/* USB handles (usb_device.c, usbd_conf.c) */
+extern USBD_HandleTypeDef hUsbDeviceFS;
+extern PCD_HandleTypeDef hpcd_USB_OTG_FS;
+
+static USB_Suspend_Stats_t suspend_stats;
+
+static uint8_t suspended = 0;           /* Configured device seen suspended */
+static uint32_t suspend_tick = 0;
+static uint8_t wake_key = 0;            /* A key press left STOP mode */
+static uint8_t rwu_sent = 0;            /* Remote wakeup done for this suspend */
+static uint8_t rwu_active = 0;          /* RWUSIG is being driven */
+static uint32_t rwu_tick = 0;
+
+/**
+  * @brief Whether the host suspended the device after configuring it
+  */
+static uint8_t USB_Suspend_Configured(void)
+{
+    return (hUsbDeviceFS.dev_state == USBD_STATE_SUSPENDED &&
+            hUsbDeviceFS.dev_old_state == USBD_STATE_CONFIGURED);
+}
+
+/**
+  * @brief Start resume signalling if the host allows it
+  * @param now: Current tick
+  * @retval 1 once signalled or not allowed, 0 to retry later
+  */
+static uint8_t USB_Suspend_Remote_Wakeup(uint32_t now)
+{
+    if (rwu_sent || hUsbDeviceFS.dev_remote_wakeup == 0U) {
+        return 1;
+    }
+    if (now - suspend_tick < USB_SUSPEND_IDLE_MS) {
+        return 0;   /* The bus must be idle for 5 ms before resume signalling */
+    }
+
+    __HAL_PCD_UNGATE_PHYCLOCK(&hpcd_USB_OTG_FS);
+    (void)HAL_PCD_ActivateRemoteWakeup(&hpcd_USB_OTG_FS);
+    rwu_active = 1;
+    rwu_tick = now;
+    rwu_sent = 1;
+    suspend_stats.remote_wakeups++;
+    return 1;
+}
+
+#if USB_SUSPEND_STOP
+/**
+  * @brief Arm the wake-up sources: all rows low so any press pulls its
+  * column low, falling edge EXTI on the columns, OTG_FS wakeup EXTI
+  */
+static void USB_Suspend_Arm(void)
+{
+    GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+    HAL_GPIO_WritePin(ROW_PORT, USB_SUSPEND_ROW_PINS, GPIO_PIN_RESET);
+
+    GPIO_InitStruct.Pin = USB_SUSPEND_COL_PINS;
+    GPIO_InitStruct.Mode = GPIO_MODE_IT_FALLING;
+    GPIO_InitStruct.Pull = GPIO_PULLUP;
+    HAL_GPIO_Init(COL_PORT, &GPIO_InitStruct);
+    __HAL_GPIO_EXTI_CLEAR_IT(USB_SUSPEND_COL_PINS);
+    HAL_NVIC_ClearPendingIRQ(EXTI9_5_IRQn);
+    HAL_NVIC_EnableIRQ(EXTI9_5_IRQn);
+
+    __HAL_USB_OTG_FS_WAKEUP_EXTI_CLEAR_FLAG();
+    __HAL_USB_OTG_FS_WAKEUP_EXTI_ENABLE_RISING_EDGE();
+    __HAL_USB_OTG_FS_WAKEUP_EXTI_ENABLE_IT();
+    HAL_NVIC_ClearPendingIRQ(OTG_FS_WKUP_IRQn);
+    HAL_NVIC_EnableIRQ(OTG_FS_WKUP_IRQn);
+
+    __HAL_PCD_GATE_PHYCLOCK(&hpcd_USB_OTG_FS);
+}
+
+/**
+  * @brief Back to scanning: columns plain inputs, rows idle, EXTI off
+  */
+static void USB_Suspend_Disarm(void)
+{
+    GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+    /* HAL_GPIO_Init() leaves the EXTI configuration of non-EXTI modes alone */
+    EXTI->IMR &= ~USB_SUSPEND_COL_PINS;
+    EXTI->FTSR &= ~USB_SUSPEND_COL_PINS;
+    GPIO_InitStruct.Pin = USB_SUSPEND_COL_PINS;
+    GPIO_InitStruct.Mode = GPIO_MODE_INPUT;
+    GPIO_InitStruct.Pull = GPIO_PULLUP;
+    HAL_GPIO_Init(COL_PORT, &GPIO_InitStruct);
+    __HAL_GPIO_EXTI_CLEAR_IT(USB_SUSPEND_COL_PINS);
+    HAL_NVIC_DisableIRQ(EXTI9_5_IRQn);
+    HAL_NVIC_ClearPendingIRQ(EXTI9_5_IRQn);
+
+    __HAL_USB_OTG_FS_WAKEUP_EXTI_DISABLE_IT();
+    __HAL_USB_OTG_FS_WAKEUP_EXTI_CLEAR_FLAG();
+    HAL_NVIC_DisableIRQ(OTG_FS_WKUP_IRQn);
+    HAL_NVIC_ClearPendingIRQ(OTG_FS_WKUP_IRQn);
+
+    HAL_GPIO_WritePin(ROW_PORT, USB_SUSPEND_ROW_PINS, GPIO_PIN_SET);
+}
+
+/**
+  * @brief Enter STOP mode until a key press or host resume
+  */
+static void USB_Suspend_Stop(void)
+{
+    uint32_t primask;
+    uint8_t by_key = 0;
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+
+    USB_Suspend_Arm();
+    suspend_stats.stops++;
+
+    HAL_SuspendTick();
+    SCB->ICSR = SCB_ICSR_PENDSTCLR_Msk;
+    HAL_PWR_EnterSTOPMode(PWR_LOWPOWERREGULATOR_ON, PWR_STOPENTRY_WFI);
+
+    /* Running on HSI: PLL, SysTick and every clock user back first */
+    Clock_Profile_Restore();
+    HAL_ResumeTick();
+    __HAL_PCD_UNGATE_PHYCLOCK(&hpcd_USB_OTG_FS);
+
+    if (__HAL_GPIO_EXTI_GET_IT(USB_SUSPEND_COL_PINS) != 0U) {
+        wake_key = 1;
+        by_key = 1;
+        suspend_stats.key_wakes++;
+    } else if ((__HAL_USB_OTG_FS_WAKEUP_EXTI_GET_FLAG()) != 0U) {   /* Macro lacks parentheses */
+        suspend_stats.host_wakes++;
+    }
+    USB_Suspend_Disarm();
+
+    /* The waking press counts even if released within the debounce time */
+    if (by_key) {
+        (void)Matrix_Keyboard_Wake_Latch();
+    }
+
+    __set_PRIMASK(primask);
+}
+#endif /* USB_SUSPEND_STOP */
+
+/**
+  * @brief Set up the wake-up interrupt priorities, call once after USB init
+  * @retval None
+  */
+void USB_Suspend_Init(void)
+{
+    HAL_NVIC_SetPriority(EXTI9_5_IRQn, 0, 0);
+    HAL_NVIC_SetPriority(OTG_FS_WKUP_IRQn, 0, 0);
+#if USB_SUSPEND_DBG_STOP
+    DBGMCU->CR |= DBGMCU_CR_DBG_STOP;
+#endif
+}
+
+/**
+  * @brief Follow the bus suspend state, call from the main loop
+  * @param busy: Nonzero while keys, sequences or reports are in progress
+  * @retval None
+  */
+void USB_Suspend_Task(uint8_t busy)
+{
+    uint32_t now = HAL_GetTick();
+
+    /* End resume signalling; the host continues it and resumes the bus */
+    if (rwu_active) {
+        if (now - rwu_tick < USB_SUSPEND_RWU_MS) {
+            return;
+        }
+        (void)HAL_PCD_DeActivateRemoteWakeup(&hpcd_USB_OTG_FS);
+        rwu_active = 0;
+    }
+
+    if (!USB_Suspend_Configured()) {
+        suspended = 0;
+        return;
+    }
+    if (!suspended) {
+        suspended = 1;
+        suspend_tick = now;
+        wake_key = 0;
+        rwu_sent = 0;
+        suspend_stats.suspends++;
+    }
+
+    /* A key press or a held report: wake the host */
+    if (wake_key || USB_Keyboard_QueueSpace() < USB_KEYBOARD_QUEUE_LEN) {
+        if (USB_Suspend_Remote_Wakeup(now)) {
+            wake_key = 0;
+        }
+        return;
+    }
+
+#if USB_SUSPEND_STOP
+    /* A held key would wake at once; let the log drain first */
+    if (!busy && !rwu_sent && UART_Log_Pending() == 0U) {
+        USB_Suspend_Stop();
+    }
+#else
+    (void)busy;
+#endif
+}
+
+/**
+  * @brief Suspend counters
+  * @retval Counters since boot
+  */
+const USB_Suspend_Stats_t *USB_Suspend_Get_Stats(void)
+{
+    return &suspend_stats;
+}
+
+#endif /* USB_SUSPEND_ENABLE */
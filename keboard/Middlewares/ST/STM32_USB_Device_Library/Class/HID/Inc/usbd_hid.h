@@ -43,11 +43,11 @@ extern "C" {
 #ifndef HID_EPIN_ADDR
 #define HID_EPIN_ADDR                              0x81U
 #endif /* HID_EPIN_ADDR */
-#define HID_EPIN_SIZE                              0x04U
+#define HID_EPIN_SIZE                              0x10U   /* report ID + keyboard (8) or mouse (4) report */
 
 #define USB_HID_CONFIG_DESC_SIZ                    34U
 #define USB_HID_DESC_SIZ                           9U
-#define HID_MOUSE_REPORT_DESC_SIZE                 63U
+#define HID_MOUSE_REPORT_DESC_SIZE                 119U
 
 #define HID_DESCRIPTOR_TYPE                        0x21U
 #define HID_REPORT_DESC                            0x22U
@@ -140,6 +140,8 @@ uint8_t USBD_HID_SendReport(USBD_HandleTypeDef *pdev, uint8_t *report, uint16_t
 uint8_t USBD_HID_SendReport(USBD_HandleTypeDef *pdev, uint8_t *report, uint16_t len);
 #endif /* USE_USBD_COMPOSITE */
 uint32_t USBD_HID_GetPollingInterval(USBD_HandleTypeDef *pdev);
+void USBD_HID_SOFCallback(USBD_HandleTypeDef *pdev);
+void USBD_HID_DataInCallback(USBD_HandleTypeDef *pdev);
 
 /**
   * @}
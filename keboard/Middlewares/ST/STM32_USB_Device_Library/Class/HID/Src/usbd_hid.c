@@ -91,6 +91,7 @@ static uint8_t USBD_HID_Init(USBD_HandleTypeDef *pdev, uint8_t cfgidx);
 static uint8_t USBD_HID_DeInit(USBD_HandleTypeDef *pdev, uint8_t cfgidx);
 static uint8_t USBD_HID_Setup(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req);
 static uint8_t USBD_HID_DataIn(USBD_HandleTypeDef *pdev, uint8_t epnum);
+static uint8_t USBD_HID_SOF(USBD_HandleTypeDef *pdev);
 #ifndef USE_USBD_COMPOSITE
 static uint8_t *USBD_HID_GetFSCfgDesc(uint16_t *length);
 static uint8_t *USBD_HID_GetHSCfgDesc(uint16_t *length);
@@ -114,7 +115,7 @@ USBD_ClassTypeDef USBD_HID =
   NULL,              /* EP0_RxReady */
   USBD_HID_DataIn,   /* DataIn */
   NULL,              /* DataOut */
-  NULL,              /* SOF */
+  USBD_HID_SOF,      /* SOF */
   NULL,
   NULL,
 #ifdef USE_USBD_COMPOSITE
@@ -158,7 +159,7 @@ __ALIGN_BEGIN static uint8_t USBD_HID_CfgDesc[USB_HID_CONFIG_DESC_SIZ] __ALIGN_E
   0x01,                                               /* bNumEndpoints */
   0x03,                                               /* bInterfaceClass: HID */
   0x01,                                               /* bInterfaceSubClass : 1=BOOT, 0=no boot */
-  0x02,                                               /* nInterfaceProtocol : 0=none, 1=keyboard, 2=mouse */
+  0x01,                                               /* nInterfaceProtocol : 0=none, 1=keyboard, 2=mouse */
   0,                                                  /* iInterface: Index of string descriptor */
   /******************** Descriptor of Joystick Mouse HID ********************/
   /* 18 */
@@ -218,12 +219,13 @@ __ALIGN_BEGIN static uint8_t USBD_HID_DeviceQualifierDesc[USB_LEN_DEV_QUALIFIER_
 #endif /* USE_USBD_COMPOSITE  */
 
 
-/* USB Keyboard Report Descriptor */
+/* USB Keyboard + Mouse Report Descriptor (report ID 1 = keyboard, 2 = mouse) */
 __ALIGN_BEGIN static uint8_t HID_MOUSE_ReportDesc[HID_MOUSE_REPORT_DESC_SIZE] __ALIGN_END =
 {
   0x05, 0x01,        /* Usage Page (Generic Desktop Ctrls)     */
   0x09, 0x06,        /* Usage (Keyboard)                       */
   0xA1, 0x01,        /* Collection (Application)               */
+  0x85, 0x01,        /*   Report ID (1)                        */
   0x05, 0x07,        /*   Usage Page (Kbrd/Keypad)             */
   0x19, 0xE0,        /*   Usage Minimum (0xE0)                 */
   0x29, 0xE7,        /*   Usage Maximum (0xE7)                 */
@@ -252,6 +254,35 @@ __ALIGN_BEGIN static uint8_t HID_MOUSE_ReportDesc[HID_MOUSE_REPORT_DESC_SIZE] __
   0x19, 0x00,        /*   Usage Minimum (0x00)                 */
   0x29, 0x65,        /*   Usage Maximum (0x65)                 */
   0x81, 0x00,        /*   Input (Data,Array,Abs,No Wrap,Linear,Preferred State,No Null Position) */
+  0xC0,              /* End Collection                         */
+
+  0x05, 0x01,        /* Usage Page (Generic Desktop Ctrls)     */
+  0x09, 0x02,        /* Usage (Mouse)                          */
+  0xA1, 0x01,        /* Collection (Application)               */
+  0x85, 0x02,        /*   Report ID (2)                        */
+  0x09, 0x01,        /*   Usage (Pointer)                      */
+  0xA1, 0x00,        /*   Collection (Physical)                */
+  0x05, 0x09,        /*     Usage Page (Button)                */
+  0x19, 0x01,        /*     Usage Minimum (0x01)               */
+  0x29, 0x03,        /*     Usage Maximum (0x03)               */
+  0x15, 0x00,        /*     Logical Minimum (0)                */
+  0x25, 0x01,        /*     Logical Maximum (1)                */
+  0x95, 0x03,        /*     Report Count (3)                   */
+  0x75, 0x01,        /*     Report Size (1)                    */
+  0x81, 0x02,        /*     Input (Data,Var,Abs)               */
+  0x95, 0x01,        /*     Report Count (1)                   */
+  0x75, 0x05,        /*     Report Size (5)                    */
+  0x81, 0x03,        /*     Input (Const,Var,Abs)              */
+  0x05, 0x01,        /*     Usage Page (Generic Desktop Ctrls) */
+  0x09, 0x30,        /*     Usage (X)                          */
+  0x09, 0x31,        /*     Usage (Y)                          */
+  0x09, 0x38,        /*     Usage (Wheel)                      */
+  0x15, 0x81,        /*     Logical Minimum (-127)             */
+  0x25, 0x7F,        /*     Logical Maximum (127)              */
+  0x75, 0x08,        /*     Report Size (8)                    */
+  0x95, 0x03,        /*     Report Count (3)                   */
+  0x81, 0x06,        /*     Input (Data,Var,Rel)               */
+  0xC0,              /*   End Collection                       */
   0xC0               /* End Collection                         */
 };
 static uint8_t HIDInEpAdd = HID_EPIN_ADDR;
@@ -308,6 +339,9 @@ static uint8_t USBD_HID_Init(USBD_HandleTypeDef *pdev, uint8_t cfgidx)
 
   hhid->state = USBD_HID_IDLE;
 
+  /* HID 1.11 7.2.6: report protocol is the default after (re)configuration */
+  hhid->Protocol = 1U;
+
   return (uint8_t)USBD_OK;
 }
 
@@ -372,6 +406,12 @@ static uint8_t USBD_HID_Setup(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *re
           break;
 
         case USBD_HID_REQ_GET_PROTOCOL:
+          if (req->wLength != 1U)
+          {
+            USBD_CtlError(pdev, req);
+            ret = USBD_FAIL;
+            break;
+          }
           (void)USBD_CtlSendData(pdev, (uint8_t *)&hhid->Protocol, 1U);
           break;
 
@@ -380,6 +420,12 @@ static uint8_t USBD_HID_Setup(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *re
           break;
 
         case USBD_HID_REQ_GET_IDLE:
+          if (req->wLength != 1U)
+          {
+            USBD_CtlError(pdev, req);
+            ret = USBD_FAIL;
+            break;
+          }
           (void)USBD_CtlSendData(pdev, (uint8_t *)&hhid->IdleState, 1U);
           break;
 
@@ -393,7 +439,7 @@ static uint8_t USBD_HID_Setup(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *re
       switch (req->bRequest)
       {
         case USB_REQ_GET_STATUS:
-          if (pdev->dev_state == USBD_STATE_CONFIGURED)
+          if ((pdev->dev_state == USBD_STATE_CONFIGURED) && (req->wLength == 2U))
           {
             (void)USBD_CtlSendData(pdev, (uint8_t *)&status_info, 2U);
           }
@@ -425,7 +471,7 @@ static uint8_t USBD_HID_Setup(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *re
           break;
 
         case USB_REQ_GET_INTERFACE :
-          if (pdev->dev_state == USBD_STATE_CONFIGURED)
+          if ((pdev->dev_state == USBD_STATE_CONFIGURED) && (req->wLength == 1U))
           {
             (void)USBD_CtlSendData(pdev, (uint8_t *)&hhid->AltSetting, 1U);
           }
@@ -612,9 +658,46 @@ static uint8_t USBD_HID_DataIn(USBD_HandleTypeDef *pdev, uint8_t epnum)
   be caused by  a new transfer before the end of the previous transfer */
   ((USBD_HID_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId])->state = USBD_HID_IDLE;
 
+  USBD_HID_DataInCallback(pdev);
+
+  return (uint8_t)USBD_OK;
+}
+
+/**
+  * @brief  USBD_HID_SOF
+  *         handle SOF event (once per 1 ms frame at full speed)
+  * @param  pdev: device instance
+  * @retval status
+  */
+static uint8_t USBD_HID_SOF(USBD_HandleTypeDef *pdev)
+{
+  USBD_HID_SOFCallback(pdev);
+
   return (uint8_t)USBD_OK;
 }
 
+/**
+  * @brief  USBD_HID_SOFCallback
+  *         Frame tick for report scheduling, override in application code
+  * @param  pdev: device instance
+  * @retval None
+  */
+__weak void USBD_HID_SOFCallback(USBD_HandleTypeDef *pdev)
+{
+  UNUSED(pdev);
+}
+
+/**
+  * @brief  USBD_HID_DataInCallback
+  *         Report delivered to the host, override in application code
+  * @param  pdev: device instance
+  * @retval None
+  */
+__weak void USBD_HID_DataInCallback(USBD_HandleTypeDef *pdev)
+{
+  UNUSED(pdev);
+}
+
 #ifndef USE_USBD_COMPOSITE
 /**
   * @brief  DeviceQualifierDescriptor
@@ -344,6 +344,12 @@ USBD_StatusTypeDef USBD_StdEPReq(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef
           break;
 
         case USB_REQ_GET_STATUS:
+          if (req->wLength != 0x2U)
+          {
+            USBD_CtlError(pdev, req);
+            break;
+          }
+
           switch (pdev->dev_state)
           {
             case USBD_STATE_ADDRESSED:
@@ -378,8 +384,8 @@ USBD_StatusTypeDef USBD_StdEPReq(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef
                 }
               }
 
-              pep = ((ep_addr & 0x80U) == 0x80U) ? &pdev->ep_in[ep_addr & 0x7FU] : \
-                    &pdev->ep_out[ep_addr & 0x7FU];
+              pep = ((ep_addr & 0x80U) == 0x80U) ? &pdev->ep_in[ep_addr & 0xFU] : \
+                    &pdev->ep_out[ep_addr & 0xFU];
 
               if ((ep_addr == 0x00U) || (ep_addr == 0x80U))
               {
@@ -26,6 +26,8 @@
 #include "usbd_hid.h"
 
 /* USER CODE BEGIN Includes */
+#include "usbd_hid_cdc.h"
+#include "usbd_cdc_if.h"
 
 /* USER CODE END Includes */
 
@@ -71,7 +73,12 @@ void MX_USB_DEVICE_Init(void)
   {
     Error_Handler();
   }
-  if (USBD_RegisterClass(&hUsbDeviceFS, &USBD_HID) != USBD_OK)
+  /* HID keyboard on interface 0, CDC ACM (configuration port) on 1 and 2 */
+  if (USBD_RegisterClass(&hUsbDeviceFS, &USBD_HID_CDC) != USBD_OK)
+  {
+    Error_Handler();
+  }
+  if (USBD_HID_CDC_RegisterInterface(&hUsbDeviceFS, &USBD_Interface_fops_FS) != USBD_OK)
   {
     Error_Handler();
   }
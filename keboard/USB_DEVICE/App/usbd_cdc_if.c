@@ -0,0 +1,641 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : usbd_cdc_if.c
+  * @version        : v1.0_Cube
+  * @brief          : Usb device for Virtual Com Port.
+  ******************************************************************************
+  * @attention
+  *
+  * Copyright (c) 2025 STMicroelectronics.
+  * All rights reserved.
+  *
+  * This software is licensed under terms that can be found in the LICENSE file
+  * in the root directory of this software component.
+  * If no LICENSE file comes with this software, it is provided AS-IS.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_cdc_if.h"
+
+/* USER CODE BEGIN INCLUDE */
+#include <string.h>
+#include "rtos_app.h"
+/* USER CODE END INCLUDE */
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private define ------------------------------------------------------------*/
+/* Private macro -------------------------------------------------------------*/
+
+/* USER CODE BEGIN PV */
+/* Private variables ---------------------------------------------------------*/
+
+/* USER CODE END PV */
+
+/** @addtogroup STM32_USB_OTG_DEVICE_LIBRARY
+  * @brief Usb device library.
+  * @{
+  */
+
+/** @addtogroup USBD_CDC_IF
+  * @{
+  */
+
+/** @defgroup USBD_CDC_IF_Private_TypesDefinitions USBD_CDC_IF_Private_TypesDefinitions
+  * @brief Private types.
+  * @{
+  */
+
+/* USER CODE BEGIN PRIVATE_TYPES */
+
+/* USER CODE END PRIVATE_TYPES */
+
+/**
+  * @}
+  */
+
+/** @defgroup USBD_CDC_IF_Private_Defines USBD_CDC_IF_Private_Defines
+  * @brief Private defines.
+  * @{
+  */
+
+/* USER CODE BEGIN PRIVATE_DEFINES */
+/* UserTxBufferFS is the TX ring, indices are masked on access */
+#if (APP_TX_DATA_SIZE & (APP_TX_DATA_SIZE - 1)) != 0
+#error "APP_TX_DATA_SIZE must be a power of two"
+#endif
+#define CDC_TX_MASK   (APP_TX_DATA_SIZE - 1U)
+
+/* UserRxBufferFS is cut into one-packet slots, used in turn */
+#define CDC_RX_SLOT_SIZE   CDC_DATA_FS_OUT_PACKET_SIZE
+#define CDC_RX_SLOTS       (APP_RX_DATA_SIZE / CDC_RX_SLOT_SIZE)
+#if (CDC_RX_SLOTS < 2) || ((CDC_RX_SLOTS & (CDC_RX_SLOTS - 1)) != 0)
+#error "APP_RX_DATA_SIZE must be a power of two of at least two packets"
+#endif
+#define CDC_RX_MASK   (CDC_RX_SLOTS - 1U)
+/* USER CODE END PRIVATE_DEFINES */
+
+/**
+  * @}
+  */
+
+/** @defgroup USBD_CDC_IF_Private_Macros USBD_CDC_IF_Private_Macros
+  * @brief Private macros.
+  * @{
+  */
+
+/* USER CODE BEGIN PRIVATE_MACRO */
+
+/* USER CODE END PRIVATE_MACRO */
+
+/**
+  * @}
+  */
+
+/** @defgroup USBD_CDC_IF_Private_Variables USBD_CDC_IF_Private_Variables
+  * @brief Private variables.
+  * @{
+  */
+/* Create buffer for reception and transmission           */
+/* It's up to user to redefine and/or remove those define */
+/** Received data over USB are stored in this buffer      */
+uint8_t UserRxBufferFS[APP_RX_DATA_SIZE];
+
+/** Data to send over USB CDC are stored in this buffer   */
+uint8_t UserTxBufferFS[APP_TX_DATA_SIZE];
+
+/* USER CODE BEGIN PRIVATE_VARIABLES */
+/* TX ring: the writer (thread context) owns tx_head, the IN endpoint side
+ * owns tx_tail and advances it from CDC_TransmitCplt_FS() */
+static volatile uint32_t tx_head = 0;
+static volatile uint32_t tx_tail = 0;
+static volatile uint32_t tx_len = 0;      /* Bytes owned by the running IN transfer */
+
+/* RX queue: the OUT endpoint side owns rx_head (slots filled), the reader
+ * owns rx_tail (slots consumed). Slot rx_head is armed unless the queue
+ * is full; then rx_parked is set and the endpoint NAKs until a slot frees */
+static volatile uint32_t rx_head = 0;
+static volatile uint32_t rx_tail = 0;
+static volatile uint8_t rx_parked = 0;
+static uint16_t rx_len[CDC_RX_SLOTS];
+static uint16_t rx_pos = 0;               /* Bytes of slot rx_tail already read */
+
+/* Line coding as last set by the host (115200 8N1 as USART2 in main.c);
+ * line_coding_seq counts SET_LINE_CODING requests for the UART bridge */
+static USBD_HID_CDC_LineCodingTypeDef line_coding = {115200U, 0x00U, 0x00U, 0x08U};
+static volatile uint32_t line_coding_seq = 0;
+/* USER CODE END PRIVATE_VARIABLES */
+
+/**
+  * @}
+  */
+
+/** @defgroup USBD_CDC_IF_Exported_Variables USBD_CDC_IF_Exported_Variables
+  * @brief Public variables.
+  * @{
+  */
+
+extern USBD_HandleTypeDef hUsbDeviceFS;
+
+/* USER CODE BEGIN EXPORTED_VARIABLES */
+
+/* USER CODE END EXPORTED_VARIABLES */
+
+/**
+  * @}
+  */
+
+/** @defgroup USBD_CDC_IF_Private_FunctionPrototypes USBD_CDC_IF_Private_FunctionPrototypes
+  * @brief Private functions declaration.
+  * @{
+  */
+
+static int8_t CDC_Init_FS(void);
+static int8_t CDC_DeInit_FS(void);
+static int8_t CDC_Control_FS(uint8_t cmd, uint8_t* pbuf, uint16_t length);
+static int8_t CDC_Receive_FS(uint8_t* pbuf, uint32_t *Len);
+static int8_t CDC_TransmitCplt_FS(uint8_t *pbuf, uint32_t *Len, uint8_t epnum);
+
+/* USER CODE BEGIN PRIVATE_FUNCTIONS_DECLARATION */
+static void CDC_TxKick_FS(void);
+/* USER CODE END PRIVATE_FUNCTIONS_DECLARATION */
+
+/**
+  * @}
+  */
+
+USBD_HID_CDC_ItfTypeDef USBD_Interface_fops_FS =
+{
+  CDC_Init_FS,
+  CDC_DeInit_FS,
+  CDC_Control_FS,
+  CDC_Receive_FS,
+  CDC_TransmitCplt_FS
+};
+
+/* Private functions ---------------------------------------------------------*/
+/**
+  * @brief  Initializes the CDC media low layer over the FS USB IP
+  * @retval USBD_OK if all operations are OK else USBD_FAIL
+  */
+static int8_t CDC_Init_FS(void)
+{
+  /* USER CODE BEGIN 3 */
+  /* A transfer cut short by a bus reset is sent again from tx_tail */
+  tx_len = 0;
+  /* The class arms the OUT endpoint with slot 0 on return; received data
+   * not read yet belongs to the old session and is dropped */
+  rx_head = 0;
+  rx_tail = 0;
+  rx_pos = 0;
+  rx_parked = 0;
+  USBD_HID_CDC_Receive(&hUsbDeviceFS, UserRxBufferFS);
+  return (USBD_OK);
+  /* USER CODE END 3 */
+}
+
+/**
+  * @brief  DeInitializes the CDC media low layer
+  * @retval USBD_OK if all operations are OK else USBD_FAIL
+  */
+static int8_t CDC_DeInit_FS(void)
+{
+  /* USER CODE BEGIN 4 */
+  return (USBD_OK);
+  /* USER CODE END 4 */
+}
+
+/**
+  * @brief  Manage the CDC class requests
+  * @param  cmd: Command code
+  * @param  pbuf: Buffer containing command data (request parameters)
+  * @param  length: Number of data to be sent (in bytes)
+  * @retval Result of the operation: USBD_OK if all operations are OK else USBD_FAIL
+  */
+static int8_t CDC_Control_FS(uint8_t cmd, uint8_t* pbuf, uint16_t length)
+{
+  /* USER CODE BEGIN 5 */
+  switch(cmd)
+  {
+    case CDC_SEND_ENCAPSULATED_COMMAND:
+
+    break;
+
+    case CDC_GET_ENCAPSULATED_RESPONSE:
+
+    break;
+
+    case CDC_SET_COMM_FEATURE:
+
+    break;
+
+    case CDC_GET_COMM_FEATURE:
+
+    break;
+
+    case CDC_CLEAR_COMM_FEATURE:
+
+    break;
+
+  /*******************************************************************************/
+  /* Line Coding Structure                                                       */
+  /*-----------------------------------------------------------------------------*/
+  /* Offset | Field       | Size | Value  | Description                          */
+  /* 0      | dwDTERate   |   4  | Number |Data terminal rate, in bits per second*/
+  /* 4      | bCharFormat |   1  | Number | Stop bits                            */
+  /*                                        0 - 1 Stop bit                       */
+  /*                                        1 - 1.5 Stop bits                    */
+  /*                                        2 - 2 Stop bits                      */
+  /* 5      | bParityType |  1   | Number | Parity                               */
+  /*                                        0 - None                             */
+  /*                                        1 - Odd                              */
+  /*                                        2 - Even                             */
+  /*                                        3 - Mark                             */
+  /*                                        4 - Space                            */
+  /* 6      | bDataBits  |   1   | Number Data bits (5, 6, 7, 8 or 16).          */
+  /*******************************************************************************/
+    case CDC_SET_LINE_CODING:
+      if (length >= 7U)
+      {
+        line_coding.bitrate = (uint32_t)(pbuf[0] | (pbuf[1] << 8) | (pbuf[2] << 16) | ((uint32_t)pbuf[3] << 24));
+        line_coding.format = pbuf[4];
+        line_coding.paritytype = pbuf[5];
+        line_coding.datatype = pbuf[6];
+        line_coding_seq++;
+      }
+    break;
+
+    case CDC_GET_LINE_CODING:
+      pbuf[0] = (uint8_t)line_coding.bitrate;
+      pbuf[1] = (uint8_t)(line_coding.bitrate >> 8);
+      pbuf[2] = (uint8_t)(line_coding.bitrate >> 16);
+      pbuf[3] = (uint8_t)(line_coding.bitrate >> 24);
+      pbuf[4] = line_coding.format;
+      pbuf[5] = line_coding.paritytype;
+      pbuf[6] = line_coding.datatype;
+    break;
+
+    case CDC_SET_CONTROL_LINE_STATE:
+      /* Port opened: send what was queued while nobody listened */
+      CDC_TxKick_FS();
+    break;
+
+    case CDC_SEND_BREAK:
+
+    break;
+
+  default:
+    break;
+  }
+
+  return (USBD_OK);
+  /* USER CODE END 5 */
+}
+
+/**
+  * @brief  Data received over USB OUT endpoint are sent over CDC interface
+  *         through this function.
+  *
+  *         @note
+  *         This function will issue a NAK packet on any OUT packet received on
+  *         USB endpoint until exiting this function. If you exit this function
+  *         before transfer is complete on CDC interface (ie. using DMA controller)
+  *         it will result in receiving more data while previous ones are still
+  *         not sent.
+  *
+  *         The packet stays in its slot for CDC_Read_FS()/CDC_RxPeek_FS().
+  *         The next slot is armed only if it is free: with the queue full
+  *         the endpoint is left unarmed, the host sees NAKs and retries,
+  *         and CDC_RxRelease_FS() arms it again. Nothing is overwritten.
+  *
+  * @param  Buf: Buffer of data to be received
+  * @param  Len: Number of data received (in bytes)
+  * @retval Result of the operation: USBD_OK if all operations are OK else USBD_FAIL
+  */
+static int8_t CDC_Receive_FS(uint8_t* Buf, uint32_t *Len)
+{
+  /* USER CODE BEGIN 6 */
+  UNUSED(Buf);
+  if (*Len != 0U)
+  {
+    rx_len[rx_head & CDC_RX_MASK] = (uint16_t)*Len;
+    rx_head++;
+  }
+  /* A ZLP leaves the slot empty: armed again as is */
+  if (rx_head - rx_tail < CDC_RX_SLOTS)
+  {
+    USBD_HID_CDC_Receive(&hUsbDeviceFS, &UserRxBufferFS[(rx_head & CDC_RX_MASK) * CDC_RX_SLOT_SIZE]);
+  }
+  else
+  {
+    rx_parked = 1;
+  }
+  RTOS_App_Cdc_Rx();
+  return (USBD_OK);
+  /* USER CODE END 6 */
+}
+
+/**
+  * @brief  CDC_Transmit_FS
+  *         Data to send over USB IN endpoint are sent over CDC interface
+  *         through this function.
+  *         @note
+  *
+  *
+  * @param  Buf: Buffer of data to be sent
+  * @param  Len: Number of data to be sent (in bytes)
+  * @retval USBD_OK if all operations are OK else USBD_FAIL or USBD_BUSY
+  */
+uint8_t CDC_Transmit_FS(uint8_t* Buf, uint16_t Len)
+{
+  uint8_t result = USBD_OK;
+  /* USER CODE BEGIN 7 */
+  result = USBD_HID_CDC_Transmit(&hUsbDeviceFS, Buf, Len);
+  /* USER CODE END 7 */
+  return result;
+}
+
+/**
+  * @brief  CDC_TransmitCplt_FS
+  *         Data transmitted callback
+  *
+  *         @note
+  *         This function is IN transfer complete callback used to inform user that
+  *         the submitted Data is successfully sent over USB.
+  *
+  * @param  Buf: Buffer of data to be received
+  * @param  Len: Number of data received (in bytes)
+  * @retval Result of the operation: USBD_OK if all operations are OK else USBD_FAIL
+  */
+static int8_t CDC_TransmitCplt_FS(uint8_t *Buf, uint32_t *Len, uint8_t epnum)
+{
+  uint8_t result = USBD_OK;
+  /* USER CODE BEGIN 13 */
+  UNUSED(Buf);
+  UNUSED(Len);
+  UNUSED(epnum);
+  /* Release the sent bytes and chain the next chunk */
+  tx_tail += tx_len;
+  tx_len = 0;
+  CDC_TxKick_FS();
+  /* USER CODE END 13 */
+  return result;
+}
+
+/* USER CODE BEGIN PRIVATE_FUNCTIONS_IMPLEMENTATION */
+
+/**
+  * @brief  CDC_TxKick_FS
+  *         Start an IN transfer if the endpoint is idle and data is queued.
+  *         Each transfer covers the contiguous part of the ring up to the
+  *         wrap, so a busy endpoint collects everything written meanwhile
+  *         and sends it as full packets back to back. A transfer that ends
+  *         on a packet boundary is closed with a ZLP by usbd_hid_cdc.c.
+  *         Must run with interrupts masked or from the USB interrupt.
+  * @retval None
+  */
+static void CDC_TxKick_FS(void)
+{
+  uint32_t start, len;
+
+  if (tx_len != 0U || tx_head == tx_tail)
+  {
+    return;
+  }
+  /* Not configured yet; a running CDC_Transmit_FS() transfer makes
+   * USBD_HID_CDC_Transmit() return USBD_BUSY below */
+  if (hUsbDeviceFS.dev_state != USBD_STATE_CONFIGURED)
+  {
+    return;
+  }
+
+  start = tx_tail & CDC_TX_MASK;
+  len = tx_head - tx_tail;
+  if (len > APP_TX_DATA_SIZE - start)
+  {
+    len = APP_TX_DATA_SIZE - start;   /* Up to the wrap, rest in the next transfer */
+  }
+
+  if (USBD_HID_CDC_Transmit(&hUsbDeviceFS, &UserTxBufferFS[start], len) == USBD_OK)
+  {
+    tx_len = len;
+  }
+}
+
+/**
+  * @brief  CDC_TxReserve_FS
+  *         Contiguous free space at the head of the TX ring, to be filled in
+  *         place and queued with CDC_TxCommit_FS(). Thread context only.
+  * @param  Len: Receives the free space in bytes (may be less than
+  *         CDC_TxFree_FS() at the wrap, 0 if the ring is full)
+  * @retval Write pointer
+  */
+uint8_t *CDC_TxReserve_FS(uint16_t *Len)
+{
+  uint32_t pos = tx_head & CDC_TX_MASK;
+  uint32_t space = APP_TX_DATA_SIZE - (tx_head - tx_tail);
+
+  if (space > APP_TX_DATA_SIZE - pos)
+  {
+    space = APP_TX_DATA_SIZE - pos;
+  }
+  *Len = (uint16_t)space;
+  return &UserTxBufferFS[pos];
+}
+
+/**
+  * @brief  CDC_TxCommit_FS
+  *         Queue bytes written at the pointer from CDC_TxReserve_FS()
+  * @param  Len: Bytes written (at most the reserved length)
+  * @retval None
+  */
+void CDC_TxCommit_FS(uint16_t Len)
+{
+  uint32_t primask;
+
+  if (Len == 0U)
+  {
+    return;
+  }
+  tx_head += Len;
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+  CDC_TxKick_FS();
+  __set_PRIMASK(primask);
+}
+
+/**
+  * @brief  CDC_Write_FS
+  *         Copy data into the TX ring and start sending, never blocks.
+  *         Unlike CDC_Transmit_FS() the buffer can be reused on return and
+  *         a busy endpoint does not lose data.
+  * @param  Buf: Data to send
+  * @param  Len: Number of bytes
+  * @retval Bytes queued: Len, or less if the ring is full
+  */
+uint16_t CDC_Write_FS(const uint8_t* Buf, uint16_t Len)
+{
+  uint16_t done = 0;
+
+  while (done < Len)
+  {
+    uint16_t space;
+    uint8_t *dst = CDC_TxReserve_FS(&space);
+
+    if (space == 0U)
+    {
+      break;
+    }
+    if (space > Len - done)
+    {
+      space = Len - done;
+    }
+    memcpy(dst, Buf + done, space);
+    CDC_TxCommit_FS(space);
+    done += space;
+  }
+  return done;
+}
+
+/**
+  * @brief  CDC_RxPeek_FS
+  *         Oldest received packet not released yet (zero-copy read).
+  *         Thread context only.
+  * @param  Len: Receives the unread bytes of the packet
+  * @retval Pointer to the unread bytes, NULL if nothing was received
+  */
+uint8_t *CDC_RxPeek_FS(uint16_t *Len)
+{
+  uint32_t slot = rx_tail & CDC_RX_MASK;
+
+  if (rx_head == rx_tail)
+  {
+    *Len = 0;
+    return NULL;
+  }
+  *Len = rx_len[slot] - rx_pos;
+  return &UserRxBufferFS[slot * CDC_RX_SLOT_SIZE + rx_pos];
+}
+
+/**
+  * @brief  CDC_RxRelease_FS
+  *         Hand the packet from CDC_RxPeek_FS() back to the OUT endpoint.
+  *         Re-arms the endpoint if it was NAKing for lack of a free slot.
+  * @retval None
+  */
+void CDC_RxRelease_FS(void)
+{
+  uint32_t primask;
+
+  if (rx_head == rx_tail)
+  {
+    return;
+  }
+  rx_pos = 0;
+  rx_tail++;
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+  if (rx_parked)
+  {
+    rx_parked = 0;
+    USBD_HID_CDC_Receive(&hUsbDeviceFS, &UserRxBufferFS[(rx_head & CDC_RX_MASK) * CDC_RX_SLOT_SIZE]);
+  }
+  __set_PRIMASK(primask);
+}
+
+/**
+  * @brief  CDC_Read_FS
+  *         Copy received data out of the RX queue, never blocks.
+  *         Packets are released as they are emptied.
+  * @param  Buf: Destination
+  * @param  Len: Size of Buf
+  * @retval Bytes copied, 0 if nothing was received
+  */
+uint16_t CDC_Read_FS(uint8_t* Buf, uint16_t Len)
+{
+  uint16_t done = 0;
+
+  while (done < Len)
+  {
+    uint16_t avail;
+    uint8_t *src = CDC_RxPeek_FS(&avail);
+
+    if (src == NULL)
+    {
+      break;
+    }
+    if (avail > Len - done)
+    {
+      avail = Len - done;
+    }
+    memcpy(Buf + done, src, avail);
+    done += avail;
+    CDC_RxConsume_FS(avail);
+  }
+  return done;
+}
+
+/**
+  * @brief  CDC_RxConsume_FS
+  *         Mark bytes from CDC_RxPeek_FS() as read, for readers that parse
+  *         in place. The packet is released once all of it was consumed.
+  * @param  Len: Bytes consumed (at most the length returned by the peek)
+  * @retval None
+  */
+void CDC_RxConsume_FS(uint16_t Len)
+{
+  if (rx_head == rx_tail)
+  {
+    return;
+  }
+  rx_pos += Len;
+  if (rx_pos >= rx_len[rx_tail & CDC_RX_MASK])
+  {
+    CDC_RxRelease_FS();
+  }
+}
+
+/**
+  * @brief  CDC_TxFree_FS
+  *         Free space in the TX ring
+  * @retval Bytes CDC_Write_FS() accepts now
+  */
+uint16_t CDC_TxFree_FS(void)
+{
+  return (uint16_t)(APP_TX_DATA_SIZE - (tx_head - tx_tail));
+}
+
+/**
+  * @brief  CDC_GetLineCoding_FS
+  *         Line coding last set by the host with SET_LINE_CODING
+  * @param  Coding: Receives the line coding
+  * @retval Number of SET_LINE_CODING requests so far; a new value means
+  *         the host (re)configured the line since the last call
+  */
+uint32_t CDC_GetLineCoding_FS(USBD_HID_CDC_LineCodingTypeDef *Coding)
+{
+  uint32_t primask;
+  uint32_t seq;
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+  *Coding = line_coding;
+  seq = line_coding_seq;
+  __set_PRIMASK(primask);
+  return seq;
+}
+
+/* USER CODE END PRIVATE_FUNCTIONS_IMPLEMENTATION */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
@@ -0,0 +1,616 @@
+/**
+  ******************************************************************************
+  * @file    usbd_hid_cdc.c
+  * @brief   HID keyboard + CDC ACM composite class
+  *
+  *          The library is built without USE_USBD_COMPOSITE, so the core
+  *          hands every request and endpoint event to this one class:
+  *           - interface 0 and EP 0x81 go to the HID class (usbd_hid.c),
+  *             which keeps pClassData for its handle as before
+  *           - interfaces 1/2 and EPs 0x02/0x82/0x83 are the CDC ACM
+  *             function, handled here with a static handle (no malloc)
+  *          The configuration descriptor is the HID class's, followed by
+  *          the interface association and the CDC interfaces.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_hid_cdc.h"
+#include "usbd_ctlreq.h"
+
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+
+/** @defgroup USBD_HID_CDC
+  * @brief usbd core module
+  * @{
+  */
+
+/** @defgroup USBD_HID_CDC_Private_FunctionPrototypes
+  * @{
+  */
+
+static uint8_t USBD_HID_CDC_Init(USBD_HandleTypeDef *pdev, uint8_t cfgidx);
+static uint8_t USBD_HID_CDC_DeInit(USBD_HandleTypeDef *pdev, uint8_t cfgidx);
+static uint8_t USBD_HID_CDC_Setup(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req);
+static uint8_t USBD_HID_CDC_EP0_RxReady(USBD_HandleTypeDef *pdev);
+static uint8_t USBD_HID_CDC_DataIn(USBD_HandleTypeDef *pdev, uint8_t epnum);
+static uint8_t USBD_HID_CDC_DataOut(USBD_HandleTypeDef *pdev, uint8_t epnum);
+static uint8_t USBD_HID_CDC_SOF(USBD_HandleTypeDef *pdev);
+static uint8_t *USBD_HID_CDC_GetCfgDesc(uint16_t *length);
+static uint8_t *USBD_HID_CDC_GetDeviceQualifierDesc(uint16_t *length);
+static uint8_t USBD_CDC_Fn_Setup(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req);
+
+/**
+  * @}
+  */
+
+/** @defgroup USBD_HID_CDC_Private_Variables
+  * @{
+  */
+
+USBD_ClassTypeDef USBD_HID_CDC =
+{
+  USBD_HID_CDC_Init,
+  USBD_HID_CDC_DeInit,
+  USBD_HID_CDC_Setup,
+  NULL,                       /* EP0_TxSent */
+  USBD_HID_CDC_EP0_RxReady,
+  USBD_HID_CDC_DataIn,
+  USBD_HID_CDC_DataOut,
+  USBD_HID_CDC_SOF,
+  NULL,
+  NULL,
+  USBD_HID_CDC_GetCfgDesc,    /* Full speed only: one descriptor for all speeds */
+  USBD_HID_CDC_GetCfgDesc,
+  USBD_HID_CDC_GetCfgDesc,
+  USBD_HID_CDC_GetDeviceQualifierDesc,
+};
+
+/* CDC ACM function, appended to the HID configuration descriptor */
+static const uint8_t USBD_HID_CDC_FuncDesc[USB_HID_CDC_FUNC_DESC_SIZ] =
+{
+  /* Interface Association Descriptor */
+  0x08,                                       /* bLength */
+  0x0B,                                       /* bDescriptorType: IAD */
+  HID_CDC_COMM_ITF,                           /* bFirstInterface */
+  0x02,                                       /* bInterfaceCount */
+  0x02,                                       /* bFunctionClass: Communication */
+  0x02,                                       /* bFunctionSubClass: Abstract Control Model */
+  0x01,                                       /* bFunctionProtocol: Common AT commands */
+  0x00,                                       /* iFunction */
+
+  /* Communication Class Interface Descriptor */
+  0x09,                                       /* bLength: Interface Descriptor size */
+  USB_DESC_TYPE_INTERFACE,                    /* bDescriptorType: Interface */
+  HID_CDC_COMM_ITF,                           /* bInterfaceNumber: Number of Interface */
+  0x00,                                       /* bAlternateSetting: Alternate setting */
+  0x01,                                       /* bNumEndpoints: One endpoint used */
+  0x02,                                       /* bInterfaceClass: Communication Interface Class */
+  0x02,                                       /* bInterfaceSubClass: Abstract Control Model */
+  0x01,                                       /* bInterfaceProtocol: Common AT commands */
+  0x00,                                       /* iInterface */
+
+  /* Header Functional Descriptor */
+  0x05,                                       /* bLength: Endpoint Descriptor size */
+  0x24,                                       /* bDescriptorType: CS_INTERFACE */
+  0x00,                                       /* bDescriptorSubtype: Header Func Desc */
+  0x10,                                       /* bcdCDC: spec release number */
+  0x01,
+
+  /* Call Management Functional Descriptor */
+  0x05,                                       /* bFunctionLength */
+  0x24,                                       /* bDescriptorType: CS_INTERFACE */
+  0x01,                                       /* bDescriptorSubtype: Call Management Func Desc */
+  0x00,                                       /* bmCapabilities: D0+D1 */
+  HID_CDC_DATA_ITF,                           /* bDataInterface */
+
+  /* ACM Functional Descriptor */
+  0x04,                                       /* bFunctionLength */
+  0x24,                                       /* bDescriptorType: CS_INTERFACE */
+  0x02,                                       /* bDescriptorSubtype: Abstract Control Management desc */
+  0x02,                                       /* bmCapabilities */
+
+  /* Union Functional Descriptor */
+  0x05,                                       /* bFunctionLength */
+  0x24,                                       /* bDescriptorType: CS_INTERFACE */
+  0x06,                                       /* bDescriptorSubtype: Union func desc */
+  HID_CDC_COMM_ITF,                           /* bMasterInterface: Communication class interface */
+  HID_CDC_DATA_ITF,                           /* bSlaveInterface0: Data Class Interface */
+
+  /* Endpoint 3 Descriptor */
+  0x07,                                       /* bLength: Endpoint Descriptor size */
+  USB_DESC_TYPE_ENDPOINT,                     /* bDescriptorType: Endpoint */
+  CDC_CMD_EP,                                 /* bEndpointAddress */
+  0x03,                                       /* bmAttributes: Interrupt */
+  LOBYTE(CDC_CMD_PACKET_SIZE),                /* wMaxPacketSize */
+  HIBYTE(CDC_CMD_PACKET_SIZE),
+  CDC_FS_BINTERVAL,                           /* bInterval */
+
+  /* Data class interface descriptor */
+  0x09,                                       /* bLength: Endpoint Descriptor size */
+  USB_DESC_TYPE_INTERFACE,                    /* bDescriptorType: */
+  HID_CDC_DATA_ITF,                           /* bInterfaceNumber: Number of Interface */
+  0x00,                                       /* bAlternateSetting: Alternate setting */
+  0x02,                                       /* bNumEndpoints: Two endpoints used */
+  0x0A,                                       /* bInterfaceClass: CDC */
+  0x00,                                       /* bInterfaceSubClass */
+  0x00,                                       /* bInterfaceProtocol */
+  0x00,                                       /* iInterface */
+
+  /* Endpoint OUT Descriptor */
+  0x07,                                       /* bLength: Endpoint Descriptor size */
+  USB_DESC_TYPE_ENDPOINT,                     /* bDescriptorType: Endpoint */
+  CDC_OUT_EP,                                 /* bEndpointAddress */
+  0x02,                                       /* bmAttributes: Bulk */
+  LOBYTE(CDC_DATA_FS_MAX_PACKET_SIZE),        /* wMaxPacketSize */
+  HIBYTE(CDC_DATA_FS_MAX_PACKET_SIZE),
+  0x00,                                       /* bInterval */
+
+  /* Endpoint IN Descriptor */
+  0x07,                                       /* bLength: Endpoint Descriptor size */
+  USB_DESC_TYPE_ENDPOINT,                     /* bDescriptorType: Endpoint */
+  CDC_IN_EP,                                  /* bEndpointAddress */
+  0x02,                                       /* bmAttributes: Bulk */
+  LOBYTE(CDC_DATA_FS_MAX_PACKET_SIZE),        /* wMaxPacketSize */
+  HIBYTE(CDC_DATA_FS_MAX_PACKET_SIZE),
+  0x00                                        /* bInterval */
+};
+
+/* Assembled by USBD_HID_CDC_GetCfgDesc() */
+__ALIGN_BEGIN static uint8_t USBD_HID_CDC_CfgDesc[USB_HID_CDC_CONFIG_DESC_SIZ] __ALIGN_END;
+
+/* One FS device: the CDC function state is static */
+static USBD_HID_CDC_HandleTypeDef hcdc_fs;
+static USBD_HID_CDC_ItfTypeDef *cdc_fops = NULL;
+
+/**
+  * @}
+  */
+
+/** @defgroup USBD_HID_CDC_Private_Functions
+  * @{
+  */
+
+/**
+  * @brief  USBD_HID_CDC_Init
+  *         Initialize the HID interface, then open the CDC endpoints
+  * @param  pdev: device instance
+  * @param  cfgidx: Configuration index
+  * @retval status
+  */
+static uint8_t USBD_HID_CDC_Init(USBD_HandleTypeDef *pdev, uint8_t cfgidx)
+{
+  uint8_t ret = USBD_HID.Init(pdev, cfgidx);
+
+  if (ret != (uint8_t)USBD_OK)
+  {
+    return ret;
+  }
+
+  /* Open EP IN */
+  (void)USBD_LL_OpenEP(pdev, CDC_IN_EP, USBD_EP_TYPE_BULK, CDC_DATA_FS_IN_PACKET_SIZE);
+  pdev->ep_in[CDC_IN_EP & 0xFU].is_used = 1U;
+
+  /* Open EP OUT */
+  (void)USBD_LL_OpenEP(pdev, CDC_OUT_EP, USBD_EP_TYPE_BULK, CDC_DATA_FS_OUT_PACKET_SIZE);
+  pdev->ep_out[CDC_OUT_EP & 0xFU].is_used = 1U;
+
+  /* Open Command IN EP */
+  pdev->ep_in[CDC_CMD_EP & 0xFU].bInterval = CDC_FS_BINTERVAL;
+  (void)USBD_LL_OpenEP(pdev, CDC_CMD_EP, USBD_EP_TYPE_INTR, CDC_CMD_PACKET_SIZE);
+  pdev->ep_in[CDC_CMD_EP & 0xFU].is_used = 1U;
+
+  hcdc_fs.RxBuffer = NULL;
+  hcdc_fs.TxState = 0U;
+  hcdc_fs.CmdOpCode = 0xFFU;
+
+  /* Init physical Interface components */
+  if (cdc_fops != NULL)
+  {
+    (void)cdc_fops->Init();
+  }
+  hcdc_fs.Active = 1U;
+
+  if (hcdc_fs.RxBuffer == NULL)
+  {
+    return (uint8_t)USBD_EMEM;
+  }
+
+  /* Prepare Out endpoint to receive next packet */
+  (void)USBD_LL_PrepareReceive(pdev, CDC_OUT_EP, hcdc_fs.RxBuffer, CDC_DATA_FS_OUT_PACKET_SIZE);
+
+  return (uint8_t)USBD_OK;
+}
+
+/**
+  * @brief  USBD_HID_CDC_DeInit
+  *         DeInitialize both functions
+  * @param  pdev: device instance
+  * @param  cfgidx: Configuration index
+  * @retval status
+  */
+static uint8_t USBD_HID_CDC_DeInit(USBD_HandleTypeDef *pdev, uint8_t cfgidx)
+{
+  (void)USBD_LL_CloseEP(pdev, CDC_IN_EP);
+  pdev->ep_in[CDC_IN_EP & 0xFU].is_used = 0U;
+
+  (void)USBD_LL_CloseEP(pdev, CDC_OUT_EP);
+  pdev->ep_out[CDC_OUT_EP & 0xFU].is_used = 0U;
+
+  (void)USBD_LL_CloseEP(pdev, CDC_CMD_EP);
+  pdev->ep_in[CDC_CMD_EP & 0xFU].is_used = 0U;
+  pdev->ep_in[CDC_CMD_EP & 0xFU].bInterval = 0U;
+
+  if (hcdc_fs.Active != 0U)
+  {
+    hcdc_fs.Active = 0U;
+    if (cdc_fops != NULL)
+    {
+      (void)cdc_fops->DeInit();
+    }
+  }
+
+  return USBD_HID.DeInit(pdev, cfgidx);
+}
+
+/**
+  * @brief  USBD_HID_CDC_Setup
+  *         Route a request by interface or endpoint to its function
+  * @param  pdev: instance
+  * @param  req: usb requests
+  * @retval status
+  */
+static uint8_t USBD_HID_CDC_Setup(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req)
+{
+  switch (req->bmRequest & USB_REQ_RECIPIENT_MASK)
+  {
+    case USB_REQ_RECIPIENT_INTERFACE:
+      if (LOBYTE(req->wIndex) != HID_CDC_HID_ITF)
+      {
+        return USBD_CDC_Fn_Setup(pdev, req);
+      }
+      break;
+
+    case USB_REQ_RECIPIENT_ENDPOINT:
+      if (LOBYTE(req->wIndex) != HID_EPIN_ADDR)
+      {
+        return USBD_CDC_Fn_Setup(pdev, req);
+      }
+      break;
+
+    default:
+      break;
+  }
+
+  return USBD_HID.Setup(pdev, req);
+}
+
+/**
+  * @brief  USBD_CDC_Fn_Setup
+  *         Requests to the CDC interfaces and endpoints
+  * @param  pdev: instance
+  * @param  req: usb requests
+  * @retval status
+  */
+static uint8_t USBD_CDC_Fn_Setup(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req)
+{
+  USBD_HID_CDC_HandleTypeDef *hcdc = &hcdc_fs;
+  uint16_t len;
+  uint8_t ifalt = 0U;
+  uint16_t status_info = 0U;
+  USBD_StatusTypeDef ret = USBD_OK;
+
+  switch (req->bmRequest & USB_REQ_TYPE_MASK)
+  {
+    case USB_REQ_TYPE_CLASS:
+      if (cdc_fops == NULL)
+      {
+        USBD_CtlError(pdev, req);
+        ret = USBD_FAIL;
+        break;
+      }
+      if (req->wLength != 0U)
+      {
+        if ((req->bmRequest & 0x80U) != 0U)
+        {
+          len = MIN(CDC_REQ_MAX_DATA_SIZE, req->wLength);
+          (void)cdc_fops->Control(req->bRequest, (uint8_t *)hcdc->data, len);
+          (void)USBD_CtlSendData(pdev, (uint8_t *)hcdc->data, len);
+        }
+        else
+        {
+          hcdc->CmdOpCode = req->bRequest;
+          hcdc->CmdLength = (uint8_t)MIN(req->wLength, USB_MAX_EP0_SIZE);
+
+          (void)USBD_CtlPrepareRx(pdev, (uint8_t *)hcdc->data, hcdc->CmdLength);
+        }
+      }
+      else
+      {
+        (void)cdc_fops->Control(req->bRequest, (uint8_t *)req, 0U);
+      }
+      break;
+
+    case USB_REQ_TYPE_STANDARD:
+      switch (req->bRequest)
+      {
+        case USB_REQ_GET_STATUS:
+          if ((pdev->dev_state == USBD_STATE_CONFIGURED) && (req->wLength == 2U))
+          {
+            (void)USBD_CtlSendData(pdev, (uint8_t *)&status_info, 2U);
+          }
+          else
+          {
+            USBD_CtlError(pdev, req);
+            ret = USBD_FAIL;
+          }
+          break;
+
+        case USB_REQ_GET_INTERFACE:
+          if ((pdev->dev_state == USBD_STATE_CONFIGURED) && (req->wLength == 1U))
+          {
+            (void)USBD_CtlSendData(pdev, &ifalt, 1U);
+          }
+          else
+          {
+            USBD_CtlError(pdev, req);
+            ret = USBD_FAIL;
+          }
+          break;
+
+        case USB_REQ_SET_INTERFACE:
+          if (pdev->dev_state != USBD_STATE_CONFIGURED || req->wValue != 0U)
+          {
+            USBD_CtlError(pdev, req);
+            ret = USBD_FAIL;
+          }
+          break;
+
+        case USB_REQ_CLEAR_FEATURE:
+          break;
+
+        default:
+          USBD_CtlError(pdev, req);
+          ret = USBD_FAIL;
+          break;
+      }
+      break;
+
+    default:
+      USBD_CtlError(pdev, req);
+      ret = USBD_FAIL;
+      break;
+  }
+
+  return (uint8_t)ret;
+}
+
+/**
+  * @brief  USBD_HID_CDC_EP0_RxReady
+  *         Data stage of a CDC class request (SET_LINE_CODING)
+  * @param  pdev: device instance
+  * @retval status
+  */
+static uint8_t USBD_HID_CDC_EP0_RxReady(USBD_HandleTypeDef *pdev)
+{
+  UNUSED(pdev);
+
+  if ((cdc_fops != NULL) && (hcdc_fs.CmdOpCode != 0xFFU))
+  {
+    (void)cdc_fops->Control(hcdc_fs.CmdOpCode, (uint8_t *)hcdc_fs.data, (uint16_t)hcdc_fs.CmdLength);
+    hcdc_fs.CmdOpCode = 0xFFU;
+  }
+
+  return (uint8_t)USBD_OK;
+}
+
+/**
+  * @brief  USBD_HID_CDC_DataIn
+  *         Data sent on non-control IN endpoint
+  * @param  pdev: device instance
+  * @param  epnum: endpoint number
+  * @retval status
+  */
+static uint8_t USBD_HID_CDC_DataIn(USBD_HandleTypeDef *pdev, uint8_t epnum)
+{
+  USBD_HID_CDC_HandleTypeDef *hcdc = &hcdc_fs;
+
+  if (epnum == (HID_EPIN_ADDR & 0xFU))
+  {
+    return USBD_HID.DataIn(pdev, epnum);
+  }
+  if (epnum != (CDC_IN_EP & 0xFU))
+  {
+    return (uint8_t)USBD_OK;
+  }
+
+  if ((pdev->ep_in[epnum].total_length > 0U) &&
+      ((pdev->ep_in[epnum].total_length % CDC_DATA_FS_IN_PACKET_SIZE) == 0U))
+  {
+    /* Update the packet total length */
+    pdev->ep_in[epnum].total_length = 0U;
+
+    /* Send ZLP */
+    (void)USBD_LL_Transmit(pdev, epnum, NULL, 0U);
+  }
+  else
+  {
+    hcdc->TxState = 0U;
+
+    if (cdc_fops != NULL && cdc_fops->TransmitCplt != NULL)
+    {
+      (void)cdc_fops->TransmitCplt(hcdc->TxBuffer, &hcdc->TxLength, epnum);
+    }
+  }
+
+  return (uint8_t)USBD_OK;
+}
+
+/**
+  * @brief  USBD_HID_CDC_DataOut
+  *         Data received on non-control Out endpoint
+  * @param  pdev: device instance
+  * @param  epnum: endpoint number
+  * @retval status
+  */
+static uint8_t USBD_HID_CDC_DataOut(USBD_HandleTypeDef *pdev, uint8_t epnum)
+{
+  USBD_HID_CDC_HandleTypeDef *hcdc = &hcdc_fs;
+
+  if (epnum != (CDC_OUT_EP & 0xFU) || cdc_fops == NULL)
+  {
+    return (uint8_t)USBD_OK;
+  }
+
+  /* Get the received data length */
+  hcdc->RxLength = USBD_LL_GetRxDataSize(pdev, epnum);
+
+  /* The application re-arms the endpoint (USBD_HID_CDC_Receive) when it
+     has room for the next packet */
+  (void)cdc_fops->Receive(hcdc->RxBuffer, &hcdc->RxLength);
+
+  return (uint8_t)USBD_OK;
+}
+
+/**
+  * @brief  USBD_HID_CDC_SOF
+  *         Start of frame, for the HID report timing
+  * @param  pdev: device instance
+  * @retval status
+  */
+static uint8_t USBD_HID_CDC_SOF(USBD_HandleTypeDef *pdev)
+{
+  return USBD_HID.SOF(pdev);
+}
+
+/**
+  * @brief  USBD_HID_CDC_GetCfgDesc
+  *         The HID class configuration descriptor with the CDC function
+  *         appended; built on every call so it follows the HID class
+  * @param  length : pointer data length
+  * @retval pointer to descriptor buffer
+  */
+static uint8_t *USBD_HID_CDC_GetCfgDesc(uint16_t *length)
+{
+  uint16_t hid_len;
+  uint8_t *hid = USBD_HID.GetFSConfigDescriptor(&hid_len);
+
+  (void)USBD_memcpy(USBD_HID_CDC_CfgDesc, hid, USB_HID_CONFIG_DESC_SIZ);
+  (void)USBD_memcpy(&USBD_HID_CDC_CfgDesc[USB_HID_CONFIG_DESC_SIZ], USBD_HID_CDC_FuncDesc,
+                    sizeof(USBD_HID_CDC_FuncDesc));
+
+  USBD_HID_CDC_CfgDesc[2] = LOBYTE(USB_HID_CDC_CONFIG_DESC_SIZ);
+  USBD_HID_CDC_CfgDesc[3] = HIBYTE(USB_HID_CDC_CONFIG_DESC_SIZ);
+  USBD_HID_CDC_CfgDesc[4] = HID_CDC_NUM_ITF;
+
+  *length = (uint16_t)sizeof(USBD_HID_CDC_CfgDesc);
+  return USBD_HID_CDC_CfgDesc;
+}
+
+/**
+  * @brief  USBD_HID_CDC_GetDeviceQualifierDesc
+  *         return Device Qualifier descriptor
+  * @param  length : pointer data length
+  * @retval pointer to descriptor buffer
+  */
+static uint8_t *USBD_HID_CDC_GetDeviceQualifierDesc(uint16_t *length)
+{
+  return USBD_HID.GetDeviceQualifierDescriptor(length);
+}
+
+/**
+  * @brief  USBD_HID_CDC_RegisterInterface
+  * @param  pdev: device instance
+  * @param  fops: CD  Interface callback
+  * @retval status
+  */
+uint8_t USBD_HID_CDC_RegisterInterface(USBD_HandleTypeDef *pdev, USBD_HID_CDC_ItfTypeDef *fops)
+{
+  UNUSED(pdev);
+
+  if (fops == NULL)
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  cdc_fops = fops;
+
+  return (uint8_t)USBD_OK;
+}
+
+/**
+  * @brief  USBD_HID_CDC_Transmit
+  *         Start an IN transfer on the CDC data endpoint. A transfer that
+  *         ends on a packet boundary is closed with a ZLP.
+  * @param  pdev: device instance
+  * @param  pbuff: Tx Buffer, in use until TransmitCplt
+  * @param  length: Tx Buffer length
+  * @retval USBD_OK, USBD_BUSY while a transfer runs, USBD_FAIL if not configured
+  */
+uint8_t USBD_HID_CDC_Transmit(USBD_HandleTypeDef *pdev, uint8_t *pbuff, uint32_t length)
+{
+  USBD_HID_CDC_HandleTypeDef *hcdc = &hcdc_fs;
+
+  if (hcdc->Active == 0U)
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+  if (hcdc->TxState != 0U)
+  {
+    return (uint8_t)USBD_BUSY;
+  }
+
+  /* Tx Transfer in progress */
+  hcdc->TxState = 1U;
+  hcdc->TxBuffer = pbuff;
+  hcdc->TxLength = length;
+
+  /* Update the packet total length */
+  pdev->ep_in[CDC_IN_EP & 0xFU].total_length = length;
+
+  /* Transmit next packet */
+  (void)USBD_LL_Transmit(pdev, CDC_IN_EP, pbuff, length);
+
+  return (uint8_t)USBD_OK;
+}
+
+/**
+  * @brief  USBD_HID_CDC_Receive
+  *         Arm the CDC data OUT endpoint for one packet. From Init the
+  *         buffer set here is armed on return.
+  * @param  pdev: device instance
+  * @param  pbuff: Rx Buffer of CDC_DATA_FS_OUT_PACKET_SIZE bytes
+  * @retval status
+  */
+uint8_t USBD_HID_CDC_Receive(USBD_HandleTypeDef *pdev, uint8_t *pbuff)
+{
+  USBD_HID_CDC_HandleTypeDef *hcdc = &hcdc_fs;
+
+  hcdc->RxBuffer = pbuff;
+  if (hcdc->Active == 0U)
+  {
+    /* Called from the interface Init(): armed by USBD_HID_CDC_Init() */
+    return (uint8_t)USBD_OK;
+  }
+
+  (void)USBD_LL_PrepareReceive(pdev, CDC_OUT_EP, pbuff, CDC_DATA_FS_OUT_PACKET_SIZE);
+
+  return (uint8_t)USBD_OK;
+}
+/**
+  * @}
+  */
+
+
+/**
+  * @}
+  */
+
+
+/**
+  * @}
+  */
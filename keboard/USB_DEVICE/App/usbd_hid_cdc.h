@@ -0,0 +1,156 @@
+/**
+  ******************************************************************************
+  * @file    usbd_hid_cdc.h
+  * @brief   Header file for usbd_hid_cdc.c: HID keyboard + CDC ACM composite
+  ******************************************************************************
+  * Interface 0 is the keyboard/mouse HID interface of the HID class
+  * (usbd_hid.c, unchanged). Interfaces 1 and 2 are a CDC ACM function
+  * grouped by an interface association descriptor; its data path is
+  * implemented here with the same callbacks as the ST CDC class, so the
+  * application side (usbd_cdc_if.c) looks like the usb/ project's.
+  *
+  * Endpoints (OTG_FS has 4 per direction):
+  *   0x81  HID interrupt IN
+  *   0x82  CDC bulk IN       0x02  CDC bulk OUT
+  *   0x83  CDC notification interrupt IN
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USBD_HID_CDC_H
+#define __USBD_HID_CDC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_ioreq.h"
+#include "usbd_hid.h"
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup USBD_HID_CDC
+  * @brief This file is the Header file for usbd_hid_cdc.c
+  * @{
+  */
+
+
+/** @defgroup USBD_HID_CDC_Exported_Defines
+  * @{
+  */
+#define HID_CDC_HID_ITF                             0x00U
+#define HID_CDC_COMM_ITF                            0x01U
+#define HID_CDC_DATA_ITF                            0x02U
+#define HID_CDC_NUM_ITF                             0x03U
+
+#define CDC_IN_EP                                   0x82U  /* EP2 for data IN */
+#define CDC_OUT_EP                                  0x02U  /* EP2 for data OUT */
+#define CDC_CMD_EP                                  0x83U  /* EP3 for CDC commands */
+
+#ifndef CDC_FS_BINTERVAL
+#define CDC_FS_BINTERVAL                            0x10U
+#endif /* CDC_FS_BINTERVAL */
+
+#define CDC_DATA_FS_MAX_PACKET_SIZE                 64U
+#define CDC_CMD_PACKET_SIZE                         8U
+#define CDC_DATA_FS_IN_PACKET_SIZE                  CDC_DATA_FS_MAX_PACKET_SIZE
+#define CDC_DATA_FS_OUT_PACKET_SIZE                 CDC_DATA_FS_MAX_PACKET_SIZE
+#define CDC_REQ_MAX_DATA_SIZE                       0x7U
+
+#define USB_HID_CDC_FUNC_DESC_SIZ                   66U
+#define USB_HID_CDC_CONFIG_DESC_SIZ                 (USB_HID_CONFIG_DESC_SIZ + USB_HID_CDC_FUNC_DESC_SIZ)
+
+/*---------------------------------------------------------------------*/
+/*  CDC definitions                                                    */
+/*---------------------------------------------------------------------*/
+#define CDC_SEND_ENCAPSULATED_COMMAND               0x00U
+#define CDC_GET_ENCAPSULATED_RESPONSE               0x01U
+#define CDC_SET_COMM_FEATURE                        0x02U
+#define CDC_GET_COMM_FEATURE                        0x03U
+#define CDC_CLEAR_COMM_FEATURE                      0x04U
+#define CDC_SET_LINE_CODING                         0x20U
+#define CDC_GET_LINE_CODING                         0x21U
+#define CDC_SET_CONTROL_LINE_STATE                  0x22U
+#define CDC_SEND_BREAK                              0x23U
+
+/**
+  * @}
+  */
+
+
+/** @defgroup USBD_HID_CDC_Exported_TypesDefinitions
+  * @{
+  */
+
+typedef struct
+{
+  int8_t (* Init)(void);
+  int8_t (* DeInit)(void);
+  int8_t (* Control)(uint8_t cmd, uint8_t *pbuf, uint16_t length);
+  int8_t (* Receive)(uint8_t *Buf, uint32_t *Len);
+  int8_t (* TransmitCplt)(uint8_t *Buf, uint32_t *Len, uint8_t epnum);
+} USBD_HID_CDC_ItfTypeDef;
+
+
+typedef struct
+{
+  uint32_t data[CDC_DATA_FS_MAX_PACKET_SIZE / 4U];      /* Force 32-bit alignment */
+  uint8_t  CmdOpCode;
+  uint8_t  CmdLength;
+  uint8_t  *RxBuffer;
+  uint8_t  *TxBuffer;
+  uint32_t RxLength;
+  uint32_t TxLength;
+
+  __IO uint32_t TxState;
+  __IO uint32_t Active;
+} USBD_HID_CDC_HandleTypeDef;
+
+typedef struct
+{
+  uint32_t bitrate;
+  uint8_t  format;
+  uint8_t  paritytype;
+  uint8_t  datatype;
+} USBD_HID_CDC_LineCodingTypeDef;
+
+/**
+  * @}
+  */
+
+
+/** @defgroup USBD_HID_CDC_Exported_Variables
+  * @{
+  */
+
+extern USBD_ClassTypeDef USBD_HID_CDC;
+
+/**
+  * @}
+  */
+
+/** @defgroup USB_HID_CDC_Exported_Functions
+  * @{
+  */
+uint8_t USBD_HID_CDC_RegisterInterface(USBD_HandleTypeDef *pdev, USBD_HID_CDC_ItfTypeDef *fops);
+uint8_t USBD_HID_CDC_Transmit(USBD_HandleTypeDef *pdev, uint8_t *pbuff, uint32_t length);
+uint8_t USBD_HID_CDC_Receive(USBD_HandleTypeDef *pdev, uint8_t *pbuff);
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __USBD_HID_CDC_H */
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
@@ -0,0 +1,137 @@
+#!/usr/bin/env python3
+"""
+Benchmark Compare
+对比 BENCH 输出与基线, 找出性能回退 (见 Core/Src/bench.c)
+
+使用方法:
+  python3 bench_compare.py run.txt                         # 打印结果
+  python3 bench_compare.py run.txt --baseline base.txt     # 与基线对比
+  python3 bench_compare.py /dev/ttyUSB0 --save base.txt    # 从串口读取并保存为基线
+  sim/build/keyboard_bench | python3 bench_compare.py - --baseline sim_base.txt
+
+Input lines (other text on the port is ignored):
+  BENCH_BEGIN platform=<p> ... unit=<u>
+  BENCH <case> n=<n> min=<> med=<> avg=<> max=<> unit=<u>
+  BENCH_END
+A case regresses when its statistic (--stat, default med) grows by more
+than --threshold percent AND by more than --min-delta units, or grows at
+all from a baseline of 0; the exit code is 1 if any case regressed or
+disappeared. Serial ports need pyserial.
+"""
+
+import argparse
+import sys
+
+STATS = ("min", "med", "avg", "max")
+
+
+def parse(lines):
+    """Return (header dict, {case: {stat: int, 'unit': str}})"""
+    header = {}
+    cases = {}
+    for raw in lines:
+        line = raw.strip()
+        if line.startswith("BENCH_BEGIN"):
+            header = dict(f.split("=", 1) for f in line.split()[1:] if "=" in f)
+            cases = {}
+        elif line.startswith("BENCH_END"):
+            break
+        elif line.startswith("BENCH "):
+            fields = line.split()
+            if len(fields) < 3:
+                continue
+            entry = {}
+            for f in fields[2:]:
+                if "=" not in f:
+                    continue
+                key, value = f.split("=", 1)
+                entry[key] = value if key == "unit" else int(value)
+            cases[fields[1]] = entry
+    return header, cases
+
+
+def read_serial(port, baud):
+    try:
+        import serial
+    except ImportError:
+        raise SystemExit("pyserial is required for serial ports: pip install pyserial")
+    with serial.Serial(port, baud, timeout=30) as s:
+        while True:
+            line = s.readline().decode("ascii", "replace")
+            if not line:
+                raise SystemExit(f"{port}: timed out waiting for BENCH_END")
+            yield line
+            if line.startswith("BENCH_END"):
+                return
+
+
+def load(source, baud):
+    if source == "-":
+        return list(sys.stdin)
+    if source.startswith("/dev/") or source.upper().startswith("COM"):
+        return list(read_serial(source, baud))
+    with open(source, encoding="ascii", errors="replace") as f:
+        return f.readlines()
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compare BENCH results against a baseline")
+    parser.add_argument("source", help="result file, serial port or - for stdin")
+    parser.add_argument("--baseline", help="baseline result file")
+    parser.add_argument("--save", help="write the BENCH lines of this run to a file")
+    parser.add_argument("--stat", choices=STATS, default="med", help="statistic to compare")
+    parser.add_argument("--threshold", type=float, default=10.0, help="allowed growth in percent")
+    parser.add_argument("--min-delta", type=int, default=5, help="ignore growth below this many units")
+    parser.add_argument("--baud", type=int, default=115200, help="serial baud rate")
+    opts = parser.parse_args()
+
+    lines = load(opts.source, opts.baud)
+    header, cases = parse(lines)
+    if not cases:
+        raise SystemExit("no BENCH lines found")
+
+    if opts.save:
+        with open(opts.save, "w") as f:
+            for line in lines:
+                if line.startswith("BENCH"):
+                    f.write(line.rstrip("\r\n") + "\n")
+
+    if not opts.baseline:
+        print(f"# {' '.join(f'{k}={v}' for k, v in header.items())}")
+        for name, entry in cases.items():
+            print(f"{name:32s} " + " ".join(f"{s}={entry.get(s, 0):>7}" for s in STATS) + f" {entry.get('unit', '')}")
+        return 0
+
+    with open(opts.baseline, encoding="ascii", errors="replace") as f:
+        base_header, base = parse(f)
+    if base_header.get("platform") != header.get("platform"):
+        print(f"warning: platform {header.get('platform')} vs baseline {base_header.get('platform')}",
+              file=sys.stderr)
+
+    failed = 0
+    print(f"{'case':32s} {'base':>8s} {'now':>8s} {'change':>8s}")
+    for name, entry in cases.items():
+        if name not in base:
+            print(f"{name:32s} {'-':>8s} {entry[opts.stat]:>8d}      new")
+            continue
+        old, new = base[name][opts.stat], entry[opts.stat]
+        if old:
+            pct = (new - old) * 100.0 / old
+            regressed = (new - old) > opts.min_delta and pct > opts.threshold
+        else:
+            pct = float("inf") if new else 0.0
+            regressed = new > 0
+        flag = "  REGRESSION" if regressed else ""
+        failed += regressed
+        print(f"{name:32s} {old:>8d} {new:>8d} {pct:>+7.1f}%{flag}")
+    for name in base:
+        if name not in cases:
+            print(f"{name:32s} {base[name][opts.stat]:>8d} {'-':>8s}  missing")
+            failed += 1
+
+    print(f"# {failed} regression(s), stat={opts.stat}, threshold={opts.threshold}%, min-delta={opts.min_delta}")
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,234 @@
+#!/usr/bin/env python3
+"""
+Binary Log Decoder
+把 BLOG() 二进制日志还原为文本 (格式字符串从 ELF 的 .blog_fmt 段读取)
+
+使用方法:
+  python3 blog_decode.py build/keboard.elf capture.bin
+  python3 blog_decode.py build/keboard.elf /dev/ttyUSB0 [--baud 115200]
+
+The stream may mix printf() text and BLOG() records (see Core/Inc/blog.h):
+  tag   0xB0 | nargs
+  id    2 bytes little endian (offset of the format string in .blog_fmt)
+  delta LEB128, ms since the previous record
+  args  LEB128 each, uint32
+%s arguments are addresses of strings in flash and are read from the ELF.
+Serial ports need pyserial (pip install pyserial).
+"""
+
+import argparse
+import re
+import struct
+import sys
+
+BLOG_TAG = 0xB0
+BLOG_MAX_ARGS = 6
+
+SHF_ALLOC = 0x2
+SHT_NOBITS = 8
+
+FORMAT_RE = re.compile(r"%([-+ #0]*)(\*|\d+)?(?:\.(\d+))?(hh|h|ll|l|z|j|t)?([diouxXcsp%])")
+
+
+class Elf:
+    """Just enough of an ELF reader for section contents (ELF32 and ELF64, LE)"""
+
+    def __init__(self, path):
+        with open(path, "rb") as f:
+            self.data = f.read()
+        if self.data[:4] != b"\x7fELF":
+            raise SystemExit(f"{path}: not an ELF file")
+        is64 = self.data[4] == 2
+        if self.data[5] != 1:
+            raise SystemExit(f"{path}: big-endian ELF not supported")
+
+        if is64:
+            shoff, = struct.unpack_from("<Q", self.data, 0x28)
+            shentsize, shnum, shstrndx = struct.unpack_from("<HHH", self.data, 0x3A)
+            fmt = "<IIQQQQIIQQ"
+        else:
+            shoff, = struct.unpack_from("<I", self.data, 0x20)
+            shentsize, shnum, shstrndx = struct.unpack_from("<HHH", self.data, 0x2E)
+            fmt = "<IIIIIIIIII"
+
+        raw = []
+        for i in range(shnum):
+            (name, typ, flags, addr, offset, size,
+             _link, _info, _align, _entsize) = struct.unpack_from(fmt, self.data, shoff + i * shentsize)
+            raw.append((name, typ, flags, addr, offset, size))
+
+        strtab_off = raw[shstrndx][4]
+        self.sections = {}
+        self.alloc = []
+        for name, typ, flags, addr, offset, size in raw:
+            end = self.data.index(b"\0", strtab_off + name)
+            sname = self.data[strtab_off + name:end].decode()
+            self.sections[sname] = (addr, offset, size)
+            if flags & SHF_ALLOC and typ != SHT_NOBITS and size:
+                self.alloc.append((addr, offset, size))
+
+    def section(self, name):
+        if name not in self.sections:
+            return None
+        _addr, offset, size = self.sections[name]
+        return self.data[offset:offset + size]
+
+    def c_string(self, address):
+        """Read a NUL-terminated string from a loaded section"""
+        for addr, offset, size in self.alloc:
+            if addr <= address < addr + size:
+                start = offset + address - addr
+                end = self.data.find(b"\0", start, offset + size)
+                if end < 0:
+                    end = offset + size
+                return self.data[start:end].decode("utf-8", "replace")
+        return f"<0x{address:08x}>"
+
+
+def load_formats(elf):
+    """Map format string offset -> format string"""
+    blob = elf.section(".blog_fmt")
+    if blob is None:
+        raise SystemExit("ELF has no .blog_fmt section (built with BLOG_TEXT=1?)")
+    if len(blob) > 0x10000:
+        print("warning: .blog_fmt larger than 64 KB, ids are truncated", file=sys.stderr)
+    formats = {}
+    pos = 0
+    while pos < len(blob):
+        end = blob.find(b"\0", pos)
+        if end < 0:
+            end = len(blob)
+        if end > pos:
+            formats[pos] = blob[pos:end].decode("utf-8", "replace")
+        pos = end + 1
+    return formats
+
+
+def render(fmt, args, elf):
+    """printf-style formatting of the raw uint32 arguments"""
+    values = iter(args)
+
+    def one(m):
+        flags, width, precision, _length, conv = m.groups()
+        if conv == "%":
+            return "%"
+        if width == "*":
+            width = str(next(values, 0))
+        value = next(values, 0)
+        spec = "%" + flags + (width or "") + (("." + precision) if precision else "")
+        if conv in "di":
+            value = value - (1 << 32) if value & 0x80000000 else value
+            return (spec + "d") % value
+        if conv == "u":
+            return (spec + "d") % value
+        if conv == "c":
+            return (spec + "c") % chr(value & 0xFF)
+        if conv == "s":
+            return (spec + "s") % elf.c_string(value)
+        if conv == "p":
+            return "0x%08x" % value
+        return (spec + conv) % value
+
+    return FORMAT_RE.sub(one, fmt)
+
+
+class Decoder:
+    """Incremental decoder: feed bytes, get text lines"""
+
+    def __init__(self, elf, formats):
+        self.elf = elf
+        self.formats = formats
+        self.buf = bytearray()
+        self.text = bytearray()
+        self.tick = 0
+
+    @staticmethod
+    def _varint(buf, pos):
+        value = shift = 0
+        while True:
+            if pos >= len(buf):
+                return None, pos
+            b = buf[pos]
+            pos += 1
+            value |= (b & 0x7F) << shift
+            shift += 7
+            if not b & 0x80:
+                return value & 0xFFFFFFFF, pos
+            if shift > 35:
+                return value & 0xFFFFFFFF, pos
+
+    def _record(self):
+        """Try to parse one record at the start of buf; None if incomplete"""
+        nargs = self.buf[0] & 0x0F
+        if len(self.buf) < 3:
+            return None
+        msg_id = self.buf[1] | (self.buf[2] << 8)
+        delta, pos = self._varint(self.buf, 3)
+        if delta is None:
+            return None
+        args = []
+        for _ in range(nargs):
+            value, pos = self._varint(self.buf, pos)
+            if value is None:
+                return None
+            args.append(value)
+        del self.buf[:pos]
+
+        self.tick += delta
+        fmt = self.formats.get(msg_id)
+        if fmt is None:
+            body = f"<unknown id 0x{msg_id:04x} args {args}>"
+        else:
+            body = render(fmt, args, self.elf).rstrip("\r\n")
+        return f"[{self.tick // 1000:6d}.{self.tick % 1000:03d}] {body}"
+
+    def feed(self, data):
+        out = []
+        self.buf.extend(data)
+        while self.buf:
+            b = self.buf[0]
+            if BLOG_TAG <= b <= BLOG_TAG + BLOG_MAX_ARGS:
+                line = self._record()
+                if line is None:
+                    break
+                out.append(line)
+                continue
+            del self.buf[0]
+            if b == 0x0A:
+                out.append(self.text.decode("utf-8", "replace").rstrip("\r"))
+                self.text.clear()
+            else:
+                self.text.append(b)
+        return out
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode BLOG() binary logs")
+    parser.add_argument("elf", help="firmware ELF (build/keboard.elf)")
+    parser.add_argument("source", help="capture file or serial port")
+    parser.add_argument("--baud", type=int, default=115200, help="serial baud rate")
+    opts = parser.parse_args()
+
+    elf = Elf(opts.elf)
+    decoder = Decoder(elf, load_formats(elf))
+
+    if opts.source.startswith("/dev/") or opts.source.upper().startswith("COM"):
+        try:
+            import serial
+        except ImportError:
+            raise SystemExit("pyserial is required for serial ports: pip install pyserial")
+        port = serial.Serial(opts.source, opts.baud, timeout=0.1)
+        try:
+            while True:
+                for line in decoder.feed(port.read(256)):
+                    print(line, flush=True)
+        except KeyboardInterrupt:
+            pass
+    else:
+        with open(opts.source, "rb") as f:
+            for line in decoder.feed(f.read()):
+                print(line)
+
+
+if __name__ == "__main__":
+    main()
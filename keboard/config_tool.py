@@ -0,0 +1,396 @@
+#!/usr/bin/env python3
+"""
+Keyboard Config Tool
+通过 CDC 虚拟串口的二进制协议读写键盘配置 (设备端见 Core/Src/config_proto.c)
+
+使用方法:
+  python3 config_tool.py --port /dev/ttyACM0 info
+  python3 config_tool.py --port COM5 keymap                   # 读取全部按键
+  python3 config_tool.py --port COM5 keymap 0=0x1E 1=0x1F     # 修改按键 0 和 1
+  python3 config_tool.py --port COM5 debounce 5 [algo]
+  python3 config_tool.py --port COM5 macro 2 [68656c6c6f]     # 读取/写入宏 (十六进制)
+  python3 config_tool.py --port COM5 stats [--reset]
+  python3 config_tool.py --port COM5 latency
+  python3 config_tool.py --port COM5 apply keyboard.cfg       # 批量写入, 流水线发送
+  python3 config_tool.py --port COM5 bench [--count N]        # 请求吞吐量
+  python3 config_tool.py --loopback selftest                  # 主机上的软件 USB 总线
+
+Frames: 0xA5, len u16, id u16, cmd u8, payload, CRC-16/CCITT-FALSE u16 (all
+little endian, see Core/Inc/config_proto.h). Requests are pipelined: up to
+--window requests are in flight and the answers are matched by id.
+An apply file has one setting per line, '#' starts a comment:
+  keymap <first> <code> [<code> ...]
+  debounce <ms> [<algorithm>]
+  macro <n> <hex bytes>
+--loopback runs loopback/build/keyboard_cdc (--bin) instead of a serial port: the
+firmware on the USB stack over a modelled full speed bus. Serial ports
+need pyserial.
+Exit code: 0 = ok, 1 = the device refused a request or selftest failed,
+2 = device did not answer.
+"""
+
+import argparse
+import os
+import select
+import struct
+import subprocess
+import sys
+import time
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+LOOPBACK_BIN = os.path.join(HERE, "loopback", "build", "keyboard_cdc")
+
+TIMEOUT_S = 5.0
+SOF = 0xA5
+RESPONSE = 0x80
+PAYLOAD_MAX = 120               # CONFIG_PROTO_PAYLOAD_MAX
+
+CMD_PING, CMD_INFO = 0x00, 0x01
+CMD_KEYMAP_GET, CMD_KEYMAP_SET = 0x10, 0x11
+CMD_DEBOUNCE_GET, CMD_DEBOUNCE_SET = 0x20, 0x21
+CMD_MACRO_GET, CMD_MACRO_SET = 0x30, 0x31
+CMD_STATS_GET, CMD_STATS_RESET, CMD_LATENCY_GET = 0x40, 0x41, 0x42
+
+STATUS = ["ok", "unknown command", "bad length", "out of range", "flash write failed",
+          "crc error", "unsupported"]
+STATUS_OK, STATUS_UNKNOWN, STATUS_LENGTH, STATUS_RANGE, STATUS_FLASH, STATUS_CRC = range(6)
+
+ALGORITHMS = ["defer", "eager", "integrator"]
+LATENCY_STAGES = ["debounce", "build", "queue", "in", "total"]
+STATS = ["uptime_ms", "usb_frame", "rx_frames", "tx_frames", "crc_errors", "framing_errors", "busy"]
+
+
+class Timeout(Exception):
+    pass
+
+
+class Refused(Exception):
+    pass
+
+
+class SerialLink:
+    def __init__(self, port):
+        try:
+            import serial
+        except ImportError:
+            raise SystemExit("pyserial is required for serial ports: pip install pyserial")
+        self.s = serial.Serial(port, 115200, timeout=TIMEOUT_S, write_timeout=TIMEOUT_S)
+        self.s.reset_input_buffer()
+
+    def write(self, data):
+        self.s.write(data)
+
+    def read(self, n):
+        data = self.s.read(n)
+        if len(data) < n:
+            raise Timeout(f"got {len(data)} of {n} bytes")
+        return data
+
+    def close(self):
+        self.s.close()
+
+
+class LoopbackLink:
+    def __init__(self, path):
+        if not os.path.exists(path):
+            raise SystemExit(f"{path} not found: make -C loopback")
+        self.p = subprocess.Popen([path], stdin=subprocess.PIPE, stdout=subprocess.PIPE, bufsize=0)
+        self.fd = self.p.stdout.fileno()
+
+    def write(self, data):
+        self.p.stdin.write(data)
+
+    def read(self, n):
+        parts = []
+        deadline = time.monotonic() + TIMEOUT_S
+        while n > 0:
+            left = deadline - time.monotonic()
+            if left <= 0 or not select.select([self.fd], [], [], left)[0]:
+                raise Timeout(f"{n} bytes missing")
+            chunk = os.read(self.fd, n)
+            if not chunk:
+                raise Timeout("keyboard_cdc exited")
+            parts.append(chunk)
+            n -= len(chunk)
+        return b"".join(parts)
+
+    def close(self):
+        self.p.stdin.close()
+        self.p.wait()
+
+
+def crc16(data, crc=0xFFFF):
+    """CRC-16/CCITT-FALSE"""
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) & 0xFFFF if crc & 0x8000 else (crc << 1) & 0xFFFF
+    return crc
+
+
+def frame(req_id, cmd, payload=b""):
+    body = struct.pack("<HHB", 3 + len(payload), req_id, cmd) + payload
+    return bytes([SOF]) + body + struct.pack("<H", crc16(body))
+
+
+class Client:
+    def __init__(self, link, window=16):
+        self.link = link
+        self.window = window
+        self.next_id = 1
+        self.skipped = 0
+
+    def send(self, cmd, payload=b"", raw=None):
+        req_id = self.next_id
+        self.next_id = (self.next_id + 1) & 0xFFFF
+        self.link.write(raw(req_id) if raw else frame(req_id, cmd, payload))
+        return req_id
+
+    def receive(self):
+        """Next answer: (id, cmd, status, data)"""
+        while self.link.read(1)[0] != SOF:
+            self.skipped += 1
+        head = self.link.read(2)
+        length = struct.unpack("<H", head)[0]
+        if length < 4 or length > PAYLOAD_MAX + 3:
+            raise Timeout(f"answer with bad length {length}")
+        rest = self.link.read(length + 2)
+        if crc16(head + rest[:length]) != struct.unpack_from("<H", rest, length)[0]:
+            raise Timeout("answer with bad CRC")
+        req_id, cmd, status = struct.unpack_from("<HBB", rest)
+        return req_id, cmd & ~RESPONSE, status, rest[4:length]
+
+    def pipeline(self, requests):
+        """Send (cmd, payload) requests with up to window in flight, answers in order"""
+        answers = []
+        sent = []
+        for cmd, payload in requests:
+            if len(sent) - len(answers) >= self.window:
+                answers.append(self.expect(sent[len(answers)]))
+            sent.append((self.send(cmd, payload), cmd))
+        while len(answers) < len(sent):
+            answers.append(self.expect(sent[len(answers)]))
+        return answers
+
+    def expect(self, request):
+        req_id, cmd = request
+        got_id, got_cmd, status, data = self.receive()
+        if got_id != req_id or got_cmd != cmd:
+            raise Timeout(f"answer {got_id}/{got_cmd:#04x} for request {req_id}/{cmd:#04x}")
+        return status, data
+
+    def call(self, cmd, payload=b""):
+        status, data = self.pipeline([(cmd, payload)])[0]
+        if status != STATUS_OK:
+            raise Refused(f"command {cmd:#04x}: {STATUS[status] if status < len(STATUS) else status}")
+        return data
+
+
+def info(client):
+    version, payload_max, keys, macros, macro_size, stages = client.call(CMD_INFO)[:6]
+    return {"version": version, "payload_max": payload_max, "keys": keys, "macros": macros,
+            "macro_size": macro_size, "latency_stages": stages}
+
+
+def parse_int(text):
+    return int(text, 0)
+
+
+def apply_lines(lines):
+    """Requests for the settings of an apply file"""
+    requests = []
+    for n, line in enumerate(lines, 1):
+        words = line.split("#", 1)[0].split()
+        if not words:
+            continue
+        try:
+            if words[0] == "keymap":
+                requests.append((CMD_KEYMAP_SET, bytes(parse_int(w) for w in words[1:])))
+            elif words[0] == "debounce":
+                ms = parse_int(words[1])
+                algo = bytes([ALGORITHMS.index(words[2]) if words[2] in ALGORITHMS else parse_int(words[2])]) \
+                    if len(words) > 2 else b""
+                requests.append((CMD_DEBOUNCE_SET, struct.pack("<H", ms) + algo))
+            elif words[0] == "macro":
+                requests.append((CMD_MACRO_SET, bytes([parse_int(words[1])]) + bytes.fromhex("".join(words[2:]))))
+            else:
+                raise ValueError(f"unknown setting '{words[0]}'")
+        except (IndexError, ValueError) as e:
+            raise SystemExit(f"line {n}: {e}")
+    return requests
+
+
+def cmd_keymap(client, args):
+    keys = info(client)["keys"]
+    if args.values:
+        changes = dict(tuple(parse_int(x) for x in v.split("=", 1)) for v in args.values)
+        current = bytearray(client.call(CMD_KEYMAP_GET, bytes([0, keys])))
+        for key, code in changes.items():
+            current[key] = code
+        client.call(CMD_KEYMAP_SET, bytes([0]) + bytes(current))
+    for key, code in enumerate(client.call(CMD_KEYMAP_GET, bytes([0, keys]))):
+        print(f"key {key}: {code:#04x}")
+
+
+def cmd_debounce(client, args):
+    if args.values:
+        payload = struct.pack("<H", parse_int(args.values[0]))
+        if len(args.values) > 1:
+            a = args.values[1]
+            payload += bytes([ALGORITHMS.index(a) if a in ALGORITHMS else parse_int(a)])
+        client.call(CMD_DEBOUNCE_SET, payload)
+    ms, algo = struct.unpack("<HB", client.call(CMD_DEBOUNCE_GET))
+    print(f"debounce {ms} ms, {ALGORITHMS[algo] if algo < len(ALGORITHMS) else algo}")
+
+
+def cmd_macro(client, args):
+    if not args.values:
+        raise SystemExit("macro <n> [hex bytes]")
+    n = parse_int(args.values[0])
+    if len(args.values) > 1:
+        client.call(CMD_MACRO_SET, bytes([n]) + bytes.fromhex("".join(args.values[1:])))
+    data = client.call(CMD_MACRO_GET, bytes([n]))
+    print(f"macro {n}: {data.hex() if data else '(unset)'}")
+
+
+def cmd_stats(client, args):
+    for name, value in zip(STATS, struct.unpack("<7I", client.call(CMD_STATS_GET))):
+        print(f"{name:15s} {value}")
+    if args.reset:
+        client.call(CMD_STATS_RESET)
+
+
+def cmd_latency(client, args):
+    print(f"{'stage':>9} {'count':>8} {'min us':>8} {'p50':>8} {'p90':>8} {'p99':>8} {'max':>8}")
+    for stage, name in enumerate(LATENCY_STAGES):
+        count, lo, p50, p90, p99, hi = struct.unpack("<6I", client.call(CMD_LATENCY_GET, bytes([stage])))
+        print(f"{name:>9} {count:>8} {lo:>8} {p50:>8} {p90:>8} {p99:>8} {hi:>8}")
+
+
+def cmd_apply(client, args):
+    if len(args.values) != 1:
+        raise SystemExit("apply <file>")
+    with open(args.values[0]) as f:
+        requests = apply_lines(f)
+    t0 = time.perf_counter()
+    answers = client.pipeline(requests)
+    dt = time.perf_counter() - t0
+    failed = [(i, s) for i, (s, _) in enumerate(answers) if s != STATUS_OK]
+    for i, s in failed:
+        print(f"setting {i + 1}: {STATUS[s] if s < len(STATUS) else s}", file=sys.stderr)
+    print(f"{len(requests) - len(failed)} of {len(requests)} settings applied in {dt * 1e3:.1f} ms")
+    return 1 if failed else 0
+
+
+def cmd_bench(client, args):
+    for size in (0, 32, PAYLOAD_MAX - 1):
+        payload = bytes(range(size))
+        t0 = time.perf_counter()
+        answers = client.pipeline([(CMD_PING, payload)] * args.count)
+        dt = time.perf_counter() - t0
+        if any(s != STATUS_OK or d != payload for s, d in answers):
+            raise Refused(f"ping {size}: echo differs")
+        print(f"ping {size:>3} bytes: {args.count / dt:>8.0f} requests/s "
+              f"({dt / args.count * 1e6:.0f} us each, window {client.window})")
+
+
+def cmd_selftest(client, args):
+    """Protocol checks against a device whose settings may be changed"""
+    errors = []
+
+    def check(ok, what):
+        if not ok:
+            errors.append(what)
+
+    dev = info(client)
+    keys = dev["keys"]
+    check(dev["payload_max"] == PAYLOAD_MAX, f"payload max {dev['payload_max']}")
+
+    # Pipelined pings of every size, answers in order
+    pings = [(CMD_PING, bytes((i * 7 + j) & 0xFF for j in range(i % PAYLOAD_MAX))) for i in range(300)]
+    for (_, payload), (status, data) in zip(pings, client.pipeline(pings)):
+        check(status == STATUS_OK and data == payload, f"ping {len(payload)}")
+
+    # Settings round trip
+    keymap = client.call(CMD_KEYMAP_GET, bytes([0, keys]))
+    client.call(CMD_KEYMAP_SET, bytes([0]) + keymap[::-1])
+    check(client.call(CMD_KEYMAP_GET, bytes([0, keys])) == keymap[::-1], "keymap write")
+    client.call(CMD_KEYMAP_SET, bytes([0]) + keymap)
+    debounce = client.call(CMD_DEBOUNCE_GET)
+    client.call(CMD_DEBOUNCE_SET, struct.pack("<HB", 7, 2))
+    check(client.call(CMD_DEBOUNCE_GET) == struct.pack("<HB", 7, 2), "debounce write")
+    client.call(CMD_DEBOUNCE_SET, debounce)
+    client.call(CMD_MACRO_SET, bytes([dev["macros"] - 1]) + b"selftest")
+    check(client.call(CMD_MACRO_GET, bytes([dev["macros"] - 1])) == b"selftest", "macro write")
+
+    # Refused requests
+    for cmd, payload, want in [(0x7F, b"", STATUS_UNKNOWN), (CMD_INFO, b"x", STATUS_LENGTH),
+                               (CMD_KEYMAP_GET, bytes([keys - 1, 2]), STATUS_RANGE),
+                               (CMD_MACRO_GET, bytes([dev["macros"]]), STATUS_RANGE),
+                               (CMD_DEBOUNCE_SET, struct.pack("<H", 101), STATUS_RANGE),
+                               (CMD_DEBOUNCE_SET, struct.pack("<HB", 5, 3), STATUS_RANGE),
+                               (CMD_MACRO_SET, bytes([0]) + bytes(dev["macro_size"] + 1), STATUS_LENGTH)]:
+        status = client.pipeline([(cmd, payload)])[0][0]
+        check(status == want, f"command {cmd:#04x}: status {status}, expected {want}")
+    check(client.call(CMD_DEBOUNCE_GET) == debounce, "debounce changed by a refused write")
+
+    # Framing: garbage is skipped, a corrupted frame is answered with a CRC error
+    client.call(CMD_STATS_RESET)
+    client.link.write(b"\x00\x11\xA5\xFF\xFF")
+    bad = client.send(CMD_PING, raw=lambda i: frame(i, CMD_PING, b"abc")[:-1]
+                      + bytes([frame(i, CMD_PING, b"abc")[-1] ^ 0xFF]))
+    check(client.expect((bad, CMD_PING))[0] == STATUS_CRC, "corrupted frame")
+    check(client.call(CMD_PING, b"after") == b"after", "resync after garbage")
+    stats = dict(zip(STATS, struct.unpack("<7I", client.call(CMD_STATS_GET))))
+    check(stats["crc_errors"] == 1, f"crc_errors {stats['crc_errors']}")
+    check(stats["framing_errors"] >= 2, f"framing_errors {stats['framing_errors']}")
+    check(client.skipped == 0, f"{client.skipped} bytes between answers")
+
+    for e in errors:
+        print(f"selftest: {e}", file=sys.stderr)
+    print(f"selftest {'failed' if errors else 'ok'}: protocol v{dev['version']}, {keys} keys, "
+          f"{len(pings)} pipelined pings")
+    return 1 if errors else 0
+
+
+COMMANDS = {
+    "info": lambda c, a: print(" ".join(f"{k}={v}" for k, v in info(c).items())),
+    "keymap": cmd_keymap,
+    "debounce": cmd_debounce,
+    "macro": cmd_macro,
+    "stats": cmd_stats,
+    "latency": cmd_latency,
+    "apply": cmd_apply,
+    "bench": cmd_bench,
+    "selftest": cmd_selftest,
+}
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Keyboard configuration over the CDC port")
+    where = parser.add_mutually_exclusive_group(required=True)
+    where.add_argument("--port", help="serial port of the keyboard")
+    where.add_argument("--loopback", action="store_true", help="run keyboard_cdc (see --bin)")
+    parser.add_argument("--bin", default=LOOPBACK_BIN, help="--loopback binary (default %(default)s)")
+    parser.add_argument("--window", type=int, default=16, help="requests in flight (default %(default)s)")
+    parser.add_argument("--count", type=int, default=1000, help="bench: requests per size (default %(default)s)")
+    parser.add_argument("--reset", action="store_true", help="stats: reset the counters after reading")
+    parser.add_argument("command", choices=COMMANDS)
+    parser.add_argument("values", nargs="*")
+    args = parser.parse_args()
+
+    link = LoopbackLink(args.bin) if args.loopback else SerialLink(args.port)
+    try:
+        return COMMANDS[args.command](Client(link, max(1, args.window)), args) or 0
+    except Timeout as e:
+        print(f"no answer: {e}", file=sys.stderr)
+        return 2
+    except Refused as e:
+        print(e, file=sys.stderr)
+        return 1
+    finally:
+        link.close()
+
+
+if __name__ == "__main__":
+    sys.exit(main())
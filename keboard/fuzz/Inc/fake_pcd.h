@@ -0,0 +1,51 @@
+/**
+  ******************************************************************************
+  * @file           : fake_pcd.h
+  * @brief          : Fake USB OTG_FS peripheral for host builds of the stack
+  *
+  * Implements the USBD_LL_* interface of usbd_conf.c in memory and lets a
+  * harness play the host: SETUP packets, OUT data packets, IN tokens, SOF,
+  * bus reset and suspend/resume. Endpoint behaviour follows the F4 HAL PCD
+  * driver: EP0 moves one packet per callback and an OUT packet is stored at
+  * the armed buffer without checking its size, as the RXFLVL handler does.
+  * Bus activity while suspended resumes the device first, like WKUPINT.
+  * Rule violations by the stack (EP0 IN data larger than wLength, bad
+  * address, transfers on closed endpoints) end the process via
+  * Fake_Pcd_Fail().
+  ******************************************************************************
+  */
+
+#ifndef __FAKE_PCD_H
+#define __FAKE_PCD_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "usbd_def.h"
+
+#define FAKE_PCD_EP_COUNT     16U     /* Size of the HAL PCD endpoint tables */
+#define FAKE_PCD_EP0_MPS      64U
+
+/* Host side result of a token */
+#define FAKE_PCD_ACK          0
+#define FAKE_PCD_NAK          1
+#define FAKE_PCD_STALL        2
+
+/* Function Prototypes */
+void Fake_Pcd_Bus_Reset(void);
+void Fake_Pcd_Setup(const uint8_t setup[8]);
+int Fake_Pcd_Out(uint8_t epnum, const uint8_t *data, uint16_t len);
+int Fake_Pcd_In(uint8_t epnum, uint8_t *data, uint16_t *len);
+void Fake_Pcd_Sof(void);
+void Fake_Pcd_Suspend(void);
+void Fake_Pcd_Resume(void);
+uint8_t Fake_Pcd_Address(void);
+uint32_t Fake_Pcd_Allocations(void);
+void Fake_Pcd_Fail(const char *fmt, ...) __attribute__((noreturn, format(printf, 1, 2)));
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __FAKE_PCD_H */
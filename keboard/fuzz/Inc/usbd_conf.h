@@ -0,0 +1,63 @@
+/**
+  ******************************************************************************
+  * @file           : usbd_conf.h
+  * @brief          : USB device library configuration for host builds
+  *
+  * Shadows USB_DEVICE/Target/usbd_conf.h: same device configuration, but no
+  * HAL, no PCD and no unique-ID registers. The low level driver is the fake
+  * PCD in fake_pcd.c.
+  ******************************************************************************
+  */
+
+#ifndef __USBD_CONF__H__
+#define __USBD_CONF__H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Same values as USB_DEVICE/Target/usbd_conf.h */
+#define USBD_MAX_NUM_INTERFACES     3U
+#define USBD_MAX_NUM_CONFIGURATION  1U
+#define USBD_MAX_STR_DESC_SIZ       512U
+#define USBD_DEBUG_LEVEL            0U
+#define USBD_LPM_ENABLED            0U
+#define USBD_SELF_POWERED           1U
+#define HID_FS_BINTERVAL            0x1U
+
+#define DEVICE_FS                   0
+#define DEVICE_HS                   1
+
+/* Normally provided by the CMSIS core and HAL headers */
+#define __IO                        volatile
+#define __STATIC_INLINE             static inline
+#define __PACKED                    __attribute__((packed))
+#define UNUSED(x)                   ((void)(x))
+
+/* Unique device ID read by usbd_desc.c for the serial number string */
+extern uint32_t fake_uid[3];
+#define UID_BASE                    ((uintptr_t)fake_uid)
+
+#define USBD_malloc                 (void *)USBD_static_malloc
+#define USBD_free                   USBD_static_free
+#define USBD_memset                 memset
+#define USBD_memcpy                 memcpy
+#define USBD_Delay(ms)              ((void)(ms))
+
+#define USBD_UsrLog(...)
+#define USBD_ErrLog(...)
+#define USBD_DbgLog(...)
+
+void *USBD_static_malloc(uint32_t size);
+void USBD_static_free(void *p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __USBD_CONF__H__ */
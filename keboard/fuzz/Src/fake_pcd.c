@@ -0,0 +1,365 @@
+/**
+  ******************************************************************************
+  * @file           : fake_pcd.c
+  * @brief          : Fake USB OTG_FS peripheral (USBD_LL_* in memory)
+  ******************************************************************************
+  */
+
+#include "fake_pcd.h"
+#include "usbd_core.h"
+#include <stdarg.h>
+
+typedef struct {
+    uint8_t open;
+    uint8_t stalled;
+    uint8_t armed;
+    uint16_t mps;
+    uint8_t *buf;
+    uint32_t len;           /* Armed transfer length */
+    uint32_t count;         /* Bytes moved so far */
+} Fake_Ep_t;
+
+static USBD_HandleTypeDef *dev = NULL;
+static Fake_Ep_t ep_in[FAKE_PCD_EP_COUNT];
+static Fake_Ep_t ep_out[FAKE_PCD_EP_COUNT];
+static uint8_t address = 0;
+static uint8_t suspended = 0;
+static uint32_t allocations = 0;
+
+uint32_t fake_uid[3] = {0x00470032U, 0x3431510DU, 0x33383639U};
+
+/**
+  * @brief Report a USB rule violated by the stack and stop
+  */
+void Fake_Pcd_Fail(const char *fmt, ...)
+{
+    va_list ap;
+
+    va_start(ap, fmt);
+    fprintf(stderr, "fake_pcd: ");
+    vfprintf(stderr, fmt, ap);
+    fprintf(stderr, "\n");
+    va_end(ap);
+    abort();
+}
+
+/* Like HAL_PCD_*: the endpoint number is masked, not checked */
+static Fake_Ep_t *Fake_Pcd_Ep(uint8_t ep_addr)
+{
+    uint8_t epnum = ep_addr & 0xFU;
+
+    return (ep_addr & 0x80U) ? &ep_in[epnum] : &ep_out[epnum];
+}
+
+/* The core raises WKUPINT on bus activity before it delivers any token */
+static void Fake_Pcd_Wakeup(void)
+{
+    if (suspended) {
+        suspended = 0;
+        USBD_LL_Resume(dev);
+    }
+}
+
+/* ---------------------------------------------------------------------------
+ * Host side
+ * ------------------------------------------------------------------------- */
+
+/**
+  * @brief USB bus reset: all endpoints closed, address 0
+  * @retval None
+  */
+void Fake_Pcd_Bus_Reset(void)
+{
+    memset(ep_in, 0, sizeof(ep_in));
+    memset(ep_out, 0, sizeof(ep_out));
+    address = 0;
+    Fake_Pcd_Wakeup();
+    USBD_LL_SetSpeed(dev, USBD_SPEED_FULL);
+    USBD_LL_Reset(dev);
+}
+
+/**
+  * @brief SETUP packet on EP0
+  * A SETUP is always accepted: it clears an EP0 stall and cancels the
+  * control transfer in progress.
+  * @param setup: 8-byte SETUP packet
+  * @retval None
+  */
+void Fake_Pcd_Setup(const uint8_t setup[8])
+{
+    uint8_t packet[8];
+
+    Fake_Pcd_Wakeup();
+    ep_in[0].stalled = 0;
+    ep_in[0].armed = 0;
+    ep_out[0].stalled = 0;
+    ep_out[0].armed = 0;
+
+    memcpy(packet, setup, sizeof(packet));
+    USBD_LL_SetupStage(dev, packet);
+}
+
+/**
+  * @brief OUT data packet
+  * @param epnum: Endpoint number
+  * @param data: Packet payload
+  * @param len: Payload size (clamped to the endpoint packet size)
+  * @retval FAKE_PCD_ACK, _NAK or _STALL
+  */
+int Fake_Pcd_Out(uint8_t epnum, const uint8_t *data, uint16_t len)
+{
+    Fake_Ep_t *ep = Fake_Pcd_Ep(epnum & 0x7FU);
+
+    Fake_Pcd_Wakeup();
+    if (!ep->open || ep->stalled) return FAKE_PCD_STALL;
+    if (!ep->armed) return FAKE_PCD_NAK;
+    if (len > ep->mps) len = ep->mps;
+
+    /* Like the RXFLVL handler: the packet lands at the buffer pointer without
+     * a size check. A NULL buffer is the status stage; on the target the
+     * payload goes to address 0 (flash alias, writes ignored). */
+    if (ep->buf != NULL && len > 0U) {
+        memcpy(ep->buf + ep->count, data, len);
+    }
+    ep->count += len;
+
+    if ((epnum & 0x7FU) == 0U || ep->count >= ep->len || len < ep->mps) {
+        ep->armed = 0;
+        USBD_LL_DataOutStage(dev, epnum & 0x7FU, ep->buf);
+    }
+    return FAKE_PCD_ACK;
+}
+
+/**
+  * @brief IN token
+  * @param epnum: Endpoint number
+  * @param data: Receives the packet (at least the endpoint packet size), may be NULL
+  * @param len: Receives the packet length, may be NULL
+  * @retval FAKE_PCD_ACK, _NAK or _STALL
+  */
+int Fake_Pcd_In(uint8_t epnum, uint8_t *data, uint16_t *len)
+{
+    static uint8_t sink[FAKE_PCD_EP0_MPS];
+    Fake_Ep_t *ep = Fake_Pcd_Ep((epnum & 0x7FU) | 0x80U);
+    uint32_t n;
+
+    Fake_Pcd_Wakeup();
+    if (!ep->open || ep->stalled) return FAKE_PCD_STALL;
+    if (!ep->armed) return FAKE_PCD_NAK;
+
+    n = ep->len - ep->count;
+    if (n > ep->mps) n = ep->mps;
+    if (n > 0U) {
+        /* Touch every byte the FIFO would read */
+        memcpy(data ? data : sink, ep->buf + ep->count, n);
+    }
+    ep->count += n;
+    if (len) *len = (uint16_t)n;
+
+    /* EP0 completes per packet, the others when the transfer is done */
+    if ((epnum & 0x7FU) == 0U || ep->count >= ep->len) {
+        ep->armed = 0;
+        USBD_LL_DataInStage(dev, epnum & 0x7FU, ep->buf);
+    }
+    return FAKE_PCD_ACK;
+}
+
+void Fake_Pcd_Sof(void)
+{
+    Fake_Pcd_Wakeup();
+    USBD_LL_SOF(dev);
+}
+
+void Fake_Pcd_Suspend(void)
+{
+    suspended = 1;
+    USBD_LL_Suspend(dev);
+}
+
+void Fake_Pcd_Resume(void)
+{
+    suspended = 0;
+    USBD_LL_Resume(dev);
+}
+
+uint8_t Fake_Pcd_Address(void)
+{
+    return address;
+}
+
+/* ---------------------------------------------------------------------------
+ * USBD_LL_* (device side, replaces USB_DEVICE/Target/usbd_conf.c)
+ * ------------------------------------------------------------------------- */
+
+USBD_StatusTypeDef USBD_LL_Init(USBD_HandleTypeDef *pdev)
+{
+    dev = pdev;
+    memset(ep_in, 0, sizeof(ep_in));
+    memset(ep_out, 0, sizeof(ep_out));
+    address = 0;
+    suspended = 0;
+    return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_DeInit(USBD_HandleTypeDef *pdev)
+{
+    (void)pdev;
+    dev = NULL;
+    return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_Start(USBD_HandleTypeDef *pdev)
+{
+    (void)pdev;
+    return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_Stop(USBD_HandleTypeDef *pdev)
+{
+    (void)pdev;
+    return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_OpenEP(USBD_HandleTypeDef *pdev, uint8_t ep_addr, uint8_t ep_type, uint16_t ep_mps)
+{
+    Fake_Ep_t *ep = Fake_Pcd_Ep(ep_addr);
+
+    (void)pdev;
+    (void)ep_type;
+    if (ep_mps == 0U || ep_mps > FAKE_PCD_EP0_MPS) {
+        Fake_Pcd_Fail("endpoint 0x%02X opened with packet size %u", ep_addr, ep_mps);
+    }
+    memset(ep, 0, sizeof(*ep));
+    ep->open = 1;
+    ep->mps = ep_mps;
+    return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_CloseEP(USBD_HandleTypeDef *pdev, uint8_t ep_addr)
+{
+    Fake_Ep_t *ep = Fake_Pcd_Ep(ep_addr);
+
+    (void)pdev;
+    ep->open = 0;
+    ep->armed = 0;
+    return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_FlushEP(USBD_HandleTypeDef *pdev, uint8_t ep_addr)
+{
+    (void)pdev;
+    Fake_Pcd_Ep(ep_addr)->armed = 0;
+    return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_StallEP(USBD_HandleTypeDef *pdev, uint8_t ep_addr)
+{
+    (void)pdev;
+    Fake_Pcd_Ep(ep_addr)->stalled = 1;
+    return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_ClearStallEP(USBD_HandleTypeDef *pdev, uint8_t ep_addr)
+{
+    (void)pdev;
+    Fake_Pcd_Ep(ep_addr)->stalled = 0;
+    return USBD_OK;
+}
+
+uint8_t USBD_LL_IsStallEP(USBD_HandleTypeDef *pdev, uint8_t ep_addr)
+{
+    (void)pdev;
+    return Fake_Pcd_Ep(ep_addr)->stalled;
+}
+
+USBD_StatusTypeDef USBD_LL_SetUSBAddress(USBD_HandleTypeDef *pdev, uint8_t dev_addr)
+{
+    (void)pdev;
+    if (dev_addr > 127U) {
+        Fake_Pcd_Fail("device address %u", dev_addr);
+    }
+    address = dev_addr;
+    return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_Transmit(USBD_HandleTypeDef *pdev, uint8_t ep_addr, uint8_t *pbuf, uint32_t size)
+{
+    /* The stack passes 0x00 for EP0 IN; the PCD only looks at the number */
+    Fake_Ep_t *ep = Fake_Pcd_Ep((ep_addr & 0x7FU) | 0x80U);
+
+    if (!ep->open) {
+        Fake_Pcd_Fail("transmit on closed endpoint 0x%02X", ep_addr | 0x80U);
+    }
+    if ((ep_addr & 0x7FU) == 0U && pdev->ep0_state == USBD_EP0_DATA_IN && size > pdev->request.wLength) {
+        Fake_Pcd_Fail("EP0 IN data stage of %lu bytes for wLength %u (request %02X %02X)",
+                      (unsigned long)size, pdev->request.wLength,
+                      pdev->request.bmRequest, pdev->request.bRequest);
+    }
+    if (size > 0U && pbuf == NULL) {
+        Fake_Pcd_Fail("transmit of %lu bytes from NULL on 0x%02X", (unsigned long)size, ep_addr | 0x80U);
+    }
+    ep->buf = pbuf;
+    ep->len = size;
+    ep->count = 0;
+    ep->armed = 1;
+    return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_PrepareReceive(USBD_HandleTypeDef *pdev, uint8_t ep_addr, uint8_t *pbuf, uint32_t size)
+{
+    Fake_Ep_t *ep = Fake_Pcd_Ep(ep_addr & 0x7FU);
+
+    (void)pdev;
+    if (!ep->open) {
+        Fake_Pcd_Fail("receive on closed endpoint 0x%02X", ep_addr & 0x7FU);
+    }
+    ep->buf = pbuf;
+    ep->len = size;
+    ep->count = 0;
+    ep->armed = 1;
+    return USBD_OK;
+}
+
+uint32_t USBD_LL_GetRxDataSize(USBD_HandleTypeDef *pdev, uint8_t ep_addr)
+{
+    (void)pdev;
+    return Fake_Pcd_Ep(ep_addr & 0x7FU)->count;
+}
+
+USBD_StatusTypeDef USBD_LL_SetTestMode(USBD_HandleTypeDef *pdev, uint8_t testmode)
+{
+    (void)pdev;
+    (void)testmode;
+    return USBD_OK;
+}
+
+void USBD_LL_Delay(uint32_t Delay)
+{
+    (void)Delay;
+}
+
+/**
+  * @brief Class data allocation
+  * Heap instead of the firmware's static block, so that the sanitizers see
+  * its exact size and any use after USBD_free().
+  */
+void *USBD_static_malloc(uint32_t size)
+{
+    allocations++;
+    return malloc(size);
+}
+
+void USBD_static_free(void *p)
+{
+    if (p != NULL) allocations--;
+    free(p);
+}
+
+/**
+  * @brief Class data blocks not given back with USBD_free()
+  * @retval Number of live allocations
+  */
+uint32_t Fake_Pcd_Allocations(void)
+{
+    return allocations;
+}
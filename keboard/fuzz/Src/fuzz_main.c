@@ -0,0 +1,350 @@
+/**
+  ******************************************************************************
+  * @file           : fuzz_main.c
+  * @brief          : Stand-alone driver for the fuzz target (gcc, AFL)
+  *
+  * usb_fuzz_replay [options] <file|dir>...
+  *   Runs every input once (corpus regression, coverage runs, crash repro).
+  *   Without inputs one input is read from stdin (AFL without @@).
+  * usb_fuzz_replay -mutate N [-seed S] [-max_len L] [-out DIR] <corpus>...
+  *   Small coverage-guided mutation loop for machines without libFuzzer:
+  *   the USB stack is built with -fsanitize-coverage=trace-pc, inputs that
+  *   reach new edges join the pool and are written to DIR.
+  * A failing input (sanitizer report or abort) is saved as crash-<hash>.
+  ******************************************************************************
+  */
+
+#include <dirent.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+#define FUZZ_POOL_MAX     4096U
+#define FUZZ_COV_SIZE     65536U
+
+typedef struct {
+    uint8_t *data;
+    size_t size;
+} Fuzz_Input_t;
+
+static Fuzz_Input_t pool[FUZZ_POOL_MAX];
+static uint32_t pool_count = 0;
+
+static const uint8_t *cur_data = NULL;
+static size_t cur_size = 0;
+
+/* Edge coverage of the instrumented sources */
+static uint8_t cov_run[FUZZ_COV_SIZE];
+static uint8_t cov_seen[FUZZ_COV_SIZE];
+static uintptr_t cov_prev = 0;
+static uint32_t cov_edges = 0;
+
+void __sanitizer_cov_trace_pc(void)
+{
+    uintptr_t pc = (uintptr_t)__builtin_return_address(0);
+
+    cov_run[(pc ^ cov_prev) & (FUZZ_COV_SIZE - 1U)] = 1;
+    cov_prev = pc >> 1;
+}
+
+/**
+  * @brief FNV-1a of an input, names the crash file
+  */
+static uint32_t Fuzz_Hash(const uint8_t *data, size_t size)
+{
+    uint32_t h = 2166136261U;
+
+    for (size_t i = 0; i < size; i++) {
+        h = (h ^ data[i]) * 16777619U;
+    }
+    return h;
+}
+
+static void Fuzz_Write(const char *path, const uint8_t *data, size_t size)
+{
+    FILE *f = fopen(path, "wb");
+
+    if (f == NULL) return;
+    fwrite(data, 1, size, f);
+    fclose(f);
+}
+
+/**
+  * @brief Save the input being run when the process dies
+  */
+static void Fuzz_Save_Crash(void)
+{
+    char path[32];
+
+    if (cur_data == NULL) return;
+    snprintf(path, sizeof(path), "crash-%08x", (unsigned)Fuzz_Hash(cur_data, cur_size));
+    Fuzz_Write(path, cur_data, cur_size);
+    fprintf(stderr, "==fuzz== input saved to %s (%zu bytes)\n", path, cur_size);
+    cur_data = NULL;
+}
+
+static void Fuzz_On_Abort(int sig)
+{
+    Fuzz_Save_Crash();
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+#if defined(__SANITIZE_ADDRESS__)
+void __sanitizer_set_death_callback(void (*callback)(void));
+#endif
+
+/**
+  * @brief Run one input
+  * @retval Number of new coverage edges
+  */
+static uint32_t Fuzz_Run(const uint8_t *data, size_t size)
+{
+    uint32_t fresh = 0;
+
+    cur_data = data;
+    cur_size = size;
+    memset(cov_run, 0, sizeof(cov_run));
+    cov_prev = 0;
+    LLVMFuzzerTestOneInput(data, size);
+    cur_data = NULL;
+
+    for (uint32_t i = 0; i < FUZZ_COV_SIZE; i++) {
+        if (cov_run[i] && !cov_seen[i]) {
+            cov_seen[i] = 1;
+            fresh++;
+        }
+    }
+    cov_edges += fresh;
+    return fresh;
+}
+
+static void Fuzz_Add(const uint8_t *data, size_t size)
+{
+    if (pool_count >= FUZZ_POOL_MAX) return;
+    pool[pool_count].data = malloc(size ? size : 1U);
+    memcpy(pool[pool_count].data, data, size);
+    pool[pool_count].size = size;
+    pool_count++;
+}
+
+static int Fuzz_Load_File(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    uint8_t *buf;
+    long size;
+
+    if (f == NULL) {
+        perror(path);
+        return -1;
+    }
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    buf = malloc(size > 0 ? (size_t)size : 1U);
+    if (fread(buf, 1, (size_t)size, f) != (size_t)size) size = 0;
+    fclose(f);
+    Fuzz_Add(buf, (size_t)size);
+    free(buf);
+    return 0;
+}
+
+static int Fuzz_Load(const char *path)
+{
+    struct stat st;
+    DIR *d;
+    struct dirent *e;
+    char child[4096];
+
+    if (stat(path, &st) != 0) {
+        perror(path);
+        return -1;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        return Fuzz_Load_File(path);
+    }
+    d = opendir(path);
+    while (d != NULL && (e = readdir(d)) != NULL) {
+        if (e->d_name[0] == '.') continue;
+        snprintf(child, sizeof(child), "%s/%s", path, e->d_name);
+        if (stat(child, &st) == 0 && S_ISREG(st.st_mode)) {
+            Fuzz_Load_File(child);
+        }
+    }
+    if (d) closedir(d);
+    return 0;
+}
+
+/* ---------------------------------------------------------------------------
+ * Mutation loop
+ * ------------------------------------------------------------------------- */
+
+static uint64_t rng_state = 0x2545F4914F6CDD1DULL;
+
+static uint32_t Fuzz_Rand(uint32_t n)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return (uint32_t)(rng_state % (n ? n : 1U));
+}
+
+/* SETUP templates: bmRequestType, bRequest, wValue high byte */
+static const uint8_t setup_dict[][3] = {
+    {0x80, 0x06, 0x01}, {0x80, 0x06, 0x02}, {0x80, 0x06, 0x03}, {0x80, 0x06, 0x06},
+    {0x80, 0x06, 0x07}, {0x80, 0x06, 0x0F}, {0x81, 0x06, 0x21}, {0x81, 0x06, 0x22},
+    {0x00, 0x05, 0x00}, {0x00, 0x09, 0x00}, {0x80, 0x08, 0x00}, {0x80, 0x00, 0x00},
+    {0x81, 0x00, 0x00}, {0x82, 0x00, 0x00}, {0x00, 0x03, 0x00}, {0x00, 0x01, 0x00},
+    {0x02, 0x01, 0x00}, {0x02, 0x03, 0x00}, {0x81, 0x0A, 0x00}, {0x01, 0x0B, 0x00},
+    {0x21, 0x0A, 0x00}, {0x21, 0x0B, 0x00}, {0xA1, 0x03, 0x00}, {0xA1, 0x01, 0x01},
+    {0x21, 0x09, 0x02}, {0xA1, 0x02, 0x00}, {0x00, 0x07, 0x01}, {0x80, 0x06, 0xEE},
+};
+
+static size_t Fuzz_Mutate(uint8_t *buf, size_t size, size_t max_len)
+{
+    uint32_t rounds = 1U + Fuzz_Rand(4);
+
+    for (uint32_t r = 0; r < rounds; r++) {
+        switch (Fuzz_Rand(7)) {
+            case 0:     /* Flip a bit */
+                if (size) buf[Fuzz_Rand(size)] ^= (uint8_t)(1U << Fuzz_Rand(8));
+                break;
+            case 1:     /* Interesting byte */
+                if (size) {
+                    static const uint8_t magic[] = {0x00, 0x01, 0x02, 0x3F, 0x40, 0x41, 0x7F, 0x80, 0xFF};
+                    buf[Fuzz_Rand(size)] = magic[Fuzz_Rand(sizeof(magic))];
+                }
+                break;
+            case 2:     /* Insert a SETUP from the dictionary */
+                if (size + 9U <= max_len) {
+                    size_t at = Fuzz_Rand((uint32_t)size + 1U);
+                    const uint8_t *t = setup_dict[Fuzz_Rand(sizeof(setup_dict) / sizeof(setup_dict[0]))];
+                    uint8_t s[9] = {0, t[0], t[1], (uint8_t)Fuzz_Rand(4), t[2],
+                                    (uint8_t)Fuzz_Rand(3), 0, (uint8_t)Fuzz_Rand(256), (uint8_t)Fuzz_Rand(3)};
+                    memmove(buf + at + 9U, buf + at, size - at);
+                    memcpy(buf + at, s, 9U);
+                    size += 9U;
+                }
+                break;
+            case 3:     /* Insert host tokens (IN/OUT/SOF/...) */
+                if (size + 4U <= max_len) {
+                    size_t at = Fuzz_Rand((uint32_t)size + 1U);
+                    uint32_t n = 1U + Fuzz_Rand(4);
+                    memmove(buf + at + n, buf + at, size - at);
+                    for (uint32_t i = 0; i < n; i++) buf[at + i] = (uint8_t)(1U + Fuzz_Rand(7));
+                    size += n;
+                }
+                break;
+            case 4:     /* Delete a range */
+                if (size > 1U) {
+                    size_t at = Fuzz_Rand((uint32_t)size);
+                    size_t n = 1U + Fuzz_Rand((uint32_t)(size - at));
+                    memmove(buf + at, buf + at + n, size - at - n);
+                    size -= n;
+                }
+                break;
+            case 5:     /* Splice the tail of another input */
+                if (pool_count > 0) {
+                    const Fuzz_Input_t *o = &pool[Fuzz_Rand(pool_count)];
+                    size_t at = Fuzz_Rand((uint32_t)size + 1U);
+                    size_t from = Fuzz_Rand((uint32_t)o->size + 1U);
+                    size_t n = o->size - from;
+                    if (at + n > max_len) n = max_len - at;
+                    memcpy(buf + at, o->data + from, n);
+                    size = at + n;
+                }
+                break;
+            default:    /* Random byte */
+                if (size) buf[Fuzz_Rand(size)] = (uint8_t)Fuzz_Rand(256);
+                break;
+        }
+    }
+    return size;
+}
+
+static int Fuzz_Mutate_Loop(uint64_t runs, size_t max_len, const char *out_dir)
+{
+    uint8_t *buf = malloc(max_len);
+    uint32_t initial = pool_count;
+
+    if (pool_count == 0) {
+        Fuzz_Add((const uint8_t *)"", 0);
+    }
+    for (uint32_t i = 0; i < pool_count; i++) {
+        Fuzz_Run(pool[i].data, pool[i].size);
+    }
+    printf("#0 loaded %u inputs, %u edges\n", initial, cov_edges);
+
+    for (uint64_t n = 1; n <= runs; n++) {
+        const Fuzz_Input_t *base = &pool[Fuzz_Rand(pool_count)];
+        size_t size = (base->size < max_len) ? base->size : max_len;
+
+        memcpy(buf, base->data, size);
+        size = Fuzz_Mutate(buf, size, max_len);
+        if (Fuzz_Run(buf, size) > 0U) {
+            Fuzz_Add(buf, size);
+            if (out_dir) {
+                char path[4096];
+                snprintf(path, sizeof(path), "%s/cov-%08x", out_dir, (unsigned)Fuzz_Hash(buf, size));
+                Fuzz_Write(path, buf, size);
+            }
+            printf("#%llu new edges: %u total, pool %u\n", (unsigned long long)n, cov_edges, pool_count);
+        }
+    }
+    printf("#%llu done: %u edges, pool %u\n", (unsigned long long)runs, cov_edges, pool_count);
+    free(buf);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t mutate = 0;
+    size_t max_len = 512;
+    const char *out_dir = NULL;
+
+    signal(SIGABRT, Fuzz_On_Abort);
+    signal(SIGSEGV, Fuzz_On_Abort);
+#if defined(__SANITIZE_ADDRESS__)
+    __sanitizer_set_death_callback(Fuzz_Save_Crash);
+#endif
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-mutate") == 0 && i + 1 < argc) {
+            mutate = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-seed") == 0 && i + 1 < argc) {
+            rng_state = strtoull(argv[++i], NULL, 0) | 1U;
+        } else if (strcmp(argv[i], "-max_len") == 0 && i + 1 < argc) {
+            max_len = strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-out") == 0 && i + 1 < argc) {
+            out_dir = argv[++i];
+        } else if (argv[i][0] == '-') {
+            fprintf(stderr, "usage: %s [-mutate N] [-seed S] [-max_len L] [-out DIR] [file|dir]...\n", argv[0]);
+            return 2;
+        } else if (Fuzz_Load(argv[i]) != 0) {
+            return 2;
+        }
+    }
+    if (max_len < 16U) max_len = 16U;
+
+    if (mutate) {
+        return Fuzz_Mutate_Loop(mutate, max_len, out_dir);
+    }
+
+    if (pool_count == 0) {
+        static uint8_t in[65536];
+        size_t size = fread(in, 1, sizeof(in), stdin);
+        Fuzz_Run(in, size);
+        return 0;
+    }
+    for (uint32_t i = 0; i < pool_count; i++) {
+        Fuzz_Run(pool[i].data, pool[i].size);
+    }
+    printf("%u inputs ok, %u edges\n", pool_count, cov_edges);
+    return 0;
+}
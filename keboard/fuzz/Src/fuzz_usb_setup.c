@@ -0,0 +1,172 @@
+/**
+  ******************************************************************************
+  * @file           : fuzz_usb_setup.c
+  * @brief          : Fuzz target for USB control request handling
+  *
+  * Runs the firmware's USB device stack (usbd_core, usbd_ctlreq, usbd_ioreq,
+  * the HID class, the HID + CDC composite and usbd_desc) on the fake PCD and plays the host from the
+  * fuzz input, one command per step:
+  *   op % 8 == 0  SETUP            8 bytes follow
+  *   op % 8 == 1  OUT on EP0       length byte (0-64) and payload follow
+  *   op % 8 == 2  IN token on EP0
+  *   op % 8 == 3  IN token on the HID endpoint (0x81)
+  *   op % 8 == 4  SOF
+  *   op % 8 == 5  bus reset
+  *   op % 8 == 6  suspend
+  *   op % 8 == 7  resume
+  * After the input the control pipe must still answer GET_DESCRIPTOR(device)
+  * with the 18-byte device descriptor; a wedged EP0 aborts like a crash.
+  ******************************************************************************
+  */
+
+#include "fake_pcd.h"
+#include "usbd_core.h"
+#include "usbd_desc.h"
+#include "usbd_hid.h"
+#include "usbd_hid_cdc.h"
+
+#define FUZZ_MAX_STEPS     4096U
+
+static USBD_HandleTypeDef dev;
+
+/* CDC interface: line coding kept as usbd_cdc_if.c would, no data path */
+static uint8_t cdc_rx[CDC_DATA_FS_OUT_PACKET_SIZE];
+static uint8_t cdc_line_coding[7];
+
+static int8_t Fuzz_Cdc_Init(void)
+{
+    USBD_HID_CDC_Receive(&dev, cdc_rx);
+    return USBD_OK;
+}
+
+static int8_t Fuzz_Cdc_DeInit(void)
+{
+    return USBD_OK;
+}
+
+static int8_t Fuzz_Cdc_Control(uint8_t cmd, uint8_t *pbuf, uint16_t length)
+{
+    if (cmd == CDC_SET_LINE_CODING) {
+        memcpy(cdc_line_coding, pbuf, (length < sizeof(cdc_line_coding)) ? length : sizeof(cdc_line_coding));
+    } else if (cmd == CDC_GET_LINE_CODING) {
+        memcpy(pbuf, cdc_line_coding, (length < sizeof(cdc_line_coding)) ? length : sizeof(cdc_line_coding));
+    }
+    return USBD_OK;
+}
+
+static int8_t Fuzz_Cdc_Receive(uint8_t *buf, uint32_t *len)
+{
+    (void)buf;
+    (void)len;
+    return USBD_OK;
+}
+
+static USBD_HID_CDC_ItfTypeDef fuzz_cdc_fops = {
+    Fuzz_Cdc_Init, Fuzz_Cdc_DeInit, Fuzz_Cdc_Control, Fuzz_Cdc_Receive, NULL
+};
+
+/**
+  * @brief Control pipe health check after the input
+  */
+static void Fuzz_Check_Ep0(void)
+{
+    static const uint8_t get_device[8] = {0x80, 0x06, 0x00, 0x01, 0x00, 0x00, 0x12, 0x00};
+    uint8_t desc[18];
+    uint16_t got = 0;
+    uint16_t n = 0;
+
+    /* Any bus activity resumes a suspended device */
+    Fake_Pcd_Resume();
+    Fake_Pcd_Setup(get_device);
+    while (got < sizeof(desc)) {
+        int res = Fake_Pcd_In(0, desc + got, &n);
+        if (res != FAKE_PCD_ACK) {
+            Fake_Pcd_Fail("control pipe wedged: GET_DESCRIPTOR(device) %s after %u bytes",
+                          (res == FAKE_PCD_NAK) ? "NAKed" : "stalled", got);
+        }
+        if (n == 0U) break;
+        got += n;
+    }
+    if (got != sizeof(desc) || desc[0] != 0x12U || desc[1] != USB_DESC_TYPE_DEVICE) {
+        Fake_Pcd_Fail("GET_DESCRIPTOR(device) returned %u bytes, type 0x%02X", got, desc[1]);
+    }
+    /* Status stage */
+    if (Fake_Pcd_Out(0, NULL, 0) != FAKE_PCD_ACK) {
+        Fake_Pcd_Fail("GET_DESCRIPTOR(device) status stage refused");
+    }
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    size_t pos = 0;
+    uint32_t steps = 0;
+    uint8_t packet[FAKE_PCD_EP0_MPS];
+
+    memset(&dev, 0, sizeof(dev));
+    USBD_Init(&dev, &FS_Desc, DEVICE_FS);
+    USBD_RegisterClass(&dev, &USBD_HID_CDC);
+    USBD_HID_CDC_RegisterInterface(&dev, &fuzz_cdc_fops);
+    USBD_Start(&dev);
+    Fake_Pcd_Bus_Reset();
+
+    while (pos < size && steps++ < FUZZ_MAX_STEPS) {
+        uint8_t op = data[pos++] % 8U;
+
+        switch (op) {
+            case 0:
+                if (size - pos < 8U) {
+                    pos = size;
+                    break;
+                }
+                Fake_Pcd_Setup(&data[pos]);
+                pos += 8U;
+                break;
+
+            case 1: {
+                uint16_t len;
+                if (pos >= size) break;
+                len = data[pos++] % (FAKE_PCD_EP0_MPS + 1U);
+                if (len > size - pos) len = (uint16_t)(size - pos);
+                memcpy(packet, &data[pos], len);
+                pos += len;
+                Fake_Pcd_Out(0, packet, len);
+                break;
+            }
+
+            case 2:
+                Fake_Pcd_In(0, NULL, NULL);
+                break;
+
+            case 3:
+                Fake_Pcd_In(HID_EPIN_ADDR & 0x7FU, NULL, NULL);
+                break;
+
+            case 4:
+                Fake_Pcd_Sof();
+                break;
+
+            case 5:
+                Fake_Pcd_Bus_Reset();
+                break;
+
+            case 6:
+                Fake_Pcd_Suspend();
+                break;
+
+            default:
+                Fake_Pcd_Resume();
+                break;
+        }
+    }
+
+    Fuzz_Check_Ep0();
+    USBD_Stop(&dev);
+    USBD_DeInit(&dev);
+
+    /* The target hands out one static block: a leak means the class was
+     * initialised twice without DeInit in between */
+    if (Fake_Pcd_Allocations() != 0U) {
+        Fake_Pcd_Fail("%lu class data block(s) not freed", (unsigned long)Fake_Pcd_Allocations());
+    }
+    return 0;
+}
@@ -0,0 +1,161 @@
+#!/usr/bin/env python3
+"""
+Seed corpus for the USB control request fuzzer (Src/fuzz_usb_setup.c)
+
+使用方法:
+  python3 make_corpus.py [corpus_dir]
+
+Each trace is the request sequence a host sends while enumerating and
+driving the keyboard, written in the harness input format: SETUP packets,
+EP0 IN/OUT tokens for the data and status stages, SOFs and bus resets.
+The sequences follow usbmon/USBPcap captures of the common hosts (Linux,
+Windows, macOS, a PC BIOS) plus the less common standard requests.
+"""
+
+import os
+import struct
+import sys
+
+OP_SETUP, OP_OUT, OP_IN, OP_HID_IN, OP_SOF, OP_RESET, OP_SUSPEND, OP_RESUME = range(8)
+
+DEV, CFG, STR, QUAL, OTHER, BOS = 1, 2, 3, 6, 7, 15
+HID, REPORT = 0x21, 0x22
+CFG_LEN = 100                   # HID + CDC composite configuration descriptor
+
+
+def setup(bm, req, value, index, length):
+    return bytes([OP_SETUP]) + struct.pack("<BBHHH", bm, req, value, index, length)
+
+
+def read(bm, req, value, index, length, packets=None):
+    """Control read: SETUP, IN data packets, OUT status"""
+    if packets is None:
+        packets = max(1, (length + 63) // 64)
+    return setup(bm, req, value, index, length) + bytes([OP_IN] * packets) + bytes([OP_OUT, 0])
+
+
+def write(bm, req, value, index, data=b""):
+    """Control write: SETUP, OUT data packet, IN status"""
+    out = setup(bm, req, value, index, len(data))
+    if data:
+        out += bytes([OP_OUT, len(data)]) + data
+    return out + bytes([OP_IN])
+
+
+def get_desc(dtype, index, length, lang=0, packets=None):
+    return read(0x80, 0x06, (dtype << 8) | index, lang, length, packets)
+
+
+def frames(n):
+    return bytes([OP_SOF] * n)
+
+
+SET_ADDRESS = write(0x00, 0x05, 7, 0)
+SET_CONFIG = write(0x00, 0x09, 1, 0)
+
+TRACES = {
+    "enum_linux": (
+        bytes([OP_RESET]) + get_desc(DEV, 0, 64) + bytes([OP_RESET]) + SET_ADDRESS + frames(2)
+        + get_desc(DEV, 0, 18) + get_desc(CFG, 0, 9) + get_desc(CFG, 0, CFG_LEN)
+        + get_desc(STR, 0, 255) + get_desc(STR, 2, 255, 0x409) + get_desc(STR, 1, 255, 0x409)
+        + get_desc(STR, 3, 255, 0x409) + SET_CONFIG
+        + write(0x21, 0x0A, 0, 0)                          # SET_IDLE 0
+        + read(0x81, 0x06, REPORT << 8, 0, 0x7F, 2)        # Report descriptor
+        + write(0x21, 0x09, 0x0201, 0, b"\x01\x00")        # SET_REPORT output (LEDs)
+        + frames(4) + bytes([OP_HID_IN])
+    ),
+    "enum_windows": (
+        bytes([OP_RESET]) + setup(0x80, 0x06, DEV << 8, 0, 64) + bytes([OP_IN, OP_RESET])
+        + SET_ADDRESS + get_desc(DEV, 0, 18) + get_desc(CFG, 0, 255, packets=1)
+        + get_desc(STR, 0xEE, 0x12)                        # MS OS string, expected to stall
+        + get_desc(QUAL, 0, 10) + get_desc(STR, 0, 255) + get_desc(STR, 2, 255, 0x409)
+        + read(0x80, 0x00, 0, 0, 2)                        # GET_STATUS device
+        + SET_CONFIG + write(0x21, 0x0A, 0, 0)
+        + read(0x81, 0x06, REPORT << 8, 0, 0x77 + 0x40, 2)
+        + write(0x21, 0x09, 0x0201, 0, b"\x01\x02")
+        + frames(8) + bytes([OP_HID_IN, OP_SOF, OP_HID_IN])
+    ),
+    "enum_macos": (
+        bytes([OP_RESET]) + get_desc(DEV, 0, 8) + bytes([OP_RESET]) + SET_ADDRESS
+        + get_desc(DEV, 0, 18) + get_desc(CFG, 0, 9) + get_desc(CFG, 0, CFG_LEN)
+        + get_desc(BOS, 0, 5) + get_desc(STR, 0, 2) + get_desc(STR, 0, 4)
+        + get_desc(STR, 1, 2, 0x409) + get_desc(STR, 1, 255, 0x409)
+        + SET_CONFIG + read(0x80, 0x08, 0, 0, 1)           # GET_CONFIGURATION
+        + read(0x81, 0x06, HID << 8, 0, 9)                 # HID descriptor
+        + write(0x21, 0x0A, 0, 0) + read(0x81, 0x06, REPORT << 8, 0, 0x80, 2)
+        + frames(3) + bytes([OP_SUSPEND, OP_RESUME]) + frames(3)
+    ),
+    "bios_boot": (
+        bytes([OP_RESET]) + get_desc(DEV, 0, 8) + SET_ADDRESS + get_desc(DEV, 0, 18)
+        + get_desc(CFG, 0, CFG_LEN) + SET_CONFIG
+        + write(0x21, 0x0B, 0, 0)                          # SET_PROTOCOL boot
+        + read(0xA1, 0x03, 0, 0, 1)                        # GET_PROTOCOL
+        + write(0x21, 0x0A, 0x7D00, 0)                     # SET_IDLE 500 ms
+        + read(0xA1, 0x02, 0, 0, 1)                        # GET_IDLE
+        + frames(10) + bytes([OP_HID_IN])
+    ),
+    "standard_requests": (
+        bytes([OP_RESET]) + SET_ADDRESS + SET_CONFIG
+        + read(0x80, 0x00, 0, 0, 2) + read(0x81, 0x00, 0, 0, 2) + read(0x82, 0x00, 0, 0x81, 2)
+        + write(0x00, 0x03, 1, 0)                          # SET_FEATURE remote wakeup
+        + write(0x00, 0x01, 1, 0)                          # CLEAR_FEATURE remote wakeup
+        + write(0x02, 0x03, 0, 0x81)                       # SET_FEATURE halt EP1 IN
+        + read(0x82, 0x00, 0, 0x81, 2) + bytes([OP_HID_IN])
+        + write(0x02, 0x01, 0, 0x81)                       # CLEAR_FEATURE halt
+        + read(0x81, 0x0A, 0, 0, 1) + write(0x01, 0x0B, 0, 0)   # GET/SET_INTERFACE
+        + get_desc(OTHER, 0, CFG_LEN) + write(0x00, 0x09, 0, 0)      # unconfigure
+        + read(0x80, 0x08, 0, 0, 1) + SET_CONFIG
+    ),
+    "malformed": (
+        bytes([OP_RESET]) + get_desc(DEV, 0, 0) + get_desc(CFG, 5, 255) + get_desc(STR, 0x7F, 255)
+        + get_desc(0x55, 0, 64) + write(0x00, 0x05, 0x80, 0) + write(0x00, 0x09, 2, 0)
+        + setup(0x80, 0x06, DEV << 8, 0, 18) + bytes([OP_OUT, 4]) + b"\xDE\xAD\xBE\xEF"
+        + setup(0x00, 0x07, DEV << 8, 0, 18) + bytes([OP_OUT, 18]) + bytes(18)  # SET_DESCRIPTOR
+        + write(0x21, 0x09, 0x0201, 5, bytes(64)) + read(0xA1, 0x01, 0x0101, 0, 64)
+        + get_desc(CFG, 0, 64, packets=3)
+    ),
+    # CDC ACM function of the composite: what a host's ACM driver sends
+    # on open, plus requests to the CDC endpoints
+    "cdc_acm": (
+        bytes([OP_RESET]) + SET_ADDRESS + get_desc(CFG, 0, CFG_LEN) + SET_CONFIG
+        + write(0x21, 0x20, 0, 1, bytes([0x00, 0xC2, 0x01, 0x00, 0x00, 0x00, 0x08]))  # SET_LINE_CODING
+        + read(0xA1, 0x21, 0, 1, 7)                        # GET_LINE_CODING
+        + write(0x21, 0x22, 0x0003, 1)                     # SET_CONTROL_LINE_STATE DTR RTS
+        + write(0x21, 0x23, 0xFFFF, 1)                     # SEND_BREAK
+        + read(0x81, 0x00, 0, 2, 2) + read(0x81, 0x0A, 0, 2, 1)   # GET_STATUS/GET_INTERFACE data
+        + write(0x01, 0x0B, 1, 2)                          # SET_INTERFACE alt 1, expected to stall
+        + write(0x02, 0x03, 0, 0x82) + read(0x82, 0x00, 0, 0x82, 2)
+        + write(0x02, 0x01, 0, 0x82) + write(0x02, 0x01, 0, 0x02)
+        + read(0xA1, 0x21, 0, 1, 64) + write(0x21, 0x20, 0, 1, bytes(64))
+        + write(0x21, 0x22, 0, 1) + frames(3) + bytes([OP_HID_IN])
+        + read(0x81, 0x00, 0, 1, 0, 0) + read(0x81, 0x0A, 0, 2, 0, 0)  # no data stage asked for
+    ),
+    # Regressions: GET_STATUS(endpoint) answered 2 bytes whatever wLength
+    # asked for, and indexed the endpoint tables with bits 0-6 of wIndex.
+    "regress_ep_get_status": (
+        bytes([OP_RESET]) + SET_ADDRESS + read(0x82, 0x00, 0, 0x81, 0, 0)
+        + SET_CONFIG + read(0x82, 0x00, 0, 0x81, 0, 0) + read(0x82, 0x00, 0, 0x7F, 2)
+        + read(0x82, 0x00, 0, 0x81, 1) + read(0x82, 0x00, 0, 0x81, 2)
+    ),
+    # The HID class sent its fixed size replies for any wLength.
+    "regress_hid_wlength": (
+        bytes([OP_RESET]) + SET_ADDRESS + SET_CONFIG
+        + read(0x81, 0x0A, 0, 0, 0, 0) + read(0x81, 0x00, 0, 0, 0, 0)
+        + read(0xA1, 0x03, 0, 0, 0, 0) + read(0xA1, 0x02, 0, 0, 0, 0)
+        + read(0x81, 0x0A, 0, 0, 1) + read(0xA1, 0x03, 0, 0, 1)
+    ),
+}
+
+
+def main():
+    out_dir = sys.argv[1] if len(sys.argv) > 1 else os.path.join(os.path.dirname(os.path.abspath(__file__)), "corpus")
+    os.makedirs(out_dir, exist_ok=True)
+    for name, data in TRACES.items():
+        with open(os.path.join(out_dir, name), "wb") as f:
+            f.write(data)
+        print(f"{name:20s} {len(data):4d} bytes")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
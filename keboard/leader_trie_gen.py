@@ -0,0 +1,169 @@
+#!/usr/bin/env python3
+"""
+Leader Sequence Trie Generator
+把 leader_sequences.txt 编译成 Core/Src/leader_trie.c (double-array trie)
+
+使用方法:
+  python3 leader_trie_gen.py [leader_sequences.txt] [Core/Src/leader_trie.c]
+
+Sequence file format (one per line, '#' starts a comment):
+  <key> [<key> ...] = [<MOD>+...]<key>
+Key names are the KEY_* names from Core/Inc/usb_keyboard.h without the
+prefix (A, 1, ENTER, ...), modifiers the KBD_MOD_* names (LCTRL, LSHIFT, ...).
+
+Example (from leader_sequences.txt):
+  1 1     = LCTRL+C
+  1 2     = LCTRL+V
+  3       = LCTRL+S          # 3 is also a prefix: fires on timeout
+  3 3     = LCTRL+LSHIFT+S
+"""
+
+import os
+import re
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+HEADER = os.path.join(HERE, "Core", "Inc", "usb_keyboard.h")
+DEFAULT_INPUT = os.path.join(HERE, "leader_sequences.txt")
+DEFAULT_OUTPUT = os.path.join(HERE, "Core", "Src", "leader_trie.c")
+
+# Must match leader_key.h
+LEADER_MAX_SEQUENCE = 8
+LEADER_TRIE_EMPTY = 0xFFFF
+
+
+def load_names(header):
+    """Read KEY_* and KBD_MOD_* values from usb_keyboard.h"""
+    keys, mods = {}, {}
+    pattern = re.compile(r"#define\s+(KEY|KBD_MOD)_(\w+)\s+(0x[0-9A-Fa-f]+)")
+    with open(header, encoding="utf-8") as f:
+        for line in f:
+            m = pattern.match(line)
+            if not m:
+                continue
+            table = keys if m.group(1) == "KEY" else mods
+            table[m.group(2)] = int(m.group(3), 16)
+    return keys, mods
+
+
+def parse_sequences(path, keys, mods):
+    """Return a list of (keycode tuple, action word, line number)"""
+    sequences = []
+    with open(path, encoding="utf-8") as f:
+        for lineno, line in enumerate(f, 1):
+            line = line.split("#", 1)[0].strip()
+            if not line:
+                continue
+            if "=" not in line:
+                raise SystemExit(f"{path}:{lineno}: expected '<keys> = <action>'")
+            lhs, rhs = (part.strip() for part in line.split("=", 1))
+
+            seq = []
+            for name in lhs.split():
+                if name not in keys or keys[name] == 0:
+                    raise SystemExit(f"{path}:{lineno}: unknown key '{name}'")
+                seq.append(keys[name])
+            if not 1 <= len(seq) <= LEADER_MAX_SEQUENCE:
+                raise SystemExit(f"{path}:{lineno}: sequence length must be "
+                                 f"1..{LEADER_MAX_SEQUENCE}")
+
+            *mod_names, key_name = rhs.split("+")
+            modifier = 0
+            for name in mod_names:
+                if name.strip() not in mods:
+                    raise SystemExit(f"{path}:{lineno}: unknown modifier '{name}'")
+                modifier |= mods[name.strip()]
+            key_name = key_name.strip()
+            if key_name not in keys or keys[key_name] == 0:
+                raise SystemExit(f"{path}:{lineno}: unknown key '{key_name}'")
+
+            sequences.append((tuple(seq), (modifier << 8) | keys[key_name], lineno))
+    return sequences
+
+
+def build_trie(sequences):
+    """Build the plain trie, then pack it into base/check/action arrays"""
+    children = [{}]   # node -> {keycode: child node}
+    action = [0]
+    for seq, act, lineno in sequences:
+        node = 0
+        for code in seq:
+            if code not in children[node]:
+                children[node][code] = len(children)
+                children.append({})
+                action.append(0)
+            node = children[node][code]
+        if action[node]:
+            raise SystemExit(f"line {lineno}: duplicate sequence")
+        action[node] = act
+
+    base, check, act_out = [0], [LEADER_TRIE_EMPTY], [action[0]]
+    used = {0}
+    slot_of = {0: 0}
+    queue = [0]
+
+    def grow(size):
+        while len(check) < size:
+            base.append(0)
+            check.append(LEADER_TRIE_EMPTY)
+            act_out.append(0)
+
+    # Breadth-first first-fit placement of each node's children
+    while queue:
+        node = queue.pop(0)
+        codes = sorted(children[node])
+        if not codes:
+            continue
+        b = 1
+        while any((b + c) in used for c in codes):
+            b += 1
+        s = slot_of[node]
+        base[s] = b
+        grow(b + codes[-1] + 1)
+        for c in codes:
+            t = b + c
+            used.add(t)
+            check[t] = s
+            child = children[node][c]
+            slot_of[child] = t
+            act_out[t] = action[child]
+            queue.append(child)
+
+    if len(check) >= LEADER_TRIE_EMPTY:
+        raise SystemExit("trie too large for 16-bit indices")
+    return base, check, act_out
+
+
+def emit(path, source, base, check, act_out, count):
+    with open(path, "w", encoding="utf-8", newline="\n") as f:
+        f.write("/**\n")
+        f.write("  ******************************************************************************\n")
+        f.write("  * @file           : leader_trie.c\n")
+        f.write("  * @brief          : Leader-key sequence trie (generated)\n")
+        f.write("  *\n")
+        f.write(f"  * Generated by leader_trie_gen.py from {os.path.basename(source)}.\n")
+        f.write("  * Do not edit by hand.\n")
+        f.write(f"  * Sequences: {count}, trie slots: {len(check)}\n")
+        f.write("  ******************************************************************************\n")
+        f.write("  */\n\n")
+        f.write('#include "leader_key.h"\n\n')
+        f.write(f"const uint16_t leader_trie_size = {len(check)};\n\n")
+        f.write("const Leader_TrieNode_t leader_trie[] = {\n")
+        for i, (b, c, a) in enumerate(zip(base, check, act_out)):
+            f.write(f"    {{0x{b:04X}, 0x{c:04X}, 0x{a:04X}}},  /* {i} */\n")
+        f.write("};\n")
+
+
+def main():
+    source = sys.argv[1] if len(sys.argv) > 1 else DEFAULT_INPUT
+    output = sys.argv[2] if len(sys.argv) > 2 else DEFAULT_OUTPUT
+
+    keys, mods = load_names(HEADER)
+    sequences = parse_sequences(source, keys, mods)
+    base, check, act_out = build_trie(sequences)
+    emit(output, source, base, check, act_out, len(sequences))
+    print(f"{len(sequences)} sequences -> {len(check)} trie slots -> {output}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,81 @@
+/**
+  ******************************************************************************
+  * @file           : usbd_conf.h
+  * @brief          : USB device library configuration for the loopback builds
+  *
+  * Shadows USB_DEVICE/Target/usbd_conf.h of the keyboard and of the usb/
+  * project on the host: same device configuration, the low level driver is
+  * the software PCD in usbd_ll_loopback.c. stm32f4xx_hal.h is the mock from
+  * sim/Inc.
+  ******************************************************************************
+  */
+
+#ifndef __USBD_CONF__H__
+#define __USBD_CONF__H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "stm32f4xx_hal.h"
+
+/* Same values as USB_DEVICE/Target/usbd_conf.h */
+#define USBD_MAX_NUM_INTERFACES     3U      /* usb/: 1 */
+#define USBD_MAX_NUM_CONFIGURATION  1U
+#define USBD_MAX_STR_DESC_SIZ       512U
+#define USBD_DEBUG_LEVEL            0U
+#define USBD_LPM_ENABLED            0U
+#ifndef USBD_SELF_POWERED
+#define USBD_SELF_POWERED           1U      /* usb/: 0 */
+#endif
+#define HID_FS_BINTERVAL            0x1U
+
+#define DEVICE_FS                   0
+#define DEVICE_HS                   1
+
+/* Normally provided by the CMSIS core headers. The stack's callbacks run
+ * from Loopback_Run(), never in between, so masking is a no-op */
+#define __STATIC_INLINE             static inline
+#define __PACKED                    __attribute__((packed))
+#define __get_PRIMASK()             0U
+#define __set_PRIMASK(x)            ((void)(x))
+#define __disable_irq()             ((void)0)
+
+/* The part of the HAL PCD handle the classes read through pdev->pData
+ * (usbd_cdc.c: IN_ep[].maxpacket for the ZLP decision). The loopback PCD
+ * starts with it. */
+typedef struct {
+    uint32_t maxpacket;
+} PCD_EPTypeDef;
+
+typedef struct {
+    PCD_EPTypeDef IN_ep[16];
+    PCD_EPTypeDef OUT_ep[16];
+} PCD_HandleTypeDef;
+
+/* Unique device ID read by usbd_desc.c for the serial number string */
+extern uint32_t loopback_uid[3];
+#define UID_BASE                    ((uintptr_t)loopback_uid)
+
+#define USBD_malloc                 (void *)USBD_static_malloc
+#define USBD_free                   USBD_static_free
+#define USBD_memset                 memset
+#define USBD_memcpy                 memcpy
+#define USBD_Delay(ms)              ((void)(ms))
+
+#define USBD_UsrLog(...)
+#define USBD_ErrLog(...)
+#define USBD_DbgLog(...)
+
+void *USBD_static_malloc(uint32_t size);
+void USBD_static_free(void *p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __USBD_CONF__H__ */
@@ -0,0 +1,168 @@
+/**
+  ******************************************************************************
+  * @file           : usbd_loopback.h
+  * @brief          : Software USB OTG_FS peripheral and host for host builds
+  *
+  * Implements the USBD_LL_* interface of usbd_conf.c in a Linux process and
+  * plays the host on the other end of the cable, so the unmodified device
+  * stack, its classes and the application above them can be enumerated and
+  * driven end to end.
+  *
+  * The bus is modelled in full-speed frames: one SOF per millisecond, then
+  * the due interrupt endpoints, then bulk endpoints round robin until the
+  * frame's 1500 bytes of bus time are used up. Each transaction costs its
+  * payload plus the USB 2.0 protocol overhead, so bulk tops out at 19
+  * packets of 64 bytes per frame, as on a real full-speed bus. Endpoints
+  * follow the F4 HAL PCD driver (EP0 moves one packet per callback) and the
+  * OTG_FS limits: 4 endpoints per direction, 320 words of FIFO RAM, a TX
+  * FIFO per IN endpoint that must hold a full packet.
+  *
+  * Errors in the device stack (transfers on closed endpoints, an EP0 data
+  * stage longer than wLength, FIFO overcommit, OUT data beyond the armed
+  * buffer) end the process via Loopback_Fail().
+  ******************************************************************************
+  */
+
+#ifndef __USBD_LOOPBACK_H
+#define __USBD_LOOPBACK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "usbd_def.h"
+
+#define LOOPBACK_EP_COUNT           16U     /* Size of the HAL PCD endpoint tables */
+#define LOOPBACK_DEV_ENDPOINTS      4U      /* OTG_FS: EP0..EP3 per direction */
+#define LOOPBACK_MAX_PACKET         64U     /* Full speed */
+#define LOOPBACK_FIFO_WORDS         320U    /* OTG_FS data FIFO RAM (1.25 KB) */
+
+/* FIFO split programmed by USBD_LL_Init(), as in USB_DEVICE/Target/usbd_conf.c */
+#ifndef LOOPBACK_RX_FIFO_WORDS
+#define LOOPBACK_RX_FIFO_WORDS      0x80U
+#endif
+#ifndef LOOPBACK_TX0_FIFO_WORDS
+#define LOOPBACK_TX0_FIFO_WORDS     0x40U
+#endif
+#ifndef LOOPBACK_TX1_FIFO_WORDS
+#define LOOPBACK_TX1_FIFO_WORDS     0x80U
+#endif
+#ifndef LOOPBACK_TX2_FIFO_WORDS
+#define LOOPBACK_TX2_FIFO_WORDS     0x00U
+#endif
+#ifndef LOOPBACK_TX3_FIFO_WORDS
+#define LOOPBACK_TX3_FIFO_WORDS     0x00U
+#endif
+
+/* Bus timing (USB 2.0 5.8.4, 5.7.4) */
+#define LOOPBACK_FRAME_US           1000U
+#define LOOPBACK_FRAME_BYTES        1500U   /* 12 Mbit/s */
+#define LOOPBACK_OVERHEAD_BYTES     13U     /* Token, handshake, sync, EOP, gaps */
+#define LOOPBACK_SOF_BYTES          6U
+#define LOOPBACK_PERIODIC_BYTES     1350U   /* 90 % of a frame for interrupt */
+#define LOOPBACK_RESET_MS           10U
+#define LOOPBACK_SET_ADDRESS_MS     2U      /* Recovery after SET_ADDRESS */
+#define LOOPBACK_SUSPEND_MS         3U      /* Idle bus before suspend */
+#define LOOPBACK_CONTROL_TIMEOUT_MS 500U
+
+/* Host side result of a transfer */
+#define LOOPBACK_OK                 0
+#define LOOPBACK_STALL              1
+#define LOOPBACK_TIMEOUT            2
+#define LOOPBACK_ERROR              3
+
+#define LOOPBACK_MAX_CONFIG_DESC    256U
+
+typedef struct _Loopback_Pcd Loopback_Pcd_t;
+
+/* Host side traffic hooks, called from the bus (interrupt context for the stack) */
+typedef struct {
+    /* The device armed an IN transfer on a non-control endpoint */
+    void (*transmit)(Loopback_Pcd_t *pcd, uint8_t ep_addr, const uint8_t *data, uint32_t len);
+    /* The host received a data packet on a non-control IN endpoint */
+    void (*receive)(Loopback_Pcd_t *pcd, uint8_t ep_addr, const uint8_t *data, uint16_t len);
+} Loopback_Hooks_t;
+
+typedef struct {
+    uint32_t packets;           /* Data packets (ZLPs included) */
+    uint32_t bytes;             /* Payload */
+    uint32_t naks;
+    uint32_t stalls;
+} Loopback_Ep_Stats_t;
+
+typedef struct {
+    /* Device side, as the PCD sees it */
+    uint8_t open;
+    uint8_t type;
+    uint8_t stalled;
+    uint8_t armed;
+    uint16_t mps;
+    uint16_t fifo_words;        /* TX FIFO depth (IN endpoints) */
+    uint8_t *buf;
+    uint32_t len;               /* Armed transfer length */
+    uint32_t count;             /* Bytes moved so far */
+
+    /* Host side pipe */
+    uint8_t polled;             /* Host reads this IN endpoint */
+    uint8_t nak;                /* NAKed, not retried until the device arms it */
+    uint8_t interval;           /* bInterval (frames) from the descriptor */
+    uint32_t next_frame;        /* Interrupt endpoints: next frame to poll */
+    const uint8_t *out_data;    /* Host OUT data queued on this endpoint */
+    uint32_t out_len;
+    uint32_t out_count;
+    uint8_t out_active;         /* Host OUT transfer in progress */
+
+    Loopback_Ep_Stats_t stats;
+} Loopback_Ep_t;
+
+struct _Loopback_Pcd {
+    PCD_HandleTypeDef hpcd;     /* First: pdev->pData points here */
+    USBD_HandleTypeDef *pdev;
+    Loopback_Ep_t ep_in[LOOPBACK_EP_COUNT];
+    Loopback_Ep_t ep_out[LOOPBACK_EP_COUNT];
+    uint16_t rx_fifo_words;
+    uint8_t address;
+    uint8_t connected;          /* D+ pull-up on (USBD_LL_Start) */
+    uint8_t suspended;          /* Host stopped sending SOFs */
+    uint8_t idle_frames;
+    uint8_t rr_next;            /* Bulk round robin position */
+
+    /* Bus clock: frame number and bus time used in it */
+    uint32_t frame;
+    uint16_t frame_bytes;
+    uint8_t frame_started;
+
+    /* Host view of the device */
+    uint8_t device_desc[18];
+    uint8_t config_desc[LOOPBACK_MAX_CONFIG_DESC];
+    uint16_t config_len;
+
+    Loopback_Hooks_t hooks;
+    uint64_t bus_bytes;         /* Bus time used (SOF and idle excluded) */
+    uint32_t frames;
+};
+
+/* Function Prototypes */
+Loopback_Pcd_t *Loopback_Get(uint8_t id);
+void Loopback_Set_Hooks(Loopback_Pcd_t *pcd, const Loopback_Hooks_t *hooks);
+void Loopback_Set_Rx_Fifo(Loopback_Pcd_t *pcd, uint16_t words);
+void Loopback_Set_Tx_Fifo(Loopback_Pcd_t *pcd, uint8_t epnum, uint16_t words);
+uint64_t Loopback_Time_Us(const Loopback_Pcd_t *pcd);
+void Loopback_Run(Loopback_Pcd_t *pcd, uint64_t until_us);
+void Loopback_Host_Reset(Loopback_Pcd_t *pcd);
+void Loopback_Host_Suspend(Loopback_Pcd_t *pcd);
+void Loopback_Host_Resume(Loopback_Pcd_t *pcd);
+int Loopback_Host_Control(Loopback_Pcd_t *pcd, uint8_t bm, uint8_t req, uint16_t value,
+                          uint16_t index, uint8_t *data, uint16_t length, uint16_t *actual);
+int Loopback_Host_Enumerate(Loopback_Pcd_t *pcd);
+void Loopback_Host_Poll(Loopback_Pcd_t *pcd, uint8_t ep_addr, uint8_t enable);
+void Loopback_Host_Write(Loopback_Pcd_t *pcd, uint8_t epnum, const uint8_t *data, uint32_t len);
+uint32_t Loopback_Host_Write_Pending(const Loopback_Pcd_t *pcd, uint8_t epnum);
+void Loopback_Print_Stats(const Loopback_Pcd_t *pcd);
+void Loopback_Fail(const char *fmt, ...) __attribute__((noreturn, format(printf, 1, 2)));
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __USBD_LOOPBACK_H */
@@ -0,0 +1,321 @@
+/**
+  ******************************************************************************
+  * @file           : cdc_loopback.c
+  * @brief          : CDC stream benchmark on the usb/ project's USB stack
+  *
+  * cdc_loopback [--bytes N] [--block N] [--loop-us N] [--ring]
+  *   Brings the usb/ project's CDC device up as MX_USB_DEVICE_Init() does,
+  *   enumerates it, sets the line coding, then streams N bytes host to
+  *   device (bulk OUT) and device to host (CDC_Transmit_FS() of --block
+  *   bytes from a main loop that runs every --loop-us of bus time, or
+  *   CDC_Write_FS() into the TX ring with --ring). The OUT data is read
+  *   with CDC_Read_FS(), --block bytes per main loop pass; a slow reader
+  *   shows up as NAKs from the full receive queue.
+  *   Prints the throughput in bus time, the host CPU time the stack took
+  *   per packet and the endpoint counters. Data in both directions is
+  *   checked byte by byte.
+  *
+  * cdc_loopback --stdio [--loop-us N]
+  *   Runs usb/Core/Src/cdc_bench.c as the firmware's main loop does. stdin
+  *   is the host's bulk OUT data, the bulk IN data goes to stdout, and the
+  *   bus is kept in step with the wall clock, so usb/cdc_bench.py sees the
+  *   bus model's timing. Ends 100 ms of bus time after stdin is closed.
+  ******************************************************************************
+  */
+
+#include "usbd_loopback.h"
+#include "usbd_core.h"
+#include "usbd_desc.h"
+#include "usbd_cdc.h"
+#include "usbd_cdc_if.h"
+#include "cdc_bench.h"
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CDC_LOOPBACK_MAX_BLOCK      4096U
+#define CDC_LOOPBACK_TIMEOUT_MS     60000U
+#define CDC_LOOPBACK_DRAIN_MS       100U
+
+USBD_HandleTypeDef hUsbDeviceFS;
+
+/* Byte i of the stream is (uint8_t)i: block k is sent from pattern[k % 256] */
+static uint8_t pattern[256U + CDC_LOOPBACK_MAX_BLOCK];
+static uint32_t rx_bytes = 0;
+static uint32_t rx_zlps = 0;
+static uint8_t stdio_mode = 0;
+static Loopback_Pcd_t *tick_pcd = NULL;
+
+static uint64_t Now_Ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/* cdc_bench.c times the sink mode with the bus clock */
+uint32_t HAL_GetTick(void)
+{
+    return tick_pcd ? (uint32_t)(Loopback_Time_Us(tick_pcd) / 1000U) : 0U;
+}
+
+/* Host side of the data IN pipe: the stream is a byte counter */
+static void Cdc_Loopback_Receive(Loopback_Pcd_t *pcd, uint8_t ep_addr, const uint8_t *data, uint16_t len)
+{
+    (void)pcd;
+    if (ep_addr != CDC_IN_EP) return;
+    if (len == 0U) {
+        rx_zlps++;
+    }
+    if (stdio_mode) {
+        fwrite(data, 1, len, stdout);
+        rx_bytes += len;
+        return;
+    }
+    for (uint16_t i = 0; i < len; i++) {
+        if (data[i] != (uint8_t)(rx_bytes + i)) {
+            Loopback_Fail("IN byte %lu is 0x%02X, expected 0x%02X",
+                          (unsigned long)(rx_bytes + i), data[i], (uint8_t)(rx_bytes + i));
+        }
+    }
+    rx_bytes += len;
+}
+
+static void Print_Result(const char *name, uint32_t bytes,
+                         uint64_t bus_us, uint32_t packets, uint64_t cpu_ns)
+{
+    printf("%-4s %8lu bytes  %8.1f ms bus  %7.1f KB/s  %5.2f packets/frame  %6.0f ns CPU/packet\n",
+           name, (unsigned long)bytes, (double)bus_us / 1000.0,
+           bus_us ? (double)bytes * 1000000.0 / (double)bus_us / 1024.0 : 0.0,
+           bus_us ? (double)packets * LOOPBACK_FRAME_US / (double)bus_us : 0.0,
+           packets ? (double)cpu_ns / (double)packets : 0.0);
+}
+
+/**
+  * @brief Host to device: one bulk OUT transfer, read by the application
+  *        with CDC_Read_FS() from a polled main loop
+  * @param block: Bytes read per main loop pass
+  * @param loop_us: Main loop period in bus time
+  * @retval None
+  */
+static void Stream_Out(Loopback_Pcd_t *pcd, uint32_t bytes, uint16_t block, uint32_t loop_us)
+{
+    static uint8_t rx_block[CDC_LOOPBACK_MAX_BLOCK];
+    uint8_t *data = malloc(bytes ? bytes : 1U);
+    uint64_t start_us = Loopback_Time_Us(pcd);
+    uint64_t now_us = start_us;
+    uint32_t packets = pcd->ep_out[CDC_OUT_EP].stats.packets;
+    uint32_t naks = pcd->ep_out[CDC_OUT_EP].stats.naks;
+    uint32_t got = 0;
+    uint64_t t0;
+
+    if (data == NULL) Loopback_Fail("out of memory");
+    for (uint32_t i = 0; i < bytes; i++) {
+        data[i] = (uint8_t)i;
+    }
+
+    t0 = Now_Ns();
+    Loopback_Host_Write(pcd, CDC_OUT_EP, data, bytes);
+    while (got < bytes) {
+        /* Main loop pass */
+        uint16_t n = CDC_Read_FS(rx_block, block);
+
+        for (uint16_t i = 0; i < n; i++) {
+            if (rx_block[i] != (uint8_t)(got + i)) {
+                Loopback_Fail("OUT byte %lu is 0x%02X, expected 0x%02X",
+                              (unsigned long)(got + i), rx_block[i], (uint8_t)(got + i));
+            }
+        }
+        got += n;
+
+        now_us += loop_us;
+        Loopback_Run(pcd, now_us);
+        if (now_us - start_us > CDC_LOOPBACK_TIMEOUT_MS * 1000ULL) {
+            Loopback_Fail("OUT stream stalled at %lu of %lu bytes",
+                          (unsigned long)got, (unsigned long)bytes);
+        }
+    }
+
+    Print_Result("OUT", bytes, Loopback_Time_Us(pcd) - start_us,
+                 pcd->ep_out[CDC_OUT_EP].stats.packets - packets, Now_Ns() - t0);
+    printf("     block %u, loop %lu us: %lu packets NAKed (receive queue full)\n",
+           block, (unsigned long)loop_us, (unsigned long)(pcd->ep_out[CDC_OUT_EP].stats.naks - naks));
+    free(data);
+}
+
+/**
+  * @brief Device to host: CDC_Transmit_FS() or CDC_Write_FS() from a polled
+  *        main loop
+  * @param block: Bytes per call
+  * @param loop_us: Main loop period in bus time
+  * @param ring: 1 = CDC_Write_FS()
+  * @retval None
+  */
+static void Stream_In(Loopback_Pcd_t *pcd, uint32_t bytes, uint16_t block, uint32_t loop_us, uint8_t ring)
+{
+    uint64_t start_us = Loopback_Time_Us(pcd);
+    uint64_t now_us = start_us;
+    uint32_t packets = pcd->ep_in[CDC_IN_EP & 0xFU].stats.packets;
+    uint32_t sent = 0;
+    uint32_t busy = 0;
+    uint64_t t0;
+
+    rx_bytes = 0;
+    rx_zlps = 0;
+    t0 = Now_Ns();
+    while (rx_bytes < bytes) {
+        /* Main loop pass */
+        if (sent < bytes) {
+            uint16_t n = (bytes - sent < block) ? (uint16_t)(bytes - sent) : block;
+
+            if (ring) {
+                uint16_t done = CDC_Write_FS(&pattern[sent & 0xFFU], n);
+
+                sent += done;
+                busy += (done < n);
+            } else if (CDC_Transmit_FS(&pattern[sent & 0xFFU], n) == USBD_OK) {
+                sent += n;
+            } else {
+                busy++;
+            }
+        }
+
+        now_us += loop_us;
+        Loopback_Run(pcd, now_us);
+        if (now_us - start_us > CDC_LOOPBACK_TIMEOUT_MS * 1000ULL) {
+            Loopback_Fail("IN stream stalled at %lu of %lu bytes",
+                          (unsigned long)rx_bytes, (unsigned long)bytes);
+        }
+    }
+
+    Print_Result("IN", bytes, Loopback_Time_Us(pcd) - start_us,
+                 pcd->ep_in[CDC_IN_EP & 0xFU].stats.packets - packets, Now_Ns() - t0);
+    printf("     block %u, loop %lu us: %lu %s calls %s, %lu ZLPs\n",
+           block, (unsigned long)loop_us, (unsigned long)busy,
+           ring ? "CDC_Write_FS()" : "CDC_Transmit_FS()", ring ? "short" : "busy",
+           (unsigned long)rx_zlps);
+}
+
+/**
+  * @brief cdc_bench.c between stdin and stdout, the bus in wall clock time
+  * @param loop_us: Main loop period in bus time
+  * @retval None
+  */
+static void Run_Stdio(Loopback_Pcd_t *pcd, uint32_t loop_us)
+{
+    static uint8_t buf[4096];
+    uint64_t start_us = Loopback_Time_Us(pcd);
+    uint64_t wall0_us = Now_Ns() / 1000U;
+    uint64_t now_us = start_us;
+    uint64_t end_us = 0;
+
+    while (end_us == 0U || now_us < end_us) {
+        uint64_t wall_us = Now_Ns() / 1000U - wall0_us;
+        int wait_ms = (now_us - start_us > wall_us + 1000U) ? (int)((now_us - start_us - wall_us) / 1000U) : 0;
+        uint32_t flushed = rx_bytes;
+
+        /* Host writes one buffer at a time; the device's NAKs pace stdin */
+        if (end_us == 0U && Loopback_Host_Write_Pending(pcd, CDC_OUT_EP) == 0U) {
+            struct pollfd pfd = {STDIN_FILENO, POLLIN, 0};
+
+            if (poll(&pfd, 1, wait_ms) > 0) {
+                ssize_t n = read(STDIN_FILENO, buf, sizeof(buf));
+
+                if (n > 0) {
+                    Loopback_Host_Write(pcd, CDC_OUT_EP, buf, (uint32_t)n);
+                } else {
+                    end_us = now_us + CDC_LOOPBACK_DRAIN_MS * 1000ULL;
+                }
+            }
+        } else if (wait_ms > 0) {
+            usleep((useconds_t)wait_ms * 1000U);
+        }
+
+        /* Main loop pass */
+        Cdc_Bench_Poll();
+
+        now_us += loop_us;
+        Loopback_Run(pcd, now_us);
+        if (rx_bytes != flushed) {
+            fflush(stdout);
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    static const Loopback_Hooks_t hooks = {NULL, Cdc_Loopback_Receive};
+    /* 115200 8N1 */
+    uint8_t line_coding[7] = {0x00, 0xC2, 0x01, 0x00, 0x00, 0x00, 0x08};
+    uint8_t readback[7] = {0};
+    uint32_t bytes = 256U * 1024U;
+    uint32_t block = 64U;
+    uint32_t loop_us = 10U;
+    uint8_t ring = 0;
+    Loopback_Pcd_t *pcd;
+
+    for (uint32_t i = 0; i < sizeof(pattern); i++) {
+        pattern[i] = (uint8_t)i;
+    }
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--bytes") == 0 && i + 1 < argc) {
+            bytes = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--block") == 0 && i + 1 < argc) {
+            block = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--loop-us") == 0 && i + 1 < argc) {
+            loop_us = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--ring") == 0) {
+            ring = 1;
+        } else if (strcmp(argv[i], "--stdio") == 0) {
+            stdio_mode = 1;
+        } else {
+            fprintf(stderr, "usage: %s [--bytes N] [--block N] [--loop-us N] [--ring]\n"
+                            "       %s --stdio [--loop-us N]\n", argv[0], argv[0]);
+            return 2;
+        }
+    }
+    if (block == 0U || block > CDC_LOOPBACK_MAX_BLOCK || loop_us == 0U) {
+        fprintf(stderr, "--block must be 1..%u, --loop-us at least 1\n", CDC_LOOPBACK_MAX_BLOCK);
+        return 2;
+    }
+
+    /* As MX_USB_DEVICE_Init() in usb/USB_DEVICE/App/usb_device.c */
+    if (USBD_Init(&hUsbDeviceFS, &FS_Desc, DEVICE_FS) != USBD_OK ||
+        USBD_RegisterClass(&hUsbDeviceFS, &USBD_CDC) != USBD_OK ||
+        USBD_CDC_RegisterInterface(&hUsbDeviceFS, &USBD_Interface_fops_FS) != USBD_OK ||
+        USBD_Start(&hUsbDeviceFS) != USBD_OK) {
+        Loopback_Fail("USB device init failed");
+    }
+    pcd = Loopback_Get(DEVICE_FS);
+    Loopback_Set_Hooks(pcd, &hooks);
+    tick_pcd = pcd;
+
+    if (Loopback_Host_Enumerate(pcd) != LOOPBACK_OK) {
+        return 1;
+    }
+    /* What a CDC ACM driver does when the port is opened */
+    if (Loopback_Host_Control(pcd, 0x21, CDC_SET_LINE_CODING, 0, 0, line_coding, sizeof(line_coding), NULL) != LOOPBACK_OK ||
+        Loopback_Host_Control(pcd, 0x21, CDC_SET_CONTROL_LINE_STATE, 0x0003, 0, NULL, 0, NULL) != LOOPBACK_OK ||
+        Loopback_Host_Control(pcd, 0xA1, CDC_GET_LINE_CODING, 0, 0, readback, sizeof(readback), NULL) != LOOPBACK_OK) {
+        fprintf(stderr, "CDC class request failed\n");
+        return 1;
+    }
+    fprintf(stdio_mode ? stderr : stdout, "# cdc_loopback: enumerated, line coding %lu %u%c%u\n",
+           (unsigned long)(readback[0] | (readback[1] << 8) | (readback[2] << 16) | ((uint32_t)readback[3] << 24)),
+           readback[6], "NOEMS"[readback[5] % 5U], readback[4] == 2U ? 2U : 1U);
+    Loopback_Host_Poll(pcd, CDC_IN_EP, 1);
+    Loopback_Host_Poll(pcd, CDC_CMD_EP, 1);
+
+    if (stdio_mode) {
+        Run_Stdio(pcd, loop_us);
+        return 0;
+    }
+    Stream_Out(pcd, bytes, (uint16_t)block, loop_us);
+    Stream_In(pcd, bytes, (uint16_t)block, loop_us, ring);
+    Loopback_Print_Stats(pcd);
+    return 0;
+}
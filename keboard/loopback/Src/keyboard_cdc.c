@@ -0,0 +1,104 @@
+/**
+  ******************************************************************************
+  * @file           : keyboard_cdc.c
+  * @brief          : Keyboard simulation with its CDC port on stdin/stdout
+  *
+  * keyboard_cdc [--loop-us N]
+  *   Runs the keyboard firmware on the real USB stack as keyboard_sim_usb
+  *   does, with Config_Proto_Task() in the main loop as in main.c. stdin
+  *   is the host's bulk OUT data to the CDC port, the bulk IN data goes to
+  *   stdout. The simulated time is kept in step with the wall clock, so
+  *   config_tool.py sees the bus model's timing. A main loop pass runs
+  *   every --loop-us (default 100). Ends 100 ms of simulated time after
+  *   stdin is closed.
+  ******************************************************************************
+  */
+
+#include "usbd_loopback.h"
+#include "usbd_hid_cdc.h"
+#include "config_proto.h"
+#include "sim.h"
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define KEYBOARD_CDC_DRAIN_MS   100U
+
+static uint32_t out_bytes = 0;
+
+static uint64_t Now_Us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000U;
+}
+
+/* Host side of the CDC data IN pipe */
+void Sim_Cdc_Receive(const uint8_t *data, uint16_t len)
+{
+    fwrite(data, 1, len, stdout);
+    out_bytes += len;
+}
+
+int main(int argc, char **argv)
+{
+    static uint8_t buf[4096];
+    uint32_t loop_us = 100U;
+    uint64_t wall0_us;
+    uint64_t end_us = 0;
+    Loopback_Pcd_t *pcd;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--loop-us") == 0 && i + 1 < argc) {
+            loop_us = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else {
+            fprintf(stderr, "usage: %s [--loop-us N]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (loop_us == 0U) {
+        loop_us = 1U;
+    }
+
+    Sim_Init();
+    pcd = Loopback_Get(DEVICE_FS);
+    Loopback_Host_Poll(pcd, CDC_IN_EP, 1);
+    Loopback_Host_Poll(pcd, CDC_CMD_EP, 1);
+    wall0_us = Now_Us();
+
+    while (end_us == 0U || Sim_Time_Us() < end_us) {
+        uint64_t wall_us = Now_Us() - wall0_us;
+        int wait_ms = (Sim_Time_Us() > wall_us + 1000U) ? (int)((Sim_Time_Us() - wall_us) / 1000U) : 0;
+        uint32_t flushed = out_bytes;
+
+        /* Host writes one buffer at a time; the device's NAKs pace stdin */
+        if (end_us == 0U && Loopback_Host_Write_Pending(pcd, CDC_OUT_EP) == 0U) {
+            struct pollfd pfd = {STDIN_FILENO, POLLIN, 0};
+
+            if (poll(&pfd, 1, wait_ms) > 0) {
+                ssize_t n = read(STDIN_FILENO, buf, sizeof(buf));
+
+                if (n > 0) {
+                    Loopback_Host_Write(pcd, CDC_OUT_EP, buf, (uint32_t)n);
+                } else {
+                    end_us = Sim_Time_Us() + KEYBOARD_CDC_DRAIN_MS * 1000ULL;
+                }
+            }
+        } else if (wait_ms > 0) {
+            usleep((useconds_t)wait_ms * 1000U);
+        }
+
+        /* Main loop pass, as in main.c */
+        Sim_Step(loop_us);
+        Config_Proto_Task();
+
+        if (out_bytes != flushed) {
+            fflush(stdout);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,134 @@
+/**
+  ******************************************************************************
+  * @file           : loopback_hid.c
+  * @brief          : Keyboard simulation on the real USB device stack
+  *
+  * Replaces sim/Src/sim_usbd.c: the device is the firmware's own USB stack
+  * (usbd_core, ctlreq, ioreq, the HID class, the HID + CDC composite,
+  * usbd_cdc_if.c and usbd_desc.c) on top of the software PCD.
+  * Sim_Usbd_Reset() enumerates it, and every simulated millisecond runs one
+  * bus frame in which the host polls the HID interrupt endpoint. Reports go
+  * to the recorder in sim/Src/sim_report.c as the stack hands them to the
+  * PCD and as the host receives them. Data the host reads from the CDC IN
+  * endpoint goes to Sim_Cdc_Receive().
+  ******************************************************************************
+  */
+
+#include "usbd_loopback.h"
+#include "usbd_core.h"
+#include "usbd_desc.h"
+#include "usbd_hid.h"
+#include "usbd_hid_cdc.h"
+#include "usbd_cdc_if.h"
+#include "sim.h"
+
+USBD_HandleTypeDef hUsbDeviceFS;
+
+static Loopback_Pcd_t *hid_pcd = NULL;
+
+/* Bus time at Sim_Time_Us() == 0 */
+static uint64_t bus_base_us = 0;
+
+static void Loopback_Hid_Transmit(Loopback_Pcd_t *pcd, uint8_t ep_addr, const uint8_t *data, uint32_t len)
+{
+    (void)pcd;
+    if (ep_addr == HID_EPIN_ADDR) {
+        Sim_Report_Submit(data, (uint16_t)len);
+    }
+}
+
+static void Loopback_Hid_Receive(Loopback_Pcd_t *pcd, uint8_t ep_addr, const uint8_t *data, uint16_t len)
+{
+    if (ep_addr == HID_EPIN_ADDR) {
+        Sim_Report_Delivered(Loopback_Time_Us(pcd) - bus_base_us);
+    } else if (ep_addr == CDC_IN_EP) {
+        Sim_Cdc_Receive(data, len);
+    }
+}
+
+/**
+  * @brief Host side of the CDC data IN pipe, replaced by front ends that
+  * use the CDC port (keyboard_cdc.c)
+  * @param data: Packet read by the host
+  * @param len: Packet length
+  * @retval None
+  */
+__attribute__((weak)) void Sim_Cdc_Receive(const uint8_t *data, uint16_t len)
+{
+    (void)data;
+    (void)len;
+}
+
+/* Host requests take bus time but no simulated time: line the next bus
+ * frame up with the next simulated millisecond */
+static void Loopback_Hid_Align(void)
+{
+    uint64_t next_ms = Sim_Time_Us() / 1000U + 1U;
+
+    bus_base_us = ((uint64_t)hid_pcd->frame + 1U - next_ms) * LOOPBACK_FRAME_US;
+}
+
+/**
+  * @brief Bring up the device stack and enumerate it
+  * @retval None
+  */
+void Sim_Usbd_Reset(void)
+{
+    static const Loopback_Hooks_t hooks = {Loopback_Hid_Transmit, Loopback_Hid_Receive};
+
+    if (hUsbDeviceFS.pData != NULL) {
+        USBD_Stop(&hUsbDeviceFS);
+        USBD_DeInit(&hUsbDeviceFS);
+    }
+    memset(&hUsbDeviceFS, 0, sizeof(hUsbDeviceFS));
+
+    /* As MX_USB_DEVICE_Init() */
+    if (USBD_Init(&hUsbDeviceFS, &FS_Desc, DEVICE_FS) != USBD_OK ||
+        USBD_RegisterClass(&hUsbDeviceFS, &USBD_HID_CDC) != USBD_OK ||
+        USBD_HID_CDC_RegisterInterface(&hUsbDeviceFS, &USBD_Interface_fops_FS) != USBD_OK ||
+        USBD_Start(&hUsbDeviceFS) != USBD_OK) {
+        Loopback_Fail("USB device init failed");
+    }
+    hid_pcd = Loopback_Get(DEVICE_FS);
+    Loopback_Set_Hooks(hid_pcd, &hooks);
+
+    Sim_Clear_Reports();
+    Sim_Set_Usb_Configured(1);
+}
+
+/**
+  * @brief Enumerate the device, or reset it to the default state
+  * @param configured: 1 = enumerated and configured, 0 = default state
+  * @retval None
+  */
+void Sim_Set_Usb_Configured(uint8_t configured)
+{
+    if (configured) {
+        if (Loopback_Host_Enumerate(hid_pcd) != LOOPBACK_OK) {
+            exit(1);
+        }
+        Loopback_Host_Poll(hid_pcd, HID_EPIN_ADDR, 1);
+    } else {
+        Loopback_Host_Reset(hid_pcd);
+        Sim_Report_Delivered(0);
+    }
+    Loopback_Hid_Align();
+}
+
+/**
+  * @brief Simulated millisecond boundary: run the bus up to the SOF
+  * @retval None
+  */
+void Sim_Usbd_Frame(void)
+{
+    Loopback_Run(hid_pcd, bus_base_us + Sim_Time_Us());
+}
+
+/**
+  * @brief Bus and endpoint counters of the simulated device
+  * @retval None
+  */
+void Sim_Usbd_Print_Stats(void)
+{
+    Loopback_Print_Stats(hid_pcd);
+}
@@ -0,0 +1,923 @@
+/**
+  ******************************************************************************
+  * @file           : usbd_ll_loopback.c
+  * @brief          : Software USB OTG_FS peripheral (USBD_LL_*) and host
+  ******************************************************************************
+  */
+
+#include "usbd_loopback.h"
+#include "usbd_core.h"
+#include <stdarg.h>
+
+/* Result of a single token on the bus */
+#define TOKEN_ACK       0
+#define TOKEN_NAK       1
+#define TOKEN_STALL     2
+
+#define LOOPBACK_RESUME_MS      20U     /* Host resume signalling */
+
+static Loopback_Pcd_t loopback_pcd[2];
+
+uint32_t loopback_uid[3] = {0x00470032U, 0x3431510DU, 0x33383639U};
+
+/**
+  * @brief Report an error in the device stack and stop
+  */
+void Loopback_Fail(const char *fmt, ...)
+{
+    va_list ap;
+
+    va_start(ap, fmt);
+    fprintf(stderr, "loopback: ");
+    vfprintf(stderr, fmt, ap);
+    fprintf(stderr, "\n");
+    va_end(ap);
+    abort();
+}
+
+/**
+  * @brief Software PCD of a device instance
+  * @param id: DEVICE_FS or DEVICE_HS
+  * @retval PCD, linked to the stack by USBD_LL_Init()
+  */
+Loopback_Pcd_t *Loopback_Get(uint8_t id)
+{
+    return &loopback_pcd[id & 1U];
+}
+
+/* Like HAL_PCD_*: the endpoint number is masked, not checked */
+static Loopback_Ep_t *Loopback_Ep(Loopback_Pcd_t *pcd, uint8_t ep_addr)
+{
+    uint8_t epnum = ep_addr & 0xFU;
+
+    return (ep_addr & 0x80U) ? &pcd->ep_in[epnum] : &pcd->ep_out[epnum];
+}
+
+/* ---------------------------------------------------------------------------
+ * FIFO RAM
+ * ------------------------------------------------------------------------- */
+
+static void Loopback_Check_Fifo(const Loopback_Pcd_t *pcd)
+{
+    uint32_t used = pcd->rx_fifo_words;
+
+    for (uint8_t i = 0; i < LOOPBACK_DEV_ENDPOINTS; i++) {
+        used += pcd->ep_in[i].fifo_words;
+    }
+    if (used > LOOPBACK_FIFO_WORDS) {
+        Loopback_Fail("FIFO allocation of %lu words exceeds the %u words of OTG_FS RAM",
+                      (unsigned long)used, LOOPBACK_FIFO_WORDS);
+    }
+}
+
+/**
+  * @brief Size the shared RX FIFO (HAL_PCDEx_SetRxFiFo)
+  * @param words: Depth in 32-bit words
+  * @retval None
+  */
+void Loopback_Set_Rx_Fifo(Loopback_Pcd_t *pcd, uint16_t words)
+{
+    pcd->rx_fifo_words = words;
+    Loopback_Check_Fifo(pcd);
+}
+
+/**
+  * @brief Size the TX FIFO of an IN endpoint (HAL_PCDEx_SetTxFiFo)
+  * @param epnum: Endpoint number
+  * @param words: Depth in 32-bit words
+  * @retval None
+  */
+void Loopback_Set_Tx_Fifo(Loopback_Pcd_t *pcd, uint8_t epnum, uint16_t words)
+{
+    if (epnum >= LOOPBACK_DEV_ENDPOINTS) {
+        Loopback_Fail("TX FIFO %u: OTG_FS has %u IN endpoints", epnum, LOOPBACK_DEV_ENDPOINTS);
+    }
+    pcd->ep_in[epnum].fifo_words = words;
+    Loopback_Check_Fifo(pcd);
+}
+
+/* RM0090 32.11.3: status entries for SETUP packets, the largest packet and
+ * one transfer complete word per OUT endpoint, plus the global NAK entry */
+static void Loopback_Check_Rx_Fifo(const Loopback_Pcd_t *pcd)
+{
+    uint32_t mps = 0;
+    uint32_t outs = 0;
+    uint32_t need;
+
+    for (uint8_t i = 0; i < LOOPBACK_DEV_ENDPOINTS; i++) {
+        if (!pcd->ep_out[i].open) continue;
+        outs++;
+        if (pcd->ep_out[i].mps > mps) mps = pcd->ep_out[i].mps;
+    }
+    need = (5U + 8U) + (mps / 4U + 1U) + 2U * outs + 1U;
+    if (pcd->rx_fifo_words < need) {
+        Loopback_Fail("RX FIFO of %u words, %lu needed for %lu OUT endpoints of up to %lu bytes",
+                      pcd->rx_fifo_words, (unsigned long)need, (unsigned long)outs, (unsigned long)mps);
+    }
+}
+
+/* ---------------------------------------------------------------------------
+ * Bus
+ * ------------------------------------------------------------------------- */
+
+/**
+  * @brief Bus time
+  * @retval Microseconds since USBD_LL_Init()
+  */
+uint64_t Loopback_Time_Us(const Loopback_Pcd_t *pcd)
+{
+    return (uint64_t)pcd->frame * LOOPBACK_FRAME_US
+           + (uint64_t)pcd->frame_bytes * LOOPBACK_FRAME_US / LOOPBACK_FRAME_BYTES;
+}
+
+static void Loopback_Bus_Use(Loopback_Pcd_t *pcd, uint32_t bytes)
+{
+    pcd->frame_bytes += bytes;
+    pcd->bus_bytes += bytes;
+}
+
+static void Loopback_Next_Frame(Loopback_Pcd_t *pcd)
+{
+    pcd->frame++;
+    pcd->frame_bytes = 0;
+    pcd->frame_started = 0;
+}
+
+/* Bus time without frames (reset, resume signalling) */
+static void Loopback_Skip_Frames(Loopback_Pcd_t *pcd, uint32_t n)
+{
+    pcd->frame += n + (pcd->frame_started ? 1U : 0U);
+    pcd->frame_bytes = 0;
+    pcd->frame_started = 0;
+}
+
+/**
+  * @brief IN token
+  * @param epnum: Endpoint number
+  * @param data: Receives the packet on EP0, may be NULL
+  * @param len: Receives the packet length, may be NULL
+  * @retval TOKEN_ACK, _NAK or _STALL
+  */
+static int Loopback_In_Token(Loopback_Pcd_t *pcd, uint8_t epnum, uint8_t *data, uint16_t *len)
+{
+    Loopback_Ep_t *ep = &pcd->ep_in[epnum];
+    uint32_t n;
+
+    if (!ep->open || ep->stalled) {
+        Loopback_Bus_Use(pcd, LOOPBACK_OVERHEAD_BYTES);
+        ep->stats.stalls++;
+        return TOKEN_STALL;
+    }
+    if (!ep->armed) {
+        Loopback_Bus_Use(pcd, LOOPBACK_OVERHEAD_BYTES);
+        ep->stats.naks++;
+        ep->nak = 1;
+        return TOKEN_NAK;
+    }
+
+    n = ep->len - ep->count;
+    if (n > ep->mps) n = ep->mps;
+    Loopback_Bus_Use(pcd, n + LOOPBACK_OVERHEAD_BYTES);
+    ep->stats.packets++;
+    ep->stats.bytes += n;
+
+    if (data != NULL && n > 0U) {
+        memcpy(data, ep->buf + ep->count, n);
+    }
+    if (len != NULL) *len = (uint16_t)n;
+    if (epnum != 0U && pcd->hooks.receive != NULL) {
+        pcd->hooks.receive(pcd, epnum | 0x80U, ep->buf + ep->count, (uint16_t)n);
+    }
+    ep->count += n;
+
+    /* EP0 completes per packet, the others when the transfer is done */
+    if (epnum == 0U || ep->count >= ep->len) {
+        ep->armed = 0;
+        USBD_LL_DataInStage(pcd->pdev, epnum, ep->buf);
+    }
+    return TOKEN_ACK;
+}
+
+/**
+  * @brief OUT token and data packet
+  * @param epnum: Endpoint number
+  * @param data: Packet payload
+  * @param n: Payload size (at most the endpoint packet size)
+  * @retval TOKEN_ACK, _NAK or _STALL
+  */
+static int Loopback_Out_Token(Loopback_Pcd_t *pcd, uint8_t epnum, const uint8_t *data, uint32_t n)
+{
+    Loopback_Ep_t *ep = &pcd->ep_out[epnum];
+
+    Loopback_Bus_Use(pcd, n + LOOPBACK_OVERHEAD_BYTES);
+    if (!ep->open || ep->stalled) {
+        ep->stats.stalls++;
+        return TOKEN_STALL;
+    }
+    if (!ep->armed) {
+        ep->stats.naks++;
+        ep->nak = 1;
+        return TOKEN_NAK;
+    }
+    if (ep->count + n > ep->len) {
+        Loopback_Fail("OUT packet of %lu bytes overruns the %lu byte transfer armed on EP%u",
+                      (unsigned long)n, (unsigned long)ep->len, epnum);
+    }
+
+    if (n > 0U) {
+        memcpy(ep->buf + ep->count, data, n);
+    }
+    ep->count += n;
+    ep->stats.packets++;
+    ep->stats.bytes += n;
+
+    if (epnum == 0U || ep->count >= ep->len || n < ep->mps) {
+        ep->armed = 0;
+        USBD_LL_DataOutStage(pcd->pdev, epnum, ep->buf);
+    }
+    return TOKEN_ACK;
+}
+
+static void Loopback_Setup_Token(Loopback_Pcd_t *pcd, const uint8_t setup[8])
+{
+    uint8_t packet[8];
+
+    Loopback_Bus_Use(pcd, 8U + LOOPBACK_OVERHEAD_BYTES);
+
+    /* A SETUP clears an EP0 stall and cancels the control transfer in progress */
+    pcd->ep_in[0].stalled = 0;
+    pcd->ep_in[0].armed = 0;
+    pcd->ep_out[0].stalled = 0;
+    pcd->ep_out[0].armed = 0;
+
+    memcpy(packet, setup, sizeof(packet));
+    USBD_LL_SetupStage(pcd->pdev, packet);
+}
+
+/* Payload of the next packet the host would move on an endpoint */
+static uint32_t Loopback_Next_Packet(const Loopback_Ep_t *ep, uint8_t in)
+{
+    uint32_t n;
+
+    if (in) {
+        n = ep->armed ? ep->len - ep->count : 0U;
+    } else {
+        n = ep->out_len - ep->out_count;
+    }
+    return (n > ep->mps) ? ep->mps : n;
+}
+
+static int Loopback_Host_Out_Packet(Loopback_Pcd_t *pcd, uint8_t epnum)
+{
+    Loopback_Ep_t *ep = &pcd->ep_out[epnum];
+    uint32_t n = Loopback_Next_Packet(ep, 0);
+    int res = Loopback_Out_Token(pcd, epnum, ep->out_data + ep->out_count, n);
+
+    if (res == TOKEN_ACK) {
+        ep->out_count += n;
+        if (ep->out_count >= ep->out_len) {
+            ep->out_active = 0;
+        }
+    }
+    return res;
+}
+
+/**
+  * @brief Start of frame: SOF, then the interrupt endpoints that are due
+  * @retval None
+  */
+static void Loopback_Frame_Start(Loopback_Pcd_t *pcd)
+{
+    pcd->frame_started = 1;
+    if (!pcd->connected || pcd->pdev == NULL) return;
+
+    if (pcd->suspended) {
+        if (pcd->idle_frames < LOOPBACK_SUSPEND_MS && ++pcd->idle_frames == LOOPBACK_SUSPEND_MS) {
+            USBD_LL_Suspend(pcd->pdev);
+        }
+        return;
+    }
+
+    pcd->frames++;
+    Loopback_Bus_Use(pcd, LOOPBACK_SOF_BYTES);
+    USBD_LL_SOF(pcd->pdev);
+
+    for (uint8_t epnum = 1; epnum < LOOPBACK_DEV_ENDPOINTS; epnum++) {
+        Loopback_Ep_t *in = &pcd->ep_in[epnum];
+        Loopback_Ep_t *out = &pcd->ep_out[epnum];
+
+        if (in->open && in->type == USBD_EP_TYPE_INTR && in->polled && !in->stalled &&
+            pcd->frame >= in->next_frame &&
+            pcd->frame_bytes + Loopback_Next_Packet(in, 1) + LOOPBACK_OVERHEAD_BYTES <= LOOPBACK_PERIODIC_BYTES) {
+            in->next_frame = pcd->frame + (in->interval ? in->interval : 1U);
+            (void)Loopback_In_Token(pcd, epnum, NULL, NULL);
+        }
+        if (out->open && out->type == USBD_EP_TYPE_INTR && out->out_active && !out->stalled &&
+            pcd->frame >= out->next_frame &&
+            pcd->frame_bytes + Loopback_Next_Packet(out, 0) + LOOPBACK_OVERHEAD_BYTES <= LOOPBACK_PERIODIC_BYTES) {
+            out->next_frame = pcd->frame + (out->interval ? out->interval : 1U);
+            (void)Loopback_Host_Out_Packet(pcd, epnum);
+        }
+    }
+}
+
+/**
+  * @brief Next bulk endpoint with work, round robin over both directions
+  * @param slot: Receives 2 * (epnum - 1) + (1 for IN)
+  * @retval Endpoint, NULL if no bulk pipe can make progress
+  */
+static Loopback_Ep_t *Loopback_Next_Bulk(Loopback_Pcd_t *pcd, uint8_t *slot)
+{
+    const uint8_t slots = 2U * (LOOPBACK_DEV_ENDPOINTS - 1U);
+
+    for (uint8_t i = 0; i < slots; i++) {
+        uint8_t s = (uint8_t)((pcd->rr_next + i) % slots);
+        uint8_t epnum = 1U + s / 2U;
+        Loopback_Ep_t *ep = (s & 1U) ? &pcd->ep_in[epnum] : &pcd->ep_out[epnum];
+
+        if (!ep->open || ep->type != USBD_EP_TYPE_BULK || ep->stalled || ep->nak) continue;
+        if ((s & 1U) ? ep->polled : ep->out_active) {
+            *slot = s;
+            return ep;
+        }
+    }
+    return NULL;
+}
+
+/**
+  * @brief Run the bus
+  * Frames that start at or before until_us get their SOF and interrupt
+  * transfers; bulk transactions run while they start before until_us.
+  * Device callbacks (the stack's interrupt context) are called from here.
+  * @param until_us: Bus time to stop at
+  * @retval None
+  */
+void Loopback_Run(Loopback_Pcd_t *pcd, uint64_t until_us)
+{
+    for (;;) {
+        uint64_t frame_us = (uint64_t)pcd->frame * LOOPBACK_FRAME_US;
+        Loopback_Ep_t *ep;
+        uint8_t slot;
+
+        if (!pcd->frame_started) {
+            if (frame_us > until_us) break;
+            Loopback_Frame_Start(pcd);
+        }
+
+        if (pcd->connected && !pcd->suspended && Loopback_Time_Us(pcd) < until_us &&
+            (ep = Loopback_Next_Bulk(pcd, &slot)) != NULL &&
+            pcd->frame_bytes + Loopback_Next_Packet(ep, slot & 1U) + LOOPBACK_OVERHEAD_BYTES <= LOOPBACK_FRAME_BYTES) {
+            uint8_t epnum = 1U + slot / 2U;
+
+            pcd->rr_next = (uint8_t)(slot + 1U);
+            if (slot & 1U) {
+                (void)Loopback_In_Token(pcd, epnum, NULL, NULL);
+            } else {
+                (void)Loopback_Host_Out_Packet(pcd, epnum);
+            }
+            continue;
+        }
+
+        if (frame_us + LOOPBACK_FRAME_US > until_us) {
+            /* Idle until until_us in this frame */
+            if (until_us > frame_us) {
+                uint64_t pos = (until_us - frame_us) * LOOPBACK_FRAME_BYTES / LOOPBACK_FRAME_US;
+                if (pos > pcd->frame_bytes) pcd->frame_bytes = (uint16_t)pos;
+            }
+            break;
+        }
+        Loopback_Next_Frame(pcd);
+    }
+}
+
+/* Room for a transaction of the host's own (control transfers) */
+static void Loopback_Reserve(Loopback_Pcd_t *pcd, uint32_t bytes)
+{
+    for (;;) {
+        if (!pcd->frame_started) {
+            Loopback_Frame_Start(pcd);
+        }
+        if (pcd->frame_bytes + bytes <= LOOPBACK_FRAME_BYTES) return;
+        Loopback_Next_Frame(pcd);
+    }
+}
+
+/* ---------------------------------------------------------------------------
+ * Host side
+ * ------------------------------------------------------------------------- */
+
+/**
+  * @brief Install the host side traffic hooks
+  * @param hooks: Hooks, copied
+  * @retval None
+  */
+void Loopback_Set_Hooks(Loopback_Pcd_t *pcd, const Loopback_Hooks_t *hooks)
+{
+    pcd->hooks = *hooks;
+}
+
+/**
+  * @brief USB bus reset: endpoints closed, address 0, host pipes dropped
+  * @retval None
+  */
+void Loopback_Host_Reset(Loopback_Pcd_t *pcd)
+{
+    for (uint8_t i = 0; i < LOOPBACK_EP_COUNT; i++) {
+        uint16_t fifo_words = pcd->ep_in[i].fifo_words;
+
+        memset(&pcd->ep_in[i], 0, sizeof(Loopback_Ep_t));
+        memset(&pcd->ep_out[i], 0, sizeof(Loopback_Ep_t));
+        pcd->ep_in[i].fifo_words = fifo_words;
+    }
+    pcd->address = 0;
+    pcd->suspended = 0;
+    pcd->idle_frames = 0;
+    Loopback_Skip_Frames(pcd, LOOPBACK_RESET_MS);
+
+    USBD_LL_SetSpeed(pcd->pdev, USBD_SPEED_FULL);
+    USBD_LL_Reset(pcd->pdev);
+}
+
+/**
+  * @brief Stop sending SOFs; the device suspends after 3 ms of idle bus
+  * @retval None
+  */
+void Loopback_Host_Suspend(Loopback_Pcd_t *pcd)
+{
+    pcd->suspended = 1;
+    pcd->idle_frames = 0;
+}
+
+/**
+  * @brief Resume signalling, then SOFs again
+  * @retval None
+  */
+void Loopback_Host_Resume(Loopback_Pcd_t *pcd)
+{
+    if (!pcd->suspended) return;
+
+    Loopback_Skip_Frames(pcd, LOOPBACK_RESUME_MS);
+    pcd->suspended = 0;
+    if (pcd->idle_frames >= LOOPBACK_SUSPEND_MS) {
+        USBD_LL_Resume(pcd->pdev);
+    }
+    pcd->idle_frames = 0;
+}
+
+/* A NAKed control stage is retried in the next frame */
+static int Loopback_Nak_Wait(Loopback_Pcd_t *pcd, uint32_t *waited)
+{
+    Loopback_Next_Frame(pcd);
+    return ++(*waited) > LOOPBACK_CONTROL_TIMEOUT_MS;
+}
+
+/**
+  * @brief Control transfer on EP0, run to completion on the bus
+  * @param bm: bmRequestType
+  * @param req: bRequest
+  * @param value: wValue
+  * @param index: wIndex
+  * @param data: Data stage buffer (length bytes), may be NULL if length is 0
+  * @param length: wLength
+  * @param actual: Receives the data stage length, may be NULL
+  * @retval LOOPBACK_OK, _STALL, _TIMEOUT or _ERROR
+  */
+int Loopback_Host_Control(Loopback_Pcd_t *pcd, uint8_t bm, uint8_t req, uint16_t value,
+                          uint16_t index, uint8_t *data, uint16_t length, uint16_t *actual)
+{
+    const uint8_t setup[8] = {
+        bm, req, (uint8_t)value, (uint8_t)(value >> 8),
+        (uint8_t)index, (uint8_t)(index >> 8), (uint8_t)length, (uint8_t)(length >> 8)
+    };
+    uint32_t waited = 0;
+    uint16_t done = 0;
+    uint16_t n;
+    int res;
+
+    if (actual != NULL) *actual = 0;
+    if (!pcd->connected || pcd->suspended) return LOOPBACK_ERROR;
+
+    Loopback_Reserve(pcd, 8U + LOOPBACK_OVERHEAD_BYTES);
+    Loopback_Setup_Token(pcd, setup);
+
+    if (bm & 0x80U) {
+        /* Data IN until a short packet or wLength, status OUT */
+        while (done < length) {
+            Loopback_Reserve(pcd, LOOPBACK_MAX_PACKET + LOOPBACK_OVERHEAD_BYTES);
+            res = Loopback_In_Token(pcd, 0, data + done, &n);
+            if (res == TOKEN_STALL) return LOOPBACK_STALL;
+            if (res == TOKEN_NAK) {
+                if (Loopback_Nak_Wait(pcd, &waited)) return LOOPBACK_TIMEOUT;
+                continue;
+            }
+            done += n;
+            if (n < pcd->ep_in[0].mps) break;
+        }
+        for (;;) {
+            Loopback_Reserve(pcd, LOOPBACK_OVERHEAD_BYTES);
+            res = Loopback_Out_Token(pcd, 0, NULL, 0);
+            if (res == TOKEN_STALL) return LOOPBACK_STALL;
+            if (res == TOKEN_ACK) break;
+            if (Loopback_Nak_Wait(pcd, &waited)) return LOOPBACK_TIMEOUT;
+        }
+    } else {
+        /* Data OUT, status IN */
+        while (done < length) {
+            n = (uint16_t)(length - done);
+            if (n > pcd->ep_out[0].mps) n = pcd->ep_out[0].mps;
+            Loopback_Reserve(pcd, n + LOOPBACK_OVERHEAD_BYTES);
+            res = Loopback_Out_Token(pcd, 0, data + done, n);
+            if (res == TOKEN_STALL) return LOOPBACK_STALL;
+            if (res == TOKEN_NAK) {
+                if (Loopback_Nak_Wait(pcd, &waited)) return LOOPBACK_TIMEOUT;
+                continue;
+            }
+            done += n;
+        }
+        for (;;) {
+            Loopback_Reserve(pcd, LOOPBACK_OVERHEAD_BYTES);
+            res = Loopback_In_Token(pcd, 0, NULL, &n);
+            if (res == TOKEN_STALL) return LOOPBACK_STALL;
+            if (res == TOKEN_ACK) break;
+            if (Loopback_Nak_Wait(pcd, &waited)) return LOOPBACK_TIMEOUT;
+        }
+    }
+
+    if (actual != NULL) *actual = done;
+    return LOOPBACK_OK;
+}
+
+static const char *Loopback_Ep_Type(uint8_t type)
+{
+    static const char *const names[] = {"ctrl", "isoc", "bulk", "intr"};
+    return names[type & 3U];
+}
+
+/**
+  * @brief Check the endpoints of the configuration descriptor against the
+  *        endpoints the device opened, and take their polling intervals
+  * @retval None
+  */
+static void Loopback_Host_Check_Endpoints(Loopback_Pcd_t *pcd)
+{
+    uint16_t pos = 0;
+
+    while (pos + 2U <= pcd->config_len && pcd->config_desc[pos] >= 2U) {
+        const uint8_t *d = &pcd->config_desc[pos];
+
+        if (d[1] == USB_DESC_TYPE_ENDPOINT && d[0] >= 7U && pos + 7U <= pcd->config_len) {
+            Loopback_Ep_t *ep = Loopback_Ep(pcd, d[2]);
+            uint16_t mps = (uint16_t)(d[4] | (d[5] << 8));
+            uint8_t type = d[3] & 3U;
+
+            if (!ep->open || ep->mps != mps || ep->type != type) {
+                Loopback_Fail("EP 0x%02X: descriptor says %s/%u, device opened %s/%u",
+                              d[2], Loopback_Ep_Type(type), mps,
+                              ep->open ? Loopback_Ep_Type(ep->type) : "closed", ep->mps);
+            }
+            ep->interval = d[6];
+            ep->next_frame = pcd->frame + 1U;
+        }
+        pos += d[0];
+    }
+}
+
+/**
+  * @brief Enumerate like a Linux host: reset, device descriptor, address,
+  *        configuration and string descriptors, SET_CONFIGURATION
+  * @retval LOOPBACK_OK, or the result of the failing request (see stderr)
+  */
+int Loopback_Host_Enumerate(Loopback_Pcd_t *pcd)
+{
+    uint8_t buf[LOOPBACK_MAX_CONFIG_DESC];
+    uint16_t n;
+    int res;
+
+#define LOOPBACK_STEP(what, call) \
+    if ((res = (call)) != LOOPBACK_OK) { \
+        fprintf(stderr, "loopback: enumeration failed at %s (%d)\n", what, res); \
+        return res; \
+    }
+
+    if (!pcd->connected) {
+        fprintf(stderr, "loopback: enumeration failed, device not connected\n");
+        return LOOPBACK_ERROR;
+    }
+
+    Loopback_Host_Reset(pcd);
+    LOOPBACK_STEP("GET_DESCRIPTOR(device, 64)",
+                  Loopback_Host_Control(pcd, 0x80, USB_REQ_GET_DESCRIPTOR, USB_DESC_TYPE_DEVICE << 8, 0, buf, 64, &n));
+    Loopback_Host_Reset(pcd);
+    LOOPBACK_STEP("SET_ADDRESS",
+                  Loopback_Host_Control(pcd, 0x00, USB_REQ_SET_ADDRESS, 1, 0, NULL, 0, NULL));
+    if (pcd->address != 1U) {
+        fprintf(stderr, "loopback: enumeration failed, address %u after SET_ADDRESS(1)\n", pcd->address);
+        return LOOPBACK_ERROR;
+    }
+    Loopback_Run(pcd, Loopback_Time_Us(pcd) + LOOPBACK_SET_ADDRESS_MS * LOOPBACK_FRAME_US);
+
+    LOOPBACK_STEP("GET_DESCRIPTOR(device)",
+                  Loopback_Host_Control(pcd, 0x80, USB_REQ_GET_DESCRIPTOR, USB_DESC_TYPE_DEVICE << 8, 0,
+                                        pcd->device_desc, sizeof(pcd->device_desc), &n));
+    if (n != sizeof(pcd->device_desc)) {
+        fprintf(stderr, "loopback: device descriptor of %u bytes\n", n);
+        return LOOPBACK_ERROR;
+    }
+    LOOPBACK_STEP("GET_DESCRIPTOR(configuration, 9)",
+                  Loopback_Host_Control(pcd, 0x80, USB_REQ_GET_DESCRIPTOR, USB_DESC_TYPE_CONFIGURATION << 8, 0,
+                                        buf, 9, &n));
+    pcd->config_len = (uint16_t)(buf[2] | (buf[3] << 8));
+    if (n != 9U || pcd->config_len > sizeof(pcd->config_desc)) {
+        fprintf(stderr, "loopback: configuration descriptor of %u bytes\n", pcd->config_len);
+        return LOOPBACK_ERROR;
+    }
+    LOOPBACK_STEP("GET_DESCRIPTOR(configuration)",
+                  Loopback_Host_Control(pcd, 0x80, USB_REQ_GET_DESCRIPTOR, USB_DESC_TYPE_CONFIGURATION << 8, 0,
+                                        pcd->config_desc, pcd->config_len, &n));
+
+    /* Language IDs, then manufacturer, product and serial number */
+    LOOPBACK_STEP("GET_DESCRIPTOR(string 0)",
+                  Loopback_Host_Control(pcd, 0x80, USB_REQ_GET_DESCRIPTOR, USB_DESC_TYPE_STRING << 8, 0, buf, 255, &n));
+    for (uint8_t i = 14; i <= 16U; i++) {
+        if (pcd->device_desc[i] == 0U) continue;
+        LOOPBACK_STEP("GET_DESCRIPTOR(string)",
+                      Loopback_Host_Control(pcd, 0x80, USB_REQ_GET_DESCRIPTOR,
+                                            (USB_DESC_TYPE_STRING << 8) | pcd->device_desc[i], 0x0409, buf, 255, &n));
+    }
+
+    LOOPBACK_STEP("SET_CONFIGURATION",
+                  Loopback_Host_Control(pcd, 0x00, USB_REQ_SET_CONFIGURATION, pcd->config_desc[5], 0, NULL, 0, NULL));
+#undef LOOPBACK_STEP
+
+    Loopback_Host_Check_Endpoints(pcd);
+    return LOOPBACK_OK;
+}
+
+/**
+  * @brief Start or stop reading an IN endpoint
+  * Interrupt endpoints are polled every bInterval frames, bulk endpoints
+  * whenever the frame has bus time left.
+  * @param ep_addr: Endpoint address (0x8n)
+  * @param enable: 1 = poll, 0 = stop
+  * @retval None
+  */
+void Loopback_Host_Poll(Loopback_Pcd_t *pcd, uint8_t ep_addr, uint8_t enable)
+{
+    Loopback_Ep_t *ep = &pcd->ep_in[ep_addr & 0xFU];
+
+    ep->polled = enable;
+    ep->nak = 0;
+}
+
+/**
+  * @brief Queue an OUT transfer: ceil(len / wMaxPacketSize) packets, or one
+  *        ZLP if len is 0
+  * @param epnum: Endpoint number
+  * @param data: Data, must stay valid until the transfer is done
+  * @param len: Length in bytes
+  * @retval None
+  */
+void Loopback_Host_Write(Loopback_Pcd_t *pcd, uint8_t epnum, const uint8_t *data, uint32_t len)
+{
+    Loopback_Ep_t *ep = &pcd->ep_out[epnum & 0xFU];
+
+    if (ep->out_active) {
+        Loopback_Fail("host write on EP%u while one is pending", epnum & 0xFU);
+    }
+    ep->out_data = data;
+    ep->out_len = len;
+    ep->out_count = 0;
+    ep->out_active = 1;
+    ep->nak = 0;
+}
+
+/**
+  * @brief Bytes of the last host write the device has not taken yet
+  * @param epnum: Endpoint number
+  * @retval Byte count (0 for a pending ZLP), 0 when the transfer is done
+  */
+uint32_t Loopback_Host_Write_Pending(const Loopback_Pcd_t *pcd, uint8_t epnum)
+{
+    const Loopback_Ep_t *ep = &pcd->ep_out[epnum & 0xFU];
+
+    return ep->out_active ? ep->out_len - ep->out_count : 0U;
+}
+
+/**
+  * @brief Print bus and endpoint counters
+  * @retval None
+  */
+void Loopback_Print_Stats(const Loopback_Pcd_t *pcd)
+{
+    printf("# loopback: %lu frames, bus %.1f %% busy\n", (unsigned long)pcd->frames,
+           pcd->frames ? 100.0 * (double)pcd->bus_bytes / ((double)pcd->frames * LOOPBACK_FRAME_BYTES) : 0.0);
+
+    for (uint8_t i = 0; i < 2U * LOOPBACK_DEV_ENDPOINTS; i++) {
+        uint8_t ep_addr = (uint8_t)((i / 2U) | ((i & 1U) ? 0x80U : 0U));
+        const Loopback_Ep_t *ep = (i & 1U) ? &pcd->ep_in[i / 2U] : &pcd->ep_out[i / 2U];
+
+        if (ep->stats.packets == 0U && ep->stats.naks == 0U && ep->stats.stalls == 0U) continue;
+        printf("#   EP 0x%02X %-4s packets %8lu bytes %10lu naks %8lu stalls %lu\n",
+               ep_addr, Loopback_Ep_Type(ep->type), (unsigned long)ep->stats.packets,
+               (unsigned long)ep->stats.bytes, (unsigned long)ep->stats.naks,
+               (unsigned long)ep->stats.stalls);
+    }
+}
+
+/* ---------------------------------------------------------------------------
+ * USBD_LL_* (device side, replaces USB_DEVICE/Target/usbd_conf.c)
+ * ------------------------------------------------------------------------- */
+
+USBD_StatusTypeDef USBD_LL_Init(USBD_HandleTypeDef *pdev)
+{
+    Loopback_Pcd_t *pcd = Loopback_Get(pdev->id);
+
+    /* Link the driver to the stack */
+    memset(pcd, 0, sizeof(*pcd));
+    pcd->pdev = pdev;
+    pdev->pData = pcd;
+
+    Loopback_Set_Rx_Fifo(pcd, LOOPBACK_RX_FIFO_WORDS);
+    Loopback_Set_Tx_Fifo(pcd, 0, LOOPBACK_TX0_FIFO_WORDS);
+    Loopback_Set_Tx_Fifo(pcd, 1, LOOPBACK_TX1_FIFO_WORDS);
+    Loopback_Set_Tx_Fifo(pcd, 2, LOOPBACK_TX2_FIFO_WORDS);
+    Loopback_Set_Tx_Fifo(pcd, 3, LOOPBACK_TX3_FIFO_WORDS);
+    return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_DeInit(USBD_HandleTypeDef *pdev)
+{
+    Loopback_Pcd_t *pcd = (Loopback_Pcd_t *)pdev->pData;
+
+    pcd->pdev = NULL;
+    pcd->connected = 0;
+    return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_Start(USBD_HandleTypeDef *pdev)
+{
+    ((Loopback_Pcd_t *)pdev->pData)->connected = 1;
+    return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_Stop(USBD_HandleTypeDef *pdev)
+{
+    ((Loopback_Pcd_t *)pdev->pData)->connected = 0;
+    return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_OpenEP(USBD_HandleTypeDef *pdev, uint8_t ep_addr, uint8_t ep_type, uint16_t ep_mps)
+{
+    Loopback_Pcd_t *pcd = (Loopback_Pcd_t *)pdev->pData;
+    Loopback_Ep_t *ep = Loopback_Ep(pcd, ep_addr);
+
+    if ((ep_addr & 0xFU) >= LOOPBACK_DEV_ENDPOINTS) {
+        Loopback_Fail("endpoint 0x%02X: OTG_FS has %u endpoints per direction", ep_addr, LOOPBACK_DEV_ENDPOINTS);
+    }
+    if (ep_mps == 0U || ep_mps > LOOPBACK_MAX_PACKET) {
+        Loopback_Fail("endpoint 0x%02X opened with packet size %u", ep_addr, ep_mps);
+    }
+    ep->open = 1;
+    ep->type = ep_type;
+    ep->mps = ep_mps;
+    if (ep_addr & 0x80U) {
+        pcd->hpcd.IN_ep[ep_addr & 0xFU].maxpacket = ep_mps;
+    } else {
+        pcd->hpcd.OUT_ep[ep_addr & 0xFU].maxpacket = ep_mps;
+    }
+    ep->stalled = 0;
+    ep->armed = 0;
+    ep->count = 0;
+    ep->nak = 0;
+
+    if ((ep_addr & 0x80U) == 0U) {
+        Loopback_Check_Rx_Fifo(pcd);
+    }
+    return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_CloseEP(USBD_HandleTypeDef *pdev, uint8_t ep_addr)
+{
+    Loopback_Ep_t *ep = Loopback_Ep((Loopback_Pcd_t *)pdev->pData, ep_addr);
+
+    ep->open = 0;
+    ep->armed = 0;
+    return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_FlushEP(USBD_HandleTypeDef *pdev, uint8_t ep_addr)
+{
+    Loopback_Ep((Loopback_Pcd_t *)pdev->pData, ep_addr)->armed = 0;
+    return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_StallEP(USBD_HandleTypeDef *pdev, uint8_t ep_addr)
+{
+    Loopback_Ep((Loopback_Pcd_t *)pdev->pData, ep_addr)->stalled = 1;
+    return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_ClearStallEP(USBD_HandleTypeDef *pdev, uint8_t ep_addr)
+{
+    Loopback_Ep_t *ep = Loopback_Ep((Loopback_Pcd_t *)pdev->pData, ep_addr);
+
+    ep->stalled = 0;
+    ep->nak = 0;
+    return USBD_OK;
+}
+
+uint8_t USBD_LL_IsStallEP(USBD_HandleTypeDef *pdev, uint8_t ep_addr)
+{
+    return Loopback_Ep((Loopback_Pcd_t *)pdev->pData, ep_addr)->stalled;
+}
+
+USBD_StatusTypeDef USBD_LL_SetUSBAddress(USBD_HandleTypeDef *pdev, uint8_t dev_addr)
+{
+    if (dev_addr > 127U) {
+        Loopback_Fail("device address %u", dev_addr);
+    }
+    ((Loopback_Pcd_t *)pdev->pData)->address = dev_addr;
+    return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_Transmit(USBD_HandleTypeDef *pdev, uint8_t ep_addr, uint8_t *pbuf, uint32_t size)
+{
+    Loopback_Pcd_t *pcd = (Loopback_Pcd_t *)pdev->pData;
+    /* The stack passes 0x00 for EP0 IN; the PCD only looks at the number */
+    uint8_t epnum = ep_addr & 0xFU;
+    Loopback_Ep_t *ep = &pcd->ep_in[epnum];
+    uint32_t packet = (size < ep->mps) ? size : ep->mps;
+
+    if (!ep->open) {
+        Loopback_Fail("transmit on closed endpoint 0x%02X", epnum | 0x80U);
+    }
+    if (epnum == 0U && pdev->ep0_state == USBD_EP0_DATA_IN && size > pdev->request.wLength) {
+        Loopback_Fail("EP0 IN data stage of %lu bytes for wLength %u (request %02X %02X)",
+                      (unsigned long)size, pdev->request.wLength,
+                      pdev->request.bmRequest, pdev->request.bRequest);
+    }
+    if (size > 0U && pbuf == NULL) {
+        Loopback_Fail("transmit of %lu bytes from NULL on 0x%02X", (unsigned long)size, epnum | 0x80U);
+    }
+    if (packet > ep->fifo_words * 4U) {
+        Loopback_Fail("EP%u IN: %lu byte packet, TX FIFO %u has %u words (HAL_PCDEx_SetTxFiFo)",
+                      epnum, (unsigned long)packet, epnum, ep->fifo_words);
+    }
+
+    ep->buf = pbuf;
+    ep->len = size;
+    ep->count = 0;
+    ep->armed = 1;
+    ep->nak = 0;
+    if (epnum != 0U && pcd->hooks.transmit != NULL) {
+        pcd->hooks.transmit(pcd, epnum | 0x80U, pbuf, size);
+    }
+    return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_PrepareReceive(USBD_HandleTypeDef *pdev, uint8_t ep_addr, uint8_t *pbuf, uint32_t size)
+{
+    Loopback_Ep_t *ep = &((Loopback_Pcd_t *)pdev->pData)->ep_out[ep_addr & 0xFU];
+
+    if (!ep->open) {
+        Loopback_Fail("receive on closed endpoint 0x%02X", ep_addr & 0xFU);
+    }
+    ep->buf = pbuf;
+    ep->len = size;
+    ep->count = 0;
+    ep->armed = 1;
+    ep->nak = 0;
+    return USBD_OK;
+}
+
+uint32_t USBD_LL_GetRxDataSize(USBD_HandleTypeDef *pdev, uint8_t ep_addr)
+{
+    return ((Loopback_Pcd_t *)pdev->pData)->ep_out[ep_addr & 0xFU].count;
+}
+
+USBD_StatusTypeDef USBD_LL_SetTestMode(USBD_HandleTypeDef *pdev, uint8_t testmode)
+{
+    (void)pdev;
+    (void)testmode;
+    return USBD_OK;
+}
+
+void USBD_LL_Delay(uint32_t Delay)
+{
+    (void)Delay;
+}
+
+/**
+  * @brief Class data allocation
+  * Heap instead of the firmware's static block, so that several device
+  * instances and classes can coexist in one process.
+  */
+void *USBD_static_malloc(uint32_t size)
+{
+    return malloc(size);
+}
+
+void USBD_static_free(void *p)
+{
+    free(p);
+}
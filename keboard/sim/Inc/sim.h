@@ -0,0 +1,67 @@
+/**
+  ******************************************************************************
+  * @file           : sim.h
+  * @brief          : Host simulation of the keyboard firmware
+  *
+  * The unmodified keyboard core (matrix scan, debounce, keymap, leader,
+  * repeat, mouse keys, report queue) runs against the mock HAL in sim/Inc:
+  *   - a switch matrix drives the column inputs of the simulated GPIOs
+  *   - a microsecond clock feeds HAL_GetTick() and generates one USB SOF
+  *     per millisecond
+  *   - the HID IN endpoint takes one report per frame; every report is
+  *     recorded with the time it was submitted and delivered to the host
+  * Sim_Step() runs one pass of the firmware main loop.
+  ******************************************************************************
+  */
+
+#ifndef __SIM_H
+#define __SIM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "stm32f4xx_hal.h"
+#include "usbd_hid.h"
+
+/* Capacity of the report recorder */
+#define SIM_MAX_REPORTS       65536U
+
+/* Firmware scan period (main.c scans every 10 ms) */
+#define SIM_SCAN_PERIOD_US    10000U
+
+/* Recorded report, as seen by the host */
+typedef struct {
+    uint64_t submit_us;         // Handed to the IN endpoint
+    uint64_t deliver_us;        // Taken by the host (next frame), 0 = in flight
+    uint8_t len;
+    uint8_t data[HID_EPIN_SIZE];
+} Sim_Report_t;
+
+/* Function Prototypes */
+void Sim_Init(void);
+void Sim_Set_Key(uint8_t row, uint8_t col, uint8_t closed);
+void Sim_Set_Usb_Configured(uint8_t configured);
+void Sim_Set_Scan_Period(uint32_t us);
+void Sim_Advance(uint32_t us);
+void Sim_Step(uint32_t us);
+uint64_t Sim_Time_Us(void);
+uint32_t Sim_Report_Count(void);
+const Sim_Report_t *Sim_Get_Report(uint32_t index);
+uint32_t Sim_Reports_Lost(void);
+void Sim_Clear_Reports(void);
+void Sim_Usbd_Print_Stats(void);
+
+/* Internals shared by sim_hal.c and the USB device back end */
+void Sim_Hal_Reset(void);
+void Sim_Usbd_Reset(void);
+void Sim_Usbd_Frame(void);
+void Sim_Report_Submit(const uint8_t *report, uint16_t len);
+void Sim_Report_Delivered(uint64_t us);
+void Sim_Cdc_Receive(const uint8_t *data, uint16_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SIM_H */
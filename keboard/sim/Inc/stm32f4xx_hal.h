@@ -0,0 +1,105 @@
+/**
+  ******************************************************************************
+  * @file           : stm32f4xx_hal.h
+  * @brief          : Host mock of the subset of the STM32F4 HAL used by the
+  *                   keyboard core (simulation build only)
+  *
+  * GPIO ports are plain structs in RAM. Column inputs are computed from the
+  * simulated switch matrix when they are read (see sim_hal.c), HAL_GetTick()
+  * follows the simulated clock.
+  ******************************************************************************
+  */
+
+#ifndef __STM32F4xx_HAL_H
+#define __STM32F4xx_HAL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define __IO       volatile
+#define __weak     __attribute__((weak))
+#define UNUSED(X)  ((void)(X))
+
+typedef enum {
+    HAL_OK      = 0x00U,
+    HAL_ERROR   = 0x01U,
+    HAL_BUSY    = 0x02U,
+    HAL_TIMEOUT = 0x03U
+} HAL_StatusTypeDef;
+
+/* GPIO */
+typedef enum {
+    GPIO_PIN_RESET = 0,
+    GPIO_PIN_SET
+} GPIO_PinState;
+
+typedef struct {
+    __IO uint32_t MODER;
+    __IO uint32_t OTYPER;
+    __IO uint32_t OSPEEDR;
+    __IO uint32_t PUPDR;
+    __IO uint32_t IDR;
+    __IO uint32_t ODR;
+    __IO uint32_t BSRR;
+    __IO uint32_t LCKR;
+    __IO uint32_t AFR[2];
+} GPIO_TypeDef;
+
+typedef struct {
+    uint32_t Pin;
+    uint32_t Mode;
+    uint32_t Pull;
+    uint32_t Speed;
+    uint32_t Alternate;
+} GPIO_InitTypeDef;
+
+#define GPIO_PIN_0              ((uint16_t)0x0001)
+#define GPIO_PIN_1              ((uint16_t)0x0002)
+#define GPIO_PIN_2              ((uint16_t)0x0004)
+#define GPIO_PIN_3              ((uint16_t)0x0008)
+#define GPIO_PIN_4              ((uint16_t)0x0010)
+#define GPIO_PIN_5              ((uint16_t)0x0020)
+#define GPIO_PIN_6              ((uint16_t)0x0040)
+#define GPIO_PIN_7              ((uint16_t)0x0080)
+#define GPIO_PIN_8              ((uint16_t)0x0100)
+#define GPIO_PIN_9              ((uint16_t)0x0200)
+#define GPIO_PIN_10             ((uint16_t)0x0400)
+#define GPIO_PIN_11             ((uint16_t)0x0800)
+#define GPIO_PIN_12             ((uint16_t)0x1000)
+#define GPIO_PIN_13             ((uint16_t)0x2000)
+#define GPIO_PIN_14             ((uint16_t)0x4000)
+#define GPIO_PIN_15             ((uint16_t)0x8000)
+
+#define GPIO_MODE_INPUT         0x00000000U
+#define GPIO_MODE_OUTPUT_PP     0x00000001U
+#define GPIO_NOPULL             0x00000000U
+#define GPIO_PULLUP             0x00000001U
+#define GPIO_PULLDOWN           0x00000002U
+#define GPIO_SPEED_FREQ_LOW     0x00000000U
+
+#define SIM_GPIO_PORTS          5
+extern GPIO_TypeDef sim_gpio[SIM_GPIO_PORTS];
+
+#define GPIOA                   (&sim_gpio[0])
+#define GPIOB                   (&sim_gpio[1])
+#define GPIOC                   (&sim_gpio[2])
+#define GPIOD                   (&sim_gpio[3])
+#define GPIOE                   (&sim_gpio[4])
+
+/* Function Prototypes */
+uint32_t HAL_GetTick(void);
+void HAL_Delay(uint32_t Delay);
+void HAL_GPIO_Init(GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_Init);
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin);
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState);
+void HAL_GPIO_TogglePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __STM32F4xx_HAL_H */
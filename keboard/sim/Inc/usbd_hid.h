@@ -0,0 +1,65 @@
+/**
+  ******************************************************************************
+  * @file           : usbd_hid.h
+  * @brief          : Host mock of the USB device / HID class interface used by
+  *                   usb_keyboard.c (simulation build only)
+  *
+  * USBD_HID_SendReport() hands the report to a simulated IN endpoint that
+  * the host polls once per frame; sim_report.c records every report with its
+  * submit and delivery time.
+  ******************************************************************************
+  */
+
+/* Same guard as the class header: a build on the real stack (loopback/)
+ * includes that first and this one drops out */
+#ifndef __USB_HID_H
+#define __USB_HID_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "stm32f4xx_hal.h"
+
+#define USBD_OK                 0U
+#define USBD_BUSY               1U
+#define USBD_FAIL               3U
+
+#define USBD_STATE_DEFAULT      0x01U
+#define USBD_STATE_ADDRESSED    0x02U
+#define USBD_STATE_CONFIGURED   0x03U
+#define USBD_STATE_SUSPENDED    0x04U
+
+#define HID_EPIN_SIZE           0x10U
+
+typedef enum {
+    USBD_HID_IDLE = 0,
+    USBD_HID_BUSY,
+} USBD_HID_StateTypeDef;
+
+typedef struct {
+    uint32_t Protocol;
+    uint32_t IdleState;
+    uint32_t AltSetting;
+    USBD_HID_StateTypeDef state;
+} USBD_HID_HandleTypeDef;
+
+struct _USBD_HandleTypeDef {
+    __IO uint8_t dev_state;
+    __IO uint8_t dev_old_state;
+    uint32_t dev_config;
+    uint32_t dev_remote_wakeup;
+    void *pClassData;
+};
+typedef struct _USBD_HandleTypeDef USBD_HandleTypeDef;
+
+/* Function Prototypes */
+uint8_t USBD_HID_SendReport(USBD_HandleTypeDef *pdev, uint8_t *report, uint16_t len);
+void USBD_HID_SOFCallback(USBD_HandleTypeDef *pdev);
+void USBD_HID_DataInCallback(USBD_HandleTypeDef *pdev);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __USB_HID_H */
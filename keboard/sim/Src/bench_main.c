@@ -0,0 +1,19 @@
+/**
+  ******************************************************************************
+  * @file           : bench_main.c
+  * @brief          : Host-native run of the benchmark suite (Core/Src/bench.c)
+  *
+  * Same cases as the benchmark firmware, timed in nanoseconds against the
+  * mock HAL; compare runs with ../bench_compare.py.
+  ******************************************************************************
+  */
+
+#include "sim.h"
+#include "bench.h"
+
+int main(void)
+{
+    Sim_Init();
+    Bench_Run();
+    return 0;
+}
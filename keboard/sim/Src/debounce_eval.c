@@ -0,0 +1,416 @@
+/**
+  ******************************************************************************
+  * @file           : debounce_eval.c
+  * @brief          : Contact-bounce replay harness for the debounce algorithms
+  *
+  * debounce_eval [--wave file] [--synthetic N] [--bounce-ms B] [--noise R]
+  *               [--seed S] [--settle-us U] [--scan-us L] [--debounce L]
+  *               [--dump file] [--csv]
+  *
+  * A contact waveform for matrix key 0 (row 0, col 0) is replayed into the
+  * simulated column input and sampled by Matrix_Keyboard_Scan() at the scan
+  * periods given by --scan-us. The clock is stepped to every transition, so
+  * each scan samples the contact level at its own instant and bounces
+  * shorter than a scan period are seen or missed as on the hardware. For every algorithm, debounce time and scan
+  * period the reports reaching the host are compared with the intended key
+  * events:
+  *   latency   first edge of the intended event -> report delivered to host
+  *   missed    intended event without a matching report
+  *   spurious  extra key transitions seen by the host (chatter, glitches)
+  *
+  * Waveform files hold one transition per line, "<time us> <0|1>" (comma or
+  * space separated, '#' comments). Intended events are recovered from the
+  * waveform: edges closer than --settle-us form one burst, and a burst whose
+  * final level differs from the current key state is an event at its first
+  * edge. The synthetic generator knows its events directly and adds bounce
+  * bursts of up to --bounce-ms and --noise short glitches per second.
+  * --scan-us and --debounce take comma separated lists.
+  ******************************************************************************
+  */
+
+#include "sim.h"
+#include "matrix_keyboard.h"
+#include "usb_keyboard.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define EVAL_MAX_LIST    16
+
+typedef struct {
+    uint64_t t_us;
+    uint8_t level;
+} Edge_t;
+
+typedef struct {
+    Edge_t *v;
+    uint32_t n;
+    uint32_t cap;
+} Edge_List_t;
+
+static Edge_List_t wave;        // Contact transitions
+static Edge_List_t truth;       // Intended key events
+
+static const char *const algo_names[] = {"defer", "eager", "integrator"};
+
+static uint32_t rng_state = 1;
+
+static uint32_t Rand(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static uint32_t Rand_Range(uint32_t lo, uint32_t hi)
+{
+    return (hi > lo) ? lo + Rand() % (hi - lo + 1U) : lo;
+}
+
+static void Edge_Push(Edge_List_t *list, uint64_t t_us, uint8_t level)
+{
+    if (list->n == list->cap) {
+        list->cap = list->cap ? list->cap * 2U : 1024U;
+        list->v = realloc(list->v, list->cap * sizeof(Edge_t));
+        if (list->v == NULL) {
+            fprintf(stderr, "out of memory\n");
+            exit(2);
+        }
+    }
+    list->v[list->n].t_us = t_us;
+    list->v[list->n].level = level;
+    list->n++;
+}
+
+/**
+  * @brief Append a transition, dropping ones that do not change the level
+  */
+static void Wave_Edge(uint64_t t_us, uint8_t level)
+{
+    uint8_t current = wave.n ? wave.v[wave.n - 1].level : 0;
+    if (level != current) {
+        Edge_Push(&wave, t_us, level);
+    }
+}
+
+/**
+  * @brief Contact bounce: random toggles for up to bounce_us, ending at level
+  */
+static uint64_t Wave_Bounce(uint64_t t, uint8_t level, uint32_t bounce_us)
+{
+    uint64_t end = t + Rand_Range(0, bounce_us);
+
+    Wave_Edge(t, level);
+    while (1) {
+        uint64_t off = t + Rand_Range(10, 300);
+        uint64_t on = off + Rand_Range(10, 500);
+        if (on >= end) break;
+        Wave_Edge(off, !level);
+        Wave_Edge(on, level);
+        t = on;
+    }
+    return end;
+}
+
+/**
+  * @brief Synthetic presses with bounce bursts and glitches
+  * @param presses: Number of key presses
+  * @param bounce_ms: Longest bounce burst
+  * @param noise: Glitches per second while the contact is at rest
+  * @retval None
+  */
+static void Generate(uint32_t presses, uint32_t bounce_ms, double noise)
+{
+    uint64_t t = 20000;
+    uint32_t bounce_us = bounce_ms * 1000U;
+
+    for (uint32_t i = 0; i < presses; i++) {
+        for (uint8_t edge = 0; edge < 2U; edge++) {
+            uint8_t level = (edge == 0U);   /* Press, then release */
+            Edge_Push(&truth, t, level);
+            uint64_t settled = Wave_Bounce(t, level, bounce_us);
+            uint64_t next = t + Rand_Range(30, 250) * 1000U;
+            if (next < settled + 1000U) next = settled + 1000U;
+
+            /* Short glitches to the other level between settle and next edge */
+            if (noise > 0) {
+                double rest_s = (next - settled) / 1e6;
+                uint32_t glitches = (uint32_t)(rest_s * noise);
+                if ((Rand() % 1000U) < (uint32_t)((rest_s * noise - glitches) * 1000.0)) glitches++;
+                uint64_t g = settled;
+                for (uint32_t k = 0; k < glitches; k++) {
+                    uint64_t span = (next - g) / (glitches - k);
+                    uint64_t start = g + Rand_Range(200, span > 400 ? (uint32_t)(span - 200) : 200);
+                    uint64_t stop = start + Rand_Range(20, 800);
+                    if (stop + 200 >= next) break;
+                    Wave_Edge(start, !level);
+                    Wave_Edge(stop, level);
+                    g = stop;
+                }
+            }
+            t = next;
+        }
+    }
+    Wave_Edge(t, 0);
+}
+
+/**
+  * @brief Load a recorded waveform
+  * @retval 0 on success
+  */
+static int Load(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    char line[128];
+    unsigned lineno = 0;
+
+    if (f == NULL) {
+        perror(path);
+        return -1;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        unsigned long long t;
+        unsigned level;
+        lineno++;
+        char *hash = strchr(line, '#');
+        if (hash) *hash = '\0';
+        for (char *p = line; *p; p++) {
+            if (*p == ',') *p = ' ';
+        }
+        int n = sscanf(line, "%llu %u", &t, &level);
+        if (n <= 0) continue;
+        if (n != 2 || level > 1 || (wave.n && t < wave.v[wave.n - 1].t_us)) {
+            fprintf(stderr, "%s:%u: expected \"<time us> <0|1>\" in time order\n", path, lineno);
+            fclose(f);
+            return -1;
+        }
+        Wave_Edge(t, (uint8_t)level);
+    }
+    fclose(f);
+    return 0;
+}
+
+/**
+  * @brief Recover intended events from a recorded waveform
+  */
+static void Derive_Truth(uint32_t settle_us)
+{
+    uint8_t state = 0;
+    uint32_t i = 0;
+
+    while (i < wave.n) {
+        uint32_t first = i;
+        while (i + 1 < wave.n && (wave.v[i + 1].t_us - wave.v[i].t_us) < settle_us) {
+            i++;
+        }
+        if (wave.v[i].level != state) {
+            state = wave.v[i].level;
+            Edge_Push(&truth, wave.v[first].t_us, state);
+        }
+        i++;
+    }
+}
+
+static int Cmp_U32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+  * @brief Replay the waveform through one configuration and print the result
+  */
+static void Evaluate(uint8_t algo, uint16_t debounce_ms, uint32_t scan_us, uint8_t csv)
+{
+    static Edge_List_t seen;
+    uint64_t end_us = wave.v[wave.n - 1].t_us + 200000U;
+    uint32_t next = 0, reported = 0;
+    uint8_t host_state = 0;
+    uint32_t missed = 0, spurious = 0, matched = 0;
+    uint32_t *latency = malloc((truth.n + 1U) * sizeof(uint32_t));
+
+    Sim_Init();
+    Matrix_Keyboard_Set_Debounce(debounce_ms);
+    Matrix_Keyboard_Set_Debounce_Algo(algo);
+    Sim_Set_Scan_Period(scan_us);
+    seen.n = 0;
+
+    /* Replay; the host state follows the key 0 usage in delivered reports.
+     * Sim_Step() scans once scan_us have passed since the previous scan, so
+     * transitions up to that instant are applied at their own time first */
+    while (Sim_Time_Us() < end_us) {
+        uint64_t scan_at = Sim_Time_Us() + scan_us;
+
+        while (next < wave.n && wave.v[next].t_us <= scan_at) {
+            if (wave.v[next].t_us > Sim_Time_Us()) {
+                Sim_Step((uint32_t)(wave.v[next].t_us - Sim_Time_Us()));
+            }
+            Sim_Set_Key(0, 0, wave.v[next].level);
+            next++;
+        }
+        Sim_Step((uint32_t)(scan_at - Sim_Time_Us()));
+
+        while (reported < Sim_Report_Count() && Sim_Get_Report(reported)->deliver_us != 0) {
+            const Sim_Report_t *r = Sim_Get_Report(reported++);
+            uint8_t down = 0;
+            for (uint8_t k = 3; k < r->len; k++) {
+                if (r->data[k] == KEY_1) down = 1;
+            }
+            if (down != host_state) {
+                host_state = down;
+                Edge_Push(&seen, r->deliver_us, down);
+            }
+        }
+        if (Sim_Report_Count() >= SIM_MAX_REPORTS - 1U && reported == Sim_Report_Count()) {
+            Sim_Clear_Reports();
+            reported = 0;
+        }
+    }
+
+    /* Match each intended event with the first host transition to its level
+     * before the next intended event; everything else is chatter */
+    uint32_t s = 0;
+    while (s < seen.n && (truth.n == 0 || seen.v[s].t_us < truth.v[0].t_us)) {
+        spurious++;
+        s++;
+    }
+    for (uint32_t e = 0; e < truth.n; e++) {
+        uint64_t window_end = (e + 1 < truth.n) ? truth.v[e + 1].t_us : UINT64_MAX;
+        uint8_t hit = 0;
+        for (; s < seen.n && seen.v[s].t_us < window_end; s++) {
+            if (!hit && seen.v[s].level == truth.v[e].level) {
+                latency[matched++] = (uint32_t)(seen.v[s].t_us - truth.v[e].t_us);
+                hit = 1;
+            } else {
+                spurious++;
+            }
+        }
+        if (!hit) missed++;
+    }
+
+    double mean = 0;
+    uint32_t p50 = 0, p99 = 0, max = 0;
+    if (matched) {
+        qsort(latency, matched, sizeof(uint32_t), Cmp_U32);
+        for (uint32_t i = 0; i < matched; i++) mean += latency[i];
+        mean /= matched;
+        p50 = latency[matched / 2U];
+        p99 = latency[(matched * 99U) / 100U];
+        max = latency[matched - 1U];
+    }
+
+    if (csv) {
+        printf("%s,%u,%u,%u,%u,%u,%.1f,%u,%u,%u\n", algo_names[algo], debounce_ms, scan_us,
+               truth.n, missed, spurious, mean, p50, p99, max);
+    } else {
+        printf("%-10s %5u %7u %7u %6u %8u %9.2f %8.2f %8.2f %8.2f\n", algo_names[algo], debounce_ms,
+               scan_us, truth.n, missed, spurious, mean / 1000.0, p50 / 1000.0, p99 / 1000.0, max / 1000.0);
+    }
+    free(latency);
+}
+
+/**
+  * @brief Parse a comma separated list of numbers
+  * @retval Number of entries
+  */
+static uint32_t Parse_List(const char *arg, uint32_t *out)
+{
+    uint32_t n = 0;
+    char *end;
+
+    while (*arg && n < EVAL_MAX_LIST) {
+        out[n++] = (uint32_t)strtoul(arg, &end, 0);
+        if (*end != ',') break;
+        arg = end + 1;
+    }
+    return n;
+}
+
+int main(int argc, char **argv)
+{
+    const char *wave_file = NULL, *dump_file = NULL;
+    uint32_t presses = 200, bounce_ms = 5, settle_us = 5000;
+    double noise = 0.5;
+    uint8_t csv = 0;
+    uint32_t scan_list[EVAL_MAX_LIST] = {1000, 10000};
+    uint32_t scan_n = 2;
+    uint32_t debounce_list[EVAL_MAX_LIST] = {0, 1, 2, 5, 10, 20};
+    uint32_t debounce_n = 6;
+
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        const char *v = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (strcmp(a, "--csv") == 0) {
+            csv = 1;
+        } else if (v == NULL) {
+            goto usage;
+        } else if (strcmp(a, "--wave") == 0) {
+            wave_file = v; i++;
+        } else if (strcmp(a, "--synthetic") == 0) {
+            presses = (uint32_t)strtoul(v, NULL, 0); i++;
+        } else if (strcmp(a, "--bounce-ms") == 0) {
+            bounce_ms = (uint32_t)strtoul(v, NULL, 0); i++;
+        } else if (strcmp(a, "--noise") == 0) {
+            noise = strtod(v, NULL); i++;
+        } else if (strcmp(a, "--seed") == 0) {
+            rng_state = (uint32_t)strtoul(v, NULL, 0); i++;
+        } else if (strcmp(a, "--settle-us") == 0) {
+            settle_us = (uint32_t)strtoul(v, NULL, 0); i++;
+        } else if (strcmp(a, "--scan-us") == 0) {
+            scan_n = Parse_List(v, scan_list); i++;
+        } else if (strcmp(a, "--debounce") == 0) {
+            debounce_n = Parse_List(v, debounce_list); i++;
+        } else if (strcmp(a, "--dump") == 0) {
+            dump_file = v; i++;
+        } else {
+            goto usage;
+        }
+    }
+    if (rng_state == 0) rng_state = 1;
+
+    if (wave_file) {
+        if (Load(wave_file) != 0) return 2;
+        Derive_Truth(settle_us);
+    } else {
+        Generate(presses, bounce_ms, noise);
+    }
+    if (wave.n == 0) {
+        fprintf(stderr, "empty waveform\n");
+        return 2;
+    }
+
+    if (dump_file) {
+        FILE *f = fopen(dump_file, "w");
+        if (f == NULL) {
+            perror(dump_file);
+            return 2;
+        }
+        fprintf(f, "# time_us level\n");
+        for (uint32_t i = 0; i < wave.n; i++) {
+            fprintf(f, "%llu %u\n", (unsigned long long)wave.v[i].t_us, wave.v[i].level);
+        }
+        fclose(f);
+    }
+
+    if (csv) {
+        printf("algo,debounce_ms,scan_us,events,missed,spurious,lat_mean_us,lat_p50_us,lat_p99_us,lat_max_us\n");
+    } else {
+        printf("# %u transitions, %u key events, %.1f s\n", wave.n, truth.n, wave.v[wave.n - 1].t_us / 1e6);
+        printf("%-10s %5s %7s %7s %6s %8s %9s %8s %8s %8s\n", "algo", "deb", "scan_us", "events",
+               "missed", "spurious", "lat_ms", "p50", "p99", "max");
+    }
+    for (uint8_t algo = DEBOUNCE_DEFER; algo <= DEBOUNCE_INTEGRATOR; algo++) {
+        for (uint32_t s = 0; s < scan_n; s++) {
+            for (uint32_t d = 0; d < debounce_n; d++) {
+                Evaluate(algo, (uint16_t)debounce_list[d], scan_list[s] ? scan_list[s] : 1U, csv);
+            }
+        }
+    }
+    return 0;
+
+usage:
+    fprintf(stderr, "usage: %s [--wave file | --synthetic N] [--bounce-ms B] [--noise R] [--seed S]\n"
+                    "       [--settle-us U] [--scan-us L] [--debounce L] [--dump file] [--csv]\n", argv[0]);
+    return 2;
+}
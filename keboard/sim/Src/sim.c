@@ -0,0 +1,86 @@
+/**
+  ******************************************************************************
+  * @file           : sim.c
+  * @brief          : Simulated firmware main loop
+  *
+  * Mirrors the init sequence and the while(1) body of Core/Src/main.c, with
+  * the scan period expressed in microseconds so it can be varied.
+  ******************************************************************************
+  */
+
+#include "sim.h"
+#include "matrix_keyboard.h"
+#include "usb_keyboard.h"
+#include "leader_key.h"
+#include "key_repeat.h"
+#include "mouse_keys.h"
+#include "unicode_input.h"
+#include "flash_kv.h"
+#include "latency.h"
+
+static uint32_t scan_period_us = SIM_SCAN_PERIOD_US;
+static uint64_t scan_timer_us = 0;
+
+/**
+  * @brief Reset the simulated board and initialize the firmware modules
+  * @retval None
+  */
+void Sim_Init(void)
+{
+    Sim_Hal_Reset();
+    Sim_Usbd_Reset();
+    scan_timer_us = 0;
+
+    FlashKV_Init();
+    Matrix_Keyboard_Init();
+    USB_Keyboard_Init();
+    Leader_Init();
+    KeyRepeat_Init();
+    Mouse_Keys_Init();
+    Unicode_Init();
+    Latency_Init();
+}
+
+/**
+  * @brief Change the matrix scan period
+  * @param us: Scan period in microseconds (0 = scan on every step)
+  * @retval None
+  */
+void Sim_Set_Scan_Period(uint32_t us)
+{
+    scan_period_us = us;
+}
+
+/**
+  * @brief Advance the clock and run one pass of the main loop
+  * @param us: Microseconds elapsed since the previous pass
+  * @retval None
+  */
+void Sim_Step(uint32_t us)
+{
+    Sim_Advance(us);
+
+    if ((Sim_Time_Us() - scan_timer_us) >= scan_period_us) {
+        scan_timer_us = Sim_Time_Us();
+        Matrix_Keyboard_Scan();
+    }
+
+    Leader_Task();
+    KeyRepeat_Task();
+    Mouse_Keys_Task();
+    Unicode_Task();
+    USB_Keyboard_Task();
+    Latency_Task();
+
+    if (!Matrix_Keyboard_Any_Pressed()) {
+        FlashKV_Task();
+    }
+}
+
+/**
+  * @brief Matrix events go straight to the HID layer, as in main.c
+  */
+void Matrix_Key_Callback(uint8_t key_code, uint8_t pressed)
+{
+    USB_Keyboard_HandleMatrixKey(key_code, pressed);
+}
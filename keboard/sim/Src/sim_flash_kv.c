@@ -0,0 +1,45 @@
+/**
+  ******************************************************************************
+  * @file           : sim_flash_kv.c
+  * @brief          : RAM-only FlashKV for the simulation build
+  *
+  * Same interface as Core/Src/flash_kv.c; values live for the lifetime of
+  * the process and FlashKV_Init() starts from an empty store, so every run
+  * uses the built-in defaults unless the scenario changes a setting.
+  ******************************************************************************
+  */
+
+#include "flash_kv.h"
+#include <string.h>
+
+static uint8_t kv_value[FLASH_KV_MAX_KEYS][FLASH_KV_VALUE_SIZE];
+static uint8_t kv_len[FLASH_KV_MAX_KEYS];
+
+void FlashKV_Init(void)
+{
+    memset(kv_len, 0, sizeof(kv_len));
+}
+
+uint8_t FlashKV_Get(uint8_t id, void *buf, uint8_t max_len)
+{
+    if (id >= FLASH_KV_MAX_KEYS || kv_len[id] == 0) {
+        return 0;
+    }
+    uint8_t len = (kv_len[id] < max_len) ? kv_len[id] : max_len;
+    memcpy(buf, kv_value[id], len);
+    return len;
+}
+
+HAL_StatusTypeDef FlashKV_Set(uint8_t id, const void *data, uint8_t len)
+{
+    if (id >= FLASH_KV_MAX_KEYS || len == 0 || len > FLASH_KV_VALUE_SIZE) {
+        return HAL_ERROR;
+    }
+    memcpy(kv_value[id], data, len);
+    kv_len[id] = len;
+    return HAL_OK;
+}
+
+void FlashKV_Task(void)
+{
+}
@@ -0,0 +1,151 @@
+/**
+  ******************************************************************************
+  * @file           : sim_hal.c
+  * @brief          : Mock HAL: simulated clock, GPIO ports and switch matrix
+  *
+  * A column input reads low when its switch is closed on a row that is
+  * driven low (pull-ups, one diode per key, so no ghosting). Inputs are
+  * evaluated at the time of the read, like the IDR of the real port.
+  ******************************************************************************
+  */
+
+#include "sim.h"
+#include "matrix_keyboard.h"
+#include <string.h>
+
+GPIO_TypeDef sim_gpio[SIM_GPIO_PORTS];
+
+/* Simulated time */
+static uint64_t sim_time_us = 0;
+
+/* Closed switches, one bit per column */
+static uint32_t sim_switch[KEYBOARD_ROWS];
+
+static const uint16_t sim_row_pins[KEYBOARD_ROWS] = {ROW_PIN_0, ROW_PIN_1, ROW_PIN_2};
+static const uint16_t sim_col_pins[KEYBOARD_COLS] = {COL_PIN_0, COL_PIN_1, COL_PIN_2};
+
+/**
+  * @brief Reset clock, ports and switches
+  * @retval None
+  */
+void Sim_Hal_Reset(void)
+{
+    sim_time_us = 0;
+    memset(sim_gpio, 0, sizeof(sim_gpio));
+    memset(sim_switch, 0, sizeof(sim_switch));
+}
+
+/**
+  * @brief Open or close a switch of the matrix
+  * @param row: Row index
+  * @param col: Column index
+  * @param closed: 1 = contact closed (pressed), 0 = open
+  * @retval None
+  */
+void Sim_Set_Key(uint8_t row, uint8_t col, uint8_t closed)
+{
+    if (row >= KEYBOARD_ROWS || col >= KEYBOARD_COLS) return;
+
+    if (closed) {
+        sim_switch[row] |= (1UL << col);
+    } else {
+        sim_switch[row] &= ~(1UL << col);
+    }
+}
+
+/**
+  * @brief Advance the simulated clock
+  * A USB frame (SOF) is generated at every millisecond boundary.
+  * @param us: Microseconds to advance
+  * @retval None
+  */
+void Sim_Advance(uint32_t us)
+{
+    uint64_t end = sim_time_us + us;
+
+    while (sim_time_us < end) {
+        uint64_t next_frame = (sim_time_us / 1000U + 1U) * 1000U;
+        if (next_frame > end) {
+            sim_time_us = end;
+            break;
+        }
+        sim_time_us = next_frame;
+        Sim_Usbd_Frame();
+    }
+}
+
+/**
+  * @brief Current simulated time
+  * @retval Microseconds since Sim_Init()
+  */
+uint64_t Sim_Time_Us(void)
+{
+    return sim_time_us;
+}
+
+uint32_t HAL_GetTick(void)
+{
+    return (uint32_t)(sim_time_us / 1000U);
+}
+
+void HAL_Delay(uint32_t Delay)
+{
+    Sim_Advance(Delay * 1000U);
+}
+
+void HAL_GPIO_Init(GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_Init)
+{
+    for (uint32_t pin = 0; pin < 16U; pin++) {
+        if (GPIO_Init->Pin & (1UL << pin)) {
+            GPIOx->MODER = (GPIOx->MODER & ~(3UL << (pin * 2U))) | (GPIO_Init->Mode << (pin * 2U));
+            GPIOx->PUPDR = (GPIOx->PUPDR & ~(3UL << (pin * 2U))) | (GPIO_Init->Pull << (pin * 2U));
+        }
+    }
+}
+
+/**
+  * @brief Column inputs as seen by the IDR
+  * @retval IDR value of COL_PORT
+  */
+static uint32_t Sim_Col_Idr(void)
+{
+    uint32_t idr = COL_PORT->ODR;
+
+    /* Pull-ups */
+    for (uint8_t col = 0; col < KEYBOARD_COLS; col++) {
+        idr |= sim_col_pins[col];
+    }
+    for (uint8_t row = 0; row < KEYBOARD_ROWS; row++) {
+        if (ROW_PORT->ODR & sim_row_pins[row]) continue;   /* Row not driven */
+        for (uint8_t col = 0; col < KEYBOARD_COLS; col++) {
+            if (sim_switch[row] & (1UL << col)) {
+                idr &= ~(uint32_t)sim_col_pins[col];
+            }
+        }
+    }
+    return idr;
+}
+
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin)
+{
+    if (GPIOx == COL_PORT) {
+        GPIOx->IDR = Sim_Col_Idr();
+    } else {
+        GPIOx->IDR = GPIOx->ODR;
+    }
+    return (GPIOx->IDR & GPIO_Pin) ? GPIO_PIN_SET : GPIO_PIN_RESET;
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState)
+{
+    if (PinState != GPIO_PIN_RESET) {
+        GPIOx->ODR |= GPIO_Pin;
+    } else {
+        GPIOx->ODR &= ~(uint32_t)GPIO_Pin;
+    }
+}
+
+void HAL_GPIO_TogglePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin)
+{
+    GPIOx->ODR ^= GPIO_Pin;
+}
@@ -0,0 +1,269 @@
+/**
+  ******************************************************************************
+  * @file           : sim_main.c
+  * @brief          : Command line front end of the simulation build
+  *
+  * keyboard_sim [scenario] [--scan-us N] [--step-us N]
+  *   Replays a scenario and prints every report the host receives with the
+  *   time it was handed to the endpoint and the time the host took it.
+  *   Scenario lines:
+  *       <time ms> press <row> <col>
+  *       <time ms> release <row> <col>
+  *       <time ms> type <utf-8 text>     (Unicode_Send_String)
+  *       <time ms> keymap <key> <hid>    (USB_Keyboard_SetKeymap, decimal)
+  *       <time ms> end
+  *   '#' starts a comment (except in text). Without a file a built-in
+  *   scenario is used. Without an end event the run continues until all
+  *   text has been typed, plus 100 ms.
+  *
+  * keyboard_sim --speed [scans]
+  *   Scan throughput of the full pipeline (scan every pass, random keys).
+  ******************************************************************************
+  */
+
+#include "sim.h"
+#include "matrix_keyboard.h"
+#include "usb_keyboard.h"
+#include "latency.h"
+#include "unicode_input.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define SIM_MAX_EVENTS   4096U
+#define SIM_TEXT_POOL    65536U
+
+typedef struct {
+    uint32_t time_ms;
+    uint8_t action;             // 0 = release, 1 = press, 2 = end, 3 = type, 4 = keymap
+    uint8_t row;                // Matrix key (keymap)
+    uint8_t col;                // HID code (keymap)
+    uint32_t text;              // Offset in text_pool (type)
+} Sim_Event_t;
+
+static Sim_Event_t events[SIM_MAX_EVENTS];
+static uint32_t event_count = 0;
+
+static char text_pool[SIM_TEXT_POOL];
+static uint32_t text_used = 0;
+
+/* Tap 1, chord 1+5, a 7 held across the report queue, then idle */
+static const char *const builtin_scenario[] = {
+    "10 press 0 0", "60 release 0 0",
+    "100 press 0 0", "105 press 1 1", "150 release 0 0", "160 release 1 1",
+    "200 press 2 0", "400 release 2 0",
+    "500 end",
+};
+
+/**
+  * @brief Parse one scenario line
+  * @retval 1 if an event was added, 0 for blank/comment lines, -1 on error
+  */
+static int Parse_Line(const char *line)
+{
+    char action[16];
+    unsigned t, row = 0, col = 0;
+    int text_at = 0;
+    const char *hash = strchr(line, '#');
+    char buf[1024];
+
+    if (sscanf(line, "%u type %n", &t, &text_at) == 1 && text_at > 0) {
+        hash = NULL;    /* Text is taken verbatim */
+    }
+    snprintf(buf, sizeof(buf), "%.*s", hash ? (int)(hash - line) : (int)strlen(line), line);
+    int n = sscanf(buf, "%u %15s %u %u", &t, action, &row, &col);
+    if (n <= 0) return 0;
+    if (event_count >= SIM_MAX_EVENTS) return -1;
+
+    Sim_Event_t *e = &events[event_count];
+    e->time_ms = t;
+    e->row = (uint8_t)row;
+    e->col = (uint8_t)col;
+    if (text_at > 0) {
+        size_t len = strcspn(&buf[text_at], "\r\n");
+        if (len == 0 || text_used + len + 1 > SIM_TEXT_POOL) return -1;
+        memcpy(&text_pool[text_used], &buf[text_at], len);
+        text_pool[text_used + len] = '\0';
+        e->action = 3;
+        e->text = text_used;
+        text_used += (uint32_t)len + 1U;
+    } else if (n == 2 && strcmp(action, "end") == 0) {
+        e->action = 2;
+    } else if (n == 4 && strcmp(action, "press") == 0) {
+        e->action = 1;
+    } else if (n == 4 && strcmp(action, "release") == 0) {
+        e->action = 0;
+    } else if (n == 4 && strcmp(action, "keymap") == 0) {
+        if (row >= TOTAL_KEYS || col > 0xFFU) return -1;
+        e->action = 4;
+    } else {
+        return -1;
+    }
+    if (e->action < 2 && (row >= KEYBOARD_ROWS || col >= KEYBOARD_COLS)) return -1;
+    if (event_count > 0 && t < events[event_count - 1].time_ms) return -1;
+    event_count++;
+    return 1;
+}
+
+static void Print_Report(const Sim_Report_t *r)
+{
+    printf("%10.3f %10.3f  ", r->submit_us / 1000.0, r->deliver_us / 1000.0);
+
+    if (r->len == 1 + sizeof(USB_KeyboardReport_t) && r->data[0] == HID_REPORT_ID_KEYBOARD) {
+        printf("KBD   mod=0x%02X keys=", r->data[1]);
+        for (int i = 3; i < 9; i++) {
+            printf("%02X%s", r->data[i], (i < 8) ? " " : "\n");
+        }
+    } else if (r->len == 1 + sizeof(USB_MouseReport_t) && r->data[0] == HID_REPORT_ID_MOUSE) {
+        printf("MOUSE btn=0x%02X x=%d y=%d wheel=%d\n", r->data[1],
+               (int8_t)r->data[2], (int8_t)r->data[3], (int8_t)r->data[4]);
+    } else {
+        for (uint8_t i = 0; i < r->len; i++) {
+            printf("%02X ", r->data[i]);
+        }
+        printf("\n");
+    }
+}
+
+/**
+  * @brief Replay the scenario and print the reports
+  * @retval Process exit code
+  */
+static int Run_Scenario(uint32_t step_us)
+{
+    uint32_t next = 0;
+    uint32_t printed = 0;
+    uint64_t end_us = (uint64_t)events[event_count - 1].time_ms * 1000U + 100000U;
+    const char *text = "";
+    uint8_t ended = 0;
+
+    printf("# submit_ms deliver_ms  report\n");
+    while (Sim_Time_Us() < end_us) {
+        while (next < event_count && (uint64_t)events[next].time_ms * 1000U <= Sim_Time_Us()) {
+            if (events[next].action == 2) {
+                end_us = Sim_Time_Us();
+                ended = 1;
+            } else if (events[next].action == 3) {
+                text = &text_pool[events[next].text];
+            } else if (events[next].action == 4) {
+                (void)USB_Keyboard_SetKeymap(events[next].row, events[next].col);
+            } else {
+                Sim_Set_Key(events[next].row, events[next].col, events[next].action);
+            }
+            next++;
+        }
+
+        /* Feed the Unicode queue as it drains */
+        if (*text != '\0') {
+            text += Unicode_Send_String(text);
+        }
+
+        Sim_Step(step_us);
+
+        /* Typing outlasts the last event: keep going until it is done */
+        if (!ended && (*text != '\0' || Unicode_Is_Busy() || USB_Keyboard_QueueSpace() < USB_KEYBOARD_QUEUE_LEN)) {
+            if (end_us < Sim_Time_Us() + 100000U) end_us = Sim_Time_Us() + 100000U;
+        }
+
+        while (printed < Sim_Report_Count() && Sim_Get_Report(printed)->deliver_us != 0) {
+            Print_Report(Sim_Get_Report(printed));
+            printed++;
+        }
+    }
+
+    printf("# %u reports, %.1f ms simulated\n", Sim_Report_Count(), Sim_Time_Us() / 1000.0);
+    Latency_Dump();
+    Sim_Usbd_Print_Stats();
+    return 0;
+}
+
+/**
+  * @brief Measure how many scan passes per second the host achieves
+  * @retval Process exit code
+  */
+static int Run_Speed(uint64_t scans)
+{
+    struct timespec t0, t1;
+    uint32_t rng = 1;
+
+    Sim_Set_Scan_Period(0);
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (uint64_t i = 0; i < scans; i++) {
+        if ((i & 0x3FFU) == 0) {
+            rng = rng * 1103515245U + 12345U;
+            Sim_Set_Key((rng >> 16) % KEYBOARD_ROWS, (rng >> 20) % KEYBOARD_COLS, (rng >> 24) & 1U);
+        }
+        Sim_Step(100);
+        if (Sim_Report_Count() > SIM_MAX_REPORTS / 2U) {
+            Sim_Clear_Reports();
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    double sec = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    printf("%llu scans in %.3f s: %.2f M scans/s (%.1f ns/scan)\n",
+           (unsigned long long)scans, sec, scans / sec / 1e6, sec * 1e9 / scans);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    const char *scenario = NULL;
+    uint32_t step_us = 100;
+    uint64_t speed_scans = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--scan-us") == 0 && i + 1 < argc) {
+            Sim_Set_Scan_Period((uint32_t)strtoul(argv[++i], NULL, 0));
+        } else if (strcmp(argv[i], "--step-us") == 0 && i + 1 < argc) {
+            step_us = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--speed") == 0) {
+            speed_scans = 10000000U;
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                speed_scans = strtoull(argv[++i], NULL, 0);
+            }
+        } else if (argv[i][0] != '-' && scenario == NULL) {
+            scenario = argv[i];
+        } else {
+            fprintf(stderr, "usage: %s [scenario] [--scan-us N] [--step-us N] | --speed [scans]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (step_us == 0) step_us = 1;
+
+    Sim_Init();
+
+    if (speed_scans) {
+        return Run_Speed(speed_scans);
+    }
+
+    if (scenario) {
+        char line[1024];
+        unsigned lineno = 0;
+        FILE *f = fopen(scenario, "r");
+        if (f == NULL) {
+            perror(scenario);
+            return 2;
+        }
+        while (fgets(line, sizeof(line), f)) {
+            lineno++;
+            if (Parse_Line(line) < 0) {
+                fprintf(stderr, "%s:%u: bad event\n", scenario, lineno);
+                fclose(f);
+                return 2;
+            }
+        }
+        fclose(f);
+    } else {
+        for (size_t i = 0; i < sizeof(builtin_scenario) / sizeof(builtin_scenario[0]); i++) {
+            Parse_Line(builtin_scenario[i]);
+        }
+    }
+    if (event_count == 0) {
+        fprintf(stderr, "empty scenario\n");
+        return 2;
+    }
+
+    return Run_Scenario(step_us);
+}
@@ -0,0 +1,93 @@
+/**
+  ******************************************************************************
+  * @file           : sim_report.c
+  * @brief          : HID report recorder shared by the USB device back ends
+  *
+  * Every report handed to the HID IN endpoint is recorded with the time it
+  * was submitted and the time the host took it. Only one report can be in
+  * flight: the HID class has a single IN endpoint.
+  ******************************************************************************
+  */
+
+#include "sim.h"
+#include <string.h>
+
+static Sim_Report_t sim_reports[SIM_MAX_REPORTS];
+static uint32_t sim_report_count = 0;
+static uint32_t sim_reports_lost = 0;
+
+/* Index of the report in flight, SIM_MAX_REPORTS if none is recorded */
+static uint32_t sim_in_flight = SIM_MAX_REPORTS;
+
+/**
+  * @brief Record a report handed to the IN endpoint
+  * @param report: Report data
+  * @param len: Report length
+  * @retval None
+  */
+void Sim_Report_Submit(const uint8_t *report, uint16_t len)
+{
+    if (sim_report_count >= SIM_MAX_REPORTS) {
+        sim_reports_lost++;
+        sim_in_flight = SIM_MAX_REPORTS;
+        return;
+    }
+    Sim_Report_t *r = &sim_reports[sim_report_count];
+    r->submit_us = Sim_Time_Us();
+    r->deliver_us = 0;
+    r->len = (len > HID_EPIN_SIZE) ? HID_EPIN_SIZE : (uint8_t)len;
+    memcpy(r->data, report, r->len);
+    sim_in_flight = sim_report_count++;
+}
+
+/**
+  * @brief The host took the report in flight
+  * @param us: Delivery time
+  * @retval None
+  */
+void Sim_Report_Delivered(uint64_t us)
+{
+    if (sim_in_flight < SIM_MAX_REPORTS) {
+        sim_reports[sim_in_flight].deliver_us = us;
+        sim_in_flight = SIM_MAX_REPORTS;
+    }
+}
+
+/**
+  * @brief Number of recorded reports
+  * @retval Reports since the last Sim_Clear_Reports()
+  */
+uint32_t Sim_Report_Count(void)
+{
+    return sim_report_count;
+}
+
+/**
+  * @brief Get a recorded report
+  * @param index: Report index (0 = oldest)
+  * @retval Report, NULL if out of range
+  */
+const Sim_Report_t *Sim_Get_Report(uint32_t index)
+{
+    return (index < sim_report_count) ? &sim_reports[index] : NULL;
+}
+
+/**
+  * @brief Reports sent after the recorder was full
+  * @retval Count of unrecorded reports
+  */
+uint32_t Sim_Reports_Lost(void)
+{
+    return sim_reports_lost;
+}
+
+/**
+  * @brief Forget all recorded reports (the one in flight is still delivered)
+  * @retval None
+  */
+void Sim_Clear_Reports(void)
+{
+    sim_report_count = 0;
+    sim_reports_lost = 0;
+    sim_in_flight = SIM_MAX_REPORTS;
+}
@@ -0,0 +1,87 @@
+/**
+  ******************************************************************************
+  * @file           : sim_usbd.c
+  * @brief          : Mock USB device: HID IN endpoint
+  *
+  * The host polls the interrupt endpoint once per frame (bInterval 1): a
+  * report submitted during frame n is delivered at the start of frame n+1,
+  * after which the endpoint is idle again. Reports go to the recorder in
+  * sim_report.c.
+  ******************************************************************************
+  */
+
+#include "sim.h"
+#include <string.h>
+
+USBD_HandleTypeDef hUsbDeviceFS;
+static USBD_HID_HandleTypeDef sim_hid;
+
+/**
+  * @brief Reset the device to the configured state, report protocol
+  * @retval None
+  */
+void Sim_Usbd_Reset(void)
+{
+    memset(&sim_hid, 0, sizeof(sim_hid));
+    sim_hid.Protocol = 1U;
+    sim_hid.state = USBD_HID_IDLE;
+
+    memset(&hUsbDeviceFS, 0, sizeof(hUsbDeviceFS));
+    hUsbDeviceFS.dev_state = USBD_STATE_CONFIGURED;
+    hUsbDeviceFS.dev_config = 1U;
+    hUsbDeviceFS.pClassData = &sim_hid;
+
+    Sim_Clear_Reports();
+}
+
+/**
+  * @brief Attach or detach the simulated host
+  * @param configured: 1 = enumerated and configured, 0 = default state
+  * @retval None
+  */
+void Sim_Set_Usb_Configured(uint8_t configured)
+{
+    if (configured) {
+        hUsbDeviceFS.dev_state = USBD_STATE_CONFIGURED;
+        hUsbDeviceFS.pClassData = &sim_hid;
+    } else {
+        hUsbDeviceFS.dev_state = USBD_STATE_DEFAULT;
+        hUsbDeviceFS.pClassData = NULL;
+        sim_hid.state = USBD_HID_IDLE;
+        Sim_Report_Delivered(0);
+    }
+}
+
+/**
+  * @brief Start of a USB frame: the host collects the report in flight
+  * @retval None
+  */
+void Sim_Usbd_Frame(void)
+{
+    if (hUsbDeviceFS.dev_state != USBD_STATE_CONFIGURED) return;
+
+    if (sim_hid.state == USBD_HID_BUSY) {
+        Sim_Report_Delivered(Sim_Time_Us());
+        sim_hid.state = USBD_HID_IDLE;
+        USBD_HID_DataInCallback(&hUsbDeviceFS);
+    }
+    USBD_HID_SOFCallback(&hUsbDeviceFS);
+}
+
+uint8_t USBD_HID_SendReport(USBD_HandleTypeDef *pdev, uint8_t *report, uint16_t len)
+{
+    if (pdev->dev_state != USBD_STATE_CONFIGURED || sim_hid.state != USBD_HID_IDLE) {
+        return USBD_BUSY;
+    }
+    sim_hid.state = USBD_HID_BUSY;
+    Sim_Report_Submit(report, len);
+    return USBD_OK;
+}
+
+/**
+  * @brief Bus counters (the mock endpoint has none)
+  * @retval None
+  */
+void Sim_Usbd_Print_Stats(void)
+{
+}
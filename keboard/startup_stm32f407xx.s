@@ -43,6 +43,17 @@ defined in linker script */
 .word  _sbss
 /* end address for the .bss section. defined in linker script */
 .word  _ebss
+/* load address, start and end of the SRAM code (.ramfunc). defined in linker script */
+.word  _siramfunc
+.word  _sramfunc
+.word  _eramfunc
+/* load address, start and end of the initialized CCM data (.ccmram). defined in linker script */
+.word  _siccmram
+.word  _sccmram
+.word  _eccmram
+/* start and end of the zero-initialized CCM data (.ccmbss). defined in linker script */
+.word  _sccmbss
+.word  _eccmbss
 /* stack used for SystemInit_ExtMemCtl; always internal RAM used */
 
 /**
@@ -94,6 +105,54 @@ LoopFillZerobss:
   cmp r2, r4
   bcc FillZerobss
 
+/* Copy the SRAM code from flash */
+  ldr r0, =_sramfunc
+  ldr r1, =_eramfunc
+  ldr r2, =_siramfunc
+  movs r3, #0
+  b LoopCopyRamFunc
+
+CopyRamFunc:
+  ldr r4, [r2, r3]
+  str r4, [r0, r3]
+  adds r3, r3, #4
+
+LoopCopyRamFunc:
+  adds r4, r0, r3
+  cmp r4, r1
+  bcc CopyRamFunc
+
+/* Copy the CCM data initializers from flash */
+  ldr r0, =_sccmram
+  ldr r1, =_eccmram
+  ldr r2, =_siccmram
+  movs r3, #0
+  b LoopCopyCcmInit
+
+CopyCcmInit:
+  ldr r4, [r2, r3]
+  str r4, [r0, r3]
+  adds r3, r3, #4
+
+LoopCopyCcmInit:
+  adds r4, r0, r3
+  cmp r4, r1
+  bcc CopyCcmInit
+
+/* Zero fill the CCM bss segment. */
+  ldr r2, =_sccmbss
+  ldr r4, =_eccmbss
+  movs r3, #0
+  b LoopFillZeroCcm
+
+FillZeroCcm:
+  str  r3, [r2]
+  adds r2, r2, #4
+
+LoopFillZeroCcm:
+  cmp r2, r4
+  bcc FillZeroCcm
+
 /* Call static constructors */
     bl __libc_init_array
 /* Call the application's entry point.*/
@@ -0,0 +1,190 @@
+#!/usr/bin/env python3
+"""
+SWO/ITM Trace Decoder
+解析 SWO 抓包 (原始 ITM 字节流), 按 stimulus port 还原事件 (见 Core/Inc/trace.h)
+
+使用方法:
+  python3 swo_decode.py capture.swo [--elf build/keboard.elf] [--cpu-hz 168000000]
+
+Capture the stream with e.g.
+  openocd ... -c "tpiu config internal capture.swo uart off 168000000 2000000"
+  pyocd swv ... (raw mode) / STM32CubeProgrammer SWV "save raw"
+The firmware bypasses the TPIU formatter, so the file is a plain ITM stream.
+
+Ports:
+  0  log bytes (printf text; BLOG records are decoded when --elf is given)
+  1  key events        4-byte packets
+  2  report submissions 2 x 4-byte packets per report
+  3  USB device state  1-byte packets
+  4  core clock in Hz  4-byte packets, at boot and on every clock profile switch
+"""
+
+import argparse
+import os
+import sys
+
+PORT_LOG, PORT_KEY, PORT_REPORT, PORT_USB, PORT_CLOCK = 0, 1, 2, 3, 4
+
+USB_STATES = {1: "DEFAULT", 2: "ADDRESSED", 3: "CONFIGURED", 4: "SUSPENDED"}
+MODIFIERS = ["LCTRL", "LSHIFT", "LALT", "LWIN", "RCTRL", "RSHIFT", "RALT", "RWIN"]
+
+
+def itm_packets(data):
+    """Yield ('ts', delta) / ('sw', port, payload bytes) / ('overflow',) from an ITM stream"""
+    i, n = 0, len(data)
+    while i < n:
+        h = data[i]
+        i += 1
+
+        if h in (0x00, 0x80):              # Synchronisation (zeros then 0x80) / padding
+            continue
+        if h == 0x70:                      # Overflow
+            yield ("overflow",)
+            continue
+
+        size = h & 0x03
+        if size:                           # Source packet
+            length = 4 if size == 3 else size
+            payload = data[i:i + length]
+            i += length
+            if len(payload) < length:
+                return
+            if h & 0x04:
+                continue                   # Hardware source (DWT), not used
+            yield ("sw", h >> 3, payload)
+            continue
+
+        if h & 0x0F == 0:                  # Local timestamp
+            if h & 0xC0 == 0xC0:           # Format 1: continuation bytes
+                value = shift = 0
+                while i < n:
+                    b = data[i]
+                    i += 1
+                    value |= (b & 0x7F) << shift
+                    shift += 7
+                    if not b & 0x80:
+                        break
+                yield ("ts", value)
+            else:                          # Format 2: value in the header
+                yield ("ts", (h >> 4) & 0x07)
+            continue
+
+        # Extension / global timestamp: skip continuation bytes
+        if h & 0x80:
+            while i < n:
+                b = data[i]
+                i += 1
+                if not b & 0x80:
+                    break
+
+
+def fmt_modifier(mod):
+    names = [name for bit, name in enumerate(MODIFIERS) if mod & (1 << bit)]
+    return "+".join(names) if names else "-"
+
+
+class TraceDecoder:
+    """Turns ITM packets into text lines"""
+
+    def __init__(self, cpu_hz, log_decoder=None):
+        self.cpu_hz = cpu_hz
+        self.cycles = 0
+        self.seconds = 0.0                 # Time at self.cycles, summed per clock
+        self.log_decoder = log_decoder
+        self.log_text = bytearray()
+        self.report_head = None
+
+    def stamp(self):
+        if self.cpu_hz:
+            return f"{self.seconds * 1e3:12.3f}ms"
+        return f"{self.cycles:12d}"
+
+    def log_bytes(self, payload):
+        if self.log_decoder is not None:
+            return self.log_decoder.feed(payload)
+        lines = []
+        for b in payload:
+            if b == 0x0A:
+                lines.append(self.log_text.decode("utf-8", "replace").rstrip("\r"))
+                self.log_text.clear()
+            else:
+                self.log_text.append(b)
+        return lines
+
+    def report(self, payload):
+        """Reports span two 4-byte packets; the first starts with report ID 1 or 2"""
+        if len(payload) == 4 and payload[0] in (1, 2):
+            self.report_head = bytes(payload)
+            return None
+        if self.report_head is None or len(payload) != 4:
+            return "REPORT <lost header>"
+        head, self.report_head = self.report_head, None
+        if head[0] == 1:
+            keys = [k for k in (head[2], head[3]) + tuple(payload) if k]
+            return f"REPORT kbd mod={fmt_modifier(head[1])} keys=[{' '.join(f'0x{k:02X}' for k in keys)}]"
+        x = head[2] - 256 if head[2] & 0x80 else head[2]
+        y = head[3] - 256 if head[3] & 0x80 else head[3]
+        w = payload[1] - 256 if payload[1] & 0x80 else payload[1]
+        return f"REPORT mouse buttons=0x{head[1]:02X} x={x} y={y} wheel={w}"
+
+    def feed(self, data):
+        out = []
+        for pkt in itm_packets(data):
+            if pkt[0] == "ts":
+                self.cycles += pkt[1]
+                if self.cpu_hz:
+                    self.seconds += pkt[1] / self.cpu_hz
+                continue
+            if pkt[0] == "overflow":
+                out.append(f"{self.stamp()}  ---- ITM overflow, packets lost ----")
+                continue
+
+            _, port, payload = pkt
+            if port == PORT_LOG:
+                out.extend(f"{self.stamp()}  LOG {line}" for line in self.log_bytes(payload))
+            elif port == PORT_KEY and len(payload) == 4:
+                state = "down" if payload[1] else "up"
+                out.append(f"{self.stamp()}  KEY matrix={payload[0]} {state} hid=0x{payload[2]:02X}")
+            elif port == PORT_REPORT:
+                line = self.report(payload)
+                if line:
+                    out.append(f"{self.stamp()}  {line}")
+            elif port == PORT_USB and len(payload) == 1:
+                name = USB_STATES.get(payload[0], f"0x{payload[0]:02X}")
+                out.append(f"{self.stamp()}  USB {name}")
+            elif port == PORT_CLOCK and len(payload) == 4:
+                hz = int.from_bytes(payload, "little")
+                if hz:
+                    if not self.cpu_hz:
+                        self.seconds = 0.0     # Raw cycles so far: count from here
+                    self.cpu_hz = hz
+                out.append(f"{self.stamp()}  CLOCK {hz / 1e6:g} MHz")
+            else:
+                out.append(f"{self.stamp()}  port {port}: {payload.hex()}")
+        return out
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode raw SWO/ITM captures")
+    parser.add_argument("capture", help="raw ITM byte stream")
+    parser.add_argument("--elf", help="firmware ELF, enables BLOG decoding on port 0")
+    parser.add_argument("--cpu-hz", type=int, default=0,
+                        help="core clock at the start of the capture, until the first "
+                             "port 4 packet (default: raw cycles)")
+    opts = parser.parse_args()
+
+    log_decoder = None
+    if opts.elf:
+        sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+        import blog_decode
+        elf = blog_decode.Elf(opts.elf)
+        log_decoder = blog_decode.Decoder(elf, blog_decode.load_formats(elf))
+
+    decoder = TraceDecoder(opts.cpu_hz, log_decoder)
+    with open(opts.capture, "rb") as f:
+        for line in decoder.feed(f.read()):
+            print(line)
+
+
+if __name__ == "__main__":
+    main()
@@ -1,248 +1,407 @@
 #!/usr/bin/env python3
 """
 USB Keyboard Test Tool
-用于测试 STM32F407 USB 键盘的工具脚本
+在主机仿真 (sim/) 上自动测试键盘固件: 按键脚本, HID 报告序列, 延迟与吞吐量
 
 使用方法:
-  python3 test_usb_keyboard.py
+  python3 test_usb_keyboard.py                          # 编译 sim 并运行全部用例
+  python3 test_usb_keyboard.py -k text -v               # 只运行名字含 text 的用例, 打印报告
+  python3 test_usb_keyboard.py --save perf_base.json    # 保存性能指标为基线
+  python3 test_usb_keyboard.py --baseline perf_base.json --threshold 5
 
-要求:
-  - Python 3.6+
-  - 可选: pynput (用于键盘输入监听)
+Every case writes a keyboard_sim scenario (see sim/Src/sim_main.c), runs it
+and checks the exact sequence of keyboard reports the simulated host
+received. Performance cases also produce metrics (simulated microseconds,
+reports per second, characters per second) that are checked against fixed
+limits and, with --baseline, against a previous run. The simulation is
+deterministic, so any change in a metric comes from the firmware.
+Exit code: 0 = all passed, 1 = failures or regressions, 2 = build error.
 """
 
+import argparse
+import json
 import os
+import subprocess
 import sys
-import time
-import platform
-
-def print_header(title):
-    """打印美观的标题"""
-    print("\n" + "="*60)
-    print(f"  {title}")
-    print("="*60)
-
-def test_basic_functionality():
-    """基础功能测试"""
-    print_header("Basic Functionality Test")
-    
-    print("\n✓ 准备步骤:")
-    print("  1. 将 STM32F407 USB 键盘连接到 PC")
-    print("  2. 打开任意文本编辑器 (记事本/gedit)")
-    print("  3. 点击文本框获得焦点")
-    print("  4. 按下键盘上的按键")
-    
-    input("\n按 Enter 键开始测试...")
-    
-    test_cases = [
-        ("按键 0", "输入: 1"),
-        ("按键 1", "输入: 2"),
-        ("按键 2", "输入: 3"),
-        ("按键 3", "输入: 4"),
-        ("按键 4", "输入: 5"),
-        ("按键 5", "输入: 6"),
-        ("按键 6", "输入: 7"),
-        ("按键 7", "输入: 8"),
-        ("按键 8", "输入: 9"),
-    ]
-    
-    passed = 0
-    failed = 0
-    
-    for key, expected in test_cases:
-        result = input(f"\n{key} -> {expected} [y/n/skip]: ").lower().strip()
-        if result == 'y':
-            passed += 1
-            print("  ✓ 通过")
-        elif result == 'n':
-            failed += 1
-            print("  ✗ 失败")
+import tempfile
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+SIM_DIR = os.path.join(HERE, "sim")
+SIM_BIN = os.path.join(SIM_DIR, "build", "keyboard_sim")
+
+# Default keymap: matrix key r*3+c types '1'..'9'
+KEY_1 = 0x1E
+DEBOUNCE_MS = 20                    # DEBOUNCE_TIME in Core/Inc/matrix_keyboard.h
+
+# HID codes used by the Linux Unicode sequence (Core/Src/unicode_input.c)
+MOD_LCTRL_LSHIFT = 0x03
+KEY_U, KEY_0, KEY_A, KEY_SPACE = 0x18, 0x27, 0x04, 0x2C
+HEX_KEYS = [KEY_0] + [KEY_1 + i for i in range(9)] + [KEY_A + i for i in range(6)]
+
+# Metrics: name -> True if higher is better
+METRICS = {
+    "tap_latency_max_us": False,
+    "tap_latency_p99_us": False,
+    "chord_latency_max_us": False,
+    "burst_reports_per_s": True,
+    "text_chars_per_s": True,
+}
+
+
+class Report:
+    def __init__(self, submit_ms, deliver_ms, mod, keys):
+        self.submit_us = round(submit_ms * 1000)
+        self.deliver_us = round(deliver_ms * 1000)
+        self.mod = mod
+        self.keys = keys
+
+    def state(self):
+        return (self.mod, tuple(k for k in self.keys if k))
+
+
+class Run:
+    """Parsed keyboard_sim output"""
+
+    def __init__(self, text):
+        self.reports = []
+        self.other = []
+        self.latency = {}
+        for line in text.splitlines():
+            fields = line.split()
+            if len(fields) >= 4 and fields[2] == "KBD":
+                mod = int(fields[3].split("=")[1], 16)
+                keys = [int(fields[4].split("=")[1], 16)] + [int(k, 16) for k in fields[5:10]]
+                self.reports.append(Report(float(fields[0]), float(fields[1]), mod, keys))
+            elif len(fields) >= 3 and fields[2] == "MOUSE":
+                self.other.append(line)
+            elif line.startswith("[LAT]") and fields[1] != "stage":
+                names = ("count", "min", "p50", "p90", "p99", "max")
+                self.latency[fields[1]] = dict(zip(names, map(int, fields[2:8])))
+
+    def states(self):
+        return [r.state() for r in self.reports]
+
+
+class Failure(Exception):
+    pass
+
+
+def key(row, col):
+    return KEY_1 + row * 3 + col
+
+
+def tap(t, row, col, hold=50):
+    return [f"{t} press {row} {col}", f"{t + hold} release {row} {col}"]
+
+
+def unicode_linux(text):
+    """Report states of Unicode_Send_String() in UNICODE_MODE_LINUX"""
+    out = []
+    for ch in text:
+        out += [(MOD_LCTRL_LSHIFT, (KEY_U,)), (0, ())]
+        for digit in f"{ord(ch):x}":
+            out += [(0, (HEX_KEYS[int(digit, 16)],)), (0, ())]
+        out += [(0, (KEY_SPACE,)), (0, ())]
+    return out
+
+
+def expected_from_events(lines):
+    """Report states for debounced press/release events in time order"""
+    held, out = [], []
+    for line in lines:
+        _, action, row, col = line.split()
+        k = key(int(row), int(col))
+        if action == "press":
+            held.append(k)
         else:
-            print("  ⊘ 跳过")
-    
-    print(f"\n结果: {passed} 通过, {failed} 失败")
-    return failed == 0
-
-def test_multikey_press():
-    """多键同时按下测试"""
-    print_header("Multi-Key Press Test")
-    
-    print("\n尝试同时按下多个按键 (最多6个)")
-    print("例如: 同时按下按键 0, 4, 8")
-    print("预期输出: 159 (在任意顺序下都应该输出这三个数字)")
-    
-    input("\n按 Enter 键开始多键测试...")
-    
-    result = input("\n看到同时输出的数字了吗? [y/n]: ").lower().strip()
-    
-    return result == 'y'
-
-def test_rapid_press():
-    """快速连续按键测试"""
-    print_header("Rapid Key Press Test")
-    
-    print("\n快速连续按下多个不同的按键")
-    print("预期: 所有按键都应该被正确识别,无遗漏")
-    
-    input("\n按 Enter 键开始快速按键测试...")
-    
-    result = input("\n所有按键都被识别了吗? [y/n]: ").lower().strip()
-    
-    return result == 'y'
-
-def test_debounce():
-    """防抖测试"""
-    print_header("Debounce Test")
-    
-    print("\n长按一个按键 (2-3秒不松开)")
-    print("预期: 按键应该只输入一次,不会重复输入")
-    
-    input("\n按 Enter 键开始防抖测试...")
-    
-    result = input("\n按键只输入了一次吗? [y/n]: ").lower().strip()
-    
-    return result == 'y'
-
-def test_device_detection():
-    """USB设备检测"""
-    print_header("USB Device Detection")
-    
-    system = platform.system()
-    
-    if system == "Linux":
-        print("\n检查 USB 设备...")
-        os.system("echo '\\n--- lsusb output ---'")
-        os.system("lsusb")
-        
-        print("\n\n--- dmesg output (recent) ---")
-        os.system("dmesg | tail -20")
-        
-        print("\n\n预期: 应该看到 STMicroelectronics STM32F4xx 设备")
-        
-    elif system == "Windows":
-        print("\n请按以下步骤检查设备:")
-        print("  1. 打开 设备管理器 (Win+X -> 设备管理器)")
-        print("  2. 展开 人机接口设备 (Human Interface Devices)")
-        print("  3. 查找 STM32F407 USB Keyboard 或类似设备")
-        print("  4. 确认设备状态正常 (无黄色警告标记)")
-        
-    elif system == "Darwin":
-        print("\n检查 USB 设备...")
-        os.system("system_profiler SPUSBDataType | grep -A 10 'STM'")
-    
-    result = input("\nUSB 设备被正确识别了吗? [y/n]: ").lower().strip()
-    
-    return result == 'y'
-
-def show_test_summary(results):
-    """显示测试总结"""
-    print_header("Test Summary")
-    
-    tests = [
-        ("USB Device Detection", results.get('detection', False)),
-        ("Basic Functionality", results.get('basic', False)),
-        ("Multi-Key Press", results.get('multikey', False)),
-        ("Rapid Key Press", results.get('rapid', False)),
-        ("Debounce", results.get('debounce', False)),
-    ]
-    
-    passed = sum(1 for _, result in tests if result)
-    total = len(tests)
-    
-    print()
-    for name, result in tests:
-        status = "✓ 通过" if result else "✗ 失败/跳过"
-        print(f"  {name}: {status}")
-    
-    print(f"\n总体结果: {passed}/{total} 通过")
-    
-    if passed == total:
-        print("\n🎉 所有测试通过! USB键盘工作正常!")
-        return True
-    else:
-        print("\n⚠️  部分测试失败,请检查硬件连接和驱动")
-        return False
-
-def show_troubleshooting():
-    """显示故障排查建议"""
-    print_header("Troubleshooting Tips")
-    
-    print("""
-如果测试失败,请按以下步骤排查:
-
-1. USB 无法识别
-   - 检查 USB 线连接
-   - 尝试不同的 USB 端口
-   - 检查设备管理器中是否有未知设备
-
-2. 部分按键无法输入
-   - 检查矩阵键盘硬件连接
-   - 用万用表测量 GPIO 引脚电压
-   - 查看 UART 调试输出确认是否检测到按键
-
-3. 输入重复或错误
-   - 增加消抖时间 (DEBOUNCE_TIME)
-   - 检查按键硬件质量
-   - 检查矩阵扫描代码
-
-4. 需要更多帮助
-   - 查看 USB_KEYBOARD_VERIFICATION.txt
-   - 查看 README.md
-   - 查看 UART 串口输出进行调试
-
-更新固件步骤:
-  make clean
-  make
-  sudo st-flash write build/keboard.bin 0x8000000
-    """)
+            held.remove(k)
+        out.append((0, tuple(held)))
+    return out
+
+
+def simulate(lines, scan_us=None, verbose=False):
+    with tempfile.NamedTemporaryFile("w", suffix=".txt", delete=False, encoding="utf-8") as f:
+        f.write("\n".join(lines) + "\n")
+        path = f.name
+    try:
+        cmd = [SIM_BIN, path]
+        if scan_us is not None:
+            cmd += ["--scan-us", str(scan_us)]
+        res = subprocess.run(cmd, capture_output=True, text=True, encoding="utf-8")
+    finally:
+        os.unlink(path)
+    if res.returncode != 0:
+        raise Failure(f"keyboard_sim exited with {res.returncode}: {res.stderr.strip()}")
+    if verbose:
+        print(res.stdout, end="")
+    return Run(res.stdout)
+
+
+def expect_states(run, expected):
+    got = run.states()
+    if got != expected:
+        fmt = lambda s: f"{s[0]:02X}:" + ",".join(f"{k:02X}" for k in s[1])
+        for i in range(max(len(got), len(expected))):
+            g = fmt(got[i]) if i < len(got) else "-"
+            e = fmt(expected[i]) if i < len(expected) else "-"
+            if g != e:
+                raise Failure(f"report {i}: got {g}, expected {e} ({len(got)} vs {len(expected)} reports)")
+    if any(r.deliver_us == 0 for r in run.reports):
+        raise Failure("report never delivered")
+
+
+def expect_at_most(name, value, limit):
+    if value > limit:
+        raise Failure(f"{name} = {value} exceeds {limit}")
+
+
+# ---------------------------------------------------------------------------
+# Cases: each returns a dict of metrics (possibly empty)
+# ---------------------------------------------------------------------------
+
+def case_single_keys(verbose):
+    lines, expected = [], []
+    for k in range(9):
+        lines += tap(10 + k * 100, k // 3, k % 3)
+        expected += [(0, (key(k // 3, k % 3),)), (0, ())]
+    run = simulate(lines, verbose=verbose)
+    expect_states(run, expected)
+    return {}
+
+
+def case_chord(verbose):
+    lines = ["10 press 0 0", "15 press 1 1", "60 release 0 0", "70 release 1 1"]
+    run = simulate(lines, verbose=verbose)
+    expect_states(run, [(0, (key(0, 0),)), (0, (key(0, 0), key(1, 1))), (0, (key(1, 1),)), (0, ())])
+    # Both presses land within one debounce window: the second report must
+    # follow the first in the next frame
+    gap = run.reports[1].deliver_us - run.reports[0].deliver_us
+    expect_at_most("chord report gap us", gap, 1000)
+    worst = run.latency["total"]["max"]
+    expect_at_most("chord latency us", worst, DEBOUNCE_MS * 1000 + 2 * 10000 + 1000)
+    return {"chord_latency_max_us": worst}
+
+
+def case_rollover(verbose):
+    """7 keys held: the report keeps the first 6, releases shift the rest"""
+    keys = [(r, c) for r in range(3) for c in range(3)][:7]
+    lines = [f"{10 + i * 30} press {r} {c}" for i, (r, c) in enumerate(keys)]
+    lines += [f"{400 + i * 30} release {r} {c}" for i, (r, c) in enumerate(keys)]
+    run = simulate(lines, verbose=verbose)
+    held, expected = [], []
+    for r, c in keys[:6]:
+        held.append(key(r, c))
+        expected.append((0, tuple(held)))
+    for r, c in keys[:6]:
+        held.remove(key(r, c))
+        expected.append((0, tuple(held)))
+    expect_states(run, expected)
+    return {}
+
+
+def case_debounce_glitch(verbose):
+    """Contact noise shorter than the debounce time never reaches the host"""
+    lines = []
+    for i in range(5):
+        t = 10 + i * 40
+        lines += [f"{t} press 2 2", f"{t + DEBOUNCE_MS // 4} release 2 2"]
+    lines += tap(300, 2, 2)
+    run = simulate(lines, scan_us=1000, verbose=verbose)
+    expect_states(run, [(0, (key(2, 2),)), (0, ())])
+    return {}
+
+
+def case_bounce(verbose):
+    """A bouncing press and release produce exactly one tap"""
+    lines = []
+    for t0, final in ((10, "press"), (100, "release")):
+        for i in range(6):
+            lines.append(f"{t0 + i} {'press' if i % 2 == 0 else 'release'} 1 0")
+        lines.append(f"{t0 + 6} {final} 1 0")
+    run = simulate(lines, scan_us=1000, verbose=verbose)
+    expect_states(run, [(0, (key(1, 0),)), (0, ())])
+    return {}
+
+
+def case_tap_latency(verbose):
+    """Edge to IN-complete latency at the default 10 ms scan period"""
+    lines = []
+    for i in range(50):
+        lines += tap(10 + i * 97, i % 3, (i // 3) % 3, hold=41)
+    run = simulate(lines, verbose=verbose)
+    if len(run.reports) != 100:
+        raise Failure(f"{len(run.reports)} reports, expected 100")
+    total = run.latency["total"]
+    if total["count"] != 100:
+        raise Failure(f"latency counted {total['count']} transitions, expected 100")
+    # Debounce + up to two scan periods + one frame
+    expect_at_most("tap latency max us", total["max"], DEBOUNCE_MS * 1000 + 2 * 10000 + 1000)
+    return {"tap_latency_max_us": total["max"], "tap_latency_p99_us": total["p99"]}
+
+
+def case_burst(verbose):
+    """Reports per second with three keys rolling as fast as debounce allows"""
+    events = []
+    hold = DEBOUNCE_MS + 5
+    for col in range(3):
+        for i in range(60):
+            t = 10 + col * 17 + i * 2 * hold
+            events += [(t, f"press 0 {col}"), (t + hold, f"release 0 {col}")]
+    lines = [f"{t} {e}" for t, e in sorted(events)]
+    run = simulate(lines, scan_us=1000, verbose=verbose)
+    expect_states(run, expected_from_events(lines))
+    span = run.reports[-1].deliver_us - run.reports[0].submit_us
+    rate = round(len(run.reports) * 1e6 / span)
+    if rate < 100:
+        raise Failure(f"{rate} reports/s, expected at least 100")
+    return {"burst_reports_per_s": rate}
+
+
+def case_text(verbose):
+    """Unicode text injection: exact sequence and characters per second"""
+    text = "Hello, wörld! ∑ 😀 " * 4
+    run = simulate([f"0 type {text}"], verbose=verbose)
+    expect_states(run, unicode_linux(text))
+    span = run.reports[-1].deliver_us - run.reports[0].submit_us
+    rate = round(len(text) * 1e6 / span)
+    if rate < 40:
+        raise Failure(f"{rate} chars/s, expected at least 40")
+    return {"text_chars_per_s": rate}
+
+
+def case_text_and_keys(verbose):
+    """A key pressed while text is typed is not lost"""
+    text = "abc"
+    run = simulate([f"0 type {text}", "5 press 2 1", "60 release 2 1"], verbose=verbose)
+    states = run.states()
+    k = key(2, 1)
+    if not any(k in s[1] for s in states):
+        raise Failure("key pressed during text injection was lost")
+    if states[-1] != (0, ()):
+        raise Failure(f"final report not empty: {states[-1]}")
+    typed = [s for s in states if k not in s[1]]
+    expected = [s for s in unicode_linux(text)]
+    if [s for s in typed if s[1]] != [s for s in expected if s[1]]:
+        raise Failure("text sequence corrupted by the key press")
+    return {}
+
+
+def case_text_held_key(verbose):
+    """Text typed while a key is held: a digit equal to the held key is
+    still a new press, and the held key is not released by the sequence"""
+    k = key(0, 0)                   # '1', a hex digit of U+0061
+    run = simulate(["0 press 0 0", f"{DEBOUNCE_MS + 20} type a", "500 release 0 0"], verbose=verbose)
+    expected = [(0, (k,)),
+                (MOD_LCTRL_LSHIFT, (k, KEY_U)), (0, (k,)),
+                (0, (k, HEX_KEYS[6])), (0, (k,)),
+                (0, ()), (0, (k,)),             # '1' lifted, then typed
+                (0, (k, KEY_SPACE)), (0, (k,)),
+                (0, ())]
+    expect_states(run, expected)
+    return {}
+
+
+def case_remap_held_key(verbose):
+    """Keymap change while the key is held: the old code is released at once
+    and the key's physical release is not turned into a release of the new code"""
+    k1, k5 = key(0, 0), key(1, 1)
+    run = simulate(["0 press 0 0", "100 keymap 0 4", "150 press 1 1", "200 release 0 0",
+                    "250 release 1 1"] + tap(300, 0, 0), verbose=verbose)
+    expected = [(0, (k1,)), (0, ()), (0, (k5,)), (0, ()),
+                (0, (KEY_A,)), (0, ())]
+    expect_states(run, expected)
+    return {}
+
+
+CASES = [
+    ("single_keys", case_single_keys),
+    ("chord", case_chord),
+    ("rollover", case_rollover),
+    ("debounce_glitch", case_debounce_glitch),
+    ("bounce", case_bounce),
+    ("tap_latency", case_tap_latency),
+    ("burst", case_burst),
+    ("text", case_text),
+    ("text_and_keys", case_text_and_keys),
+    ("text_held_key", case_text_held_key),
+    ("remap_held_key", case_remap_held_key),
+]
+
+
+def compare(metrics, baseline, threshold):
+    regressions = 0
+    print(f"\n{'metric':24s} {'base':>10s} {'now':>10s} {'change':>8s}")
+    for name, value in metrics.items():
+        if name not in baseline:
+            print(f"{name:24s} {'-':>10s} {value:>10d}      new")
+            continue
+        old = baseline[name]
+        pct = (value - old) * 100.0 / old if old else 0.0
+        worse = -pct if METRICS[name] else pct
+        flag = "  REGRESSION" if worse > threshold else ""
+        regressions += bool(flag)
+        print(f"{name:24s} {old:>10d} {value:>10d} {pct:>+7.1f}%{flag}")
+    for name in baseline:
+        if name not in metrics:
+            print(f"{name:24s} {baseline[name]:>10d} {'-':>10s}  missing")
+            regressions += 1
+    return regressions
+
 
 def main():
-    """主函数"""
-    print("\n" + "="*60)
-    print("  STM32F407 USB Keyboard Test Tool")
-    print("="*60)
-    
-    print("\n这个工具将帮助你验证 USB 键盘的功能")
-    print("按照提示完成各个测试步骤")
-    
-    # 确认准备好
-    ready = input("\n你已经准备好进行测试了吗? (y/n): ").lower().strip()
-    if ready != 'y':
-        print("请准备好后重新运行")
-        return
-    
-    results = {}
-    
-    # 测试1: USB设备检测
-    results['detection'] = test_device_detection()
-    
-    if results['detection']:
-        # 如果检测到USB设备,进行其他测试
-        results['basic'] = test_basic_functionality()
-        results['multikey'] = test_multikey_press()
-        results['rapid'] = test_rapid_press()
-        results['debounce'] = test_debounce()
-    else:
-        print("\n⚠️  USB 设备未被识别,跳过其他测试")
-        results['basic'] = False
-        results['multikey'] = False
-        results['rapid'] = False
-        results['debounce'] = False
-    
-    # 显示总结
-    success = show_test_summary(results)
-    
-    # 显示故障排查提示
-    if not success:
-        show_troubleshooting()
-    
-    print("\n" + "="*60)
-    print("  测试完成")
-    print("="*60 + "\n")
+    global SIM_BIN
+    parser = argparse.ArgumentParser(description="Automated keyboard tests on the host simulation")
+    parser.add_argument("-k", dest="pattern", help="only run cases whose name contains this")
+    parser.add_argument("-v", "--verbose", action="store_true", help="print the simulated reports")
+    parser.add_argument("--no-build", action="store_true", help="do not run make for the simulator")
+    parser.add_argument("--sim", default=SIM_BIN,
+                        help="simulator binary, e.g. loopback/build/keyboard_sim_usb for the real USB stack")
+    parser.add_argument("--save", help="write the performance metrics to a JSON file")
+    parser.add_argument("--baseline", help="compare the performance metrics against a JSON file")
+    parser.add_argument("--threshold", type=float, default=0.0,
+                        help="allowed change for the worse in percent (default 0: the sim is deterministic)")
+    opts = parser.parse_args()
+
+    SIM_BIN = os.path.abspath(opts.sim)
+    if not opts.no_build:
+        # <dir>/build/<program>: make it from <dir>
+        sim_dir = os.path.dirname(os.path.dirname(SIM_BIN))
+        res = subprocess.run(["make", "-s", "-C", sim_dir, "build/" + os.path.basename(SIM_BIN)])
+        if res.returncode != 0:
+            return 2
+
+    metrics, failed, ran = {}, 0, 0
+    for name, func in CASES:
+        if opts.pattern and opts.pattern not in name:
+            continue
+        ran += 1
+        try:
+            metrics.update(func(opts.verbose))
+            print(f"PASS  {name}")
+        except (Failure, KeyError, IndexError) as e:
+            failed += 1
+            print(f"FAIL  {name}: {e}")
+
+    if metrics:
+        print()
+        for name, value in metrics.items():
+            print(f"{name:24s} {value:>10d}")
+    if opts.save:
+        with open(opts.save, "w") as f:
+            json.dump(metrics, f, indent=2, sort_keys=True)
+            f.write("\n")
+
+    regressions = 0
+    if opts.baseline:
+        with open(opts.baseline) as f:
+            baseline = json.load(f)
+        if opts.pattern:
+            baseline = {k: v for k, v in baseline.items() if k in metrics}
+        regressions = compare(metrics, baseline, opts.threshold)
+
+    print(f"\n# {ran - failed}/{ran} passed, {regressions} regression(s)")
+    return 1 if failed or regressions else 0
+
 
 if __name__ == "__main__":
-    try:
-        main()
-    except KeyboardInterrupt:
-        print("\n\n测试被中断")
-        sys.exit(1)
+    sys.exit(main())
@@ -0,0 +1,37 @@
+/**
+  ******************************************************************************
+  * @file           : cdc_bench.h
+  * @brief          : CDC throughput and latency benchmark (device side)
+  *
+  * Line commands on the CDC port, one reply line each ("ok ..." or "err"):
+  *   info                       buffer sizes
+  *   source <bytes> <block>     device sends <bytes> of patterned blocks
+  *   sink <bytes> <block>       host sends them; "done <bytes> <bad> <ms>"
+  *                              follows once all bytes were checked
+  *   echo <bytes>               the next <bytes> bytes are sent back as is
+  * A block starts with its sequence number (32 bit, little endian), byte
+  * i >= 4 of block n is (uint8_t)(n + i). Blocks are at least 8 bytes.
+  * The host tool is usb/cdc_bench.py.
+  ******************************************************************************
+  */
+
+#ifndef __CDC_BENCH_H
+#define __CDC_BENCH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#define CDC_BENCH_LINE_MAX      48U
+#define CDC_BENCH_MIN_BLOCK     8U
+
+/* Function Prototypes */
+void Cdc_Bench_Poll(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __CDC_BENCH_H */
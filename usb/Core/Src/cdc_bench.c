@@ -0,0 +1,251 @@
+/**
+  ******************************************************************************
+  * @file           : cdc_bench.c
+  * @brief          : CDC throughput and latency benchmark (device side)
+  *
+  * Runs from the main loop on top of the CDC TX ring and RX queue of
+  * usbd_cdc_if.c. Source mode generates the pattern straight into the TX
+  * ring (CDC_TxReserve_FS), sink mode checks it as it is read, so both
+  * measure the bulk pipe and not a copy loop. Commands are read one byte
+  * at a time, so data that follows a command in the same packet is left
+  * for the mode it starts.
+  ******************************************************************************
+  */
+
+#include "cdc_bench.h"
+#include "usbd_cdc_if.h"
+#include "stm32f4xx_hal.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef enum {
+    CDC_BENCH_IDLE = 0,
+    CDC_BENCH_SOURCE,
+    CDC_BENCH_SINK,
+    CDC_BENCH_ECHO
+} Cdc_Bench_Mode_t;
+
+/* Position in the block pattern */
+typedef struct {
+    uint32_t seq;
+    uint32_t off;
+} Cdc_Bench_Pattern_t;
+
+static Cdc_Bench_Mode_t bench_mode = CDC_BENCH_IDLE;
+static uint32_t bench_total = 0;
+static uint32_t bench_done = 0;
+static uint32_t bench_block = 0;
+static uint32_t bench_bad = 0;
+static uint32_t bench_start_ms = 0;
+static Cdc_Bench_Pattern_t bench_pattern;
+
+static char bench_line[CDC_BENCH_LINE_MAX];
+static uint8_t bench_line_len = 0;
+
+/**
+  * @brief Next byte of the block pattern
+  * @retval Pattern byte
+  */
+static uint8_t Cdc_Bench_Next(Cdc_Bench_Pattern_t *p)
+{
+    uint8_t b = (p->off < 4U) ? (uint8_t)(p->seq >> (8U * p->off)) : (uint8_t)(p->seq + p->off);
+
+    if (++p->off == bench_block) {
+        p->off = 0;
+        p->seq++;
+    }
+    return b;
+}
+
+/* Reply lines are short and go out before any bulk data of the mode */
+static void Cdc_Bench_Reply(const char *fmt, ...)
+    __attribute__((format(printf, 1, 2)));
+
+static void Cdc_Bench_Reply(const char *fmt, ...)
+{
+    char buf[64];
+    va_list ap;
+    int n;
+
+    va_start(ap, fmt);
+    n = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    if (n > 0) {
+        CDC_Write_FS((const uint8_t *)buf, (uint16_t)((n < (int)sizeof(buf)) ? n : (int)sizeof(buf) - 1));
+    }
+}
+
+/**
+  * @brief Start a mode
+  * @param mode: Mode
+  * @param total: Bytes to move
+  * @param block: Block size (source and sink)
+  * @retval None
+  */
+static void Cdc_Bench_Start(Cdc_Bench_Mode_t mode, uint32_t total, uint32_t block)
+{
+    bench_mode = mode;
+    bench_total = total;
+    bench_done = 0;
+    bench_block = block;
+    bench_bad = 0;
+    bench_pattern.seq = 0;
+    bench_pattern.off = 0;
+    bench_start_ms = HAL_GetTick();
+    if (total == 0U) {
+        bench_mode = CDC_BENCH_IDLE;
+    }
+}
+
+/**
+  * @brief Parse and run a command line
+  * @param line: Command, NUL terminated, without the line end
+  * @retval None
+  */
+static void Cdc_Bench_Command(char *line)
+{
+    char *arg = strchr(line, ' ');
+    uint32_t bytes = 0;
+    uint32_t block = 0;
+
+    if (arg != NULL) {
+        *arg++ = '\0';
+        bytes = strtoul(arg, &arg, 0);
+        block = strtoul(arg, NULL, 0);
+    }
+
+    if (strcmp(line, "info") == 0) {
+        Cdc_Bench_Reply("ok cdc_bench rx %u tx %u mps %u\n",
+                        APP_RX_DATA_SIZE, APP_TX_DATA_SIZE, CDC_DATA_FS_MAX_PACKET_SIZE);
+    } else if (strcmp(line, "source") == 0 && block >= CDC_BENCH_MIN_BLOCK) {
+        Cdc_Bench_Reply("ok\n");
+        Cdc_Bench_Start(CDC_BENCH_SOURCE, bytes, block);
+    } else if (strcmp(line, "sink") == 0 && block >= CDC_BENCH_MIN_BLOCK) {
+        Cdc_Bench_Reply("ok\n");
+        Cdc_Bench_Start(CDC_BENCH_SINK, bytes, block);
+        if (bytes == 0U) {
+            Cdc_Bench_Reply("done 0 0 0\n");
+        }
+    } else if (strcmp(line, "echo") == 0) {
+        Cdc_Bench_Reply("ok\n");
+        Cdc_Bench_Start(CDC_BENCH_ECHO, bytes, 0);
+    } else if (line[0] != '\0') {
+        Cdc_Bench_Reply("err\n");
+    }
+}
+
+/* Idle: collect a command line */
+static void Cdc_Bench_Read_Command(void)
+{
+    uint8_t c;
+
+    while (bench_mode == CDC_BENCH_IDLE && CDC_Read_FS(&c, 1) == 1U) {
+        if (c == '\r') {
+            continue;
+        }
+        if (c != '\n') {
+            if (bench_line_len < CDC_BENCH_LINE_MAX - 1U) {
+                bench_line[bench_line_len++] = (char)c;
+            }
+            continue;
+        }
+        bench_line[bench_line_len] = '\0';
+        bench_line_len = 0;
+        Cdc_Bench_Command(bench_line);
+    }
+}
+
+/* Source: fill the free part of the TX ring with the pattern */
+static void Cdc_Bench_Source(void)
+{
+    while (bench_done < bench_total) {
+        uint16_t len;
+        uint8_t *dst = CDC_TxReserve_FS(&len);
+
+        if (len == 0U) {
+            return;
+        }
+        if (len > bench_total - bench_done) {
+            len = (uint16_t)(bench_total - bench_done);
+        }
+        for (uint16_t i = 0; i < len; i++) {
+            dst[i] = Cdc_Bench_Next(&bench_pattern);
+        }
+        CDC_TxCommit_FS(len);
+        bench_done += len;
+    }
+    bench_mode = CDC_BENCH_IDLE;
+}
+
+/* Sink: check what was received against the pattern */
+static void Cdc_Bench_Sink(void)
+{
+    uint8_t buf[CDC_DATA_FS_MAX_PACKET_SIZE];
+    uint16_t n;
+
+    while (bench_done < bench_total) {
+        uint32_t want = bench_total - bench_done;
+
+        n = CDC_Read_FS(buf, (want < sizeof(buf)) ? (uint16_t)want : (uint16_t)sizeof(buf));
+        if (n == 0U) {
+            return;
+        }
+        for (uint16_t i = 0; i < n; i++) {
+            bench_bad += (buf[i] != Cdc_Bench_Next(&bench_pattern));
+        }
+        bench_done += n;
+    }
+    bench_mode = CDC_BENCH_IDLE;
+    Cdc_Bench_Reply("done %lu %lu %lu\n", (unsigned long)bench_total,
+                    (unsigned long)bench_bad, (unsigned long)(HAL_GetTick() - bench_start_ms));
+}
+
+/* Echo: send back what was received, as far as the TX ring takes it */
+static void Cdc_Bench_Echo(void)
+{
+    uint8_t buf[CDC_DATA_FS_MAX_PACKET_SIZE];
+    uint16_t n;
+
+    while (bench_done < bench_total) {
+        uint32_t want = bench_total - bench_done;
+
+        if (want > sizeof(buf)) {
+            want = sizeof(buf);
+        }
+        if (want > CDC_TxFree_FS()) {
+            want = CDC_TxFree_FS();
+        }
+        n = CDC_Read_FS(buf, (uint16_t)want);
+        if (n == 0U) {
+            return;
+        }
+        CDC_Write_FS(buf, n);
+        bench_done += n;
+    }
+    bench_mode = CDC_BENCH_IDLE;
+}
+
+/**
+  * @brief Run the benchmark, call from the main loop
+  * Never blocks: each call moves what the TX ring and RX queue allow.
+  * @retval None
+  */
+void Cdc_Bench_Poll(void)
+{
+    switch (bench_mode) {
+    case CDC_BENCH_SOURCE:
+        Cdc_Bench_Source();
+        break;
+    case CDC_BENCH_SINK:
+        Cdc_Bench_Sink();
+        break;
+    case CDC_BENCH_ECHO:
+        Cdc_Bench_Echo();
+        break;
+    default:
+        Cdc_Bench_Read_Command();
+        break;
+    }
+}
@@ -24,6 +24,7 @@
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
 #include "usbd_cdc_if.h"
+#include "cdc_bench.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -100,9 +101,8 @@ int main(void)
     /* USER CODE END WHILE */
 
     /* USER CODE BEGIN 3 */
-      uint8_t data[] = "Hello USB!\r\n";
-    CDC_Transmit_FS(data, sizeof(data) - 1); // 发送数据
-    HAL_Delay(1000);
+    // CDC 基准测试: 命令见 cdc_bench.h, 主机端工具为 cdc_bench.py
+    Cdc_Bench_Poll();
   }
   /* USER CODE END 3 */
 }
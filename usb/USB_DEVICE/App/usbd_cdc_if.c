@@ -22,7 +22,7 @@
 #include "usbd_cdc_if.h"
 
 /* USER CODE BEGIN INCLUDE */
-
+#include <string.h>
 /* USER CODE END INCLUDE */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -62,6 +62,19 @@
   */
 
 /* USER CODE BEGIN PRIVATE_DEFINES */
+/* UserTxBufferFS is the TX ring, indices are masked on access */
+#if (APP_TX_DATA_SIZE & (APP_TX_DATA_SIZE - 1)) != 0
+#error "APP_TX_DATA_SIZE must be a power of two"
+#endif
+#define CDC_TX_MASK   (APP_TX_DATA_SIZE - 1U)
+
+/* UserRxBufferFS is cut into one-packet slots, used in turn */
+#define CDC_RX_SLOT_SIZE   CDC_DATA_FS_OUT_PACKET_SIZE
+#define CDC_RX_SLOTS       (APP_RX_DATA_SIZE / CDC_RX_SLOT_SIZE)
+#if (CDC_RX_SLOTS < 2) || ((CDC_RX_SLOTS & (CDC_RX_SLOTS - 1)) != 0)
+#error "APP_RX_DATA_SIZE must be a power of two of at least two packets"
+#endif
+#define CDC_RX_MASK   (CDC_RX_SLOTS - 1U)
 /* USER CODE END PRIVATE_DEFINES */
 
 /**
@@ -94,7 +107,20 @@ uint8_t UserRxBufferFS[APP_RX_DATA_SIZE];
 uint8_t UserTxBufferFS[APP_TX_DATA_SIZE];
 
 /* USER CODE BEGIN PRIVATE_VARIABLES */
-
+/* TX ring: the writer (thread context) owns tx_head, the IN endpoint side
+ * owns tx_tail and advances it from CDC_TransmitCplt_FS() */
+static volatile uint32_t tx_head = 0;
+static volatile uint32_t tx_tail = 0;
+static volatile uint32_t tx_len = 0;      /* Bytes owned by the running IN transfer */
+
+/* RX queue: the OUT endpoint side owns rx_head (slots filled), the reader
+ * owns rx_tail (slots consumed). Slot rx_head is armed unless the queue
+ * is full; then rx_parked is set and the endpoint NAKs until a slot frees */
+static volatile uint32_t rx_head = 0;
+static volatile uint32_t rx_tail = 0;
+static volatile uint8_t rx_parked = 0;
+static uint16_t rx_len[CDC_RX_SLOTS];
+static uint16_t rx_pos = 0;               /* Bytes of slot rx_tail already read */
 /* USER CODE END PRIVATE_VARIABLES */
 
 /**
@@ -128,7 +154,7 @@ static int8_t CDC_Receive_FS(uint8_t* pbuf, uint32_t *Len);
 static int8_t CDC_TransmitCplt_FS(uint8_t *pbuf, uint32_t *Len, uint8_t epnum);
 
 /* USER CODE BEGIN PRIVATE_FUNCTIONS_DECLARATION */
-
+static void CDC_TxKick_FS(void);
 /* USER CODE END PRIVATE_FUNCTIONS_DECLARATION */
 
 /**
@@ -154,6 +180,14 @@ static int8_t CDC_Init_FS(void)
   /* USER CODE BEGIN 3 */
   /* Set Application Buffers */
   USBD_CDC_SetTxBuffer(&hUsbDeviceFS, UserTxBufferFS, 0);
+  /* A transfer cut short by a bus reset is sent again from tx_tail */
+  tx_len = 0;
+  /* The class arms the OUT endpoint with slot 0 on return; received data
+   * not read yet belongs to the old session and is dropped */
+  rx_head = 0;
+  rx_tail = 0;
+  rx_pos = 0;
+  rx_parked = 0;
   USBD_CDC_SetRxBuffer(&hUsbDeviceFS, UserRxBufferFS);
   return (USBD_OK);
   /* USER CODE END 3 */
@@ -228,7 +262,8 @@ static int8_t CDC_Control_FS(uint8_t cmd, uint8_t* pbuf, uint16_t length)
     break;
 
     case CDC_SET_CONTROL_LINE_STATE:
-
+      /* Port opened: send what was queued while nobody listened */
+      CDC_TxKick_FS();
     break;
 
     case CDC_SEND_BREAK:
@@ -254,6 +289,11 @@ static int8_t CDC_Control_FS(uint8_t cmd, uint8_t* pbuf, uint16_t length)
   *         it will result in receiving more data while previous ones are still
   *         not sent.
   *
+  *         The packet stays in its slot for CDC_Read_FS()/CDC_RxPeek_FS().
+  *         The next slot is armed only if it is free: with the queue full
+  *         the endpoint is left unarmed, the host sees NAKs and retries,
+  *         and CDC_RxRelease_FS() arms it again. Nothing is overwritten.
+  *
   * @param  Buf: Buffer of data to be received
   * @param  Len: Number of data received (in bytes)
   * @retval Result of the operation: USBD_OK if all operations are OK else USBD_FAIL
@@ -261,8 +301,22 @@ static int8_t CDC_Control_FS(uint8_t cmd, uint8_t* pbuf, uint16_t length)
 static int8_t CDC_Receive_FS(uint8_t* Buf, uint32_t *Len)
 {
   /* USER CODE BEGIN 6 */
-  USBD_CDC_SetRxBuffer(&hUsbDeviceFS, &Buf[0]);
-  USBD_CDC_ReceivePacket(&hUsbDeviceFS);
+  UNUSED(Buf);
+  if (*Len != 0U)
+  {
+    rx_len[rx_head & CDC_RX_MASK] = (uint16_t)*Len;
+    rx_head++;
+  }
+  /* A ZLP leaves the slot empty: armed again as is */
+  if (rx_head - rx_tail < CDC_RX_SLOTS)
+  {
+    USBD_CDC_SetRxBuffer(&hUsbDeviceFS, &UserRxBufferFS[(rx_head & CDC_RX_MASK) * CDC_RX_SLOT_SIZE]);
+    USBD_CDC_ReceivePacket(&hUsbDeviceFS);
+  }
+  else
+  {
+    rx_parked = 1;
+  }
   return (USBD_OK);
   /* USER CODE END 6 */
 }
@@ -311,12 +365,225 @@ static int8_t CDC_TransmitCplt_FS(uint8_t *Buf, uint32_t *Len, uint8_t epnum)
   UNUSED(Buf);
   UNUSED(Len);
   UNUSED(epnum);
+  /* Release the sent bytes and chain the next chunk */
+  tx_tail += tx_len;
+  tx_len = 0;
+  CDC_TxKick_FS();
   /* USER CODE END 13 */
   return result;
 }
 
 /* USER CODE BEGIN PRIVATE_FUNCTIONS_IMPLEMENTATION */
 
+/**
+  * @brief  CDC_TxKick_FS
+  *         Start an IN transfer if the endpoint is idle and data is queued.
+  *         Each transfer covers the contiguous part of the ring up to the
+  *         wrap, so a busy endpoint collects everything written meanwhile
+  *         and sends it as full packets back to back. A transfer that ends
+  *         on a packet boundary is closed with a ZLP by usbd_cdc.c.
+  *         Must run with interrupts masked or from the USB interrupt.
+  * @retval None
+  */
+static void CDC_TxKick_FS(void)
+{
+  USBD_CDC_HandleTypeDef *hcdc = (USBD_CDC_HandleTypeDef*)hUsbDeviceFS.pClassData;
+  uint32_t start, len;
+
+  if (tx_len != 0U || tx_head == tx_tail)
+  {
+    return;
+  }
+  /* Not configured yet, or a CDC_Transmit_FS() transfer is running */
+  if (hUsbDeviceFS.dev_state != USBD_STATE_CONFIGURED || hcdc == NULL || hcdc->TxState != 0U)
+  {
+    return;
+  }
+
+  start = tx_tail & CDC_TX_MASK;
+  len = tx_head - tx_tail;
+  if (len > APP_TX_DATA_SIZE - start)
+  {
+    len = APP_TX_DATA_SIZE - start;   /* Up to the wrap, rest in the next transfer */
+  }
+
+  USBD_CDC_SetTxBuffer(&hUsbDeviceFS, &UserTxBufferFS[start], len);
+  if (USBD_CDC_TransmitPacket(&hUsbDeviceFS) == USBD_OK)
+  {
+    tx_len = len;
+  }
+}
+
+/**
+  * @brief  CDC_TxReserve_FS
+  *         Contiguous free space at the head of the TX ring, to be filled in
+  *         place and queued with CDC_TxCommit_FS(). Thread context only.
+  * @param  Len: Receives the free space in bytes (may be less than
+  *         CDC_TxFree_FS() at the wrap, 0 if the ring is full)
+  * @retval Write pointer
+  */
+uint8_t *CDC_TxReserve_FS(uint16_t *Len)
+{
+  uint32_t pos = tx_head & CDC_TX_MASK;
+  uint32_t space = APP_TX_DATA_SIZE - (tx_head - tx_tail);
+
+  if (space > APP_TX_DATA_SIZE - pos)
+  {
+    space = APP_TX_DATA_SIZE - pos;
+  }
+  *Len = (uint16_t)space;
+  return &UserTxBufferFS[pos];
+}
+
+/**
+  * @brief  CDC_TxCommit_FS
+  *         Queue bytes written at the pointer from CDC_TxReserve_FS()
+  * @param  Len: Bytes written (at most the reserved length)
+  * @retval None
+  */
+void CDC_TxCommit_FS(uint16_t Len)
+{
+  uint32_t primask;
+
+  if (Len == 0U)
+  {
+    return;
+  }
+  tx_head += Len;
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+  CDC_TxKick_FS();
+  __set_PRIMASK(primask);
+}
+
+/**
+  * @brief  CDC_Write_FS
+  *         Copy data into the TX ring and start sending, never blocks.
+  *         Unlike CDC_Transmit_FS() the buffer can be reused on return and
+  *         a busy endpoint does not lose data.
+  * @param  Buf: Data to send
+  * @param  Len: Number of bytes
+  * @retval Bytes queued: Len, or less if the ring is full
+  */
+uint16_t CDC_Write_FS(const uint8_t* Buf, uint16_t Len)
+{
+  uint16_t done = 0;
+
+  while (done < Len)
+  {
+    uint16_t space;
+    uint8_t *dst = CDC_TxReserve_FS(&space);
+
+    if (space == 0U)
+    {
+      break;
+    }
+    if (space > Len - done)
+    {
+      space = Len - done;
+    }
+    memcpy(dst, Buf + done, space);
+    CDC_TxCommit_FS(space);
+    done += space;
+  }
+  return done;
+}
+
+/**
+  * @brief  CDC_RxPeek_FS
+  *         Oldest received packet not released yet (zero-copy read).
+  *         Thread context only.
+  * @param  Len: Receives the unread bytes of the packet
+  * @retval Pointer to the unread bytes, NULL if nothing was received
+  */
+uint8_t *CDC_RxPeek_FS(uint16_t *Len)
+{
+  uint32_t slot = rx_tail & CDC_RX_MASK;
+
+  if (rx_head == rx_tail)
+  {
+    *Len = 0;
+    return NULL;
+  }
+  *Len = rx_len[slot] - rx_pos;
+  return &UserRxBufferFS[slot * CDC_RX_SLOT_SIZE + rx_pos];
+}
+
+/**
+  * @brief  CDC_RxRelease_FS
+  *         Hand the packet from CDC_RxPeek_FS() back to the OUT endpoint.
+  *         Re-arms the endpoint if it was NAKing for lack of a free slot.
+  * @retval None
+  */
+void CDC_RxRelease_FS(void)
+{
+  uint32_t primask;
+
+  if (rx_head == rx_tail)
+  {
+    return;
+  }
+  rx_pos = 0;
+  rx_tail++;
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+  if (rx_parked)
+  {
+    rx_parked = 0;
+    USBD_CDC_SetRxBuffer(&hUsbDeviceFS, &UserRxBufferFS[(rx_head & CDC_RX_MASK) * CDC_RX_SLOT_SIZE]);
+    USBD_CDC_ReceivePacket(&hUsbDeviceFS);
+  }
+  __set_PRIMASK(primask);
+}
+
+/**
+  * @brief  CDC_Read_FS
+  *         Copy received data out of the RX queue, never blocks.
+  *         Packets are released as they are emptied.
+  * @param  Buf: Destination
+  * @param  Len: Size of Buf
+  * @retval Bytes copied, 0 if nothing was received
+  */
+uint16_t CDC_Read_FS(uint8_t* Buf, uint16_t Len)
+{
+  uint16_t done = 0;
+
+  while (done < Len)
+  {
+    uint16_t avail;
+    uint8_t *src = CDC_RxPeek_FS(&avail);
+
+    if (src == NULL)
+    {
+      break;
+    }
+    if (avail > Len - done)
+    {
+      avail = Len - done;
+    }
+    memcpy(Buf + done, src, avail);
+    done += avail;
+    rx_pos += avail;
+    if (rx_pos >= rx_len[rx_tail & CDC_RX_MASK])
+    {
+      CDC_RxRelease_FS();
+    }
+  }
+  return done;
+}
+
+/**
+  * @brief  CDC_TxFree_FS
+  *         Free space in the TX ring
+  * @retval Bytes CDC_Write_FS() accepts now
+  */
+uint16_t CDC_TxFree_FS(void)
+{
+  return (uint16_t)(APP_TX_DATA_SIZE - (tx_head - tx_tail));
+}
+
 /* USER CODE END PRIVATE_FUNCTIONS_IMPLEMENTATION */
 
 /**
@@ -49,8 +49,8 @@
   * @{
   */
 /* Define size for the receive and transmit buffer over CDC */
-#define APP_RX_DATA_SIZE  512
-#define APP_TX_DATA_SIZE  512
+#define APP_RX_DATA_SIZE  2048
+#define APP_TX_DATA_SIZE  2048
 /* USER CODE BEGIN EXPORTED_DEFINES */
 
 /* USER CODE END EXPORTED_DEFINES */
@@ -109,7 +109,15 @@ extern USBD_CDC_ItfTypeDef USBD_Interface_fops_FS;
 uint8_t CDC_Transmit_FS(uint8_t* Buf, uint16_t Len);
 
 /* USER CODE BEGIN EXPORTED_FUNCTIONS */
-
+/* Streaming TX ring (UserTxBufferFS), chained from the IN completion */
+uint16_t CDC_Write_FS(const uint8_t* Buf, uint16_t Len);
+uint8_t *CDC_TxReserve_FS(uint16_t *Len);
+void CDC_TxCommit_FS(uint16_t Len);
+uint16_t CDC_TxFree_FS(void);
+/* RX queue (UserRxBufferFS in packet slots), NAKs the host when full */
+uint16_t CDC_Read_FS(uint8_t* Buf, uint16_t Len);
+uint8_t *CDC_RxPeek_FS(uint16_t *Len);
+void CDC_RxRelease_FS(void);
 /* USER CODE END EXPORTED_FUNCTIONS */
 
 /**
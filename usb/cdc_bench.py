@@ -0,0 +1,230 @@
+#!/usr/bin/env python3
+"""
+CDC Benchmark
+测量 CDC 虚拟串口的吞吐量与往返延迟 (设备端见 Core/Src/cdc_bench.c)
+
+使用方法:
+  python3 cdc_bench.py --port /dev/ttyACM0                  # 默认块大小与字节数
+  python3 cdc_bench.py --port COM5 --sizes 64,1024 --bytes 4M
+  python3 cdc_bench.py --loopback                           # 主机上的软件 USB 总线
+  python3 cdc_bench.py --loopback --rtt 1000 --rtt-size 1,64,512
+
+For every block size in --sizes the device sends --bytes of patterned
+blocks (source) and then checks the same amount sent by the host (sink).
+Every block starts with its 32 bit little endian sequence number, so a lost
+or repeated USB packet shows up as a sequence error, not only as a count
+mismatch. The round trip time is measured with the echo command: the time
+from writing --rtt-size bytes until they are all read back.
+--loopback runs ../keboard/loopback/build/cdc_loopback --stdio instead of a
+serial port: the same device code on the USB stack over a modelled full
+speed bus, whose timing follows the wall clock. Serial ports need pyserial.
+Exit code: 0 = ok, 1 = data errors, 2 = device did not answer.
+"""
+
+import argparse
+import os
+import select
+import subprocess
+import sys
+import time
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+LOOPBACK_BIN = os.path.join(HERE, "..", "keboard", "loopback", "build", "cdc_loopback")
+
+MIN_BLOCK = 8                       # CDC_BENCH_MIN_BLOCK in Core/Inc/cdc_bench.h
+TIMEOUT_S = 10.0
+
+
+class Timeout(Exception):
+    pass
+
+
+class SerialLink:
+    def __init__(self, port):
+        try:
+            import serial
+        except ImportError:
+            raise SystemExit("pyserial is required for serial ports: pip install pyserial")
+        self.s = serial.Serial(port, 115200, timeout=TIMEOUT_S, write_timeout=TIMEOUT_S)
+        self.s.reset_input_buffer()
+
+    def write(self, data):
+        self.s.write(data)
+        self.s.flush()
+
+    def read(self, n):
+        data = self.s.read(n)
+        if len(data) < n:
+            raise Timeout(f"got {len(data)} of {n} bytes")
+        return data
+
+    def close(self):
+        self.s.close()
+
+
+class LoopbackLink:
+    def __init__(self, path):
+        if not os.path.exists(path):
+            raise SystemExit(f"{path} not found: make -C keboard/loopback")
+        self.p = subprocess.Popen([path, "--stdio"], stdin=subprocess.PIPE,
+                                  stdout=subprocess.PIPE, bufsize=0)
+        self.fd = self.p.stdout.fileno()
+
+    def write(self, data):
+        self.p.stdin.write(data)
+
+    def read(self, n):
+        parts = []
+        deadline = time.monotonic() + TIMEOUT_S
+        while n > 0:
+            left = deadline - time.monotonic()
+            if left <= 0 or not select.select([self.fd], [], [], left)[0]:
+                raise Timeout(f"{n} bytes missing")
+            chunk = os.read(self.fd, min(n, 65536))
+            if not chunk:
+                raise Timeout("cdc_loopback exited")
+            parts.append(chunk)
+            n -= len(chunk)
+        return b"".join(parts)
+
+    def close(self):
+        self.p.stdin.close()
+        self.p.wait()
+
+
+def readline(link):
+    line = bytearray()
+    while not line.endswith(b"\n"):
+        line += link.read(1)
+    return line.decode("ascii", "replace").strip()
+
+
+def command(link, cmd):
+    link.write(cmd.encode("ascii") + b"\n")
+    reply = readline(link)
+    if not reply.startswith("ok"):
+        raise Timeout(f"'{cmd}': {reply}")
+    return reply
+
+
+def pattern(total, block):
+    """Block stream as cdc_bench.c generates it"""
+    ramp = bytes(range(256)) * ((block + 511) // 256)
+    out = bytearray()
+    seq = 0
+    while len(out) < total:
+        body = ramp[(seq + 4) & 0xFF:][:block - 4]
+        out += seq.to_bytes(4, "little") + body
+        seq += 1
+    return bytes(out[:total])
+
+
+def check(name, got, expect, block):
+    """Describe the first difference, None if the data matches"""
+    if got == expect:
+        return None
+    pos = next(i for i in range(min(len(got), len(expect))) if got[i] != expect[i])
+    n, off = divmod(pos, block)
+    head = got[n * block:n * block + 4]
+    seq = int.from_bytes(head, "little") if len(head) == 4 else None
+    return (f"{name}: first error at byte {pos} (block {n}, offset {off}), "
+            f"block carries sequence number {seq}")
+
+
+def parse_size(text):
+    scale = {"K": 1024, "M": 1024 * 1024}.get(text[-1:].upper(), 1)
+    return int(text[:-1] if scale > 1 else text, 0) * scale
+
+
+def percentile(values, p):
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * p / 100))]
+
+
+def run_source(link, total, block):
+    t0 = time.perf_counter()
+    command(link, f"source {total} {block}")
+    data = link.read(total)
+    dt = time.perf_counter() - t0
+    return dt, check("source", data, pattern(total, block), block)
+
+
+def run_sink(link, total, block):
+    data = pattern(total, block)
+    t0 = time.perf_counter()
+    command(link, f"sink {total} {block}")
+    for i in range(0, total, 4096):
+        link.write(data[i:i + 4096])
+    done = readline(link).split()
+    dt = time.perf_counter() - t0
+    if len(done) != 4 or done[0] != "done":
+        raise Timeout(f"sink: {' '.join(done)}")
+    bad = int(done[2])
+    return dt, int(done[3]), (f"sink: device counted {bad} bad bytes" if bad else None)
+
+
+def run_rtt(link, count, size):
+    payload = bytes((i * 7) & 0xFF for i in range(size))
+    times = []
+    for _ in range(count):
+        command(link, f"echo {size}")
+        t0 = time.perf_counter()
+        link.write(payload)
+        back = link.read(size)
+        times.append((time.perf_counter() - t0) * 1e6)
+        if back != payload:
+            return times, f"echo {size}: data differs"
+    return times, None
+
+
+def main():
+    parser = argparse.ArgumentParser(description="CDC throughput and latency benchmark")
+    where = parser.add_mutually_exclusive_group(required=True)
+    where.add_argument("--port", help="serial port of the device")
+    where.add_argument("--loopback", nargs="?", const=LOOPBACK_BIN,
+                       help="run cdc_loopback --stdio (default %(const)s)")
+    parser.add_argument("--sizes", default="64,512,4096",
+                        help="block sizes, comma separated (default %(default)s)")
+    parser.add_argument("--bytes", default="1M", help="bytes per direction and size (default %(default)s)")
+    parser.add_argument("--rtt", type=int, default=200, help="echo round trips per size (default %(default)s)")
+    parser.add_argument("--rtt-size", default="1,64",
+                        help="echo payload sizes, comma separated (default %(default)s)")
+    args = parser.parse_args()
+
+    sizes = [parse_size(s) for s in args.sizes.split(",")]
+    rtt_sizes = [parse_size(s) for s in args.rtt_size.split(",")]
+    total = parse_size(args.bytes)
+    if min(sizes) < MIN_BLOCK:
+        raise SystemExit(f"block sizes must be at least {MIN_BLOCK}")
+
+    link = LoopbackLink(args.loopback) if args.loopback else SerialLink(args.port)
+    errors = []
+    try:
+        print(f"# {command(link, 'info')[3:]}")
+        print(f"{'block':>6} {'source MB/s':>12} {'sink MB/s':>10} {'sink dev ms':>12}")
+        for block in sizes:
+            src_s, err_src = run_source(link, total, block)
+            sink_s, dev_ms, err_sink = run_sink(link, total, block)
+            print(f"{block:>6} {total / src_s / 1e6:>12.3f} {total / sink_s / 1e6:>10.3f} {dev_ms:>12}")
+            errors += [e for e in (err_src, err_sink) if e]
+        if args.rtt > 0:
+            print(f"{'echo':>6} {'min us':>9} {'p50':>9} {'p90':>9} {'p99':>9} {'max':>9}")
+            for size in rtt_sizes:
+                times, err = run_rtt(link, args.rtt, size)
+                print(f"{size:>6} {min(times):>9.0f} {percentile(times, 50):>9.0f} "
+                      f"{percentile(times, 90):>9.0f} {percentile(times, 99):>9.0f} {max(times):>9.0f}")
+                if err:
+                    errors.append(err)
+    except Timeout as e:
+        print(f"no answer: {e}", file=sys.stderr)
+        return 2
+    finally:
+        link.close()
+
+    for e in errors:
+        print(e, file=sys.stderr)
+    return 1 if errors else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())